@@ -11,42 +11,32 @@ Texture2DArray normalMapTexture : register (t1);
 
 SamplerState colorSampler : register(s0);
 
-struct ModelBuffer
+struct Material
 {
-    float4x4 model;
-    float4x4 normTransform;
-    float4 lightParams;
-    float4 baseColor;
-    int4 modelInfo;
+    float4 lightParams; //x - ambientCoef, y - diffuseCoef, z - specularCoef, w - shinines
+    float4 baseColor; //xyz - color, w - opacity
+    int4 modelInfo; //x - color texture, y - normal map, z - use light
 };
 
-cbuffer ModelBufferInst : register (b1)
-{
-    ModelBuffer modelBuffer[100];
-};
-
-cbuffer VisibleInstIdBuffer : register (b2)
-{
-    uint4 ids[100];
-};
+StructuredBuffer<Material> materials : register (t7);
 
 struct VSOutput
 {
     float4 pos : SV_Position;
     float4 worldPos : POSITION;
-    float3 tang : TANGENT;
+    float4 tang : TANGENT;
     float3 norm : NORMAL;
     float2 uv : TEXCOORD;
-    nointerpolation uint instanceId : INST_ID;
+    nointerpolation uint materialId : MATERIAL_ID;
 };
 
 float4 ps(VSOutput pixel) : SV_Target0
 {
-    uint idx = pixel.instanceId;
-    float3 color = modelBuffer[idx].baseColor.xyz;
+    Material material = materials[pixel.materialId];
+    float3 color = material.baseColor.xyz;
 
 #ifdef USE_TEXTURE
-    int colorTextureId = modelBuffer[idx].modelInfo.x;
+    int colorTextureId = material.modelInfo.x;
     if (colorTextureId >= 0)
     {
         color = color * colorTexture.Sample(colorSampler, float3(pixel.uv, colorTextureId)).xyz;
@@ -56,12 +46,12 @@ float4 ps(VSOutput pixel) : SV_Target0
 
     float3 normal = normalize(pixel.norm);
 #ifdef USE_NORMAL_MAP
-    int normalMapId = modelBuffer[idx].modelInfo.y;
+    int normalMapId = material.modelInfo.y;
     if (normalMapId >= 0)
     {
         float3 localNorm = normalMapTexture.Sample(colorSampler, float3(pixel.uv, normalMapId)).xyz * 2.0 - float3(1.0, 1.0, 1.0);
-        float3 tangent = normalize(pixel.tang);
-        float3 binorm = cross(tangent, normal);
+        float3 tangent = normalize(pixel.tang.xyz);
+        float3 binorm = cross(tangent, normal) * (pixel.tang.w < 0.0 ? -1.0 : 1.0);
         normal = normalize(localNorm.x * tangent + localNorm.y * binorm + localNorm.z * normal);
     }
 #endif //USE_NORMAL_MAP
@@ -73,16 +63,16 @@ float4 ps(VSOutput pixel) : SV_Target0
 #endif //USE_TRANSPARENCY
 
 #ifdef USE_LIGHT
-    if (modelBuffer[idx].modelInfo.z != 0)
+    if (material.modelInfo.z != 0)
     {
-        color = CalculateColor(color, normal, pixel.worldPos.xyz, modelBuffer[idx].lightParams, _IS_TRANSPARENT);
+        color = CalculateColor(color, normal, pixel.worldPos.xyz, material.lightParams, _IS_TRANSPARENT);
     }
 #endif //USE_LIGHT
 
 #undef _IS_TRANSPARENT
 
 #ifdef USE_TRANSPARENCY
-    return float4(color, modelBuffer[idx].baseColor.w);
+    return float4(color, material.baseColor.w);
 #else
     return float4(color, 1.0);
 #endif //USE_TRANSPARENCY
@@ -2,29 +2,25 @@
 
 struct ModelBuffer
 {
-    float4x4 model;
-    float4x4 normTransform;
-    float4 lightParams; //x - ambientCoef, y - diffuseCoef, z - specularCoef, w - shinines
-    float4 baseColor; //xyz - color, w - opacity
-    int4 colorTextureId_normalMapId_useLight;
+    float4 world[3]; // first three columns of the affine model matrix
+    uint materialId; // in the material buffer of the pixel shader
 };
 
-cbuffer ModelBufferInst : register (b1)
+StructuredBuffer<ModelBuffer> modelBuffer : register (t5);
+
+cbuffer DrawBuffer : register (b2)
 {
-    ModelBuffer modelBuffer[100];
+    uint4 drawOffsets; // x - first instance, y - first visible id in the upload buffers
 };
 
 #ifdef USE_VISIBLE_ID
-cbuffer VisibleInstIdBuffer : register (b2)
-{
-    uint4 ids[100];
-};
+StructuredBuffer<uint> ids : register (t6);
 #endif //USE_VISIBLE_ID
 
 struct VSInput
 {
     float3 pos : POSITION;
-    float3 tang : TANGENT;
+    float4 tang : TANGENT;
     float3 norm : NORMAL;
     float2 uv : TEXCOORD;
     uint instanceId : SV_InstanceID;
@@ -34,26 +30,33 @@ struct VSOutput
 {
     float4 pos : SV_Position;
     float4 worldPos : POSITION;
-    float3 tang : TANGENT;
+    float4 tang : TANGENT;
     float3 norm : NORMAL;
     float2 uv : TEXCOORD;
-    nointerpolation uint instanceId : INST_ID;
+    nointerpolation uint materialId : MATERIAL_ID;
 };
 
 VSOutput vs(VSInput vertex)
 {
     VSOutput result;
 #ifdef USE_VISIBLE_ID
-    uint idx = ids[vertex.instanceId].x;
+    uint idx = drawOffsets.x + ids[drawOffsets.y + vertex.instanceId];
 #else
-    uint idx = vertex.instanceId;
+    uint idx = drawOffsets.x + vertex.instanceId;
 #endif //USE_VISIBLE_ID
-    result.worldPos = mul(modelBuffer[idx].model, float4(vertex.pos, 1.0));
+    float4 world[3] = modelBuffer[idx].world;
+    float4 pos = float4(vertex.pos, 1.0);
+    result.worldPos = float4(dot(world[0], pos), dot(world[1], pos), dot(world[2], pos), 1.0);
     result.pos = mul(vp, result.worldPos);
-    result.tang = mul(modelBuffer[idx].normTransform, float4(vertex.tang, 0.0)).xyz;
-    result.norm = mul(modelBuffer[idx].normTransform, float4(vertex.norm, 0.0)).xyz;
+
+    // Cofactors are the inverse transpose scaled by the determinant, only its sign matters for normals
+    float3x3 axes = float3x3(world[0].xyz, world[1].xyz, world[2].xyz);
+    float3x3 cofactors = float3x3(cross(axes[1], axes[2]), cross(axes[2], axes[0]), cross(axes[0], axes[1]));
+    float handedness = dot(axes[0], cofactors[0]) < 0.0 ? -1.0 : 1.0;
+    result.tang = float4(mul(axes, vertex.tang.xyz), vertex.tang.w * handedness);
+    result.norm = mul(cofactors, vertex.norm) * handedness;
     result.uv = vertex.uv;
-    result.instanceId = idx;
+    result.materialId = modelBuffer[idx].materialId;
 
     return result;
 }
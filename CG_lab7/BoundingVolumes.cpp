@@ -0,0 +1,223 @@
+#include "BoundingVolumes.h"
+#include <cfloat>
+
+namespace
+{
+	const DirectX::XMFLOAT3& PositionAt(const void* pPositions, size_t stride, size_t index)
+	{
+		return *reinterpret_cast<const DirectX::XMFLOAT3*>(static_cast<const BYTE*>(pPositions) + stride * index);
+	}
+
+	size_t FarthestPoint(const void* pPositions, size_t stride, size_t count, DirectX::FXMVECTOR from)
+	{
+		size_t farthest = 0;
+		float farthestDistSq = -1.0f;
+		for (size_t i = 0; i < count; i++)
+		{
+			DirectX::XMVECTOR point = DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, i));
+			float distSq = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(point, from)));
+			if (distSq > farthestDistSq)
+			{
+				farthestDistSq = distSq;
+				farthest = i;
+			}
+		}
+		return farthest;
+	}
+
+	// Cyclic Jacobi rotations, the columns of outVectors are the eigenvectors of the symmetric matrix
+	void EigenVectors(float matrix[3][3], float outVectors[3][3])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				outVectors[i][j] = i == j ? 1.0f : 0.0f;
+		}
+		for (int sweep = 0; sweep < 32; sweep++)
+		{
+			float offDiagonal = fabsf(matrix[0][1]) + fabsf(matrix[0][2]) + fabsf(matrix[1][2]);
+			if (offDiagonal < 1e-9f)
+				break;
+			for (int p = 0; p < 2; p++)
+			{
+				for (int q = p + 1; q < 3; q++)
+				{
+					if (fabsf(matrix[p][q]) < 1e-12f)
+						continue;
+					float theta = (matrix[q][q] - matrix[p][p]) / (2.0f * matrix[p][q]);
+					float t = (theta >= 0.0f ? 1.0f : -1.0f) / (fabsf(theta) + sqrtf(theta * theta + 1.0f));
+					float c = 1.0f / sqrtf(t * t + 1.0f);
+					float s = t * c;
+					for (int k = 0; k < 3; k++)
+					{
+						float kp = matrix[k][p];
+						float kq = matrix[k][q];
+						matrix[k][p] = c * kp - s * kq;
+						matrix[k][q] = s * kp + c * kq;
+					}
+					for (int k = 0; k < 3; k++)
+					{
+						float pk = matrix[p][k];
+						float qk = matrix[q][k];
+						matrix[p][k] = c * pk - s * qk;
+						matrix[q][k] = s * pk + c * qk;
+					}
+					for (int k = 0; k < 3; k++)
+					{
+						float kp = outVectors[k][p];
+						float kq = outVectors[k][q];
+						outVectors[k][p] = c * kp - s * kq;
+						outVectors[k][q] = s * kp + c * kq;
+					}
+				}
+			}
+		}
+	}
+
+	// Fits the box along the given orthonormal axes, returns its volume with flat sides counted as thin slabs
+	float FitBox(const void* pPositions, size_t stride, size_t count, const DirectX::XMFLOAT3 axes[3], OrientedBox& outBox)
+	{
+		float minProj[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float maxProj[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (size_t i = 0; i < count; i++)
+		{
+			DirectX::XMVECTOR point = DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, i));
+			for (int a = 0; a < 3; a++)
+			{
+				float proj = DirectX::XMVectorGetX(DirectX::XMVector3Dot(point, DirectX::XMLoadFloat3(&axes[a])));
+				minProj[a] = min(minProj[a], proj);
+				maxProj[a] = max(maxProj[a], proj);
+			}
+		}
+
+		DirectX::XMVECTOR center = DirectX::XMVectorZero();
+		float extents[3];
+		for (int a = 0; a < 3; a++)
+		{
+			outBox.axes[a] = axes[a];
+			extents[a] = (maxProj[a] - minProj[a]) * 0.5f;
+			center = DirectX::XMVectorAdd(center, DirectX::XMVectorScale(DirectX::XMLoadFloat3(&axes[a]), (maxProj[a] + minProj[a]) * 0.5f));
+		}
+		DirectX::XMStoreFloat3(&outBox.center, center);
+		outBox.extents = DirectX::XMFLOAT3(extents[0], extents[1], extents[2]);
+
+		const float slab = 1e-4f * (extents[0] + extents[1] + extents[2]);
+		return (extents[0] + slab) * (extents[1] + slab) * (extents[2] + slab);
+	}
+}
+
+AxisAlignedBox ComputeAxisAlignedBox(const void* pPositions, size_t stride, size_t count)
+{
+	AxisAlignedBox box;
+	if (count == 0)
+		return box;
+
+	DirectX::XMVECTOR minVec = DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, 0));
+	DirectX::XMVECTOR maxVec = minVec;
+	for (size_t i = 1; i < count; i++)
+	{
+		DirectX::XMVECTOR point = DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, i));
+		minVec = DirectX::XMVectorMin(minVec, point);
+		maxVec = DirectX::XMVectorMax(maxVec, point);
+	}
+	DirectX::XMStoreFloat3(&box.center, DirectX::XMVectorScale(DirectX::XMVectorAdd(minVec, maxVec), 0.5f));
+	DirectX::XMStoreFloat3(&box.extents, DirectX::XMVectorScale(DirectX::XMVectorSubtract(maxVec, minVec), 0.5f));
+	return box;
+}
+
+BoundingSphere ComputeBoundingSphere(const void* pPositions, size_t stride, size_t count)
+{
+	BoundingSphere sphere;
+	if (count == 0)
+		return sphere;
+
+	// Start from the two mutually far points and grow the sphere over the ones left outside
+	size_t a = FarthestPoint(pPositions, stride, count, DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, 0)));
+	DirectX::XMVECTOR pointA = DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, a));
+	size_t b = FarthestPoint(pPositions, stride, count, pointA);
+	DirectX::XMVECTOR pointB = DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, b));
+
+	DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(pointA, pointB), 0.5f);
+	float radius = DirectX::XMVectorGetX(DirectX::XMVector3Length(DirectX::XMVectorSubtract(pointB, pointA))) * 0.5f;
+	for (size_t i = 0; i < count; i++)
+	{
+		DirectX::XMVECTOR offset = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, i)), center);
+		float dist = DirectX::XMVectorGetX(DirectX::XMVector3Length(offset));
+		if (dist > radius)
+		{
+			float newRadius = (radius + dist) * 0.5f;
+			center = DirectX::XMVectorAdd(center, DirectX::XMVectorScale(offset, (newRadius - radius) / dist));
+			radius = newRadius;
+		}
+	}
+
+	DirectX::XMStoreFloat3(&sphere.center, center);
+	sphere.radius = radius;
+	return sphere;
+}
+
+OrientedBox ComputeOrientedBox(const void* pPositions, size_t stride, size_t count)
+{
+	OrientedBox box;
+	if (count == 0)
+		return box;
+
+	DirectX::XMVECTOR mean = DirectX::XMVectorZero();
+	for (size_t i = 0; i < count; i++)
+		mean = DirectX::XMVectorAdd(mean, DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, i)));
+	mean = DirectX::XMVectorScale(mean, 1.0f / count);
+
+	float covariance[3][3] = {};
+	for (size_t i = 0; i < count; i++)
+	{
+		DirectX::XMFLOAT3 offset;
+		DirectX::XMStoreFloat3(&offset, DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&PositionAt(pPositions, stride, i)), mean));
+		const float v[3] = { offset.x, offset.y, offset.z };
+		for (int r = 0; r < 3; r++)
+		{
+			for (int c = 0; c < 3; c++)
+				covariance[r][c] += v[r] * v[c];
+		}
+	}
+	float vectors[3][3];
+	EigenVectors(covariance, vectors);
+
+	DirectX::XMFLOAT3 principalAxes[3];
+	for (int a = 0; a < 3; a++)
+		principalAxes[a] = DirectX::XMFLOAT3(vectors[0][a], vectors[1][a], vectors[2][a]);
+	// Keeps the basis right handed and orthonormal after the float rotations
+	DirectX::XMVECTOR axisX = DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&principalAxes[0]));
+	DirectX::XMVECTOR axisZ = DirectX::XMVector3Normalize(DirectX::XMVector3Cross(axisX, DirectX::XMLoadFloat3(&principalAxes[1])));
+	DirectX::XMStoreFloat3(&principalAxes[0], axisX);
+	DirectX::XMStoreFloat3(&principalAxes[1], DirectX::XMVector3Cross(axisZ, axisX));
+	DirectX::XMStoreFloat3(&principalAxes[2], axisZ);
+
+	OrientedBox alignedBox;
+	const DirectX::XMFLOAT3 identityAxes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+	float principalVolume = FitBox(pPositions, stride, count, principalAxes, box);
+	float alignedVolume = FitBox(pPositions, stride, count, identityAxes, alignedBox);
+	return alignedVolume <= principalVolume ? alignedBox : box;
+}
+
+void ComputeAABBCorners(const void* pPositions, size_t stride, size_t count, std::vector<DirectX::XMFLOAT3>& outCorners)
+{
+	outCorners.clear();
+	if (count == 0)
+		return;
+
+	DirectX::XMFLOAT3 minVec(FLT_MAX, FLT_MAX, FLT_MAX);
+	DirectX::XMFLOAT3 maxVec(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i < count; i++)
+	{
+		const DirectX::XMFLOAT3& point = PositionAt(pPositions, stride, i);
+		minVec = DirectX::XMFLOAT3(min(minVec.x, point.x), min(minVec.y, point.y), min(minVec.z, point.z));
+		maxVec = DirectX::XMFLOAT3(max(maxVec.x, point.x), max(maxVec.y, point.y), max(maxVec.z, point.z));
+	}
+	for (int corner = 0; corner < 8; corner++)
+	{
+		outCorners.push_back(DirectX::XMFLOAT3(
+			(corner & 1) ? maxVec.x : minVec.x,
+			(corner & 2) ? maxVec.y : minVec.y,
+			(corner & 4) ? maxVec.z : minVec.z));
+	}
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "framework.h"
+#include <vector>
+
+// Box by its center and half extents, the form transformed by AABBSoA::SetTransformed
+struct AxisAlignedBox
+{
+	DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 extents = { 0.0f, 0.0f, 0.0f };
+};
+
+struct BoundingSphere
+{
+	DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f };
+	float radius = 0.0f;
+};
+
+// Box with half extents along three orthonormal axes
+struct OrientedBox
+{
+	DirectX::XMFLOAT3 center = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 extents = { 0.0f, 0.0f, 0.0f };
+	DirectX::XMFLOAT3 axes[3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+};
+
+AxisAlignedBox ComputeAxisAlignedBox(const void* pPositions, size_t stride, size_t count);
+// Ritter's approximate sphere, at most a few percent larger than the minimal one
+BoundingSphere ComputeBoundingSphere(const void* pPositions, size_t stride, size_t count);
+// Box along the principal axes of the points, the axis aligned box is returned when it is smaller
+OrientedBox ComputeOrientedBox(const void* pPositions, size_t stride, size_t count);
+// The 8 corners of the axis aligned bounds, the support points kept in GeometryData::vectorsAABB
+void ComputeAABBCorners(const void* pPositions, size_t stride, size_t count, std::vector<DirectX::XMFLOAT3>& outCorners);
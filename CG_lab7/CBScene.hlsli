@@ -1,6 +1,6 @@
 struct Light
 {
-    float4 pos;
+    float4 pos; // w - radius
     float4 color;
 };
 
@@ -9,6 +9,11 @@ cbuffer ViewBuffer : register (b0)
     float4x4 vp;
     float4 cameraPosition;
     int4 lightCount;
-    Light lights[10];
     float4 ambientColor;
-};
\ No newline at end of file
+    uint4 clusterCounts; // tiles x, tiles y, depth slices
+    float4 clusterDepth; // slice = log(view z) * x - y
+};
+
+StructuredBuffer<Light> lights : register (t2);
+StructuredBuffer<uint2> clusterRanges : register (t3); // offset in clusterLights, light count
+StructuredBuffer<uint> clusterLights : register (t4);
\ No newline at end of file
@@ -1,42 +1,45 @@
 #include "LightCalc.hlsli"
 
 
-cbuffer ModelBuffer : register (b1)
+struct Material
 {
-    float4x4 model;
-    float4x4 normTransform;
     float4 lightParams;
     float4 baseColor;
+    int4 modelInfo;
 };
 
+StructuredBuffer<Material> materials : register (t7);
+
 struct VSOutput
 {
     float4 pos : SV_Position;
     float4 worldPos : POSITION;
     float3 norm : NORMAL;
+    nointerpolation uint materialId : MATERIAL_ID;
 };
 
 float4 ps(VSOutput pixel) : SV_Target0
 {
-    float3 color = baseColor.xyz;
+    Material material = materials[pixel.materialId];
+    float3 color = material.baseColor.xyz;
     float3 normal = normalize(pixel.norm);
 
 #ifdef USE_LIGHT
 
     #ifdef USE_TRANSPARENCY
 
-    color = CalculateColor(color, normal, pixel.worldPos.xyz, lightParams, true);
+    color = CalculateColor(color, normal, pixel.worldPos.xyz, material.lightParams, true);
 
     #else
 
-    color = CalculateColor(color, normal, pixel.worldPos.xyz, lightParams, false);
+    color = CalculateColor(color, normal, pixel.worldPos.xyz, material.lightParams, false);
 
     #endif //USE_TRANSPARENCY
 
 #endif //USE_LIGHT
 
 #ifdef USE_TRANSPARENCY
-    return float4(color, baseColor.w);
+    return float4(color, material.baseColor.w);
 #else
     return float4(color, 1.0);
 #endif //USE_TRANSPARENCY
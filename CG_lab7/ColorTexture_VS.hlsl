@@ -1,17 +1,24 @@
 #include "CBScene.hlsli"
 
-cbuffer ModelBuffer : register (b1)
+struct ModelBuffer
 {
-    float4x4 model;
-    float4x4 normTransform;
-    float4 lightParams;
-    float4 baseColor;
+    float4 world[3]; // first three columns of the affine model matrix
+    uint materialId; // in the material buffer of the pixel shader
+};
+
+StructuredBuffer<ModelBuffer> modelBuffer : register (t5);
+StructuredBuffer<uint> ids : register (t6);
+
+cbuffer DrawBuffer : register (b2)
+{
+    uint4 drawOffsets; // x - first instance, y - first visible id in the upload buffers
 };
 
 struct VSInput
 {
     float3 pos : POSITION;
     float3 norm : NORMAL;
+    uint instanceId : SV_InstanceID;
 };
 
 struct VSOutput
@@ -19,14 +26,23 @@ struct VSOutput
     float4 pos : SV_Position;
     float4 worldPos : POSITION;
     float3 norm : NORMAL;
+    nointerpolation uint materialId : MATERIAL_ID;
 };
 
 VSOutput vs(VSInput vertex)
 {
     VSOutput result;
-    result.worldPos = mul(model, float4(vertex.pos, 1.0));
+    uint idx = drawOffsets.x + ids[drawOffsets.y + vertex.instanceId];
+    float4 world[3] = modelBuffer[idx].world;
+    float4 pos = float4(vertex.pos, 1.0);
+    result.worldPos = float4(dot(world[0], pos), dot(world[1], pos), dot(world[2], pos), 1.0);
     result.pos = mul(vp, result.worldPos);
-    result.norm = mul(normTransform, float4(vertex.norm, 0.0)).xyz;
+
+    float3x3 axes = float3x3(world[0].xyz, world[1].xyz, world[2].xyz);
+    float3x3 cofactors = float3x3(cross(axes[1], axes[2]), cross(axes[2], axes[0]), cross(axes[0], axes[1]));
+    float handedness = dot(axes[0], cofactors[0]) < 0.0 ? -1.0 : 1.0;
+    result.norm = mul(cofactors, vertex.norm) * handedness;
+    result.materialId = modelBuffer[idx].materialId;
 
     return result;
 }
@@ -0,0 +1,478 @@
+#include "CookedMesh.h"
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const uint64_t SectionAlignment = 16;
+
+	uint64_t AlignSection(uint64_t offset)
+	{
+		return (offset + SectionAlignment - 1) & ~(SectionAlignment - 1);
+	}
+
+	bool Fail(std::string* pError, const char* message)
+	{
+		if (pError != nullptr)
+			*pError = message;
+		return false;
+	}
+
+	bool CheckSection(uint64_t offset, uint64_t size, uint64_t fileSize)
+	{
+		return offset % SectionAlignment == 0 && offset <= fileSize && size <= fileSize - offset;
+	}
+
+	// Cheap part of the validation, enough to make every section pointer safe to dereference
+	bool CheckHeader(const uint8_t* pData, size_t size, std::string* pError)
+	{
+		if (size < sizeof(CookedMeshHeader))
+			return Fail(pError, "File is smaller than the header");
+		const CookedMeshHeader& header = *reinterpret_cast<const CookedMeshHeader*>(pData);
+		if (header.magic != CookedMeshMagic)
+			return Fail(pError, "Bad magic");
+		if (header.version != CookedMeshVersion)
+			return Fail(pError, "Unsupported version");
+		if (header.headerSize != sizeof(CookedMeshHeader))
+			return Fail(pError, "Bad header size");
+		if (header.fileSize != size)
+			return Fail(pError, "File size does not match the header");
+		if (header.vertexStride < sizeof(float) * 3 || header.vertexStride % sizeof(float) != 0)
+			return Fail(pError, "Bad vertex stride");
+		if (header.indexStride != sizeof(uint16_t) && header.indexStride != sizeof(uint32_t))
+			return Fail(pError, "Bad index stride");
+		if (header.indexCount % 3 != 0)
+			return Fail(pError, "Index count is not a multiple of 3");
+
+		// Every count decides an allocation or a loop, so it is bounded by the file before anything is read
+		bool compressed = (header.flags & CookedMeshFlag_CompressedIndices) != 0;
+		if (!compressed && header.indexSize != uint64_t(header.indexCount) * header.indexStride)
+			return Fail(pError, "Index section size does not match the index count");
+		if (compressed && header.indexCount > header.indexSize)
+			return Fail(pError, "Index count exceeds the compressed index section"); // at least a byte per index
+
+		if (!CheckSection(header.vertexOffset, uint64_t(header.vertexCount) * header.vertexStride, size)
+			|| !CheckSection(header.indexOffset, header.indexSize, size)
+			|| !CheckSection(header.lodOffset, uint64_t(header.lodCount) * sizeof(CookedMeshLod), size)
+			|| !CheckSection(header.aabbOffset, uint64_t(header.aabbVectorCount) * sizeof(DirectX::XMFLOAT3), size)
+			|| !CheckSection(header.meshletOffset, uint64_t(header.meshletCount) * sizeof(CookedMeshlet), size)
+			|| !CheckSection(header.meshletVerticesOffset, uint64_t(header.meshletVertexCount) * sizeof(uint32_t), size)
+			|| !CheckSection(header.meshletTrianglesOffset, uint64_t(header.meshletTriangleCount) * 3, size))
+			return Fail(pError, "Section is out of the file bounds or misaligned");
+
+		const BoundingSphere& sphere = header.boundingSphere;
+		const OrientedBox& box = header.orientedBox;
+		if (!(sphere.radius >= 0.0f && sphere.radius <= FLT_MAX) || !(box.extents.x >= 0.0f && box.extents.y >= 0.0f
+			&& box.extents.z >= 0.0f && box.extents.x <= FLT_MAX && box.extents.y <= FLT_MAX && box.extents.z <= FLT_MAX))
+			return Fail(pError, "Bad bounding volumes");
+		return true;
+	}
+
+	void ComputePositionBounds(const CookedMeshDesc& desc, DirectX::XMFLOAT3& minVec, DirectX::XMFLOAT3& maxVec)
+	{
+		minVec = DirectX::XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+		maxVec = DirectX::XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+		const uint8_t* pVertex = reinterpret_cast<const uint8_t*>(desc.pVertices);
+		for (uint32_t i = 0; i < desc.vertexCount; i++, pVertex += desc.vertexStride)
+		{
+			const float* pPos = reinterpret_cast<const float*>(pVertex);
+			minVec.x = min(minVec.x, pPos[0]);
+			minVec.y = min(minVec.y, pPos[1]);
+			minVec.z = min(minVec.z, pPos[2]);
+			maxVec.x = max(maxVec.x, pPos[0]);
+			maxVec.y = max(maxVec.y, pPos[1]);
+			maxVec.z = max(maxVec.z, pPos[2]);
+		}
+	}
+
+	DirectX::XMFLOAT4 ComputeMeshletSphere(const float* pPositions, uint32_t positionStride, const uint32_t* pVertices, uint32_t vertexCount)
+	{
+		const uint8_t* pBase = reinterpret_cast<const uint8_t*>(pPositions);
+		float minVec[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float maxVec[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			const float* pPos = reinterpret_cast<const float*>(pBase + size_t(pVertices[i]) * positionStride);
+			for (int c = 0; c < 3; c++)
+			{
+				minVec[c] = min(minVec[c], pPos[c]);
+				maxVec[c] = max(maxVec[c], pPos[c]);
+			}
+		}
+
+		float center[3] = { (minVec[0] + maxVec[0]) * 0.5f, (minVec[1] + maxVec[1]) * 0.5f, (minVec[2] + maxVec[2]) * 0.5f };
+		float radiusSq = 0.0f;
+		for (uint32_t i = 0; i < vertexCount; i++)
+		{
+			const float* pPos = reinterpret_cast<const float*>(pBase + size_t(pVertices[i]) * positionStride);
+			float dx = pPos[0] - center[0];
+			float dy = pPos[1] - center[1];
+			float dz = pPos[2] - center[2];
+			radiusSq = max(radiusSq, dx * dx + dy * dy + dz * dz);
+		}
+		return DirectX::XMFLOAT4(center[0], center[1], center[2], sqrtf(radiusSq));
+	}
+}
+
+void EncodeIndices(const uint32_t* pIndices, uint32_t indexCount, std::vector<uint8_t>& outData)
+{
+	outData.clear();
+	outData.reserve(indexCount * 2);
+	uint32_t prev = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		int32_t delta = int32_t(pIndices[i] - prev);
+		uint32_t zigzag = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+		while (zigzag >= 0x80)
+		{
+			outData.push_back(uint8_t(zigzag | 0x80));
+			zigzag >>= 7;
+		}
+		outData.push_back(uint8_t(zigzag));
+		prev = pIndices[i];
+	}
+}
+
+bool DecodeIndices(const uint8_t* pData, size_t size, uint32_t indexCount, uint32_t indexStride, void* pOutIndices)
+{
+	const uint8_t* pEnd = pData + size;
+	uint32_t prev = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+	{
+		uint32_t zigzag = 0;
+		for (uint32_t shift = 0;; shift += 7)
+		{
+			if (pData == pEnd || shift > 28)
+				return false;
+			uint8_t byte = *pData++;
+			zigzag |= uint32_t(byte & 0x7F) << shift;
+			if ((byte & 0x80) == 0)
+				break;
+		}
+		uint32_t delta = (zigzag >> 1) ^ (0u - (zigzag & 1));
+		prev += delta;
+
+		if (indexStride == sizeof(uint16_t))
+		{
+			if (prev > 0xFFFF)
+				return false;
+			reinterpret_cast<uint16_t*>(pOutIndices)[i] = uint16_t(prev);
+		}
+		else
+			reinterpret_cast<uint32_t*>(pOutIndices)[i] = prev;
+	}
+	return pData == pEnd;
+}
+
+void BuildMeshlets(const float* pPositions, uint32_t positionStride, const uint32_t* pIndices, uint32_t indexCount,
+	std::vector<CookedMeshlet>& outMeshlets, std::vector<uint32_t>& outMeshletVertices, std::vector<uint8_t>& outMeshletTriangles)
+{
+	outMeshlets.clear();
+	outMeshletVertices.clear();
+	outMeshletTriangles.clear();
+
+	uint32_t maxIndex = 0;
+	for (uint32_t i = 0; i < indexCount; i++)
+		maxIndex = max(maxIndex, pIndices[i]);
+	const uint32_t NoLocalIndex = ~0u;
+	std::vector<uint32_t> localIndices(indexCount > 0 ? size_t(maxIndex) + 1 : 0, NoLocalIndex);
+
+	CookedMeshlet meshlet = {};
+	auto flush = [&]()
+	{
+		if (meshlet.triangleCount == 0)
+			return;
+		meshlet.boundingSphere = ComputeMeshletSphere(pPositions, positionStride,
+			outMeshletVertices.data() + meshlet.vertexOffset, meshlet.vertexCount);
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			localIndices[outMeshletVertices[meshlet.vertexOffset + i]] = NoLocalIndex;
+		outMeshlets.push_back(meshlet);
+
+		meshlet = CookedMeshlet();
+		meshlet.vertexOffset = (uint32_t)outMeshletVertices.size();
+		meshlet.triangleOffset = (uint32_t)outMeshletTriangles.size() / 3;
+	};
+
+	// Greedy in index order, the importers already emit triangles with good locality
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		uint32_t newVertices = 0;
+		for (int c = 0; c < 3; c++)
+			newVertices += localIndices[pIndices[i + c]] == NoLocalIndex ? 1 : 0;
+		if (meshlet.vertexCount + newVertices > MeshletMaxVertices || meshlet.triangleCount + 1 > MeshletMaxTriangles)
+			flush();
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t& local = localIndices[pIndices[i + c]];
+			if (local == NoLocalIndex)
+			{
+				local = meshlet.vertexCount++;
+				outMeshletVertices.push_back(pIndices[i + c]);
+			}
+			outMeshletTriangles.push_back(uint8_t(local));
+		}
+		meshlet.triangleCount++;
+	}
+	flush();
+}
+
+bool CookMesh(const CookedMeshDesc& desc, std::vector<uint8_t>& outData)
+{
+	if (desc.pVertices == nullptr || desc.vertexCount == 0 || desc.vertexStride < sizeof(float) * 3
+		|| desc.pIndices == nullptr || desc.indexCount == 0 || desc.indexCount % 3 != 0)
+		return false;
+	for (uint32_t i = 0; i < desc.indexCount; i++)
+	{
+		if (desc.pIndices[i] >= desc.vertexCount)
+			return false;
+	}
+
+	CookedMeshHeader header = {};
+	header.magic = CookedMeshMagic;
+	header.version = CookedMeshVersion;
+	header.headerSize = sizeof(CookedMeshHeader);
+	header.vertexStride = desc.vertexStride;
+	header.vertexCount = desc.vertexCount;
+	header.indexStride = desc.allow16BitIndices && desc.vertexCount <= 0x10000 ? sizeof(uint16_t) : sizeof(uint32_t);
+	header.indexCount = desc.indexCount;
+	header.boundingSphere = ComputeBoundingSphere(desc.pVertices, desc.vertexStride, desc.vertexCount);
+	header.orientedBox = ComputeOrientedBox(desc.pVertices, desc.vertexStride, desc.vertexCount);
+
+	std::vector<uint8_t> indexData;
+	if (desc.compressIndices)
+	{
+		EncodeIndices(desc.pIndices, desc.indexCount, indexData);
+		header.flags |= CookedMeshFlag_CompressedIndices;
+	}
+	else if (header.indexStride == sizeof(uint16_t))
+	{
+		indexData.resize(size_t(desc.indexCount) * sizeof(uint16_t));
+		uint16_t* pIndices16 = reinterpret_cast<uint16_t*>(indexData.data());
+		for (uint32_t i = 0; i < desc.indexCount; i++)
+			pIndices16[i] = uint16_t(desc.pIndices[i]);
+	}
+	else
+	{
+		indexData.resize(size_t(desc.indexCount) * sizeof(uint32_t));
+		memcpy(indexData.data(), desc.pIndices, indexData.size());
+	}
+	header.indexSize = indexData.size();
+
+	std::vector<CookedMeshLod> lods = desc.lods;
+	if (lods.empty())
+		lods.push_back({ 0, desc.indexCount, 0.0f, 0 });
+	for (const CookedMeshLod& lod : lods)
+	{
+		if (lod.firstIndex % 3 != 0 || lod.indexCount % 3 != 0 || lod.firstIndex > desc.indexCount
+			|| lod.indexCount > desc.indexCount - lod.firstIndex)
+			return false;
+	}
+	header.lodCount = (uint32_t)lods.size();
+
+	std::vector<DirectX::XMFLOAT3> vectorsAABB = desc.vectorsAABB;
+	if (vectorsAABB.empty())
+	{
+		DirectX::XMFLOAT3 minVec, maxVec;
+		ComputePositionBounds(desc, minVec, maxVec);
+		for (int i = 0; i < 8; i++)
+		{
+			vectorsAABB.push_back(DirectX::XMFLOAT3(
+				(i & 1) ? maxVec.x : minVec.x,
+				(i & 2) ? maxVec.y : minVec.y,
+				(i & 4) ? maxVec.z : minVec.z));
+		}
+	}
+	header.aabbVectorCount = (uint32_t)vectorsAABB.size();
+
+	std::vector<CookedMeshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+	if (desc.buildMeshlets)
+	{
+		BuildMeshlets(reinterpret_cast<const float*>(desc.pVertices), desc.vertexStride, desc.pIndices, desc.indexCount,
+			meshlets, meshletVertices, meshletTriangles);
+	}
+	header.meshletCount = (uint32_t)meshlets.size();
+	header.meshletVertexCount = (uint32_t)meshletVertices.size();
+	header.meshletTriangleCount = (uint32_t)meshletTriangles.size() / 3;
+
+	uint64_t offset = AlignSection(sizeof(CookedMeshHeader));
+	header.vertexOffset = offset;
+	offset = AlignSection(offset + uint64_t(desc.vertexCount) * desc.vertexStride);
+	header.indexOffset = offset;
+	offset = AlignSection(offset + indexData.size());
+	header.lodOffset = offset;
+	offset = AlignSection(offset + lods.size() * sizeof(CookedMeshLod));
+	header.aabbOffset = offset;
+	offset = AlignSection(offset + vectorsAABB.size() * sizeof(DirectX::XMFLOAT3));
+	header.meshletOffset = offset;
+	offset = AlignSection(offset + meshlets.size() * sizeof(CookedMeshlet));
+	header.meshletVerticesOffset = offset;
+	offset = AlignSection(offset + meshletVertices.size() * sizeof(uint32_t));
+	header.meshletTrianglesOffset = offset;
+	offset = AlignSection(offset + meshletTriangles.size());
+	header.fileSize = offset;
+
+	outData.assign(size_t(header.fileSize), 0);
+	uint8_t* pData = outData.data();
+	memcpy(pData, &header, sizeof(header));
+	memcpy(pData + header.vertexOffset, desc.pVertices, size_t(desc.vertexCount) * desc.vertexStride);
+	memcpy(pData + header.indexOffset, indexData.data(), indexData.size());
+	memcpy(pData + header.lodOffset, lods.data(), lods.size() * sizeof(CookedMeshLod));
+	memcpy(pData + header.aabbOffset, vectorsAABB.data(), vectorsAABB.size() * sizeof(DirectX::XMFLOAT3));
+	if (!meshlets.empty())
+	{
+		memcpy(pData + header.meshletOffset, meshlets.data(), meshlets.size() * sizeof(CookedMeshlet));
+		memcpy(pData + header.meshletVerticesOffset, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+		memcpy(pData + header.meshletTrianglesOffset, meshletTriangles.data(), meshletTriangles.size());
+	}
+	return true;
+}
+
+bool WriteCookedMesh(const wchar_t* fileName, const CookedMeshDesc& desc)
+{
+	std::vector<uint8_t> data;
+	if (!CookMesh(desc, data))
+		return false;
+
+	HANDLE hFile = CreateFileW(fileName, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (hFile == INVALID_HANDLE_VALUE)
+		return false;
+	DWORD written = 0;
+	BOOL success = WriteFile(hFile, data.data(), (DWORD)data.size(), &written, nullptr);
+	CloseHandle(hFile);
+	return success && written == data.size();
+}
+
+bool ValidateCookedMesh(const uint8_t* pData, size_t size, std::string* pError)
+{
+	if (!CheckHeader(pData, size, pError))
+		return false;
+	const CookedMeshHeader& header = *reinterpret_cast<const CookedMeshHeader*>(pData);
+
+	std::vector<uint32_t> indices(header.indexCount);
+	const uint8_t* pIndexData = pData + header.indexOffset;
+	if (header.flags & CookedMeshFlag_CompressedIndices)
+	{
+		std::vector<uint8_t> decoded(size_t(header.indexCount) * header.indexStride);
+		if (!DecodeIndices(pIndexData, size_t(header.indexSize), header.indexCount, header.indexStride, decoded.data()))
+			return Fail(pError, "Compressed index stream is corrupted");
+		pIndexData = nullptr;
+		for (uint32_t i = 0; i < header.indexCount; i++)
+		{
+			indices[i] = header.indexStride == sizeof(uint16_t)
+				? reinterpret_cast<const uint16_t*>(decoded.data())[i]
+				: reinterpret_cast<const uint32_t*>(decoded.data())[i];
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < header.indexCount; i++)
+		{
+			indices[i] = header.indexStride == sizeof(uint16_t)
+				? reinterpret_cast<const uint16_t*>(pIndexData)[i]
+				: reinterpret_cast<const uint32_t*>(pIndexData)[i];
+		}
+	}
+	for (uint32_t index : indices)
+	{
+		if (index >= header.vertexCount)
+			return Fail(pError, "Index is out of the vertex range");
+	}
+
+	const CookedMeshLod* pLods = reinterpret_cast<const CookedMeshLod*>(pData + header.lodOffset);
+	for (uint32_t i = 0; i < header.lodCount; i++)
+	{
+		const CookedMeshLod& lod = pLods[i];
+		if (lod.firstIndex % 3 != 0 || lod.indexCount % 3 != 0 || lod.firstIndex > header.indexCount
+			|| lod.indexCount > header.indexCount - lod.firstIndex)
+			return Fail(pError, "LOD range is out of the index range");
+	}
+
+	const CookedMeshlet* pMeshlets = reinterpret_cast<const CookedMeshlet*>(pData + header.meshletOffset);
+	const uint32_t* pMeshletVertices = reinterpret_cast<const uint32_t*>(pData + header.meshletVerticesOffset);
+	const uint8_t* pMeshletTriangles = pData + header.meshletTrianglesOffset;
+	for (uint32_t i = 0; i < header.meshletCount; i++)
+	{
+		const CookedMeshlet& meshlet = pMeshlets[i];
+		if (meshlet.vertexCount > MeshletMaxVertices || meshlet.triangleCount > MeshletMaxTriangles
+			|| meshlet.vertexOffset > header.meshletVertexCount
+			|| meshlet.vertexCount > header.meshletVertexCount - meshlet.vertexOffset
+			|| meshlet.triangleOffset > header.meshletTriangleCount
+			|| meshlet.triangleCount > header.meshletTriangleCount - meshlet.triangleOffset)
+			return Fail(pError, "Meshlet is out of the meshlet tables");
+		for (uint32_t v = 0; v < meshlet.vertexCount; v++)
+		{
+			if (pMeshletVertices[meshlet.vertexOffset + v] >= header.vertexCount)
+				return Fail(pError, "Meshlet vertex is out of the vertex range");
+		}
+		for (uint32_t t = 0; t < meshlet.triangleCount * 3; t++)
+		{
+			if (pMeshletTriangles[(meshlet.triangleOffset * 3) + t] >= meshlet.vertexCount)
+				return Fail(pError, "Meshlet triangle references a vertex outside of the meshlet");
+		}
+	}
+	return true;
+}
+
+bool CookedMeshFile::Open(const wchar_t* fileName)
+{
+	Close();
+	if (!m_file.Open(fileName))
+		return false;
+	if (!CheckHeader(m_file.GetData(), m_file.GetSize(), nullptr))
+	{
+		Close();
+		return false;
+	}
+	m_pHeader = reinterpret_cast<const CookedMeshHeader*>(m_file.GetData());
+	return true;
+}
+
+void CookedMeshFile::Close()
+{
+	m_file.Close();
+	m_pHeader = nullptr;
+	m_decodedIndices.clear();
+}
+
+const void* CookedMeshFile::GetIndices()
+{
+	if ((m_pHeader->flags & CookedMeshFlag_CompressedIndices) == 0)
+		return m_file.GetData() + m_pHeader->indexOffset;
+
+	if (m_decodedIndices.empty())
+	{
+		std::vector<uint8_t> decoded(size_t(m_pHeader->indexCount) * m_pHeader->indexStride);
+		if (!DecodeIndices(m_file.GetData() + m_pHeader->indexOffset, size_t(m_pHeader->indexSize),
+			m_pHeader->indexCount, m_pHeader->indexStride, decoded.data()))
+			return nullptr;
+		m_decodedIndices.swap(decoded);
+	}
+	return m_decodedIndices.data();
+}
+
+HRESULT CookedMeshFile::AddToPool(ID3D11DeviceContext* pDeviceContext, GeometryPool& pool, GeometryData& outGeometry)
+{
+	if (m_pHeader == nullptr)
+		return E_FAIL;
+	DXGI_FORMAT indexFormat = m_pHeader->indexStride == sizeof(uint32_t) ? DXGI_FORMAT_R32_UINT : DXGI_FORMAT_R16_UINT;
+	if (pool.GetVertexStride() != m_pHeader->vertexStride || pool.GetIndexFormat() != indexFormat)
+		return E_INVALIDARG;
+
+	const void* pIndices = GetIndices();
+	if (pIndices == nullptr)
+		return E_FAIL;
+
+	HRESULT result = pool.Add(pDeviceContext, GetVertices(), m_pHeader->vertexCount, pIndices, m_pHeader->indexCount, outGeometry);
+	if (SUCCEEDED(result))
+	{
+		const DirectX::XMFLOAT3* pVectors = GetAABBVectors();
+		outGeometry.vectorsAABB.assign(pVectors, pVectors + m_pHeader->aabbVectorCount);
+		outGeometry.boundingSphere = m_pHeader->boundingSphere;
+		outGeometry.orientedBox = m_pHeader->orientedBox;
+	}
+	return result;
+}
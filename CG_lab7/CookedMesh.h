@@ -0,0 +1,135 @@
+#pragma once
+#include "framework.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "GeometryData.h"
+#include "GeometryPool.h"
+#include "MappedFile.h"
+
+// Binary mesh container, every section is 16-byte aligned and stored exactly as it is uploaded,
+// so a mapped file is handed to the GPU without parsing (unless the index section is compressed).
+const uint32_t CookedMeshMagic = 0x534D4743; // "CGMS"
+const uint32_t CookedMeshVersion = 2;
+
+enum CookedMeshFlags : uint32_t
+{
+	CookedMeshFlag_CompressedIndices = 1 << 0,
+};
+
+struct CookedMeshHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t headerSize;
+	uint32_t flags;
+
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexStride; // 2 or 4
+	uint32_t indexCount;
+
+	uint32_t lodCount;
+	uint32_t aabbVectorCount;
+	uint32_t meshletCount;
+	uint32_t meshletVertexCount;
+
+	uint32_t meshletTriangleCount;
+	uint32_t reserved[3];
+
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	uint64_t indexSize; // bytes actually stored, differs from indexCount * indexStride when compressed
+	uint64_t lodOffset;
+	uint64_t aabbOffset;
+	uint64_t meshletOffset;
+	uint64_t meshletVerticesOffset;
+	uint64_t meshletTrianglesOffset;
+	uint64_t fileSize;
+	uint64_t reserved2;
+
+	// Culling volumes of the positions, computed at cook time so loading does not touch the vertices
+	BoundingSphere boundingSphere;
+	OrientedBox orientedBox;
+	uint32_t reserved3;
+};
+
+struct CookedMeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error; // geometric error of the LOD relative to LOD 0
+	uint32_t reserved;
+};
+
+struct CookedMeshlet
+{
+	uint32_t vertexOffset; // into the meshlet vertex table
+	uint32_t triangleOffset; // into the meshlet triangle table, 3 local indices per triangle
+	uint32_t vertexCount;
+	uint32_t triangleCount;
+	DirectX::XMFLOAT4 boundingSphere;
+};
+
+struct CookedMeshDesc
+{
+	// Position is expected in the first three floats of the vertex, as in Vertex and TextureNormalVertex
+	const void* pVertices = nullptr;
+	uint32_t vertexStride = 0;
+	uint32_t vertexCount = 0;
+	const uint32_t* pIndices = nullptr;
+	uint32_t indexCount = 0;
+
+	bool allow16BitIndices = true;
+	bool compressIndices = false;
+	bool buildMeshlets = true;
+	std::vector<CookedMeshLod> lods; // empty - a single LOD covering all indices
+	std::vector<DirectX::XMFLOAT3> vectorsAABB; // empty - the 8 corners of the position bounds
+};
+
+static const uint32_t MeshletMaxVertices = 64;
+static const uint32_t MeshletMaxTriangles = 124;
+
+bool CookMesh(const CookedMeshDesc& desc, std::vector<uint8_t>& outData);
+bool WriteCookedMesh(const wchar_t* fileName, const CookedMeshDesc& desc);
+// Full check of a cooked mesh, index values and meshlet tables included
+bool ValidateCookedMesh(const uint8_t* pData, size_t size, std::string* pError = nullptr);
+
+void BuildMeshlets(const float* pPositions, uint32_t positionStride, const uint32_t* pIndices, uint32_t indexCount,
+	std::vector<CookedMeshlet>& outMeshlets, std::vector<uint32_t>& outMeshletVertices, std::vector<uint8_t>& outMeshletTriangles);
+
+// Delta + zigzag + varint index codec
+void EncodeIndices(const uint32_t* pIndices, uint32_t indexCount, std::vector<uint8_t>& outData);
+bool DecodeIndices(const uint8_t* pData, size_t size, uint32_t indexCount, uint32_t indexStride, void* pOutIndices);
+
+class CookedMeshFile
+{
+public:
+	// Only the header and the section bounds are checked, use ValidateCookedMesh for untrusted files
+	bool Open(const wchar_t* fileName);
+	void Close();
+
+	const CookedMeshHeader& GetHeader() const { return *m_pHeader; }
+	const void* GetVertices() const { return m_file.GetData() + m_pHeader->vertexOffset; }
+	// Decompressed on first use for files with compressed indices
+	const void* GetIndices();
+	const CookedMeshLod* GetLods() const { return Section<CookedMeshLod>(m_pHeader->lodOffset); }
+	const DirectX::XMFLOAT3* GetAABBVectors() const { return Section<DirectX::XMFLOAT3>(m_pHeader->aabbOffset); }
+	const CookedMeshlet* GetMeshlets() const { return Section<CookedMeshlet>(m_pHeader->meshletOffset); }
+	const uint32_t* GetMeshletVertices() const { return Section<uint32_t>(m_pHeader->meshletVerticesOffset); }
+	const uint8_t* GetMeshletTriangles() const { return Section<uint8_t>(m_pHeader->meshletTrianglesOffset); }
+
+	// Uploads the whole index range, the LOD table stays available for picking firstIndex/indexCount
+	HRESULT AddToPool(ID3D11DeviceContext* pDeviceContext, GeometryPool& pool, GeometryData& outGeometry);
+
+private:
+	template <typename T>
+	const T* Section(uint64_t offset) const
+	{
+		return reinterpret_cast<const T*>(m_file.GetData() + offset);
+	}
+
+	MappedFile m_file;
+	const CookedMeshHeader* m_pHeader = nullptr;
+	std::vector<uint8_t> m_decodedIndices;
+};
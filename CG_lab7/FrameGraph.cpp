@@ -0,0 +1,176 @@
+#include "FrameGraph.h"
+#include <algorithm>
+#include <cassert>
+
+void FrameGraph::Reset()
+{
+	m_resources.clear();
+	m_passes.clear();
+	m_order.clear();
+	m_slots.clear();
+	m_slotLastUse.clear();
+}
+
+uint32_t FrameGraph::CreateTransient(const char* name, const TransientDesc& desc)
+{
+	const uint32_t id = uint32_t(m_resources.size());
+	m_resources.push_back({ name, desc, false, id, InvalidId, InvalidId, InvalidId });
+	return id;
+}
+
+uint32_t FrameGraph::Import(const char* name)
+{
+	const uint32_t id = uint32_t(m_resources.size());
+	m_resources.push_back({ name, {}, true, id, InvalidId, InvalidId, InvalidId });
+	return id;
+}
+
+uint32_t FrameGraph::AddPass(const char* name, std::function<void()> execute)
+{
+	const uint32_t id = uint32_t(m_passes.size());
+	m_passes.push_back({ name, std::move(execute), {}, {}, false, false });
+	return id;
+}
+
+uint32_t FrameGraph::AddCopyPass(const char* name, uint32_t source, uint32_t destination, std::function<void()> execute)
+{
+	const uint32_t id = AddPass(name, std::move(execute));
+	m_passes[id].copy = true;
+	Read(id, source);
+	Write(id, destination);
+	return id;
+}
+
+void FrameGraph::Read(uint32_t pass, uint32_t resource)
+{
+	assert(resource < m_resources.size());
+	m_passes[pass].reads.push_back(resource);
+}
+
+void FrameGraph::Write(uint32_t pass, uint32_t resource)
+{
+	assert(resource < m_resources.size());
+	m_passes[pass].writes.push_back(resource);
+}
+
+uint32_t FrameGraph::Resolve(uint32_t resource) const
+{
+	while (m_resources[resource].alias != resource)
+		resource = m_resources[resource].alias;
+	return resource;
+}
+
+void FrameGraph::ElideCopy(uint32_t pass)
+{
+	const uint32_t source = m_passes[pass].reads[0];
+	const uint32_t destination = m_passes[pass].writes[0];
+	const Resource& sourceResource = m_resources[source];
+	const Resource& destinationResource = m_resources[destination];
+	if (sourceResource.imported || (!destinationResource.imported && !(sourceResource.desc == destinationResource.desc)))
+		return;
+	for (uint32_t other = 0; other < m_passes.size(); other++)
+	{
+		if (other == pass || m_passes[other].culled)
+			continue;
+		const Pass& otherPass = m_passes[other];
+		auto touches = [](const std::vector<uint32_t>& resources, uint32_t resource)
+		{
+			return std::find(resources.begin(), resources.end(), resource) != resources.end();
+		};
+		if (touches(otherPass.reads, source) || touches(otherPass.reads, destination) || touches(otherPass.writes, destination))
+			return;
+	}
+	m_resources[source].alias = destination;
+	m_passes[pass].culled = true;
+}
+
+void FrameGraph::CullPasses()
+{
+	// From the last pass back, a pass is kept when a kept later pass reads what it writes
+	m_needed.assign(m_resources.size(), false);
+	for (uint32_t pass = uint32_t(m_passes.size()); pass-- > 0;)
+	{
+		Pass& current = m_passes[pass];
+		if (current.culled)
+			continue;
+		bool effective = false;
+		for (uint32_t resource : current.writes)
+		{
+			const uint32_t target = Resolve(resource);
+			effective |= m_resources[target].imported || m_needed[target];
+		}
+		current.culled = !effective;
+		if (effective)
+		{
+			for (uint32_t resource : current.reads)
+				m_needed[Resolve(resource)] = true;
+		}
+	}
+}
+
+void FrameGraph::AssignSlots()
+{
+	m_transients.clear();
+	for (uint32_t position = 0; position < m_order.size(); position++)
+	{
+		const Pass& pass = m_passes[m_order[position]];
+		for (const std::vector<uint32_t>* pAccesses : { &pass.reads, &pass.writes })
+		{
+			for (uint32_t access : *pAccesses)
+			{
+				Resource& resource = m_resources[Resolve(access)];
+				if (resource.imported)
+					continue;
+				if (resource.firstUse == InvalidId)
+				{
+					resource.firstUse = position;
+					m_transients.push_back(Resolve(access));
+				}
+				resource.lastUse = position;
+			}
+		}
+	}
+
+	// In the order of first use, taking the first slot of the same description free by then
+	for (uint32_t id : m_transients)
+	{
+		Resource& resource = m_resources[id];
+		uint32_t slot = 0;
+		while (slot < m_slots.size() && !(m_slots[slot] == resource.desc && m_slotLastUse[slot] < resource.firstUse))
+			slot++;
+		if (slot == m_slots.size())
+		{
+			m_slots.push_back(resource.desc);
+			m_slotLastUse.push_back(0);
+		}
+		m_slotLastUse[slot] = resource.lastUse;
+		resource.slot = slot;
+	}
+}
+
+void FrameGraph::Compile()
+{
+	for (uint32_t pass = 0; pass < m_passes.size(); pass++)
+	{
+		if (m_passes[pass].copy)
+			ElideCopy(pass);
+	}
+	CullPasses();
+
+	m_order.clear();
+	for (uint32_t pass = 0; pass < m_passes.size(); pass++)
+	{
+		if (!m_passes[pass].culled)
+			m_order.push_back(pass);
+	}
+	AssignSlots();
+}
+
+void FrameGraph::Execute() const
+{
+	for (uint32_t pass : m_order)
+	{
+		if (m_passes[pass].execute)
+			m_passes[pass].execute();
+	}
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Texture of a transient resource. The DXGI format and D3D11 bind flags are kept as integers, so the graph stays
+// free of Windows and D3D headers.
+struct TransientDesc
+{
+	uint32_t width;
+	uint32_t height;
+	uint32_t format;
+	uint32_t bindFlags;
+};
+
+inline bool operator==(const TransientDesc& a, const TransientDesc& b)
+{
+	return a.width == b.width && a.height == b.height && a.format == b.format && a.bindFlags == b.bindFlags;
+}
+
+// Passes of a frame with the resources they read and write, rebuilt every frame. Compile drops the passes whose
+// writes nobody needs, where only writes to imported resources count as an effect of their own, and lays the
+// transient resources over slots: resources with equal descriptions and disjoint lifetimes share a slot, which
+// the caller backs with one texture. Passes run in the order they were added, which has to put the writers of
+// a resource before its readers.
+class FrameGraph
+{
+public:
+	static const uint32_t InvalidId = UINT32_MAX;
+
+	void Reset();
+
+	uint32_t CreateTransient(const char* name, const TransientDesc& desc);
+	// Resource living outside the frame, like the back buffer
+	uint32_t Import(const char* name);
+
+	uint32_t AddPass(const char* name, std::function<void()> execute);
+	// Pass only copying the source into the destination. When nothing else reads the transient source and nothing
+	// else touches the destination, Compile drops the pass and the writers of the source write the destination
+	// instead, so the caller has to make sure they can.
+	uint32_t AddCopyPass(const char* name, uint32_t source, uint32_t destination, std::function<void()> execute);
+	void Read(uint32_t pass, uint32_t resource);
+	void Write(uint32_t pass, uint32_t resource);
+
+	// Once, after the passes are added
+	void Compile();
+	// Runs the passes left by Compile
+	void Execute() const;
+
+	const std::vector<uint32_t>& GetOrder() const { return m_order; }
+	bool IsCulled(uint32_t pass) const { return m_passes[pass].culled; }
+	// Of the resource, or of the one it was merged into by a dropped copy
+	bool IsImported(uint32_t resource) const { return m_resources[Resolve(resource)].imported; }
+	uint32_t GetSlot(uint32_t resource) const { return m_resources[Resolve(resource)].slot; }
+	const std::vector<TransientDesc>& GetSlots() const { return m_slots; }
+
+private:
+	struct Resource
+	{
+		const char* name;
+		TransientDesc desc;
+		bool imported;
+		uint32_t alias; // resource written instead, itself unless merged by a copy
+		uint32_t slot;
+		uint32_t firstUse; // positions in the order
+		uint32_t lastUse;
+	};
+
+	struct Pass
+	{
+		const char* name;
+		std::function<void()> execute;
+		std::vector<uint32_t> reads;
+		std::vector<uint32_t> writes;
+		bool copy;
+		bool culled;
+	};
+
+	uint32_t Resolve(uint32_t resource) const;
+	void ElideCopy(uint32_t pass);
+	void CullPasses();
+	void AssignSlots();
+
+	std::vector<Resource> m_resources;
+	std::vector<Pass> m_passes;
+	std::vector<uint32_t> m_order;
+	std::vector<TransientDesc> m_slots;
+	std::vector<uint32_t> m_slotLastUse;
+	std::vector<uint32_t> m_transients; // live ones sorted by first use
+	std::vector<bool> m_needed;
+};
@@ -0,0 +1,683 @@
+#include "FrustumCulling.h"
+#include <immintrin.h>
+#include <cstring>
+
+void Frustum::ExtractFromMatrix(const DirectX::XMMATRIX& viewProjection)
+{
+	// Rows of the transposed matrix are the columns producing clip x, y, z and w
+	DirectX::XMMATRIX m = DirectX::XMMatrixTranspose(viewProjection);
+	DirectX::XMVECTOR extracted[6] =
+	{
+		DirectX::XMVectorAdd(m.r[3], m.r[0]),      // left
+		DirectX::XMVectorSubtract(m.r[3], m.r[0]), // right
+		DirectX::XMVectorAdd(m.r[3], m.r[1]),      // bottom
+		DirectX::XMVectorSubtract(m.r[3], m.r[1]), // top
+		m.r[2],                                    // z >= 0
+		DirectX::XMVectorSubtract(m.r[3], m.r[2]), // z <= w
+	};
+	for (int i = 0; i < 6; i++)
+		DirectX::XMStoreFloat4(&planes[i], DirectX::XMPlaneNormalize(extracted[i]));
+}
+
+bool Frustum::IsVisible(const DirectX::XMFLOAT3& minVec, const DirectX::XMFLOAT3& maxVec) const
+{
+	for (const DirectX::XMFLOAT4& plane : planes)
+	{
+		float s = plane.x * (plane.x < 0 ? minVec.x : maxVec.x)
+			+ plane.y * (plane.y < 0 ? minVec.y : maxVec.y)
+			+ plane.z * (plane.z < 0 ? minVec.z : maxVec.z)
+			+ plane.w;
+		if (s < 0.0f)
+			return false;
+	}
+	return true;
+}
+
+void ContributionParams::Set(const DirectX::XMVECTOR& camera, float fov, float aspectRatio, float viewportHeight,
+	float minPixelArea)
+{
+	DirectX::XMStoreFloat3(&cameraPosition, camera);
+	float pixelsPerUnit = viewportHeight / (2.0f * tanf(fov / 2) * aspectRatio);
+	areaScale = minPixelArea > 0.0f ? DirectX::XM_PI * pixelsPerUnit * pixelsPerUnit / minPixelArea : 0.0f;
+}
+
+void AABBSoA::Resize(size_t count)
+{
+	m_count = count;
+	m_minX.resize(count);
+	m_minY.resize(count);
+	m_minZ.resize(count);
+	m_maxX.resize(count);
+	m_maxY.resize(count);
+	m_maxZ.resize(count);
+}
+
+void AABBSoA::Set(size_t index, const DirectX::XMFLOAT3& minVec, const DirectX::XMFLOAT3& maxVec)
+{
+	m_minX[index] = minVec.x;
+	m_minY[index] = minVec.y;
+	m_minZ[index] = minVec.z;
+	m_maxX[index] = maxVec.x;
+	m_maxY[index] = maxVec.y;
+	m_maxZ[index] = maxVec.z;
+}
+
+void AABBSoA::SetTransformed(const AxisAlignedBox& localBox, const DirectX::XMMATRIX* pModels, size_t modelStride,
+	const UINT32* pIds, size_t count)
+{
+	const BYTE* pModelBytes = reinterpret_cast<const BYTE*>(pModels);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	const __m128 centerX = _mm_set1_ps(localBox.center.x);
+	const __m128 centerY = _mm_set1_ps(localBox.center.y);
+	const __m128 centerZ = _mm_set1_ps(localBox.center.z);
+	const __m128 extentX = _mm_set1_ps(localBox.extents.x);
+	const __m128 extentY = _mm_set1_ps(localBox.extents.y);
+	const __m128 extentZ = _mm_set1_ps(localBox.extents.z);
+	for (size_t i = 0; i < count; i += 4)
+	{
+		// Short batches repeat their last box
+		const size_t batchSize = min(count - i, size_t(4));
+		size_t indices[4];
+		__m128 minVec[4];
+		__m128 maxVec[4];
+		for (size_t k = 0; k < 4; k++)
+		{
+			const size_t item = i + min(k, batchSize - 1);
+			indices[k] = pIds ? pIds[item] : item;
+			const float* pModel = reinterpret_cast<const float*>(pModelBytes + modelStride * indices[k]);
+			const __m128 row0 = _mm_loadu_ps(pModel);
+			const __m128 row1 = _mm_loadu_ps(pModel + 4);
+			const __m128 row2 = _mm_loadu_ps(pModel + 8);
+			const __m128 row3 = _mm_loadu_ps(pModel + 12);
+			const __m128 center = _mm_add_ps(_mm_add_ps(_mm_mul_ps(centerX, row0), _mm_mul_ps(centerY, row1)),
+				_mm_add_ps(_mm_mul_ps(centerZ, row2), row3));
+			const __m128 extents = _mm_add_ps(_mm_add_ps(_mm_mul_ps(extentX, _mm_and_ps(row0, absMask)),
+				_mm_mul_ps(extentY, _mm_and_ps(row1, absMask))), _mm_mul_ps(extentZ, _mm_and_ps(row2, absMask)));
+			minVec[k] = _mm_sub_ps(center, extents);
+			maxVec[k] = _mm_add_ps(center, extents);
+		}
+		_MM_TRANSPOSE4_PS(minVec[0], minVec[1], minVec[2], minVec[3]);
+		_MM_TRANSPOSE4_PS(maxVec[0], maxVec[1], maxVec[2], maxVec[3]);
+
+		if (!pIds && batchSize == 4)
+		{
+			_mm_storeu_ps(&m_minX[i], minVec[0]);
+			_mm_storeu_ps(&m_minY[i], minVec[1]);
+			_mm_storeu_ps(&m_minZ[i], minVec[2]);
+			_mm_storeu_ps(&m_maxX[i], maxVec[0]);
+			_mm_storeu_ps(&m_maxY[i], maxVec[1]);
+			_mm_storeu_ps(&m_maxZ[i], maxVec[2]);
+			continue;
+		}
+		float lanes[6][4];
+		for (int axis = 0; axis < 3; axis++)
+		{
+			_mm_storeu_ps(lanes[axis], minVec[axis]);
+			_mm_storeu_ps(lanes[axis + 3], maxVec[axis]);
+		}
+		for (size_t k = 0; k < batchSize; k++)
+		{
+			const size_t index = indices[k];
+			m_minX[index] = lanes[0][k];
+			m_minY[index] = lanes[1][k];
+			m_minZ[index] = lanes[2][k];
+			m_maxX[index] = lanes[3][k];
+			m_maxY[index] = lanes[4][k];
+			m_maxZ[index] = lanes[5][k];
+		}
+	}
+}
+
+void BoundingVolumesSoA::Resize(size_t count)
+{
+	m_count = count;
+	for (int a = 0; a < 3; a++)
+	{
+		m_sphereCenter[a].resize(count);
+		m_boxCenter[a].resize(count);
+	}
+	m_sphereRadius.resize(count);
+	for (auto& axis : m_boxAxes)
+		axis.resize(count);
+}
+
+void BoundingVolumesSoA::Set(size_t index, const BoundingSphere& sphere, const OrientedBox& box, const DirectX::XMMATRIX& model)
+{
+	DirectX::XMFLOAT3 center;
+	DirectX::XMStoreFloat3(&center, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&sphere.center), model));
+	float maxScaleSq = 0.0f;
+	for (int a = 0; a < 3; a++)
+		maxScaleSq = max(maxScaleSq, DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(model.r[a])));
+	m_sphereCenter[0][index] = center.x;
+	m_sphereCenter[1][index] = center.y;
+	m_sphereCenter[2][index] = center.z;
+	m_sphereRadius[index] = sphere.radius * sqrtf(maxScaleSq);
+
+	DirectX::XMStoreFloat3(&center, DirectX::XMVector3Transform(DirectX::XMLoadFloat3(&box.center), model));
+	m_boxCenter[0][index] = center.x;
+	m_boxCenter[1][index] = center.y;
+	m_boxCenter[2][index] = center.z;
+	const float extents[3] = { box.extents.x, box.extents.y, box.extents.z };
+	for (int b = 0; b < 3; b++)
+	{
+		DirectX::XMFLOAT3 axis;
+		DirectX::XMStoreFloat3(&axis, DirectX::XMVector3TransformNormal(
+			DirectX::XMVectorScale(DirectX::XMLoadFloat3(&box.axes[b]), extents[b]), model));
+		m_boxAxes[b * 3 + 0][index] = axis.x;
+		m_boxAxes[b * 3 + 1][index] = axis.y;
+		m_boxAxes[b * 3 + 2][index] = axis.z;
+	}
+}
+
+namespace
+{
+	// For every plane the box corner furthest along the normal is picked per axis, the choice only
+	// depends on the plane sign, so it is made once per plane instead of per lane
+	struct PlaneStreams
+	{
+		const float* pX[6];
+		const float* pY[6];
+		const float* pZ[6];
+	};
+
+	PlaneStreams SelectStreams(const Frustum& frustum, const AABBSoA& bounds)
+	{
+		PlaneStreams streams;
+		for (int i = 0; i < 6; i++)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[i];
+			streams.pX[i] = plane.x < 0 ? bounds.GetMinX() : bounds.GetMaxX();
+			streams.pY[i] = plane.y < 0 ? bounds.GetMinY() : bounds.GetMaxY();
+			streams.pZ[i] = plane.z < 0 ? bounds.GetMinZ() : bounds.GetMaxZ();
+		}
+		return streams;
+	}
+
+	UINT CullTail(const Frustum& frustum, const AABBSoA& bounds, size_t first, size_t end, UINT count, UINT32* pOutVisible)
+	{
+		for (size_t i = first; i < end; i++)
+		{
+			DirectX::XMFLOAT3 minVec(bounds.GetMinX()[i], bounds.GetMinY()[i], bounds.GetMinZ()[i]);
+			DirectX::XMFLOAT3 maxVec(bounds.GetMaxX()[i], bounds.GetMaxY()[i], bounds.GetMaxZ()[i]);
+			pOutVisible[count] = UINT32(i);
+			count += frustum.IsVisible(minVec, maxVec) ? 1 : 0;
+		}
+		return count;
+	}
+}
+
+UINT CullAABBsScalar(const Frustum& frustum, const AABBSoA& bounds, UINT32* pOutVisible)
+{
+	return CullTail(frustum, bounds, 0, bounds.GetCount(), 0, pOutVisible);
+}
+
+UINT CullAABBRangeCoherent(const Frustum& frustum, const AABBSoA& bounds, size_t first, size_t end, UINT8* pFailedPlanes,
+	UINT32* pOutVisible, UINT* pPlaneHits)
+{
+	PlaneStreams streams = SelectStreams(frustum, bounds);
+	UINT visibleCount = 0;
+	UINT planeHits = 0;
+	size_t i = first;
+
+	// Four boxes at a time, the cached planes are gathered and transposed so every lane tests its own plane.
+	// Only groups with a lane surviving its cached plane go through the full six plane test.
+	__m128 planeRows[6];
+	__m128 a[6], b[6], c[6], d[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeRows[p] = _mm_loadu_ps(&frustum.planes[p].x);
+		a[p] = _mm_set1_ps(frustum.planes[p].x);
+		b[p] = _mm_set1_ps(frustum.planes[p].y);
+		c[p] = _mm_set1_ps(frustum.planes[p].z);
+		d[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	const __m128 zero = _mm_setzero_ps();
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 cachedA = planeRows[pFailedPlanes[i]];
+		__m128 cachedB = planeRows[pFailedPlanes[i + 1]];
+		__m128 cachedC = planeRows[pFailedPlanes[i + 2]];
+		__m128 cachedD = planeRows[pFailedPlanes[i + 3]];
+		_MM_TRANSPOSE4_PS(cachedA, cachedB, cachedC, cachedD);
+
+		auto corner = [](__m128 normal, const float* pMin, const float* pMax)
+		{
+			__m128 negative = _mm_cmplt_ps(normal, _mm_setzero_ps());
+			return _mm_or_ps(_mm_and_ps(negative, _mm_loadu_ps(pMin)), _mm_andnot_ps(negative, _mm_loadu_ps(pMax)));
+		};
+		__m128 s = _mm_add_ps(_mm_mul_ps(cachedA, corner(cachedA, bounds.GetMinX() + i, bounds.GetMaxX() + i)), cachedD);
+		s = _mm_add_ps(_mm_mul_ps(cachedB, corner(cachedB, bounds.GetMinY() + i, bounds.GetMaxY() + i)), s);
+		s = _mm_add_ps(_mm_mul_ps(cachedC, corner(cachedC, bounds.GetMinZ() + i, bounds.GetMaxZ() + i)), s);
+		const int cachedMask = _mm_movemask_ps(_mm_cmplt_ps(s, zero));
+		planeHits += UINT(_mm_popcnt_u32(cachedMask));
+		if (cachedMask == 0xF)
+			continue;
+
+		// The first plane rejecting a lane replaces its cached one
+		int packedPlanes;
+		memcpy(&packedPlanes, pFailedPlanes + i, sizeof(packedPlanes));
+		__m128i cachedPlanes = _mm_cvtsi32_si128(packedPlanes);
+		cachedPlanes = _mm_unpacklo_epi16(_mm_unpacklo_epi8(cachedPlanes, _mm_setzero_si128()), _mm_setzero_si128());
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 s = _mm_add_ps(_mm_mul_ps(a[p], _mm_loadu_ps(streams.pX[p] + i)), d[p]);
+			s = _mm_add_ps(_mm_mul_ps(b[p], _mm_loadu_ps(streams.pY[p] + i)), s);
+			s = _mm_add_ps(_mm_mul_ps(c[p], _mm_loadu_ps(streams.pZ[p] + i)), s);
+			__m128 planeInside = _mm_cmpge_ps(s, zero);
+			__m128i failed = _mm_castps_si128(_mm_andnot_ps(planeInside, inside));
+			cachedPlanes = _mm_or_si128(_mm_andnot_si128(failed, cachedPlanes), _mm_and_si128(failed, _mm_set1_epi32(p)));
+			inside = _mm_and_ps(inside, planeInside);
+		}
+		cachedPlanes = _mm_packus_epi16(_mm_packs_epi32(cachedPlanes, cachedPlanes), cachedPlanes);
+		packedPlanes = _mm_cvtsi128_si32(cachedPlanes);
+		memcpy(pFailedPlanes + i, &packedPlanes, sizeof(packedPlanes));
+
+		const int mask = _mm_movemask_ps(inside);
+		for (UINT lane = 0; lane < 4; lane++)
+		{
+			pOutVisible[visibleCount] = UINT32(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+
+	for (; i < end; i++)
+	{
+		auto distance = [&](UINT p)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[p];
+			return ((plane.x * streams.pX[p][i] + plane.w) + plane.y * streams.pY[p][i]) + plane.z * streams.pZ[p][i];
+		};
+		const UINT cachedPlane = pFailedPlanes[i];
+		if (distance(cachedPlane) < 0.0f)
+		{
+			planeHits++;
+			continue;
+		}
+		bool visible = true;
+		for (UINT p = 0; p < 6 && visible; p++)
+		{
+			if (distance(p) < 0.0f)
+			{
+				pFailedPlanes[i] = UINT8(p);
+				visible = false;
+			}
+		}
+		pOutVisible[visibleCount] = UINT32(i);
+		visibleCount += visible ? 1 : 0;
+	}
+	*pPlaneHits += planeHits;
+	return visibleCount;
+}
+
+UINT CullAABBs(const Frustum& frustum, const AABBSoA& bounds, UINT32* pOutVisible)
+{
+	return CullAABBRange(frustum, bounds, 0, bounds.GetCount(), pOutVisible);
+}
+
+UINT CullAABBRange(const Frustum& frustum, const AABBSoA& bounds, size_t first, size_t end, UINT32* pOutVisible)
+{
+	PlaneStreams streams = SelectStreams(frustum, bounds);
+	UINT visibleCount = 0;
+	size_t i = first;
+
+#if defined(__AVX512F__)
+	__m512 a[6], b[6], c[6], d[6];
+	for (int p = 0; p < 6; p++)
+	{
+		a[p] = _mm512_set1_ps(frustum.planes[p].x);
+		b[p] = _mm512_set1_ps(frustum.planes[p].y);
+		c[p] = _mm512_set1_ps(frustum.planes[p].z);
+		d[p] = _mm512_set1_ps(frustum.planes[p].w);
+	}
+	const __m512i laneIds = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+	for (; i + 16 <= end; i += 16)
+	{
+		__mmask16 inside = 0xFFFF;
+		for (int p = 0; p < 6; p++)
+		{
+			__m512 s = _mm512_fmadd_ps(a[p], _mm512_loadu_ps(streams.pX[p] + i), d[p]);
+			s = _mm512_fmadd_ps(b[p], _mm512_loadu_ps(streams.pY[p] + i), s);
+			s = _mm512_fmadd_ps(c[p], _mm512_loadu_ps(streams.pZ[p] + i), s);
+			inside = _mm512_mask_cmp_ps_mask(inside, s, _mm512_setzero_ps(), _CMP_GE_OQ);
+		}
+		__m512i ids = _mm512_add_epi32(laneIds, _mm512_set1_epi32(int(i)));
+		_mm512_mask_compressstoreu_epi32(pOutVisible + visibleCount, inside, ids);
+		visibleCount += UINT(_mm_popcnt_u32(inside));
+	}
+#elif defined(__AVX2__)
+	__m256 a[6], b[6], c[6], d[6];
+	for (int p = 0; p < 6; p++)
+	{
+		a[p] = _mm256_set1_ps(frustum.planes[p].x);
+		b[p] = _mm256_set1_ps(frustum.planes[p].y);
+		c[p] = _mm256_set1_ps(frustum.planes[p].z);
+		d[p] = _mm256_set1_ps(frustum.planes[p].w);
+	}
+	for (; i + 8 <= end; i += 8)
+	{
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 s = _mm256_add_ps(_mm256_mul_ps(a[p], _mm256_loadu_ps(streams.pX[p] + i)), d[p]);
+			s = _mm256_add_ps(_mm256_mul_ps(b[p], _mm256_loadu_ps(streams.pY[p] + i)), s);
+			s = _mm256_add_ps(_mm256_mul_ps(c[p], _mm256_loadu_ps(streams.pZ[p] + i)), s);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		for (UINT lane = 0; lane < 8; lane++)
+		{
+			pOutVisible[visibleCount] = UINT32(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#else
+	__m128 a[6], b[6], c[6], d[6];
+	for (int p = 0; p < 6; p++)
+	{
+		a[p] = _mm_set1_ps(frustum.planes[p].x);
+		b[p] = _mm_set1_ps(frustum.planes[p].y);
+		c[p] = _mm_set1_ps(frustum.planes[p].z);
+		d[p] = _mm_set1_ps(frustum.planes[p].w);
+	}
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 s = _mm_add_ps(_mm_mul_ps(a[p], _mm_loadu_ps(streams.pX[p] + i)), d[p]);
+			s = _mm_add_ps(_mm_mul_ps(b[p], _mm_loadu_ps(streams.pY[p] + i)), s);
+			s = _mm_add_ps(_mm_mul_ps(c[p], _mm_loadu_ps(streams.pZ[p] + i)), s);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(s, _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (UINT lane = 0; lane < 4; lane++)
+		{
+			pOutVisible[visibleCount] = UINT32(i + lane);
+			visibleCount += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	return CullTail(frustum, bounds, i, end, visibleCount, pOutVisible);
+}
+
+UINT CullAABBIds(const Frustum& frustum, const AABBSoA& bounds, UINT32* pIds, UINT count)
+{
+	PlaneStreams streams = SelectStreams(frustum, bounds);
+	UINT keptCount = 0;
+	UINT i = 0;
+
+#if defined(__AVX2__)
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIds + i));
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[p];
+			__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), _mm256_i32gather_ps(streams.pX[p], ids, 4)), _mm256_set1_ps(plane.w));
+			s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.y), _mm256_i32gather_ps(streams.pY[p], ids, 4)), s);
+			s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), _mm256_i32gather_ps(streams.pZ[p], ids, 4)), s);
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		int mask = _mm256_movemask_ps(inside);
+		UINT32 laneIds[8];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(laneIds), ids);
+		for (UINT lane = 0; lane < 8; lane++)
+		{
+			pIds[keptCount] = laneIds[lane];
+			keptCount += (mask >> lane) & 1;
+		}
+	}
+#else
+	for (; i + 4 <= count; i += 4)
+	{
+		const UINT32 laneIds[4] = { pIds[i], pIds[i + 1], pIds[i + 2], pIds[i + 3] };
+		auto gather = [&](const float* pStream) { return _mm_setr_ps(pStream[laneIds[0]], pStream[laneIds[1]], pStream[laneIds[2]], pStream[laneIds[3]]); };
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[p];
+			__m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), gather(streams.pX[p])), _mm_set1_ps(plane.w));
+			s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.y), gather(streams.pY[p])), s);
+			s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), gather(streams.pZ[p])), s);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(s, _mm_setzero_ps()));
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (UINT lane = 0; lane < 4; lane++)
+		{
+			pIds[keptCount] = laneIds[lane];
+			keptCount += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const UINT32 id = pIds[i];
+		DirectX::XMFLOAT3 minVec(bounds.GetMinX()[id], bounds.GetMinY()[id], bounds.GetMinZ()[id]);
+		DirectX::XMFLOAT3 maxVec(bounds.GetMaxX()[id], bounds.GetMaxY()[id], bounds.GetMaxZ()[id]);
+		pIds[keptCount] = id;
+		keptCount += frustum.IsVisible(minVec, maxVec) ? 1 : 0;
+	}
+	return keptCount;
+}
+
+UINT CullSmallAABBs(const ContributionParams& params, const AABBSoA& bounds, UINT32* pIds, UINT count)
+{
+	if (!params.IsEnabled())
+		return count;
+
+	// Projected area of a sphere is pi * (r * pixelsPerUnit / distance)^2, compared without the division:
+	// r^2 * areaScale >= distance^2. The camera inside the sphere always passes.
+	const float* pMin[3] = { bounds.GetMinX(), bounds.GetMinY(), bounds.GetMinZ() };
+	const float* pMax[3] = { bounds.GetMaxX(), bounds.GetMaxY(), bounds.GetMaxZ() };
+	const float camera[3] = { params.cameraPosition.x, params.cameraPosition.y, params.cameraPosition.z };
+	UINT keptCount = 0;
+	UINT i = 0;
+
+#if defined(__AVX2__)
+	const __m256 areaScale = _mm256_set1_ps(params.areaScale * 0.25f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIds + i));
+		__m256 diameterSq = _mm256_setzero_ps();
+		__m256 distanceSq = _mm256_setzero_ps();
+		for (int a = 0; a < 3; a++)
+		{
+			__m256 minVec = _mm256_i32gather_ps(pMin[a], ids, 4);
+			__m256 maxVec = _mm256_i32gather_ps(pMax[a], ids, 4);
+			__m256 size = _mm256_sub_ps(maxVec, minVec);
+			__m256 offset = _mm256_sub_ps(_mm256_mul_ps(_mm256_add_ps(minVec, maxVec), _mm256_set1_ps(0.5f)), _mm256_set1_ps(camera[a]));
+			diameterSq = _mm256_add_ps(diameterSq, _mm256_mul_ps(size, size));
+			distanceSq = _mm256_add_ps(distanceSq, _mm256_mul_ps(offset, offset));
+		}
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(_mm256_mul_ps(diameterSq, areaScale), distanceSq, _CMP_GE_OQ));
+		UINT32 laneIds[8];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(laneIds), ids);
+		for (UINT lane = 0; lane < 8; lane++)
+		{
+			pIds[keptCount] = laneIds[lane];
+			keptCount += (mask >> lane) & 1;
+		}
+	}
+#else
+	const __m128 areaScale = _mm_set1_ps(params.areaScale * 0.25f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const UINT32 laneIds[4] = { pIds[i], pIds[i + 1], pIds[i + 2], pIds[i + 3] };
+		__m128 diameterSq = _mm_setzero_ps();
+		__m128 distanceSq = _mm_setzero_ps();
+		for (int a = 0; a < 3; a++)
+		{
+			__m128 minVec = _mm_setr_ps(pMin[a][laneIds[0]], pMin[a][laneIds[1]], pMin[a][laneIds[2]], pMin[a][laneIds[3]]);
+			__m128 maxVec = _mm_setr_ps(pMax[a][laneIds[0]], pMax[a][laneIds[1]], pMax[a][laneIds[2]], pMax[a][laneIds[3]]);
+			__m128 size = _mm_sub_ps(maxVec, minVec);
+			__m128 offset = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(minVec, maxVec), _mm_set1_ps(0.5f)), _mm_set1_ps(camera[a]));
+			diameterSq = _mm_add_ps(diameterSq, _mm_mul_ps(size, size));
+			distanceSq = _mm_add_ps(distanceSq, _mm_mul_ps(offset, offset));
+		}
+		int mask = _mm_movemask_ps(_mm_cmpge_ps(_mm_mul_ps(diameterSq, areaScale), distanceSq));
+		for (UINT lane = 0; lane < 4; lane++)
+		{
+			pIds[keptCount] = laneIds[lane];
+			keptCount += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const UINT32 id = pIds[i];
+		float diameterSq = 0.0f;
+		float distanceSq = 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			float size = pMax[a][id] - pMin[a][id];
+			float offset = (pMin[a][id] + pMax[a][id]) * 0.5f - camera[a];
+			diameterSq += size * size;
+			distanceSq += offset * offset;
+		}
+		pIds[keptCount] = id;
+		keptCount += diameterSq * (params.areaScale * 0.25f) >= distanceSq ? 1 : 0;
+	}
+	return keptCount;
+}
+
+UINT CullBoundingVolumes(const Frustum& frustum, const BoundingVolumesSoA& volumes, UINT32* pIds, UINT count)
+{
+	// Sphere: the center distance must be at least -radius. Oriented box: the projected radius is the sum of
+	// |dot(normal, axis)| over the three scaled axes. The box is only tested when a lane survives the spheres.
+	const float* pSphere[4] = { volumes.GetSphereCenter(0), volumes.GetSphereCenter(1), volumes.GetSphereCenter(2), volumes.GetSphereRadius() };
+	const float* pBox[12] = { volumes.GetBoxCenter(0), volumes.GetBoxCenter(1), volumes.GetBoxCenter(2) };
+	for (int b = 0; b < 3; b++)
+	{
+		for (int a = 0; a < 3; a++)
+			pBox[3 + b * 3 + a] = volumes.GetBoxAxis(b, a);
+	}
+	UINT keptCount = 0;
+	UINT i = 0;
+
+#if defined(__AVX2__)
+	const __m256 signMask = _mm256_set1_ps(-0.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pIds + i));
+		auto gather = [&](const float* pStream) { return _mm256_i32gather_ps(pStream, ids, 4); };
+		auto centerDistance = [&](int p, __m256 x, __m256 y, __m256 z)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[p];
+			__m256 s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.x), x), _mm256_set1_ps(plane.w));
+			s = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.y), y), s);
+			return _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), z), s);
+		};
+
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		{
+			__m256 x = gather(pSphere[0]), y = gather(pSphere[1]), z = gather(pSphere[2]), r = gather(pSphere[3]);
+			for (int p = 0; p < 6; p++)
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(_mm256_add_ps(centerDistance(p, x, y, z), r), _mm256_setzero_ps(), _CMP_GE_OQ));
+		}
+		if (_mm256_movemask_ps(inside) != 0)
+		{
+			__m256 box[12];
+			for (int k = 0; k < 12; k++)
+				box[k] = gather(pBox[k]);
+			for (int p = 0; p < 6; p++)
+			{
+				const DirectX::XMFLOAT4& plane = frustum.planes[p];
+				__m256 radius = _mm256_setzero_ps();
+				for (int b = 0; b < 3; b++)
+				{
+					__m256 proj = _mm256_mul_ps(_mm256_set1_ps(plane.x), box[3 + b * 3]);
+					proj = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.y), box[4 + b * 3]), proj);
+					proj = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.z), box[5 + b * 3]), proj);
+					radius = _mm256_add_ps(radius, _mm256_andnot_ps(signMask, proj));
+				}
+				__m256 s = _mm256_add_ps(centerDistance(p, box[0], box[1], box[2]), radius);
+				inside = _mm256_and_ps(inside, _mm256_cmp_ps(s, _mm256_setzero_ps(), _CMP_GE_OQ));
+			}
+		}
+		int mask = _mm256_movemask_ps(inside);
+		UINT32 laneIds[8];
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(laneIds), ids);
+		for (UINT lane = 0; lane < 8; lane++)
+		{
+			pIds[keptCount] = laneIds[lane];
+			keptCount += (mask >> lane) & 1;
+		}
+	}
+#else
+	const __m128 signMask = _mm_set1_ps(-0.0f);
+	for (; i + 4 <= count; i += 4)
+	{
+		const UINT32 laneIds[4] = { pIds[i], pIds[i + 1], pIds[i + 2], pIds[i + 3] };
+		auto gather = [&](const float* pStream) { return _mm_setr_ps(pStream[laneIds[0]], pStream[laneIds[1]], pStream[laneIds[2]], pStream[laneIds[3]]); };
+		auto centerDistance = [&](int p, __m128 x, __m128 y, __m128 z)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[p];
+			__m128 s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.x), x), _mm_set1_ps(plane.w));
+			s = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.y), y), s);
+			return _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), z), s);
+		};
+
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+		{
+			__m128 x = gather(pSphere[0]), y = gather(pSphere[1]), z = gather(pSphere[2]), r = gather(pSphere[3]);
+			for (int p = 0; p < 6; p++)
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(centerDistance(p, x, y, z), r), _mm_setzero_ps()));
+		}
+		if (_mm_movemask_ps(inside) != 0)
+		{
+			__m128 box[12];
+			for (int k = 0; k < 12; k++)
+				box[k] = gather(pBox[k]);
+			for (int p = 0; p < 6; p++)
+			{
+				const DirectX::XMFLOAT4& plane = frustum.planes[p];
+				__m128 radius = _mm_setzero_ps();
+				for (int b = 0; b < 3; b++)
+				{
+					__m128 proj = _mm_mul_ps(_mm_set1_ps(plane.x), box[3 + b * 3]);
+					proj = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.y), box[4 + b * 3]), proj);
+					proj = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane.z), box[5 + b * 3]), proj);
+					radius = _mm_add_ps(radius, _mm_andnot_ps(signMask, proj));
+				}
+				__m128 s = _mm_add_ps(centerDistance(p, box[0], box[1], box[2]), radius);
+				inside = _mm_and_ps(inside, _mm_cmpge_ps(s, _mm_setzero_ps()));
+			}
+		}
+		int mask = _mm_movemask_ps(inside);
+		for (UINT lane = 0; lane < 4; lane++)
+		{
+			pIds[keptCount] = laneIds[lane];
+			keptCount += (mask >> lane) & 1;
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		const UINT32 id = pIds[i];
+		bool visible = true;
+		for (int p = 0; p < 6 && visible; p++)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[p];
+			float s = ((plane.x * pSphere[0][id] + plane.w) + plane.y * pSphere[1][id]) + plane.z * pSphere[2][id];
+			visible = s + pSphere[3][id] >= 0.0f;
+		}
+		for (int p = 0; p < 6 && visible; p++)
+		{
+			const DirectX::XMFLOAT4& plane = frustum.planes[p];
+			float radius = 0.0f;
+			for (int b = 0; b < 3; b++)
+				radius += fabsf(((plane.x * pBox[3 + b * 3][id]) + plane.y * pBox[4 + b * 3][id]) + plane.z * pBox[5 + b * 3][id]);
+			float s = ((plane.x * pBox[0][id] + plane.w) + plane.y * pBox[1][id]) + plane.z * pBox[2][id];
+			visible = s + radius >= 0.0f;
+		}
+		pIds[keptCount] = id;
+		keptCount += visible ? 1 : 0;
+	}
+	return keptCount;
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "framework.h"
+#include <vector>
+#include "BoundingVolumes.h"
+
+// Six planes with normals pointing inside, a point is inside when dot(plane, (p, 1)) >= 0 for all of them
+struct Frustum
+{
+	DirectX::XMFLOAT4 planes[6];
+
+	// Works for any D3D projection including reverse-Z, the clip volume is 0 <= z <= w either way
+	void ExtractFromMatrix(const DirectX::XMMATRIX& viewProjection);
+	bool IsVisible(const DirectX::XMFLOAT3& minVec, const DirectX::XMFLOAT3& maxVec) const;
+};
+
+// Screen coverage estimate for contribution culling, boxes are replaced by their bounding spheres
+struct ContributionParams
+{
+	DirectX::XMFLOAT3 cameraPosition = { 0.0f, 0.0f, 0.0f };
+	float areaScale = 0.0f; // pi * (pixels per unit at distance 1)^2 / minPixelArea, 0 disables the test
+
+	// fov and aspectRatio (height / width) as passed to the projection, fov spans the viewport width
+	void Set(const DirectX::XMVECTOR& camera, float fov, float aspectRatio, float viewportHeight, float minPixelArea);
+	bool IsEnabled() const { return areaScale > 0.0f; }
+};
+
+// Instance bounds in structure-of-arrays form for the SIMD kernel
+class AABBSoA
+{
+public:
+	void Resize(size_t count);
+	void Set(size_t index, const DirectX::XMFLOAT3& minVec, const DirectX::XMFLOAT3& maxVec);
+	// Arvo's transform of localBox by the model matrices of the ids (of the first count boxes when pIds is null):
+	// the center goes through the matrix, the extents through its absolute value. Consecutive models are
+	// modelStride bytes apart, 4 boxes are transformed per iteration.
+	void SetTransformed(const AxisAlignedBox& localBox, const DirectX::XMMATRIX* pModels, size_t modelStride,
+		const UINT32* pIds, size_t count);
+	size_t GetCount() const { return m_count; }
+
+	const float* GetMinX() const { return m_minX.data(); }
+	const float* GetMinY() const { return m_minY.data(); }
+	const float* GetMinZ() const { return m_minZ.data(); }
+	const float* GetMaxX() const { return m_maxX.data(); }
+	const float* GetMaxY() const { return m_maxY.data(); }
+	const float* GetMaxZ() const { return m_maxZ.data(); }
+
+private:
+	size_t m_count = 0;
+	std::vector<float> m_minX, m_minY, m_minZ;
+	std::vector<float> m_maxX, m_maxY, m_maxZ;
+};
+
+// World space bounding spheres and oriented boxes of the instances, box axes are stored scaled by the half extents
+class BoundingVolumesSoA
+{
+public:
+	void Resize(size_t count);
+	// Transforms the mesh volumes by the instance model matrix
+	void Set(size_t index, const BoundingSphere& sphere, const OrientedBox& box, const DirectX::XMMATRIX& model);
+	size_t GetCount() const { return m_count; }
+
+	const float* GetSphereCenter(int axis) const { return m_sphereCenter[axis].data(); }
+	const float* GetSphereRadius() const { return m_sphereRadius.data(); }
+	const float* GetBoxCenter(int axis) const { return m_boxCenter[axis].data(); }
+	const float* GetBoxAxis(int boxAxis, int axis) const { return m_boxAxes[boxAxis * 3 + axis].data(); }
+
+private:
+	size_t m_count = 0;
+	std::vector<float> m_sphereCenter[3];
+	std::vector<float> m_sphereRadius;
+	std::vector<float> m_boxCenter[3];
+	std::vector<float> m_boxAxes[9];
+};
+
+// Writes indices of the boxes intersecting the frustum in ascending order and returns their number.
+// pOutVisible must hold bounds.GetCount() elements. Processes 16, 8 or 4 boxes per iteration
+// depending on the target instruction set (AVX-512, AVX2, SSE).
+UINT CullAABBs(const Frustum& frustum, const AABBSoA& bounds, UINT32* pOutVisible);
+// Same for the [first, end) range, written indices stay absolute. pOutVisible must hold end - first elements.
+UINT CullAABBRange(const Frustum& frustum, const AABBSoA& bounds, size_t first, size_t end, UINT32* pOutVisible);
+// Plane coherent variant: pFailedPlanes holds one entry per box (0-5) with the plane that rejected it last time,
+// that plane is tested first and the entry is updated. pPlaneHits counts boxes rejected by their cached plane.
+UINT CullAABBRangeCoherent(const Frustum& frustum, const AABBSoA& bounds, size_t first, size_t end, UINT8* pFailedPlanes,
+	UINT32* pOutVisible, UINT* pPlaneHits);
+// Removes the ids whose box is outside the frustum keeping the order, returns the new count. For candidate lists
+// like a potentially visible set, where the boxes are gathered instead of streamed.
+UINT CullAABBIds(const Frustum& frustum, const AABBSoA& bounds, UINT32* pIds, UINT count);
+// Second stage for the boxes passing the frustum test: removes the ids whose bounding sphere, then oriented box,
+// is outside the frustum keeping the order, returns the new count. Both volumes are conservative like the AABB.
+UINT CullBoundingVolumes(const Frustum& frustum, const BoundingVolumesSoA& volumes, UINT32* pIds, UINT count);
+// Removes the boxes covering less than the minimum pixel area from the id list keeping the order, returns the new count
+UINT CullSmallAABBs(const ContributionParams& params, const AABBSoA& bounds, UINT32* pIds, UINT count);
+// Scalar reference of the frustum test
+UINT CullAABBsScalar(const Frustum& frustum, const AABBSoA& bounds, UINT32* pOutVisible);
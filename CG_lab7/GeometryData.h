@@ -1,13 +1,16 @@
 #pragma once
 #include "framework.h"
 #include <vector>
+#include <cstring>
+#include "FrustumCulling.h"
+#include "InstanceBVH.h"
+#include "MaterialTable.h"
 
 using namespace std;
 
 struct SceneBuffer
 {
 	DirectX::XMMATRIX model;
-	DirectX::XMMATRIX normTransform;
 	DirectX::XMFLOAT4 lightParams;
 	DirectX::XMFLOAT4 baseColor;
 	union{
@@ -22,7 +25,6 @@ struct SceneBuffer
 	
 	void setModel(const DirectX::XMMATRIX& model) {
 		this->model = model;
-		normTransform = DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(nullptr, model));
 	}
 	SceneBuffer() {
 		textureId = 0;
@@ -32,6 +34,15 @@ struct SceneBuffer
 	}
 };
 
+// Instance record of the base shaders. The world matrix is affine, its first three columns are sent
+// (world x = dot(world[0], float4(pos, 1))); Base_VS derives the normal matrix from its cofactors.
+// The shading parameters are looked up in the material table.
+struct InstanceData
+{
+	DirectX::XMFLOAT4 world[3];
+	UINT32 materialId;
+};
+
 struct Vertex {
 	float x, y, z;
 };
@@ -39,81 +50,23 @@ struct Vertex {
 struct TextureNormalVertex
 {
 	DirectX::XMFLOAT3 pos;
-	DirectX::XMFLOAT3 tang;
+	DirectX::XMFLOAT4 tang; // w - bitangent sign, bitangent = cross(tang, normal) * w
 	DirectX::XMFLOAT3 normal;
 	DirectX::XMFLOAT2 textureUV;
 };
 
 struct Instance {
-	SceneBuffer sceneBuffer;
-	DirectX::XMFLOAT3 minVec;
-	DirectX::XMFLOAT3 maxVec;
-
-	Instance(DirectX::XMMATRIX& model, DirectX::XMFLOAT4& lightParams, DirectX::XMFLOAT4 &baseColor, int textureId = 0) {
-		sceneBuffer.setModel(model);
-		sceneBuffer.lightParams = lightParams;
-		sceneBuffer.baseColor = baseColor;
-		sceneBuffer.textureId = textureId;
-	}
-
-	Instance() {
-		sceneBuffer.lightParams = { 1.0f, 1.0f, 3.0f, 32.0f };
-		sceneBuffer.baseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
-		sceneBuffer.textureId = 0;
-	}
-
-	void UpdateAABB(const std::vector<DirectX::XMFLOAT3>& AABBSupportVectors, const DirectX::XMMATRIX& model)
-	{
-		if (AABBSupportVectors.size() == 0)
-			return;
-		DirectX::XMFLOAT3 vec = *reinterpret_cast<DirectX::XMFLOAT3*>((DirectX::XMMatrixTranslation(AABBSupportVectors[0].x, AABBSupportVectors[0].y, AABBSupportVectors[0].z) * model).r[3].m128_f32);
-		minVec = vec;
-		maxVec = vec;
-		for (auto& supportVec : AABBSupportVectors)
-		{
-			vec = *reinterpret_cast<DirectX::XMFLOAT3*>((DirectX::XMMatrixTranslation(supportVec.x, supportVec.y, supportVec.z) * model).r[3].m128_f32);
-			minVec.x = min(minVec.x, vec.x);
-			minVec.y = min(minVec.y, vec.y);
-			minVec.z = min(minVec.z, vec.z);
-			maxVec.x = max(maxVec.x, vec.x);
-			maxVec.y = max(maxVec.y, vec.y);
-			maxVec.z = max(maxVec.z, vec.z);
-		}
-	}
-
-	bool IsVisible(const std::vector<DirectX::XMVECTOR>& frustum)
-	{
-		for (auto& plane : frustum)
-		{
-			DirectX::XMVECTOR p =
-			{
-				plane.m128_f32[0] < 0 ? minVec.x : maxVec.x,
-				plane.m128_f32[1] < 0 ? minVec.y : maxVec.y,
-				plane.m128_f32[2] < 0 ? minVec.z : maxVec.z,
-				1.0f
-			};
-			float s = DirectX::XMVector4Dot(p, plane).m128_f32[0];
-			if (s < 0.0f)
-				return false;
-		}
-		return true;
-	}
-};
-
-struct ObjectBuffer {
-	std::vector<Instance> instances;
+	DirectX::XMMATRIX model;
+	UINT16 materialId; // in the material table of the renderer
 
-	void set(int idx, const DirectX::XMMATRIX& model, vector<DirectX::XMFLOAT3>& vectorsAABB, int textureId = 0) {
-		instances[idx].sceneBuffer.setModel(model);
-		instances[idx].UpdateAABB(vectorsAABB, model);
-		instances[idx].sceneBuffer.textureId = textureId;
+	Instance(const DirectX::XMMATRIX& model, UINT16 materialId = 0) {
+		this->model = model;
+		this->materialId = materialId;
 	}
 
-	void Update(vector<DirectX::XMFLOAT3>& vectorsAABB) {
-		for (auto& inst : instances)
-		{
-			inst.UpdateAABB(vectorsAABB, inst.sceneBuffer.model);
-		}
+	Instance() {
+		model = DirectX::XMMatrixIdentity();
+		materialId = 0;
 	}
 };
 
@@ -122,91 +75,65 @@ struct GeometryData {
     ID3D11Buffer* vertexBuffer[1];
     UINT strides[1];
     UINT offsets[1];
+    DXGI_FORMAT indexFormat;
+    UINT baseVertex;
+    UINT vertexCount;
+    UINT firstIndex;
     UINT indexCount;
 	vector<DirectX::XMFLOAT3> vectorsAABB;
+	BoundingSphere boundingSphere;
+	OrientedBox orientedBox;
     GeometryData()
     {
         pIndexBuffer = nullptr;
         vertexBuffer[0] = nullptr;
         strides[0] = 0;
         offsets[0] = 0;
+        indexFormat = DXGI_FORMAT_R16_UINT;
+        baseVertex = 0;
+        vertexCount = 0;
+        firstIndex = 0;
         indexCount = 0;
     }
-    GeometryData(ID3D11Buffer* pIndexBuffer, ID3D11Buffer* pVertexBuffer, UINT stride, UINT offset, UINT indexCount): pIndexBuffer(pIndexBuffer), indexCount(indexCount)
-    {
-        vertexBuffer[0] = pVertexBuffer;
-        strides[0] = stride;
-        offsets[0] = offset;
-    }
-
-	static void getSphereGeometry(vector<Vertex>& sphereVertices, vector<USHORT>& sphereIndices, int hRes, int wRes, float rad) {
-		for (int w = 0; w <= wRes; w++)
-		{
-			for (int h = 0; h <= hRes; h++)
-			{
-				float alpha = float(M_PI) * 2.0f * h / hRes;
-				float beta = float(M_PI) * 1.0f * w / wRes;
-				float x = rad * sinf(beta) * cosf(alpha);
-				float z = rad * sinf(beta) * sinf(alpha);
-				float y = rad * cosf(beta);
-				sphereVertices.push_back({ x, y, z });
-			}
-		}
 
-		for (int w = 0; w < wRes; w++)
-		{
-			for (int h = 0; h < hRes; h++)
-			{
-				int i = w * (hRes + 1) + h;
-				int iNext = i + (hRes + 1);
-				if (w != 0)
-				{
-					sphereIndices.push_back(iNext + 1);
-					sphereIndices.push_back(i + 1);
-					sphereIndices.push_back(i);
-				}
-				if (w + 1 != wRes)
-				{
-					sphereIndices.push_back(i);
-					sphereIndices.push_back(iNext);
-					sphereIndices.push_back(iNext + 1);
-				}
-
-			}
-		}
+	// Derives all culling volumes from the positions at the start of every vertex
+	void ComputeBounds(const void* pVertices, size_t stride, size_t count) {
+		ComputeAABBCorners(pVertices, stride, count, vectorsAABB);
+		boundingSphere = ComputeBoundingSphere(pVertices, stride, count);
+		orientedBox = ComputeOrientedBox(pVertices, stride, count);
 	}
 
 	static void getCubeGeometry(vector<TextureNormalVertex>& outVertices, vector<USHORT>& outIndices) {
 		static const TextureNormalVertex vertices[] = {
-			{ {-1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f } },
-			{ {-1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 0.0f } },
-			{ { 1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 0.0f } },
-			{ { 1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 1.0f } },
-
-			{ { 1.0f, -1.0f,  1.5f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f } },
-			{ { 1.0f,  1.0f,  1.5f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 0.0f } },
-			{ {-1.0f,  1.0f,  1.5f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 0.0f } },
-			{ {-1.0f, -1.0f,  1.5f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 1.0f } },
-
-			{ {-1.0f, -1.0f,  1.5f }, { 0.0f,  0.0, -1.0f }, {-1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f } },
-			{ {-1.0f,  1.0f,  1.5f }, { 0.0f,  0.0, -1.0f }, {-1.0f,  0.0f,  0.0f }, { 0.0f, 0.0f } },
-			{ {-1.0f,  1.0f, -1.5f }, { 0.0f,  0.0, -1.0f }, {-1.0f,  0.0f,  0.0f }, { 1.0f, 0.0f } },
-			{ {-1.0f, -1.0f, -1.5f }, { 0.0f,  0.0, -1.0f }, {-1.0f,  0.0f,  0.0f }, { 1.0f, 1.0f } },
-
-			{ { 1.0f, -1.0f, -1.5f }, { 0.0f,  0.0,  1.0f }, { 1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f } },
-			{ { 1.0f,  1.0f, -1.5f }, { 0.0f,  0.0,  1.0f }, { 1.0f,  0.0f,  0.0f }, { 0.0f, 0.0f } },
-			{ { 1.0f,  1.0f,  1.5f }, { 0.0f,  0.0,  1.0f }, { 1.0f,  0.0f,  0.0f }, { 1.0f, 0.0f } },
-			{ { 1.0f, -1.0f,  1.5f }, { 0.0f,  0.0,  1.0f }, { 1.0f,  0.0f,  0.0f }, { 1.0f, 1.0f } },
-
-			{ {-1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  1.0f,  0.0f }, { 0.0f, 1.0f } },
-			{ {-1.0f,  1.0f,  1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  1.0f,  0.0f }, { 0.0f, 0.0f } },
-			{ { 1.0f,  1.0f,  1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  1.0f,  0.0f }, { 1.0f, 0.0f } },
-			{ { 1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  1.0f,  0.0f }, { 1.0f, 1.0f } },
-
-			{ {-1.0f, -1.0f,  1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  -1.0f,  0.0f }, { 0.0f, 1.0f } },
-			{ {-1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  -1.0f,  0.0f }, { 0.0f, 0.0f } },
-			{ { 1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  -1.0f,  0.0f }, { 1.0f, 0.0f } },
-			{ { 1.0f, -1.0f,  1.5f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  -1.0f,  0.0f }, { 1.0f, 1.0f } },
+			{ {-1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f } },
+			{ {-1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 0.0f } },
+			{ { 1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 0.0f } },
+			{ { 1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 1.0f } },
+
+			{ { 1.0f, -1.0f,  1.5f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f } },
+			{ { 1.0f,  1.0f,  1.5f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 0.0f } },
+			{ {-1.0f,  1.0f,  1.5f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 0.0f } },
+			{ {-1.0f, -1.0f,  1.5f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 1.0f } },
+
+			{ {-1.0f, -1.0f,  1.5f }, { 0.0f,  0.0, -1.0f, 1.0f }, {-1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f } },
+			{ {-1.0f,  1.0f,  1.5f }, { 0.0f,  0.0, -1.0f, 1.0f }, {-1.0f,  0.0f,  0.0f }, { 0.0f, 0.0f } },
+			{ {-1.0f,  1.0f, -1.5f }, { 0.0f,  0.0, -1.0f, 1.0f }, {-1.0f,  0.0f,  0.0f }, { 1.0f, 0.0f } },
+			{ {-1.0f, -1.0f, -1.5f }, { 0.0f,  0.0, -1.0f, 1.0f }, {-1.0f,  0.0f,  0.0f }, { 1.0f, 1.0f } },
+
+			{ { 1.0f, -1.0f, -1.5f }, { 0.0f,  0.0,  1.0f, 1.0f }, { 1.0f,  0.0f,  0.0f }, { 0.0f, 1.0f } },
+			{ { 1.0f,  1.0f, -1.5f }, { 0.0f,  0.0,  1.0f, 1.0f }, { 1.0f,  0.0f,  0.0f }, { 0.0f, 0.0f } },
+			{ { 1.0f,  1.0f,  1.5f }, { 0.0f,  0.0,  1.0f, 1.0f }, { 1.0f,  0.0f,  0.0f }, { 1.0f, 0.0f } },
+			{ { 1.0f, -1.0f,  1.5f }, { 0.0f,  0.0,  1.0f, 1.0f }, { 1.0f,  0.0f,  0.0f }, { 1.0f, 1.0f } },
+
+			{ {-1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  1.0f,  0.0f }, { 0.0f, 1.0f } },
+			{ {-1.0f,  1.0f,  1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  1.0f,  0.0f }, { 0.0f, 0.0f } },
+			{ { 1.0f,  1.0f,  1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  1.0f,  0.0f }, { 1.0f, 0.0f } },
+			{ { 1.0f,  1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  1.0f,  0.0f }, { 1.0f, 1.0f } },
+
+			{ {-1.0f, -1.0f,  1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  -1.0f,  0.0f }, { 0.0f, 1.0f } },
+			{ {-1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  -1.0f,  0.0f }, { 0.0f, 0.0f } },
+			{ { 1.0f, -1.0f, -1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  -1.0f,  0.0f }, { 1.0f, 0.0f } },
+			{ { 1.0f, -1.0f,  1.5f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  -1.0f,  0.0f }, { 1.0f, 1.0f } },
 
 		};
 
@@ -239,15 +166,15 @@ struct GeometryData {
 	static void getPlaneGeometry(vector<TextureNormalVertex>& outVertices, vector<USHORT>& outIndices)
 	{
 		static const TextureNormalVertex vertices[] = {
-			{ {-1.5f, -1.5f,  1.0f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f } },
-			{ {-1.5f,  1.5f,  1.0f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 0.0f } },
-			{ { 1.5f,  1.5f,  1.0f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 0.0f } },
-			{ { 1.5f, -1.5f,  1.0f }, { 1.0f,  0.0,  0.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 1.0f } },
-
-			{ { 1.5f, -1.5f,  1.0f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f } },
-			{ { 1.5f,  1.5f,  1.0f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 0.0f } },
-			{ {-1.5f,  1.5f,  1.0f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 0.0f } },
-			{ {-1.5f, -1.5f,  1.0f }, {-1.0f,  0.0,  0.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 1.0f } },
+			{ {-1.5f, -1.5f,  1.0f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 1.0f } },
+			{ {-1.5f,  1.5f,  1.0f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 0.0f, 0.0f } },
+			{ { 1.5f,  1.5f,  1.0f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 0.0f } },
+			{ { 1.5f, -1.5f,  1.0f }, { 1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f, -1.0f }, { 1.0f, 1.0f } },
+
+			{ { 1.5f, -1.5f,  1.0f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 1.0f } },
+			{ { 1.5f,  1.5f,  1.0f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 0.0f, 0.0f } },
+			{ {-1.5f,  1.5f,  1.0f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 0.0f } },
+			{ {-1.5f, -1.5f,  1.0f }, {-1.0f,  0.0,  0.0f, 1.0f }, { 0.0f,  0.0f,  1.0f }, { 1.0f, 1.0f } },
 		};
 		static const USHORT indices[] = {
 			0, 1, 2,
@@ -263,8 +190,130 @@ struct GeometryData {
 	}
 };
 
+struct ObjectBuffer {
+	std::vector<Instance> instances;
+	AABBSoA bounds;
+	BoundingVolumesSoA volumes;
+	InstanceBVH bvh;
+	// Instances whose transform changed since the last ClearChanges, their bounds are refit by Refresh
+	std::vector<uint32_t> changedInstances;
+	std::vector<UINT8> instanceChanged;
+	bool allChanged = true;
+	// Mesh volumes shared by all instances of the buffer
+	AxisAlignedBox localBox;
+	BoundingSphere localSphere;
+	OrientedBox localOrientedBox;
+
+	void SetGeometry(const GeometryData& geometry) {
+		AxisAlignedBox box = ComputeAxisAlignedBox(geometry.vectorsAABB.data(), sizeof(DirectX::XMFLOAT3), geometry.vectorsAABB.size());
+		if (memcmp(&box, &localBox, sizeof(box)) == 0 && memcmp(&geometry.boundingSphere, &localSphere, sizeof(localSphere)) == 0 &&
+			memcmp(&geometry.orientedBox, &localOrientedBox, sizeof(localOrientedBox)) == 0)
+			return;
+		localBox = box;
+		localSphere = geometry.boundingSphere;
+		localOrientedBox = geometry.orientedBox;
+		allChanged = true;
+	}
+
+	void set(int idx, const DirectX::XMMATRIX& model, const GeometryData& geometry, UINT16 materialId = 0) {
+		SetGeometry(geometry);
+		setModel(idx, model);
+		instances[idx].materialId = materialId;
+	}
+
+	// The normal matrix of instances is not kept, the shaders build it from the model
+	void setModel(int idx, const DirectX::XMMATRIX& model) {
+		instances[idx].model = model;
+		if (allChanged)
+			return;
+		if (instanceChanged.size() != instances.size())
+			instanceChanged.resize(instances.size());
+		if (!instanceChanged[idx])
+		{
+			instanceChanged[idx] = 1;
+			changedInstances.push_back(idx);
+		}
+	}
+
+	void Update(const GeometryData& geometry) {
+		SetGeometry(geometry);
+		allChanged = true;
+	}
+
+	BVHInput GetBVHInput() const {
+		return { { bounds.GetMinX(), bounds.GetMinY(), bounds.GetMinZ() }, { bounds.GetMaxX(), bounds.GetMaxY(), bounds.GetMaxZ() }, uint32_t(bounds.GetCount()) };
+	}
+
+	// pOut holds instances.size() elements
+	void WriteInstanceData(InstanceData* pOut) const {
+		for (size_t i = 0; i < instances.size(); i++)
+		{
+			DirectX::XMMATRIX columns = DirectX::XMMatrixTranspose(instances[i].model);
+			DirectX::XMStoreFloat4(&pOut[i].world[0], columns.r[0]);
+			DirectX::XMStoreFloat4(&pOut[i].world[1], columns.r[1]);
+			DirectX::XMStoreFloat4(&pOut[i].world[2], columns.r[2]);
+			pOut[i].materialId = instances[i].materialId;
+		}
+	}
 
+	// Refits the bounds of the changed instances in SIMD batches
+	void RefitBounds() {
+		const DirectX::XMMATRIX* pModels = instances.empty() ? nullptr : &instances[0].model;
+		if (bounds.GetCount() != instances.size())
+		{
+			bounds.Resize(instances.size());
+			volumes.Resize(instances.size());
+			allChanged = true;
+		}
+		if (allChanged)
+		{
+			bounds.SetTransformed(localBox, pModels, sizeof(Instance), nullptr, instances.size());
+			for (size_t i = 0; i < instances.size(); i++)
+				volumes.Set(i, localSphere, localOrientedBox, instances[i].model);
+			return;
+		}
+		bounds.SetTransformed(localBox, pModels, sizeof(Instance), changedInstances.data(), changedInstances.size());
+		for (uint32_t i : changedInstances)
+			volumes.Set(i, localSphere, localOrientedBox, instances[i].model);
+	}
 
+	// Refits the changed bounds and brings the BVH up to date with them, small buffers are culled linearly
+	void Refresh() {
+		RefitBounds();
+		if (bounds.GetCount() < InstanceBVH::MinInstanceCount)
+			bvh.Clear();
+		else if (allChanged || bvh.GetItemCount() != bounds.GetCount())
+			bvh.Build(GetBVHInput());
+		else
+			bvh.Update(GetBVHInput(), changedInstances.data(), changedInstances.size());
+	}
 
+	void ClearChanges() {
+		for (uint32_t i : changedInstances)
+			instanceChanged[i] = 0;
+		changedInstances.clear();
+		allChanged = false;
+	}
 
+	// Orders the ids by the material of their instances
+	void SortByMaterial(std::vector<UINT32>& ids, UINT materialCount, std::vector<UINT32>& scratch) const {
+		if (!instances.empty())
+			SortIdsByMaterial(&instances[0].materialId, sizeof(Instance), materialCount, ids.data(), ids.size(), scratch);
+	}
 
+	UINT Cull(const Frustum& frustum, std::vector<UINT32>& outVisible) const {
+		if (bvh.GetItemCount() != bounds.GetCount())
+		{
+			outVisible.resize(bounds.GetCount());
+			outVisible.resize(CullAABBs(frustum, bounds, outVisible.data()));
+		}
+		else
+		{
+			outVisible.clear();
+			bvh.Cull(GetBVHInput(), &frustum.planes[0].x, outVisible);
+		}
+		if (volumes.GetCount() == bounds.GetCount())
+			outVisible.resize(CullBoundingVolumes(frustum, volumes, outVisible.data(), UINT(outVisible.size())));
+		return UINT(outVisible.size());
+	}
+};
@@ -0,0 +1,111 @@
+#include "GeometryPool.h"
+
+#define SafeRelease(A) if ((A) != NULL) { (A)->Release(); (A) = NULL; }
+
+HRESULT GeometryPool::Init(ID3D11Device* pDevice, UINT vertexStride, UINT vertexCapacity,
+	DXGI_FORMAT indexFormat, UINT indexCapacity, const std::string& name)
+{
+	Clean();
+	m_vertexStride = vertexStride;
+	m_indexFormat = indexFormat;
+	m_indexStride = indexFormat == DXGI_FORMAT_R32_UINT ? sizeof(UINT32) : sizeof(USHORT);
+
+	HRESULT result = S_OK;
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = vertexStride * vertexCapacity;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+		desc.StructureByteStride = 0;
+
+		result = pDevice->CreateBuffer(&desc, nullptr, &m_pVertexBuffer);
+		assert(SUCCEEDED(result));
+		if (SUCCEEDED(result))
+		{
+			std::string bufferName = name + "VertexBuffer";
+			result = m_pVertexBuffer->SetPrivateData(WKPDID_D3DDebugObjectName, (UINT)bufferName.length(), bufferName.c_str());
+		}
+	}
+	if (SUCCEEDED(result))
+	{
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = m_indexStride * indexCapacity;
+		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
+		desc.CPUAccessFlags = 0;
+		desc.MiscFlags = 0;
+		desc.StructureByteStride = 0;
+
+		result = pDevice->CreateBuffer(&desc, nullptr, &m_pIndexBuffer);
+		assert(SUCCEEDED(result));
+		if (SUCCEEDED(result))
+		{
+			std::string bufferName = name + "IndexBuffer";
+			result = m_pIndexBuffer->SetPrivateData(WKPDID_D3DDebugObjectName, (UINT)bufferName.length(), bufferName.c_str());
+		}
+	}
+	if (SUCCEEDED(result))
+	{
+		m_vertexAllocator.Reset(vertexCapacity);
+		m_indexAllocator.Reset(indexCapacity);
+	}
+	return result;
+}
+
+HRESULT GeometryPool::Add(ID3D11DeviceContext* pDeviceContext, const void* pVertices, UINT vertexCount,
+	const void* pIndices, UINT indexCount, GeometryData& outGeometry)
+{
+	UINT baseVertex = m_vertexAllocator.Allocate(vertexCount);
+	if (baseVertex == RangeAllocator::InvalidOffset)
+		return E_OUTOFMEMORY;
+	UINT firstIndex = m_indexAllocator.Allocate(indexCount);
+	if (firstIndex == RangeAllocator::InvalidOffset)
+	{
+		m_vertexAllocator.Free(baseVertex, vertexCount);
+		return E_OUTOFMEMORY;
+	}
+
+	D3D11_BOX box = {};
+	box.top = 0;
+	box.bottom = 1;
+	box.front = 0;
+	box.back = 1;
+
+	box.left = baseVertex * m_vertexStride;
+	box.right = (baseVertex + vertexCount) * m_vertexStride;
+	pDeviceContext->UpdateSubresource(m_pVertexBuffer, 0, &box, pVertices, 0, 0);
+
+	box.left = firstIndex * m_indexStride;
+	box.right = (firstIndex + indexCount) * m_indexStride;
+	pDeviceContext->UpdateSubresource(m_pIndexBuffer, 0, &box, pIndices, 0, 0);
+
+	outGeometry.pIndexBuffer = m_pIndexBuffer;
+	outGeometry.vertexBuffer[0] = m_pVertexBuffer;
+	outGeometry.strides[0] = m_vertexStride;
+	outGeometry.offsets[0] = 0;
+	outGeometry.indexFormat = m_indexFormat;
+	outGeometry.baseVertex = baseVertex;
+	outGeometry.vertexCount = vertexCount;
+	outGeometry.firstIndex = firstIndex;
+	outGeometry.indexCount = indexCount;
+	return S_OK;
+}
+
+void GeometryPool::Remove(GeometryData& geometry)
+{
+	if (geometry.pIndexBuffer != m_pIndexBuffer || geometry.indexCount == 0)
+		return;
+	m_vertexAllocator.Free(geometry.baseVertex, geometry.vertexCount);
+	m_indexAllocator.Free(geometry.firstIndex, geometry.indexCount);
+	geometry = GeometryData();
+}
+
+void GeometryPool::Clean()
+{
+	SafeRelease(m_pVertexBuffer);
+	SafeRelease(m_pIndexBuffer);
+	m_vertexAllocator.Reset(0);
+	m_indexAllocator.Reset(0);
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "framework.h"
+#include <string>
+#include "RangeAllocator.h"
+#include "GeometryData.h"
+
+// One vertex buffer and one index buffer shared by all meshes of a single vertex format.
+// Meshes are suballocated and referenced by GeometryData (baseVertex, firstIndex, indexCount).
+class GeometryPool
+{
+public:
+	HRESULT Init(ID3D11Device* pDevice, UINT vertexStride, UINT vertexCapacity,
+		DXGI_FORMAT indexFormat, UINT indexCapacity, const std::string& name);
+	HRESULT Add(ID3D11DeviceContext* pDeviceContext, const void* pVertices, UINT vertexCount,
+		const void* pIndices, UINT indexCount, GeometryData& outGeometry);
+	void Remove(GeometryData& geometry);
+	void Clean();
+
+	UINT GetVertexStride() const { return m_vertexStride; }
+	DXGI_FORMAT GetIndexFormat() const { return m_indexFormat; }
+	const RangeAllocator& GetVertexAllocator() const { return m_vertexAllocator; }
+	const RangeAllocator& GetIndexAllocator() const { return m_indexAllocator; }
+
+	~GeometryPool() { Clean(); }
+
+private:
+	ID3D11Buffer* m_pVertexBuffer = NULL;
+	ID3D11Buffer* m_pIndexBuffer = NULL;
+	UINT m_vertexStride = 0;
+	UINT m_indexStride = 0;
+	DXGI_FORMAT m_indexFormat = DXGI_FORMAT_R16_UINT;
+	RangeAllocator m_vertexAllocator;
+	RangeAllocator m_indexAllocator;
+};
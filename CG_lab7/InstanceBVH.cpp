@@ -0,0 +1,451 @@
+#include "InstanceBVH.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+
+namespace
+{
+	const uint32_t BinCount = 16;
+	const uint32_t MinLeafSize = 4; // never split below this
+	const uint32_t MaxLeafSize = 16; // always split above this
+	const uint32_t MaxSAHDepth = 40; // deeper nodes are split in half, which bounds the traversal stack
+
+	float HalfArea(const float minVec[3], const float maxVec[3])
+	{
+		float dx = std::max(maxVec[0] - minVec[0], 0.0f);
+		float dy = std::max(maxVec[1] - minVec[1], 0.0f);
+		float dz = std::max(maxVec[2] - minVec[2], 0.0f);
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	struct Bin
+	{
+		float minVec[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float maxVec[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		uint32_t count = 0;
+
+		void Grow(const float otherMin[3], const float otherMax[3])
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				minVec[a] = std::min(minVec[a], otherMin[a]);
+				maxVec[a] = std::max(maxVec[a], otherMax[a]);
+			}
+		}
+	};
+
+	// Signed distance of the box corner furthest along the plane normal (p-vertex) and of the nearest one (n-vertex)
+	void PlaneDistances(const float* pPlane, const float minVec[3], const float maxVec[3], float& farDist, float& nearDist)
+	{
+		farDist = pPlane[3];
+		nearDist = pPlane[3];
+		for (int a = 0; a < 3; a++)
+		{
+			bool negative = pPlane[a] < 0.0f;
+			farDist += pPlane[a] * (negative ? minVec[a] : maxVec[a]);
+			nearDist += pPlane[a] * (negative ? maxVec[a] : minVec[a]);
+		}
+	}
+}
+
+void InstanceBVH::Clear()
+{
+	m_nodes.clear();
+	m_items.clear();
+	m_itemLeaves.clear();
+	m_refitMarks.clear();
+	m_cost = 0.0f;
+	m_buildCost = 0.0f;
+}
+
+void InstanceBVH::Build(const BVHInput& input)
+{
+	Clear();
+	m_buildCount++;
+	if (input.count == 0)
+		return;
+
+	// Bounds are gathered once so the binning passes touch one cache line per item
+	m_items.resize(input.count);
+	m_itemLeaves.resize(input.count);
+	std::vector<BuildItem> buildItems(input.count);
+	for (uint32_t i = 0; i < input.count; i++)
+	{
+		m_items[i] = i;
+		BuildItem& buildItem = buildItems[i];
+		for (int a = 0; a < 3; a++)
+		{
+			buildItem.minVec[a] = input.pMin[a][i];
+			buildItem.maxVec[a] = input.pMax[a][i];
+			buildItem.centroid[a] = (buildItem.minVec[a] + buildItem.maxVec[a]) * 0.5f;
+		}
+	}
+
+	// A binary tree with single item leaves at worst
+	m_nodes.reserve(size_t(input.count) * 2);
+	Node root = {};
+	root.count = input.count;
+	m_nodes.push_back(root);
+	BuildNode(buildItems, 0, 0);
+
+	m_refitMarks.assign(m_nodes.size(), 0);
+	m_refitStamp = 0;
+	m_cost = 0.0f;
+	for (const Node& node : m_nodes)
+		m_cost += NodeCost(node);
+	m_buildCost = m_cost;
+}
+
+void InstanceBVH::BuildNode(const std::vector<BuildItem>& buildItems, uint32_t nodeIndex, uint32_t depth)
+{
+	const uint32_t first = m_nodes[nodeIndex].first;
+	const uint32_t count = m_nodes[nodeIndex].count;
+
+	auto makeLeaf = [&]()
+	{
+		for (uint32_t i = first; i < first + count; i++)
+			m_itemLeaves[m_items[i]] = nodeIndex;
+	};
+
+	Bin nodeBounds;
+	float centroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		const BuildItem& buildItem = buildItems[m_items[i]];
+		nodeBounds.Grow(buildItem.minVec, buildItem.maxVec);
+		for (int a = 0; a < 3; a++)
+		{
+			centroidMin[a] = std::min(centroidMin[a], buildItem.centroid[a]);
+			centroidMax[a] = std::max(centroidMax[a], buildItem.centroid[a]);
+		}
+	}
+	Node& node = m_nodes[nodeIndex];
+	std::copy(nodeBounds.minVec, nodeBounds.minVec + 3, node.minVec);
+	std::copy(nodeBounds.maxVec, nodeBounds.maxVec + 3, node.maxVec);
+	if (count <= MinLeafSize)
+	{
+		makeLeaf();
+		return;
+	}
+
+	// Binned SAH over all three axes
+	int bestAxis = -1;
+	uint32_t bestSplit = 0;
+	float bestCost = FLT_MAX;
+	for (int axis = 0; axis < 3 && depth < MaxSAHDepth; axis++)
+	{
+		float extent = centroidMax[axis] - centroidMin[axis];
+		if (extent <= 0.0f)
+			continue;
+		float scale = BinCount / extent;
+
+		Bin bins[BinCount];
+		for (uint32_t i = first; i < first + count; i++)
+		{
+			const BuildItem& buildItem = buildItems[m_items[i]];
+			uint32_t bin = std::min(BinCount - 1, uint32_t((buildItem.centroid[axis] - centroidMin[axis]) * scale));
+			bins[bin].Grow(buildItem.minVec, buildItem.maxVec);
+			bins[bin].count++;
+		}
+
+		float rightCosts[BinCount];
+		Bin right;
+		for (uint32_t b = BinCount - 1; b > 0; b--)
+		{
+			right.Grow(bins[b].minVec, bins[b].maxVec);
+			right.count += bins[b].count;
+			rightCosts[b] = right.count > 0 ? right.count * HalfArea(right.minVec, right.maxVec) : 0.0f;
+		}
+		Bin left;
+		for (uint32_t b = 0; b + 1 < BinCount; b++)
+		{
+			left.Grow(bins[b].minVec, bins[b].maxVec);
+			left.count += bins[b].count;
+			if (left.count == 0 || left.count == count)
+				continue;
+			float cost = left.count * HalfArea(left.minVec, left.maxVec) + rightCosts[b + 1];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestSplit = b;
+			}
+		}
+	}
+
+	float leafCost = count * HalfArea(nodeBounds.minVec, nodeBounds.maxVec);
+	if (count <= MaxLeafSize && (bestAxis < 0 || bestCost >= leafCost))
+	{
+		makeLeaf();
+		return;
+	}
+
+	uint32_t* pBegin = m_items.data() + first;
+	uint32_t* pEnd = pBegin + count;
+	uint32_t* pMiddle = pBegin;
+	if (bestAxis >= 0)
+	{
+		float scale = BinCount / (centroidMax[bestAxis] - centroidMin[bestAxis]);
+		pMiddle = std::partition(pBegin, pEnd, [&](uint32_t item)
+			{
+				uint32_t bin = std::min(BinCount - 1, uint32_t((buildItems[item].centroid[bestAxis] - centroidMin[bestAxis]) * scale));
+				return bin <= bestSplit;
+			});
+	}
+	if (pMiddle == pBegin || pMiddle == pEnd)
+	{
+		// All centroids fall into one bin or the tree is too deep, split the range in half
+		pMiddle = pBegin + count / 2;
+	}
+
+	uint32_t leftIndex = uint32_t(m_nodes.size());
+	Node child = {};
+	child.parent = nodeIndex;
+	child.first = first;
+	child.count = uint32_t(pMiddle - pBegin);
+	m_nodes.push_back(child);
+	child.first = first + child.count;
+	child.count = count - child.count;
+	m_nodes.push_back(child);
+	m_nodes[nodeIndex].left = leftIndex;
+
+	BuildNode(buildItems, leftIndex, depth + 1);
+	BuildNode(buildItems, leftIndex + 1, depth + 1);
+}
+
+void InstanceBVH::FitLeaf(const BVHInput& input, Node& node) const
+{
+	for (int a = 0; a < 3; a++)
+	{
+		node.minVec[a] = FLT_MAX;
+		node.maxVec[a] = -FLT_MAX;
+	}
+	for (uint32_t i = node.first; i < node.first + node.count; i++)
+	{
+		uint32_t item = m_items[i];
+		for (int a = 0; a < 3; a++)
+		{
+			node.minVec[a] = std::min(node.minVec[a], input.pMin[a][item]);
+			node.maxVec[a] = std::max(node.maxVec[a], input.pMax[a][item]);
+		}
+	}
+}
+
+void InstanceBVH::FitInternal(Node& node) const
+{
+	const Node& left = m_nodes[node.left];
+	const Node& right = m_nodes[node.left + 1];
+	for (int a = 0; a < 3; a++)
+	{
+		node.minVec[a] = std::min(left.minVec[a], right.minVec[a]);
+		node.maxVec[a] = std::max(left.maxVec[a], right.maxVec[a]);
+	}
+}
+
+float InstanceBVH::NodeCost(const Node& node) const
+{
+	float area = HalfArea(node.minVec, node.maxVec);
+	return node.left == 0 ? area * node.count : area;
+}
+
+void InstanceBVH::Refit(const BVHInput& input)
+{
+	if (input.count != m_items.size())
+	{
+		Build(input);
+		return;
+	}
+
+	// Children always come after their parent
+	m_cost = 0.0f;
+	for (size_t i = m_nodes.size(); i-- > 0;)
+	{
+		Node& node = m_nodes[i];
+		if (node.left == 0)
+			FitLeaf(input, node);
+		else
+			FitInternal(node);
+		m_cost += NodeCost(node);
+	}
+}
+
+void InstanceBVH::Update(const BVHInput& input, const uint32_t* pChangedItems, size_t changedCount)
+{
+	if (input.count != m_items.size())
+	{
+		Build(input);
+		return;
+	}
+	if (changedCount == 0)
+		return;
+
+	if (++m_refitStamp == 0)
+	{
+		std::fill(m_refitMarks.begin(), m_refitMarks.end(), 0);
+		m_refitStamp = 1;
+	}
+	m_refitNodes.clear();
+	for (size_t i = 0; i < changedCount; i++)
+	{
+		uint32_t node = m_itemLeaves[pChangedItems[i]];
+		while (m_refitMarks[node] != m_refitStamp)
+		{
+			m_refitMarks[node] = m_refitStamp;
+			m_refitNodes.push_back(node);
+			if (node == 0)
+				break;
+			node = m_nodes[node].parent;
+		}
+	}
+
+	std::sort(m_refitNodes.begin(), m_refitNodes.end(), std::greater<uint32_t>());
+	for (uint32_t index : m_refitNodes)
+	{
+		Node& node = m_nodes[index];
+		m_cost -= NodeCost(node);
+		if (node.left == 0)
+			FitLeaf(input, node);
+		else
+			FitInternal(node);
+		m_cost += NodeCost(node);
+	}
+
+	if (m_cost > m_buildCost * rebuildCostRatio)
+	{
+		Build(input);
+		m_rebuildCount++;
+	}
+}
+
+void InstanceBVH::Cull(const BVHInput& input, const float* pPlanes, std::vector<uint32_t>& outVisible) const
+{
+	if (!m_nodes.empty())
+		CullSubtree(input, pPlanes, 0, outVisible);
+}
+
+void InstanceBVH::GetSubtrees(uint32_t maxItemCount, std::vector<uint32_t>& outNodes) const
+{
+	if (m_nodes.empty())
+		return;
+
+	uint32_t stack[MaxStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const uint32_t index = stack[--stackSize];
+		const Node& node = m_nodes[index];
+		if (node.left == 0 || node.count <= maxItemCount)
+		{
+			outNodes.push_back(index);
+			continue;
+		}
+		assert(stackSize + 2 <= MaxStackSize);
+		stack[stackSize++] = node.left + 1;
+		stack[stackSize++] = node.left;
+	}
+}
+
+void InstanceBVH::CullSubtree(const BVHInput& input, const float* pPlanes, uint32_t rootNode, std::vector<uint32_t>& outVisible,
+	uint8_t* pFailedPlanes, BVHCullCounters* pCounters) const
+{
+	struct StackEntry
+	{
+		uint32_t node;
+		uint32_t planeMask;
+	};
+	StackEntry stack[MaxStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = { rootNode, 0x3F };
+
+	while (stackSize > 0)
+	{
+		StackEntry entry = stack[--stackSize];
+		const Node& node = m_nodes[entry.node];
+
+		uint32_t planeMask = entry.planeMask;
+		bool outside = false;
+		for (uint32_t p = 0; p < 6 && !outside; p++)
+		{
+			if ((planeMask & (1u << p)) == 0)
+				continue;
+			float farDist, nearDist;
+			PlaneDistances(pPlanes + p * 4, node.minVec, node.maxVec, farDist, nearDist);
+			outside = farDist < 0.0f;
+			if (nearDist >= 0.0f)
+				planeMask &= ~(1u << p);
+		}
+		if (outside)
+			continue;
+
+		if (planeMask == 0)
+		{
+			outVisible.insert(outVisible.end(), m_items.begin() + node.first, m_items.begin() + node.first + node.count);
+			continue;
+		}
+		if (node.left == 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				uint32_t item = m_items[i];
+				float itemMin[3] = { input.pMin[0][item], input.pMin[1][item], input.pMin[2][item] };
+				float itemMax[3] = { input.pMax[0][item], input.pMax[1][item], input.pMax[2][item] };
+				float farDist, nearDist;
+				uint32_t cachedPlane = pFailedPlanes ? pFailedPlanes[item] : 6;
+				if (pCounters)
+					pCounters->testedItems++;
+				if (cachedPlane < 6 && (planeMask & (1u << cachedPlane)) != 0)
+				{
+					PlaneDistances(pPlanes + cachedPlane * 4, itemMin, itemMax, farDist, nearDist);
+					if (farDist < 0.0f)
+					{
+						if (pCounters)
+							pCounters->planeHits++;
+						continue;
+					}
+				}
+				bool visible = true;
+				for (uint32_t p = 0; p < 6 && visible; p++)
+				{
+					if ((planeMask & (1u << p)) == 0 || p == cachedPlane)
+						continue;
+					PlaneDistances(pPlanes + p * 4, itemMin, itemMax, farDist, nearDist);
+					visible = farDist >= 0.0f;
+					if (!visible && pFailedPlanes)
+						pFailedPlanes[item] = uint8_t(p);
+				}
+				if (visible)
+					outVisible.push_back(item);
+			}
+			continue;
+		}
+
+		assert(stackSize + 2 <= MaxStackSize);
+		stack[stackSize++] = { node.left + 1, planeMask };
+		stack[stackSize++] = { node.left, planeMask };
+	}
+}
+
+bool InstanceBVH::SegmentHitsBox(const float origin[3], const float direction[3], const float minVec[3], const float maxVec[3])
+{
+	float tNear = 0.0f;
+	float tFar = 1.0f;
+	for (int a = 0; a < 3; a++)
+	{
+		if (direction[a] == 0.0f)
+		{
+			if (origin[a] < minVec[a] || origin[a] > maxVec[a])
+				return false;
+			continue;
+		}
+		float invDirection = 1.0f / direction[a];
+		float t0 = (minVec[a] - origin[a]) * invDirection;
+		float t1 = (maxVec[a] - origin[a]) * invDirection;
+		tNear = std::max(tNear, std::min(t0, t1));
+		tFar = std::min(tFar, std::max(t0, t1));
+		if (tNear > tFar)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Instance bounds given as separate min/max streams per axis (the AABBSoA layout)
+struct BVHInput
+{
+	const float* pMin[3];
+	const float* pMax[3];
+	uint32_t count;
+};
+
+struct BVHCullCounters
+{
+	uint32_t testedItems = 0;
+	uint32_t planeHits = 0; // items rejected by their cached plane
+};
+
+// Binary BVH over instance AABBs built with binned SAH. Kept free of Windows and D3D headers.
+class InstanceBVH
+{
+public:
+	// Below this count the linear SIMD kernel is faster than traversal
+	static const uint32_t MinInstanceCount = 64;
+
+	void Build(const BVHInput& input);
+	// Refits the paths from the changed items to the root, rebuilds when the tree quality dropped too far
+	void Update(const BVHInput& input, const uint32_t* pChangedItems, size_t changedCount);
+	void Refit(const BVHInput& input);
+	void Clear();
+
+	// pPlanes - six xyzw planes pointing inside. Subtrees fully inside are accepted without further tests,
+	// the visible item indices are appended in tree order.
+	void Cull(const BVHInput& input, const float* pPlanes, std::vector<uint32_t>& outVisible) const;
+	// Splits the tree into subtrees of at most maxItemCount items (or leaves) in traversal order, culling them
+	// one by one with CullSubtree gives the same list as Cull
+	void GetSubtrees(uint32_t maxItemCount, std::vector<uint32_t>& outNodes) const;
+	// pFailedPlanes - optional per item plane (0-5) that rejected it last time, tested first and updated
+	void CullSubtree(const BVHInput& input, const float* pPlanes, uint32_t rootNode, std::vector<uint32_t>& outVisible,
+		uint8_t* pFailedPlanes = nullptr, BVHCullCounters* pCounters = nullptr) const;
+	// Calls visit(item) for the items whose box the segment from origin to end passes through, in tree order,
+	// until it returns true. Returns whether it did.
+	template<typename Visitor>
+	bool QuerySegment(const BVHInput& input, const float origin[3], const float end[3], Visitor visit) const;
+
+	uint32_t GetItemCount() const { return uint32_t(m_items.size()); }
+	size_t GetNodeCount() const { return m_nodes.size(); }
+	uint32_t GetItemLeaf(uint32_t item) const { return m_itemLeaves[item]; }
+	uint32_t GetParent(uint32_t node) const { return m_nodes[node].parent; }
+	uint32_t GetNodeItemCount(uint32_t node) const { return m_nodes[node].count; }
+	// Counts every build including the automatic rebuilds, node indices are only stable between builds
+	uint32_t GetBuildCount() const { return m_buildCount; }
+	uint32_t GetRebuildCount() const { return m_rebuildCount; }
+	// Summed surface area cost relative to the cost right after the last build
+	float GetCostRatio() const { return m_buildCost > 0.0f ? m_cost / m_buildCost : 1.0f; }
+
+	float rebuildCostRatio = 1.5f;
+
+private:
+	static const int MaxStackSize = 128;
+
+	struct Node
+	{
+		float minVec[3];
+		float maxVec[3];
+		uint32_t left; // right child is left + 1, 0 for leaves
+		uint32_t first; // range of m_items covered by the subtree
+		uint32_t count;
+		uint32_t parent;
+	};
+
+	struct BuildItem
+	{
+		float minVec[3];
+		float maxVec[3];
+		float centroid[3];
+	};
+
+	// Slab test of origin + t * direction, 0 <= t <= 1
+	static bool SegmentHitsBox(const float origin[3], const float direction[3], const float minVec[3], const float maxVec[3]);
+	void BuildNode(const std::vector<BuildItem>& buildItems, uint32_t nodeIndex, uint32_t depth);
+	void FitLeaf(const BVHInput& input, Node& node) const;
+	void FitInternal(Node& node) const;
+	float NodeCost(const Node& node) const;
+
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_items;
+	std::vector<uint32_t> m_itemLeaves;
+	std::vector<uint32_t> m_refitMarks;
+	std::vector<uint32_t> m_refitNodes;
+	uint32_t m_refitStamp = 0;
+	float m_cost = 0.0f;
+	float m_buildCost = 0.0f;
+	uint32_t m_buildCount = 0;
+	uint32_t m_rebuildCount = 0;
+};
+
+template<typename Visitor>
+bool InstanceBVH::QuerySegment(const BVHInput& input, const float origin[3], const float end[3], Visitor visit) const
+{
+	if (m_nodes.empty())
+		return false;
+
+	const float direction[3] = { end[0] - origin[0], end[1] - origin[1], end[2] - origin[2] };
+	uint32_t stack[MaxStackSize];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if (!SegmentHitsBox(origin, direction, node.minVec, node.maxVec))
+			continue;
+		if (node.left == 0)
+		{
+			for (uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				uint32_t item = m_items[i];
+				float itemMin[3] = { input.pMin[0][item], input.pMin[1][item], input.pMin[2][item] };
+				float itemMax[3] = { input.pMax[0][item], input.pMax[1][item], input.pMax[2][item] };
+				if (SegmentHitsBox(origin, direction, itemMin, itemMax) && visit(item))
+					return true;
+			}
+			continue;
+		}
+		stack[stackSize++] = node.left + 1;
+		stack[stackSize++] = node.left;
+	}
+	return false;
+}
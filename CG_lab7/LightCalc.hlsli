@@ -1,18 +1,30 @@
 #include "CBScene.hlsli"
 
+uint FindCluster(in float3 pos)
+{
+    float4 clipPos = mul(vp, float4(pos, 1.0));
+    float2 tile = (clipPos.xy / clipPos.w * 0.5 + 0.5) * float2(clusterCounts.xy);
+    uint2 tileIndex = min(uint2(max(tile, 0.0)), clusterCounts.xy - 1);
+    uint slice = min(uint(max(log(clipPos.w) * clusterDepth.x - clusterDepth.y, 0.0)), clusterCounts.z - 1);
+    return (slice * clusterCounts.y + tileIndex.y) * clusterCounts.x + tileIndex.x;
+}
+
 float3 CalculateColor(in float3 objColor, in float3 objNormal, in float3 pos, in float4 lightParams, in bool trans)
 {
     float3 finalColor = objColor * ambientColor.xyz * lightParams.x;
 
-    for (int i = 0; i < lightCount.x; i++)
+    uint2 range = clusterRanges[FindCluster(pos)];
+    for (uint j = 0; j < range.y; j++)
     {
+        uint i = clusterLights[range.x + j];
         float3 normal = objNormal;
 
         float3 lightDir = lights[i].pos.xyz - pos;
         float lightDist = length(lightDir);
         lightDir /= lightDist;
 
-        float atten = clamp(1.0 / (lightDist * lightDist), 0, 1);
+        float window = saturate(1.0 - pow(lightDist / lights[i].pos.w, 4));
+        float atten = clamp(1.0 / (lightDist * lightDist), 0, 1) * window * window;
 
         if (trans && dot(lightDir, objNormal) < 0.0)
         {
@@ -0,0 +1,372 @@
+#include "LightClusters.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <immintrin.h>
+
+namespace
+{
+	// Below this many lights the workers are not woken
+	const uint32_t MinParallelLights = 128;
+	const uint32_t ColumnBlock = 8;
+
+	// Distance from the interval, 0 inside
+	inline float AxisDistance(float minValue, float maxValue, float value)
+	{
+		return std::max(std::max(minValue - value, value - maxValue), 0.0f);
+	}
+}
+
+LightClusterBuilder::~LightClusterBuilder()
+{
+	Term();
+}
+
+void LightClusterBuilder::Init(const ClusterGridDesc& desc, uint32_t threadCount)
+{
+	Term();
+	m_desc = desc;
+	m_desc.tilesX = std::max(1u, m_desc.tilesX);
+	m_desc.tilesY = std::max(1u, m_desc.tilesY);
+	m_desc.slices = std::max(1u, m_desc.slices);
+	m_paddedTilesX = (m_desc.tilesX + ColumnBlock - 1) / ColumnBlock * ColumnBlock;
+	m_gridValid = false;
+	m_jobs.assign(m_desc.slices, SliceJob());
+	m_clusterRanges.assign(size_t(GetClusterCount()) * 2, 0);
+	m_lightIndices.clear();
+	m_stats = {};
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	m_stop = false;
+	m_generation = 0;
+	for (uint32_t i = 1; i < threadCount; i++)
+		m_workers.emplace_back(&LightClusterBuilder::WorkerLoop, this);
+}
+
+void LightClusterBuilder::Term()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+void LightClusterBuilder::WorkerLoop()
+{
+	uint64_t seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&]() { return m_stop || m_generation != seenGeneration; });
+			if (m_stop)
+				return;
+			seenGeneration = m_generation;
+		}
+		RunJobs();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (++m_finishedWorkers == m_workers.size())
+				m_doneCondition.notify_one();
+		}
+	}
+}
+
+void LightClusterBuilder::RunJobs()
+{
+	for (uint32_t slice = m_nextSlice++; slice < m_desc.slices; slice = m_nextSlice++)
+		AssignSlice(slice);
+}
+
+void LightClusterBuilder::SetupGrid(const ClusterProjection& projection)
+{
+	if (m_gridValid && projection.tanHalfFovX == m_projection.tanHalfFovX && projection.tanHalfFovY == m_projection.tanHalfFovY &&
+		projection.nearZ == m_projection.nearZ && projection.farZ == m_projection.farZ)
+		return;
+	m_projection = projection;
+	m_gridValid = true;
+
+	const uint32_t slices = m_desc.slices;
+	const double depthRatio = double(projection.farZ) / projection.nearZ;
+	m_sliceBounds.resize(slices + 1);
+	for (uint32_t s = 0; s < slices; s++)
+		m_sliceBounds[s] = float(projection.nearZ * std::pow(depthRatio, double(s) / slices));
+	m_sliceBounds[slices] = projection.farZ;
+	m_sliceScale = float(slices / std::log(depthRatio));
+	m_sliceBias = float(std::log(double(projection.nearZ)) * slices / std::log(depthRatio));
+
+	// A tile edge is a plane through the eye, its box extent over a slice is at the slice's near or far depth
+	auto setupEdges = [&](uint32_t tiles, uint32_t stride, float tanHalfFov, std::vector<float>& outMin, std::vector<float>& outMax)
+	{
+		outMin.assign(size_t(slices) * stride, FLT_MAX);
+		outMax.assign(size_t(slices) * stride, FLT_MAX);
+		for (uint32_t s = 0; s < slices; s++)
+		{
+			const float z0 = m_sliceBounds[s];
+			const float z1 = m_sliceBounds[s + 1];
+			for (uint32_t t = 0; t < tiles; t++)
+			{
+				const float low = (-1.0f + 2.0f * t / tiles) * tanHalfFov;
+				const float high = (-1.0f + 2.0f * (t + 1) / tiles) * tanHalfFov;
+				outMin[s * stride + t] = std::min(low * z0, low * z1);
+				outMax[s * stride + t] = std::max(high * z0, high * z1);
+			}
+		}
+	};
+	setupEdges(m_desc.tilesX, m_paddedTilesX, projection.tanHalfFovX, m_columnMin, m_columnMax);
+	setupEdges(m_desc.tilesY, m_desc.tilesY, projection.tanHalfFovY, m_rowMin, m_rowMax);
+}
+
+void LightClusterBuilder::TransformLights(const float* pView, const ClusterLight* pLights, uint32_t lightCount)
+{
+	m_viewLights.resize(size_t(lightCount) * 4);
+	for (uint32_t i = 0; i < lightCount; i++)
+	{
+		const float* pPos = pLights[i].position;
+		float* pOut = &m_viewLights[size_t(i) * 4];
+		for (int c = 0; c < 3; c++)
+			pOut[c] = pPos[0] * pView[c] + pPos[1] * pView[4 + c] + pPos[2] * pView[8 + c] + pView[12 + c];
+		pOut[3] = pLights[i].radius;
+	}
+}
+
+void LightClusterBuilder::Build(const float* pView, const ClusterProjection& projection, const ClusterLight* pLights, uint32_t lightCount)
+{
+	SetupGrid(projection);
+	TransformLights(pView, pLights, lightCount);
+
+	// Conservative slice range from the depth interval, one slice of slack covers the rounding between the log
+	// here and the pow of the bounds. The jobs test the exact slice interval.
+	const int32_t lastSlice = int32_t(m_desc.slices) - 1;
+	auto findSlice = [&](float depth)
+	{
+		if (!(depth > m_projection.nearZ))
+			return 0;
+		const float slice = std::log(depth) * m_sliceScale - m_sliceBias;
+		return slice >= float(lastSlice) ? lastSlice : int32_t(slice);
+	};
+	for (auto& job : m_jobs)
+		job.lights.clear();
+	for (uint32_t i = 0; i < lightCount; i++)
+	{
+		const float* pLight = &m_viewLights[size_t(i) * 4];
+		const int32_t first = std::max(findSlice(pLight[2] - pLight[3]) - 1, 0);
+		const int32_t last = std::min(findSlice(pLight[2] + pLight[3]) + 1, lastSlice);
+		for (int32_t s = first; s <= last; s++)
+			m_jobs[s].lights.push_back(i);
+	}
+
+	m_nextSlice = 0;
+	if (m_workers.empty() || lightCount < MinParallelLights)
+		RunJobs();
+	else
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_finishedWorkers = 0;
+			m_generation++;
+		}
+		m_wakeCondition.notify_all();
+		RunJobs();
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneCondition.wait(lock, [&]() { return m_finishedWorkers == m_workers.size(); });
+	}
+	GatherSlices();
+	UpdateStats();
+}
+
+void LightClusterBuilder::AssignSlice(uint32_t slice)
+{
+	SliceJob& job = m_jobs[slice];
+	const uint32_t tilesX = m_desc.tilesX;
+	const uint32_t tilesY = m_desc.tilesY;
+	const float z0 = m_sliceBounds[slice];
+	const float z1 = m_sliceBounds[slice + 1];
+	const float* pColumnMin = &m_columnMin[size_t(slice) * m_paddedTilesX];
+	const float* pColumnMax = &m_columnMax[size_t(slice) * m_paddedTilesX];
+	const float* pRowMin = &m_rowMin[size_t(slice) * tilesY];
+	const float* pRowMax = &m_rowMax[size_t(slice) * tilesY];
+	job.columnDistances.resize(m_paddedTilesX);
+	job.rowDistances.resize(tilesY);
+	job.pairs.clear();
+
+	for (uint32_t light : job.lights)
+	{
+		const float* pLight = &m_viewLights[size_t(light) * 4];
+		const float radiusSq = pLight[3] * pLight[3];
+		const float dz = AxisDistance(z0, z1, pLight[2]);
+		const float dzSq = dz * dz;
+		if (!(dzSq <= radiusSq))
+			continue;
+
+		// Rows first, a row too far away skips all of its columns
+		bool anyRow = false;
+		for (uint32_t y = 0; y < tilesY; y++)
+		{
+			const float dy = AxisDistance(pRowMin[y], pRowMax[y], pLight[1]);
+			job.rowDistances[y] = dy * dy;
+			anyRow |= dy * dy + dzSq <= radiusSq;
+		}
+		if (!anyRow)
+			continue;
+
+#if defined(__AVX2__)
+		const __m256 x = _mm256_set1_ps(pLight[0]);
+		const __m256 zero = _mm256_setzero_ps();
+		for (uint32_t c = 0; c < m_paddedTilesX; c += 8)
+		{
+			const __m256 d = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(pColumnMin + c), x),
+				_mm256_sub_ps(x, _mm256_loadu_ps(pColumnMax + c))), zero);
+			_mm256_storeu_ps(&job.columnDistances[c], _mm256_mul_ps(d, d));
+		}
+#else
+		const __m128 x = _mm_set1_ps(pLight[0]);
+		const __m128 zero = _mm_setzero_ps();
+		for (uint32_t c = 0; c < m_paddedTilesX; c += 4)
+		{
+			const __m128 d = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(pColumnMin + c), x),
+				_mm_sub_ps(x, _mm_loadu_ps(pColumnMax + c))), zero);
+			_mm_storeu_ps(&job.columnDistances[c], _mm_mul_ps(d, d));
+		}
+#endif
+
+		for (uint32_t y = 0; y < tilesY; y++)
+		{
+			const float dySq = job.rowDistances[y];
+			if (!(dySq + dzSq <= radiusSq))
+				continue;
+			// Same summation order as the reference, (dx + dy) + dz
+#if defined(__AVX2__)
+			const __m256 rowSq = _mm256_set1_ps(dySq);
+			const __m256 sliceSq = _mm256_set1_ps(dzSq);
+			const __m256 limit = _mm256_set1_ps(radiusSq);
+			for (uint32_t c = 0; c < m_paddedTilesX; c += 8)
+			{
+				const __m256 distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_loadu_ps(&job.columnDistances[c]), rowSq), sliceSq);
+				uint32_t mask = uint32_t(_mm256_movemask_ps(_mm256_cmp_ps(distanceSq, limit, _CMP_LE_OQ)));
+#else
+			const __m128 rowSq = _mm_set1_ps(dySq);
+			const __m128 sliceSq = _mm_set1_ps(dzSq);
+			const __m128 limit = _mm_set1_ps(radiusSq);
+			for (uint32_t c = 0; c < m_paddedTilesX; c += 4)
+			{
+				const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(&job.columnDistances[c]), rowSq), sliceSq);
+				uint32_t mask = uint32_t(_mm_movemask_ps(_mm_cmple_ps(distanceSq, limit)));
+#endif
+				while (mask != 0)
+				{
+					uint32_t lane = 0;
+					while (!(mask & (1u << lane)))
+						lane++;
+					mask &= mask - 1;
+					job.pairs.push_back(y * tilesX + c + lane);
+					job.pairs.push_back(light);
+				}
+			}
+		}
+	}
+
+	// Counting sort by cluster, stable so the lights stay ascending
+	const uint32_t sliceClusters = tilesX * tilesY;
+	job.counts.assign(sliceClusters, 0);
+	for (size_t i = 0; i < job.pairs.size(); i += 2)
+		job.counts[job.pairs[i]]++;
+	uint32_t offset = 0;
+	for (uint32_t c = 0; c < sliceClusters; c++)
+	{
+		const uint32_t count = job.counts[c];
+		job.counts[c] = offset;
+		offset += count;
+	}
+	job.indices.resize(offset);
+	for (size_t i = 0; i < job.pairs.size(); i += 2)
+		job.indices[job.counts[job.pairs[i]]++] = job.pairs[i + 1];
+}
+
+void LightClusterBuilder::GatherSlices()
+{
+	const uint32_t sliceClusters = m_desc.tilesX * m_desc.tilesY;
+	size_t total = 0;
+	for (const auto& job : m_jobs)
+		total += job.indices.size();
+	m_lightIndices.resize(total);
+	m_clusterRanges.resize(size_t(GetClusterCount()) * 2);
+
+	uint32_t base = 0;
+	for (uint32_t s = 0; s < m_desc.slices; s++)
+	{
+		const SliceJob& job = m_jobs[s];
+		// After the fill the counts hold the end offset of every cluster
+		uint32_t begin = 0;
+		for (uint32_t c = 0; c < sliceClusters; c++)
+		{
+			const size_t cluster = size_t(s) * sliceClusters + c;
+			m_clusterRanges[cluster * 2] = base + begin;
+			m_clusterRanges[cluster * 2 + 1] = job.counts[c] - begin;
+			begin = job.counts[c];
+		}
+		std::copy(job.indices.begin(), job.indices.end(), m_lightIndices.begin() + base);
+		base += uint32_t(job.indices.size());
+	}
+}
+
+void LightClusterBuilder::BuildReference(const float* pView, const ClusterProjection& projection, const ClusterLight* pLights, uint32_t lightCount)
+{
+	SetupGrid(projection);
+	TransformLights(pView, pLights, lightCount);
+
+	m_lightIndices.clear();
+	m_clusterRanges.resize(size_t(GetClusterCount()) * 2);
+	for (uint32_t cluster = 0; cluster < GetClusterCount(); cluster++)
+	{
+		float minVec[3], maxVec[3];
+		GetClusterBounds(cluster, minVec, maxVec);
+		m_clusterRanges[cluster * 2] = uint32_t(m_lightIndices.size());
+		for (uint32_t i = 0; i < lightCount; i++)
+		{
+			const float* pLight = &m_viewLights[size_t(i) * 4];
+			float distanceSq[3];
+			for (int c = 0; c < 3; c++)
+			{
+				const float d = AxisDistance(minVec[c], maxVec[c], pLight[c]);
+				distanceSq[c] = d * d;
+			}
+			if (distanceSq[0] + distanceSq[1] + distanceSq[2] <= pLight[3] * pLight[3])
+				m_lightIndices.push_back(i);
+		}
+		m_clusterRanges[cluster * 2 + 1] = uint32_t(m_lightIndices.size()) - m_clusterRanges[cluster * 2];
+	}
+	UpdateStats();
+}
+
+void LightClusterBuilder::UpdateStats()
+{
+	m_stats = {};
+	m_stats.assignments = uint32_t(m_lightIndices.size());
+	for (size_t i = 1; i < m_clusterRanges.size(); i += 2)
+		m_stats.maxClusterLights = std::max(m_stats.maxClusterLights, m_clusterRanges[i]);
+}
+
+void LightClusterBuilder::GetClusterBounds(uint32_t cluster, float minVec[3], float maxVec[3]) const
+{
+	const uint32_t x = cluster % m_desc.tilesX;
+	const uint32_t y = cluster / m_desc.tilesX % m_desc.tilesY;
+	const uint32_t slice = cluster / (m_desc.tilesX * m_desc.tilesY);
+	minVec[0] = m_columnMin[size_t(slice) * m_paddedTilesX + x];
+	maxVec[0] = m_columnMax[size_t(slice) * m_paddedTilesX + x];
+	minVec[1] = m_rowMin[size_t(slice) * m_desc.tilesY + y];
+	maxVec[1] = m_rowMax[size_t(slice) * m_desc.tilesY + y];
+	minVec[2] = m_sliceBounds[slice];
+	maxVec[2] = m_sliceBounds[slice + 1];
+}
+
+void LightClusterBuilder::GetSliceParams(float& scale, float& bias) const
+{
+	scale = m_sliceScale;
+	bias = m_sliceBias;
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Layout of the Light structure in CBScene.hlsli
+struct ClusterLight
+{
+	float position[3];
+	float radius; // the attenuation window reaches zero here
+	float color[4];
+};
+
+struct ClusterGridDesc
+{
+	uint32_t tilesX = 16;
+	uint32_t tilesY = 9;
+	uint32_t slices = 24; // exponential in view depth
+};
+
+// Symmetric left handed perspective, the depth range is given in view space even with reversed depth
+struct ClusterProjection
+{
+	float tanHalfFovX = 1.0f;
+	float tanHalfFovY = 1.0f;
+	float nearZ = 0.1f;
+	float farZ = 100.0f;
+};
+
+struct ClusterStats
+{
+	uint32_t assignments = 0; // entries in the index list
+	uint32_t maxClusterLights = 0;
+};
+
+// Clustered light assignment. The view frustum is split into tiles on screen and exponential depth slices, every
+// cluster gets the lights whose sphere touches the view space box of the cluster. Tile x runs left to right,
+// tile y bottom to top, cluster index is (slice * tilesY + tileY) * tilesX + tileX.
+// The box of a cluster is the product of a column, a row and a slice interval, so the sphere test splits into one
+// squared distance per axis. Slices are processed in parallel, the lights of a cluster are in ascending order and
+// the result does not depend on the thread count.
+// Kept free of Windows and D3D headers.
+class LightClusterBuilder
+{
+public:
+	~LightClusterBuilder();
+
+	void Init(const ClusterGridDesc& desc, uint32_t threadCount = 0);
+	void Term();
+
+	// pView - world to view matrix, 16 floats with row vectors
+	void Build(const float* pView, const ClusterProjection& projection, const ClusterLight* pLights, uint32_t lightCount);
+	// Every light against every cluster box, the result matches Build
+	void BuildReference(const float* pView, const ClusterProjection& projection, const ClusterLight* pLights, uint32_t lightCount);
+
+	uint32_t GetClusterCount() const { return m_desc.tilesX * m_desc.tilesY * m_desc.slices; }
+	const ClusterGridDesc& GetGridDesc() const { return m_desc; }
+	// Offset into the index list and light count of every cluster
+	const std::vector<uint32_t>& GetClusterRanges() const { return m_clusterRanges; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_lightIndices; }
+	void GetClusterBounds(uint32_t cluster, float minVec[3], float maxVec[3]) const;
+	// Shader constants: slice = log(viewZ) * scale - bias
+	void GetSliceParams(float& scale, float& bias) const;
+	const ClusterStats& GetStats() const { return m_stats; }
+	uint32_t GetThreadCount() const { return uint32_t(m_workers.size()) + 1; }
+
+private:
+	struct SliceJob
+	{
+		std::vector<uint32_t> lights; // touching the slice depth range, ascending
+		std::vector<uint32_t> pairs; // cluster in the slice and light
+		std::vector<uint32_t> counts;
+		std::vector<uint32_t> indices; // grouped by cluster
+		std::vector<float> columnDistances; // squared, per padded column
+		std::vector<float> rowDistances;
+	};
+
+	void SetupGrid(const ClusterProjection& projection);
+	void TransformLights(const float* pView, const ClusterLight* pLights, uint32_t lightCount);
+	void WorkerLoop();
+	void RunJobs();
+	void AssignSlice(uint32_t slice);
+	void GatherSlices();
+	void UpdateStats();
+
+	ClusterGridDesc m_desc;
+	ClusterProjection m_projection;
+	bool m_gridValid = false;
+	uint32_t m_paddedTilesX = 0; // columns padded to the SIMD width
+	std::vector<float> m_columnMin; // per slice and column, padding columns never touch a sphere
+	std::vector<float> m_columnMax;
+	std::vector<float> m_rowMin; // per slice and row
+	std::vector<float> m_rowMax;
+	std::vector<float> m_sliceBounds; // slices + 1 depths
+	float m_sliceScale = 0.0f;
+	float m_sliceBias = 0.0f;
+
+	std::vector<float> m_viewLights; // x, y, z, radius per light
+	std::vector<SliceJob> m_jobs;
+	std::vector<uint32_t> m_clusterRanges;
+	std::vector<uint32_t> m_lightIndices;
+	ClusterStats m_stats;
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	uint64_t m_generation = 0;
+	size_t m_finishedWorkers = 0;
+	bool m_stop = false;
+	std::atomic<uint32_t> m_nextSlice{ 0 };
+};
@@ -0,0 +1,27 @@
+#pragma once
+#include "framework.h"
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { Close(); }
+
+	bool Open(const wchar_t* fileName);
+	void Close();
+
+	bool IsOpen() const { return m_pData != nullptr; }
+	const uint8_t* GetData() const { return m_pData; }
+	size_t GetSize() const { return m_size; }
+
+private:
+	HANDLE m_hFile = INVALID_HANDLE_VALUE;
+	HANDLE m_hMapping = NULL;
+	const uint8_t* m_pData = nullptr;
+	size_t m_size = 0;
+};
@@ -0,0 +1,61 @@
+#include "MaterialTable.h"
+#include <cstring>
+
+size_t MaterialTable::MaterialHash::operator()(const Material& material) const
+{
+	// FNV-1a over the bytes, the members have no padding
+	const BYTE* pBytes = reinterpret_cast<const BYTE*>(&material);
+	UINT64 hash = 14695981039346656037ull;
+	for (size_t i = 0; i < sizeof(Material); i++)
+		hash = (hash ^ pBytes[i]) * 1099511628211ull;
+	return size_t(hash);
+}
+
+bool MaterialTable::MaterialEqual::operator()(const Material& a, const Material& b) const
+{
+	return memcmp(&a, &b, sizeof(Material)) == 0;
+}
+
+UINT16 MaterialTable::Add(const Material& material)
+{
+	auto found = m_lookup.find(material);
+	if (found != m_lookup.end())
+		return found->second;
+	assert(m_materials.size() < MaxMaterials);
+	if (m_materials.size() >= MaxMaterials)
+		return 0;
+
+	UINT16 id = UINT16(m_materials.size());
+	m_materials.push_back(material);
+	m_lookup.emplace(material, id);
+	m_version++;
+	return id;
+}
+
+void SortIdsByMaterial(const UINT16* pMaterialIds, size_t materialStride, UINT materialCount, UINT32* pIds, size_t count,
+	std::vector<UINT32>& scratch)
+{
+	const BYTE* pMaterialBytes = reinterpret_cast<const BYTE*>(pMaterialIds);
+	auto materialOf = [&](UINT32 id) { return *reinterpret_cast<const UINT16*>(pMaterialBytes + materialStride * id); };
+	if (count < 2 || materialCount < 2)
+		return;
+
+	// Buffers filled in material order stay sorted after culling and need no pass
+	bool sorted = true;
+	for (size_t i = 1; i < count && sorted; i++)
+		sorted = materialOf(pIds[i - 1]) <= materialOf(pIds[i]);
+	if (sorted)
+		return;
+
+	// Offsets of every material followed by the ids
+	scratch.assign(materialCount + 1, 0);
+	for (size_t i = 0; i < count; i++)
+		scratch[materialOf(pIds[i]) + 1]++;
+	for (UINT m = 1; m <= materialCount; m++)
+		scratch[m] += scratch[m - 1];
+	scratch.resize(materialCount + 1 + count);
+	UINT32* pSorted = scratch.data() + materialCount + 1;
+	for (size_t i = 0; i < count; i++)
+		pSorted[scratch[materialOf(pIds[i])]++] = pIds[i];
+	memcpy(pIds, pSorted, count * sizeof(UINT32));
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "framework.h"
+#include <vector>
+#include <unordered_map>
+
+// Shading parameters shared by instances, Base_PS reads them from the material buffer
+struct Material
+{
+	DirectX::XMFLOAT4 lightParams = { 1.0f, 1.0f, 3.0f, 32.0f }; // ambient, diffuse, specular, shininess
+	DirectX::XMFLOAT4 baseColor = { 1.0f, 1.0f, 1.0f, 1.0f }; // w - opacity
+	DirectX::XMINT4 modelInfo = { 0, 0, 1, 0 }; // color texture, normal map, use light
+};
+
+// Deduplicated materials referenced by 16 bit index. Identical materials share one entry, so the table only
+// grows with the distinct materials of the scene and is uploaded again only after it changed.
+class MaterialTable
+{
+public:
+	static const UINT MaxMaterials = 0x10000;
+
+	// Index of the identical material when there is one. A full table asserts and returns the first material.
+	UINT16 Add(const Material& material);
+	const Material& Get(UINT16 id) const { return m_materials[id]; }
+	const std::vector<Material>& GetMaterials() const { return m_materials; }
+	UINT GetCount() const { return UINT(m_materials.size()); }
+	// Increases with every new material
+	UINT GetVersion() const { return m_version; }
+
+private:
+	struct MaterialHash
+	{
+		size_t operator()(const Material& material) const;
+	};
+	struct MaterialEqual
+	{
+		bool operator()(const Material& a, const Material& b) const;
+	};
+
+	std::vector<Material> m_materials;
+	std::unordered_map<Material, UINT16, MaterialHash, MaterialEqual> m_lookup;
+	UINT m_version = 0;
+};
+
+// Stable counting sort of the ids by the material of their instance, consecutive material indices of
+// the instances are materialStride bytes apart. Instances drawn in this order come in runs of one material.
+void SortIdsByMaterial(const UINT16* pMaterialIds, size_t materialStride, UINT materialCount, UINT32* pIds, size_t count,
+	std::vector<UINT32>& scratch);
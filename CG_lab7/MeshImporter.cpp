@@ -0,0 +1,914 @@
+#include "MeshImporter.h"
+#include "MappedFile.h"
+
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <cwctype>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+	//--------------------------------------------------------------------------------------
+	// Number parsing
+	//--------------------------------------------------------------------------------------
+	const double Pow10Table[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	inline bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	inline const char* SkipBlanks(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t'))
+			p++;
+		return p;
+	}
+
+	inline const char* SkipLine(const char* p, const char* end)
+	{
+		while (p < end && *p != '\n')
+			p++;
+		return p < end ? p + 1 : end;
+	}
+
+	// Decimal number without locale and strtod overhead. The first 19 significant digits are accumulated exactly,
+	// the result is correctly rounded while they fit the 53 bit double mantissa (up to 15 digits) and |exp| <= 22,
+	// longer numbers can be off by an ulp or two, far below the float precision of the vertex data.
+	const char* ParseNumber(const char* p, const char* end, double& out)
+	{
+		p = SkipBlanks(p, end);
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		for (; p < end && IsDigit(*p); p++)
+		{
+			if (digits < 19)
+			{
+				mantissa = mantissa * 10 + uint64_t(*p - '0');
+				digits += mantissa != 0;
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+		if (p < end && *p == '.')
+		{
+			for (p++; p < end && IsDigit(*p); p++)
+			{
+				if (digits < 19)
+				{
+					mantissa = mantissa * 10 + uint64_t(*p - '0');
+					digits += mantissa != 0;
+					exponent--;
+				}
+			}
+		}
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			p++;
+			bool negativeExp = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExp = *p == '-';
+				p++;
+			}
+			int e = 0;
+			for (; p < end && IsDigit(*p); p++)
+				e = e < 10000 ? e * 10 + (*p - '0') : e;
+			exponent += negativeExp ? -e : e;
+		}
+
+		double value = double(mantissa);
+		if (exponent < 0)
+			value = exponent >= -22 ? value / Pow10Table[-exponent] : value * pow(10.0, exponent);
+		else if (exponent > 0)
+			value = exponent <= 22 ? value * Pow10Table[exponent] : value * pow(10.0, exponent);
+		out = negative ? -value : value;
+		return p;
+	}
+
+	inline const char* ParseFloat(const char* p, const char* end, float& out)
+	{
+		double value;
+		p = ParseNumber(p, end, value);
+		out = float(value);
+		return p;
+	}
+
+	const char* ParseInt(const char* p, const char* end, int& out)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			p++;
+		}
+		int value = 0;
+		for (; p < end && IsDigit(*p); p++)
+			value = value * 10 + (*p - '0');
+		out = negative ? -value : value;
+		return p;
+	}
+
+	//--------------------------------------------------------------------------------------
+	// OBJ
+	//--------------------------------------------------------------------------------------
+	const int MissingIndex = INT_MIN;
+
+	// Indices are resolved to zero-based ones; relative (negative) indices are local to the chunk until merged
+	struct ObjCorner
+	{
+		int idx[3]; // position, uv, normal
+		UINT8 relativeMask;
+	};
+
+	struct ObjChunk
+	{
+		vector<DirectX::XMFLOAT3> positions;
+		vector<DirectX::XMFLOAT2> uvs;
+		vector<DirectX::XMFLOAT3> normals;
+		vector<ObjCorner> corners; // three per triangle
+	};
+
+	const char* ParseCorner(const char* p, const char* end, const ObjChunk& chunk, ObjCorner& corner)
+	{
+		const int counts[3] = { int(chunk.positions.size()), int(chunk.uvs.size()), int(chunk.normals.size()) };
+		corner.relativeMask = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			corner.idx[k] = MissingIndex;
+			if (k > 0)
+			{
+				if (p >= end || *p != '/')
+					continue;
+				p++;
+			}
+			if (p >= end || !(IsDigit(*p) || *p == '-' || *p == '+'))
+				continue;
+			int value;
+			p = ParseInt(p, end, value);
+			if (value > 0)
+			{
+				corner.idx[k] = value - 1;
+			}
+			else if (value < 0)
+			{
+				corner.idx[k] = counts[k] + value;
+				corner.relativeMask |= 1 << k;
+			}
+		}
+		return p;
+	}
+
+	void ParseObjChunk(const char* p, const char* end, ObjChunk& chunk)
+	{
+		vector<ObjCorner> polygon;
+		while (p < end)
+		{
+			p = SkipBlanks(p, end);
+			if (p >= end)
+				break;
+			if (p + 1 < end && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				DirectX::XMFLOAT3 pos;
+				p = ParseFloat(p + 2, end, pos.x);
+				p = ParseFloat(p, end, pos.y);
+				p = ParseFloat(p, end, pos.z);
+				chunk.positions.push_back(pos);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 't' && (p[2] == ' ' || p[2] == '\t'))
+			{
+				DirectX::XMFLOAT2 uv;
+				p = ParseFloat(p + 3, end, uv.x);
+				p = ParseFloat(p, end, uv.y);
+				chunk.uvs.push_back(uv);
+			}
+			else if (p + 2 < end && p[0] == 'v' && p[1] == 'n' && (p[2] == ' ' || p[2] == '\t'))
+			{
+				DirectX::XMFLOAT3 normal;
+				p = ParseFloat(p + 3, end, normal.x);
+				p = ParseFloat(p, end, normal.y);
+				p = ParseFloat(p, end, normal.z);
+				chunk.normals.push_back(normal);
+			}
+			else if (p + 1 < end && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t'))
+			{
+				polygon.clear();
+				p += 2;
+				while (true)
+				{
+					p = SkipBlanks(p, end);
+					if (p >= end || !(IsDigit(*p) || *p == '-' || *p == '+'))
+						break;
+					ObjCorner corner;
+					p = ParseCorner(p, end, chunk, corner);
+					polygon.push_back(corner);
+				}
+				// Fan triangulation, winding is reversed together with z for the left-handed view space
+				for (size_t i = 1; i + 1 < polygon.size(); i++)
+				{
+					chunk.corners.push_back(polygon[0]);
+					chunk.corners.push_back(polygon[i + 1]);
+					chunk.corners.push_back(polygon[i]);
+				}
+			}
+			p = SkipLine(p, end);
+		}
+	}
+
+	struct CornerKey
+	{
+		int idx[3];
+		bool operator==(const CornerKey& other) const
+		{
+			return idx[0] == other.idx[0] && idx[1] == other.idx[1] && idx[2] == other.idx[2];
+		}
+	};
+
+	struct CornerKeyHash
+	{
+		size_t operator()(const CornerKey& key) const
+		{
+			uint64_t h = uint64_t(uint32_t(key.idx[0])) * 0x9E3779B97F4A7C15ull;
+			h ^= (uint64_t(uint32_t(key.idx[1])) + 0x632BE59BD9B4E019ull + (h << 6) + (h >> 2));
+			h ^= (uint64_t(uint32_t(key.idx[2])) * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2));
+			return size_t(h ^ (h >> 32));
+		}
+	};
+
+	//--------------------------------------------------------------------------------------
+	// Minimal JSON reader for the glTF header
+	//--------------------------------------------------------------------------------------
+	struct JsonValue
+	{
+		enum Type { Null, Bool, Number, String, Array, Object };
+		Type type = Null;
+		double number = 0.0;
+		std::string string;
+		vector<JsonValue> items;
+		vector<std::string> keys; // for objects, parallel to items
+
+		const JsonValue* Find(const char* key) const
+		{
+			for (size_t i = 0; i < keys.size(); i++)
+			{
+				if (keys[i] == key)
+					return &items[i];
+			}
+			return nullptr;
+		}
+		int GetInt(const char* key, int defaultValue) const
+		{
+			const JsonValue* pValue = Find(key);
+			return pValue != nullptr && pValue->type == Number ? int(pValue->number) : defaultValue;
+		}
+	};
+
+	class JsonParser
+	{
+	public:
+		JsonParser(const char* p, const char* end) : m_p(p), m_end(end) {}
+
+		bool Parse(JsonValue& out, int depth = 0)
+		{
+			SkipSpaces();
+			if (m_p >= m_end || depth > 64)
+				return false;
+			switch (*m_p)
+			{
+			case '{':
+				out.type = JsonValue::Object;
+				m_p++;
+				SkipSpaces();
+				if (m_p < m_end && *m_p == '}')
+				{
+					m_p++;
+					return true;
+				}
+				while (true)
+				{
+					std::string key;
+					SkipSpaces();
+					if (!ParseString(key))
+						return false;
+					SkipSpaces();
+					if (m_p >= m_end || *m_p != ':')
+						return false;
+					m_p++;
+					out.keys.push_back(key);
+					out.items.emplace_back();
+					if (!Parse(out.items.back(), depth + 1))
+						return false;
+					SkipSpaces();
+					if (m_p < m_end && *m_p == ',')
+					{
+						m_p++;
+						continue;
+					}
+					if (m_p < m_end && *m_p == '}')
+					{
+						m_p++;
+						return true;
+					}
+					return false;
+				}
+			case '[':
+				out.type = JsonValue::Array;
+				m_p++;
+				SkipSpaces();
+				if (m_p < m_end && *m_p == ']')
+				{
+					m_p++;
+					return true;
+				}
+				while (true)
+				{
+					out.items.emplace_back();
+					if (!Parse(out.items.back(), depth + 1))
+						return false;
+					SkipSpaces();
+					if (m_p < m_end && *m_p == ',')
+					{
+						m_p++;
+						continue;
+					}
+					if (m_p < m_end && *m_p == ']')
+					{
+						m_p++;
+						return true;
+					}
+					return false;
+				}
+			case '"':
+				out.type = JsonValue::String;
+				return ParseString(out.string);
+			case 't':
+			case 'f':
+			case 'n':
+			{
+				const char* words[] = { "true", "false", "null" };
+				for (const char* word : words)
+				{
+					size_t len = strlen(word);
+					if (size_t(m_end - m_p) >= len && memcmp(m_p, word, len) == 0)
+					{
+						out.type = word[0] == 'n' ? JsonValue::Null : JsonValue::Bool;
+						out.number = word[0] == 't' ? 1.0 : 0.0;
+						m_p += len;
+						return true;
+					}
+				}
+				return false;
+			}
+			default:
+			{
+				double value;
+				const char* p = ParseNumber(m_p, m_end, value);
+				if (p == m_p)
+					return false;
+				out.type = JsonValue::Number;
+				out.number = value;
+				m_p = p;
+				return true;
+			}
+			}
+		}
+
+	private:
+		void SkipSpaces()
+		{
+			while (m_p < m_end && (*m_p == ' ' || *m_p == '\t' || *m_p == '\n' || *m_p == '\r'))
+				m_p++;
+		}
+
+		// Escapes are kept only for the characters glTF keys and URIs can realistically contain
+		bool ParseString(std::string& out)
+		{
+			if (m_p >= m_end || *m_p != '"')
+				return false;
+			for (m_p++; m_p < m_end && *m_p != '"'; m_p++)
+			{
+				if (*m_p == '\\' && m_p + 1 < m_end)
+				{
+					m_p++;
+					if (*m_p == 'u')
+					{
+						m_p += 4;
+						out.push_back('?');
+						continue;
+					}
+				}
+				out.push_back(*m_p);
+			}
+			if (m_p >= m_end)
+				return false;
+			m_p++;
+			return true;
+		}
+
+		const char* m_p;
+		const char* m_end;
+	};
+
+	//--------------------------------------------------------------------------------------
+	// glTF accessors
+	//--------------------------------------------------------------------------------------
+	const uint32_t GlbMagic = 0x46546C67; // "glTF"
+	const uint32_t GlbChunkJson = 0x4E4F534A;
+	const uint32_t GlbChunkBin = 0x004E4942;
+
+	const int ComponentUByte = 5121;
+	const int ComponentUShort = 5123;
+	const int ComponentUInt = 5125;
+	const int ComponentFloat = 5126;
+
+	struct AccessorView
+	{
+		const uint8_t* pData = nullptr;
+		size_t count = 0;
+		size_t stride = 0;
+		int componentType = 0;
+		int componentCount = 0;
+	};
+
+	int GetComponentCount(const std::string& type)
+	{
+		if (type == "SCALAR")
+			return 1;
+		if (type == "VEC2")
+			return 2;
+		if (type == "VEC3")
+			return 3;
+		if (type == "VEC4")
+			return 4;
+		return 0;
+	}
+
+	int GetComponentSize(int componentType)
+	{
+		switch (componentType)
+		{
+		case ComponentUByte:
+			return 1;
+		case ComponentUShort:
+			return 2;
+		case ComponentUInt:
+		case ComponentFloat:
+			return 4;
+		default:
+			return 0;
+		}
+	}
+
+	bool GetAccessor(const JsonValue& root, int accessorIdx, const uint8_t* pBin, size_t binSize, AccessorView& out)
+	{
+		const JsonValue* pAccessors = root.Find("accessors");
+		const JsonValue* pViews = root.Find("bufferViews");
+		if (pAccessors == nullptr || pViews == nullptr || accessorIdx < 0 || accessorIdx >= int(pAccessors->items.size()))
+			return false;
+		const JsonValue& accessor = pAccessors->items[accessorIdx];
+		int viewIdx = accessor.GetInt("bufferView", -1);
+		if (viewIdx < 0 || viewIdx >= int(pViews->items.size()))
+			return false;
+		const JsonValue& view = pViews->items[viewIdx];
+		if (view.GetInt("buffer", 0) != 0)
+			return false;
+
+		const JsonValue* pType = accessor.Find("type");
+		out.componentType = accessor.GetInt("componentType", 0);
+		out.componentCount = pType != nullptr ? GetComponentCount(pType->string) : 0;
+		out.count = size_t(accessor.GetInt("count", 0));
+		size_t elementSize = size_t(GetComponentSize(out.componentType) * out.componentCount);
+		if (elementSize == 0)
+			return false;
+		out.stride = size_t(view.GetInt("byteStride", 0));
+		if (out.stride == 0)
+			out.stride = elementSize;
+
+		size_t offset = size_t(view.GetInt("byteOffset", 0)) + size_t(accessor.GetInt("byteOffset", 0));
+		size_t viewEnd = size_t(view.GetInt("byteOffset", 0)) + size_t(view.GetInt("byteLength", 0));
+		if (out.count > 0 && (viewEnd > binSize || offset + (out.count - 1) * out.stride + elementSize > viewEnd))
+			return false;
+		out.pData = pBin + offset;
+		return true;
+	}
+
+	bool ReadFloats(const AccessorView& view, size_t idx, float* pOut, int count)
+	{
+		if (view.componentType != ComponentFloat || view.componentCount < count)
+			return false;
+		memcpy(pOut, view.pData + idx * view.stride, sizeof(float) * count);
+		return true;
+	}
+
+	UINT32 ReadIndex(const AccessorView& view, size_t idx)
+	{
+		const uint8_t* p = view.pData + idx * view.stride;
+		switch (view.componentType)
+		{
+		case ComponentUByte:
+			return *p;
+		case ComponentUShort:
+		{
+			uint16_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		default:
+		{
+			uint32_t value;
+			memcpy(&value, p, sizeof(value));
+			return value;
+		}
+		}
+	}
+
+	double SecondsSince(const std::chrono::high_resolution_clock::time_point& start)
+	{
+		return std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+}
+
+bool ParseOBJ(const char* pText, size_t size, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	UINT threadCount)
+{
+	outVertices.clear();
+	outIndices.clear();
+	const char* pEnd = pText + size;
+
+	static const size_t MinChunkSize = 256 * 1024;
+	if (threadCount == 0)
+		threadCount = max(1u, std::thread::hardware_concurrency());
+	size_t chunkCount = min(size_t(threadCount), size / MinChunkSize + 1);
+
+	// Chunk borders are moved to the next line start so every line is parsed by exactly one thread
+	vector<const char*> borders(chunkCount + 1);
+	borders[0] = pText;
+	for (size_t i = 1; i < chunkCount; i++)
+		borders[i] = max(borders[i - 1], SkipLine(pText + size * i / chunkCount, pEnd));
+	borders[chunkCount] = pEnd;
+
+	vector<ObjChunk> chunks(chunkCount);
+	{
+		vector<std::thread> workers;
+		for (size_t i = 1; i < chunkCount; i++)
+			workers.emplace_back(ParseObjChunk, borders[i], borders[i + 1], std::ref(chunks[i]));
+		ParseObjChunk(borders[0], borders[1], chunks[0]);
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	vector<DirectX::XMFLOAT3> positions;
+	vector<DirectX::XMFLOAT2> uvs;
+	vector<DirectX::XMFLOAT3> normals;
+	vector<ObjCorner> corners;
+	{
+		size_t counts[4] = {};
+		for (auto& chunk : chunks)
+		{
+			counts[0] += chunk.positions.size();
+			counts[1] += chunk.uvs.size();
+			counts[2] += chunk.normals.size();
+			counts[3] += chunk.corners.size();
+		}
+		positions.reserve(counts[0]);
+		uvs.reserve(counts[1]);
+		normals.reserve(counts[2]);
+		corners.reserve(counts[3]);
+	}
+	for (auto& chunk : chunks)
+	{
+		int bases[3] = { int(positions.size()), int(uvs.size()), int(normals.size()) };
+		for (auto corner : chunk.corners)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				if (corner.relativeMask & (1 << k))
+					corner.idx[k] += bases[k];
+			}
+			corners.push_back(corner);
+		}
+		positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+		uvs.insert(uvs.end(), chunk.uvs.begin(), chunk.uvs.end());
+		normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+		chunk = ObjChunk();
+	}
+
+	bool hasMissingNormals = false;
+	std::unordered_map<CornerKey, UINT32, CornerKeyHash> vertexMap;
+	vertexMap.reserve(corners.size() / 2);
+	outIndices.reserve(corners.size());
+	for (auto& corner : corners)
+	{
+		CornerKey key = { { corner.idx[0], corner.idx[1], corner.idx[2] } };
+		if (key.idx[0] < 0 || key.idx[0] >= int(positions.size()))
+			return false;
+		if (key.idx[1] < 0 || key.idx[1] >= int(uvs.size()))
+			key.idx[1] = MissingIndex;
+		if (key.idx[2] < 0 || key.idx[2] >= int(normals.size()))
+			key.idx[2] = MissingIndex;
+
+		auto it = vertexMap.find(key);
+		if (it != vertexMap.end())
+		{
+			outIndices.push_back(it->second);
+			continue;
+		}
+
+		TextureNormalVertex vertex = {};
+		const DirectX::XMFLOAT3& pos = positions[key.idx[0]];
+		vertex.pos = { pos.x, pos.y, -pos.z };
+		if (key.idx[1] != MissingIndex)
+			vertex.textureUV = { uvs[key.idx[1]].x, 1.0f - uvs[key.idx[1]].y };
+		if (key.idx[2] != MissingIndex)
+			vertex.normal = { normals[key.idx[2]].x, normals[key.idx[2]].y, -normals[key.idx[2]].z };
+		else
+			hasMissingNormals = true;
+
+		UINT32 idx = UINT32(outVertices.size());
+		vertexMap.emplace(key, idx);
+		outVertices.push_back(vertex);
+		outIndices.push_back(idx);
+	}
+
+	if (hasMissingNormals)
+		ComputeNormals(outVertices, outIndices);
+	ComputeTangents(outVertices, outIndices);
+	return !outIndices.empty();
+}
+
+bool ImportOBJ(const wchar_t* fileName, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	MeshImportStats* pStats, UINT threadCount)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	MappedFile file;
+	if (!file.Open(fileName))
+		return false;
+	bool result = ParseOBJ(reinterpret_cast<const char*>(file.GetData()), file.GetSize(), outVertices, outIndices, threadCount);
+	if (pStats != nullptr)
+	{
+		pStats->fileBytes = file.GetSize();
+		pStats->vertexCount = outVertices.size();
+		pStats->triangleCount = outIndices.size() / 3;
+		pStats->seconds = SecondsSince(start);
+	}
+	return result;
+}
+
+bool ParseGLB(const uint8_t* pData, size_t size, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices)
+{
+	outVertices.clear();
+	outIndices.clear();
+
+	uint32_t header[3];
+	if (size < sizeof(header))
+		return false;
+	memcpy(header, pData, sizeof(header));
+	if (header[0] != GlbMagic || header[1] != 2 || header[2] > size)
+		return false;
+
+	const char* pJson = nullptr;
+	size_t jsonSize = 0;
+	const uint8_t* pBin = nullptr;
+	size_t binSize = 0;
+	for (size_t offset = sizeof(header); offset + 8 <= header[2];)
+	{
+		uint32_t chunkHeader[2];
+		memcpy(chunkHeader, pData + offset, sizeof(chunkHeader));
+		offset += sizeof(chunkHeader);
+		if (offset + chunkHeader[0] > header[2])
+			return false;
+		if (chunkHeader[1] == GlbChunkJson && pJson == nullptr)
+		{
+			pJson = reinterpret_cast<const char*>(pData + offset);
+			jsonSize = chunkHeader[0];
+		}
+		else if (chunkHeader[1] == GlbChunkBin && pBin == nullptr)
+		{
+			pBin = pData + offset;
+			binSize = chunkHeader[0];
+		}
+		offset += (chunkHeader[0] + 3) & ~3u;
+	}
+	if (pJson == nullptr || pBin == nullptr)
+		return false;
+
+	JsonValue root;
+	JsonParser parser(pJson, pJson + jsonSize);
+	if (!parser.Parse(root) || root.type != JsonValue::Object)
+		return false;
+	const JsonValue* pMeshes = root.Find("meshes");
+	if (pMeshes == nullptr)
+		return false;
+
+	// Primitives without TANGENT get generated tangents, the ones stored in the file are kept with their sign
+	struct PrimitiveRange
+	{
+		size_t firstVertex;
+		size_t vertexCount;
+		size_t firstIndex;
+		size_t indexCount;
+	};
+	vector<PrimitiveRange> missingTangents;
+	bool hasMissingNormals = false;
+	for (auto& mesh : pMeshes->items)
+	{
+		const JsonValue* pPrimitives = mesh.Find("primitives");
+		if (pPrimitives == nullptr)
+			continue;
+		for (auto& primitive : pPrimitives->items)
+		{
+			const JsonValue* pAttributes = primitive.Find("attributes");
+			if (primitive.GetInt("mode", 4) != 4 || pAttributes == nullptr)
+				continue;
+
+			AccessorView positions, normals, tangents, uvs, indices;
+			if (!GetAccessor(root, pAttributes->GetInt("POSITION", -1), pBin, binSize, positions))
+				return false;
+			bool hasNormals = GetAccessor(root, pAttributes->GetInt("NORMAL", -1), pBin, binSize, normals);
+			bool hasTangents = GetAccessor(root, pAttributes->GetInt("TANGENT", -1), pBin, binSize, tangents);
+			bool hasUVs = GetAccessor(root, pAttributes->GetInt("TEXCOORD_0", -1), pBin, binSize, uvs);
+			bool hasIndices = GetAccessor(root, primitive.GetInt("indices", -1), pBin, binSize, indices);
+			hasMissingNormals |= !hasNormals;
+
+			UINT32 baseVertex = UINT32(outVertices.size());
+			outVertices.resize(outVertices.size() + positions.count);
+			for (size_t i = 0; i < positions.count; i++)
+			{
+				TextureNormalVertex& vertex = outVertices[baseVertex + i];
+				vertex = {};
+				if (!ReadFloats(positions, i, &vertex.pos.x, 3))
+					return false;
+				vertex.pos.z = -vertex.pos.z;
+				if (hasNormals && i < normals.count && ReadFloats(normals, i, &vertex.normal.x, 3))
+					vertex.normal.z = -vertex.normal.z;
+				// Mirroring z flips the cross product as well, so the glTF sign w already fits cross(tang, normal)
+				if (hasTangents && i < tangents.count && ReadFloats(tangents, i, &vertex.tang.x, 4))
+					vertex.tang.z = -vertex.tang.z;
+				if (hasUVs && i < uvs.count)
+					ReadFloats(uvs, i, &vertex.textureUV.x, 2);
+			}
+
+			size_t firstIndex = outIndices.size();
+			size_t indexCount = hasIndices ? indices.count : positions.count;
+			for (size_t i = 0; i + 2 < indexCount; i += 3)
+			{
+				UINT32 tri[3];
+				for (size_t k = 0; k < 3; k++)
+				{
+					tri[k] = hasIndices ? ReadIndex(indices, i + k) : UINT32(i + k);
+					if (tri[k] >= positions.count)
+						return false;
+				}
+				outIndices.push_back(baseVertex + tri[0]);
+				outIndices.push_back(baseVertex + tri[2]);
+				outIndices.push_back(baseVertex + tri[1]);
+			}
+			if (!hasTangents)
+				missingTangents.push_back({ baseVertex, positions.count, firstIndex, outIndices.size() - firstIndex });
+		}
+	}
+
+	if (hasMissingNormals)
+		ComputeNormals(outVertices, outIndices);
+	for (const PrimitiveRange& range : missingTangents)
+		ComputeTangents(outVertices, outIndices, range.firstVertex, range.vertexCount, range.firstIndex, range.indexCount);
+	return !outIndices.empty();
+}
+
+bool ImportGLB(const wchar_t* fileName, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	MeshImportStats* pStats)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	MappedFile file;
+	if (!file.Open(fileName))
+		return false;
+	bool result = ParseGLB(file.GetData(), file.GetSize(), outVertices, outIndices);
+	if (pStats != nullptr)
+	{
+		pStats->fileBytes = file.GetSize();
+		pStats->vertexCount = outVertices.size();
+		pStats->triangleCount = outIndices.size() / 3;
+		pStats->seconds = SecondsSince(start);
+	}
+	return result;
+}
+
+bool ImportMesh(const wchar_t* fileName, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	MeshImportStats* pStats)
+{
+	std::wstring name = fileName;
+	size_t dot = name.find_last_of(L'.');
+	std::wstring ext = dot == std::wstring::npos ? L"" : name.substr(dot + 1);
+	for (auto& c : ext)
+		c = towlower(c);
+	if (ext == L"obj")
+		return ImportOBJ(fileName, outVertices, outIndices, pStats);
+	if (ext == L"glb")
+		return ImportGLB(fileName, outVertices, outIndices, pStats);
+	return false;
+}
+
+void ComputeNormals(vector<TextureNormalVertex>& vertices, const vector<UINT32>& indices)
+{
+	vector<DirectX::XMFLOAT3> accumulated(vertices.size(), DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		DirectX::XMVECTOR p0 = DirectX::XMLoadFloat3(&vertices[indices[i]].pos);
+		DirectX::XMVECTOR p1 = DirectX::XMLoadFloat3(&vertices[indices[i + 1]].pos);
+		DirectX::XMVECTOR p2 = DirectX::XMLoadFloat3(&vertices[indices[i + 2]].pos);
+		// Area weighted, clockwise front faces in the left-handed space
+		DirectX::XMVECTOR n = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p2, p0));
+		for (size_t k = 0; k < 3; k++)
+		{
+			DirectX::XMFLOAT3& acc = accumulated[indices[i + k]];
+			DirectX::XMStoreFloat3(&acc, DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&acc), n));
+		}
+	}
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		if (vertices[i].normal.x != 0.0f || vertices[i].normal.y != 0.0f || vertices[i].normal.z != 0.0f)
+			continue;
+		DirectX::XMStoreFloat3(&vertices[i].normal, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&accumulated[i])));
+	}
+}
+
+void ComputeTangents(vector<TextureNormalVertex>& vertices, const vector<UINT32>& indices)
+{
+	ComputeTangents(vertices, indices, 0, vertices.size(), 0, indices.size());
+}
+
+void ComputeTangents(vector<TextureNormalVertex>& vertices, const vector<UINT32>& indices,
+	size_t firstVertex, size_t vertexCount, size_t firstIndex, size_t indexCount)
+{
+	// Tangent (along u) and texture up (along -v) directions summed over the triangles of each vertex
+	vector<DirectX::XMFLOAT3> tangents(vertexCount, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+	vector<DirectX::XMFLOAT3> ups(vertexCount, DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f));
+	for (size_t i = firstIndex; i + 2 < firstIndex + indexCount; i += 3)
+	{
+		const TextureNormalVertex& v0 = vertices[indices[i]];
+		const TextureNormalVertex& v1 = vertices[indices[i + 1]];
+		const TextureNormalVertex& v2 = vertices[indices[i + 2]];
+		DirectX::XMVECTOR e1 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&v1.pos), DirectX::XMLoadFloat3(&v0.pos));
+		DirectX::XMVECTOR e2 = DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&v2.pos), DirectX::XMLoadFloat3(&v0.pos));
+		float du1 = v1.textureUV.x - v0.textureUV.x, dv1 = v1.textureUV.y - v0.textureUV.y;
+		float du2 = v2.textureUV.x - v0.textureUV.x, dv2 = v2.textureUV.y - v0.textureUV.y;
+		float det = du1 * dv2 - du2 * dv1;
+		if (fabsf(det) < 1e-12f)
+			continue;
+		DirectX::XMVECTOR t = DirectX::XMVectorScale(
+			DirectX::XMVectorSubtract(DirectX::XMVectorScale(e1, dv2), DirectX::XMVectorScale(e2, dv1)), 1.0f / det);
+		DirectX::XMVECTOR up = DirectX::XMVectorScale(
+			DirectX::XMVectorSubtract(DirectX::XMVectorScale(e1, du2), DirectX::XMVectorScale(e2, du1)), 1.0f / det);
+		for (size_t k = 0; k < 3; k++)
+		{
+			size_t v = indices[i + k] - firstVertex;
+			DirectX::XMStoreFloat3(&tangents[v], DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&tangents[v]), t));
+			DirectX::XMStoreFloat3(&ups[v], DirectX::XMVectorAdd(DirectX::XMLoadFloat3(&ups[v]), up));
+		}
+	}
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		TextureNormalVertex& vertex = vertices[firstVertex + i];
+		DirectX::XMVECTOR n = DirectX::XMLoadFloat3(&vertex.normal);
+		DirectX::XMVECTOR t = DirectX::XMLoadFloat3(&tangents[i]);
+		// Gram-Schmidt, any perpendicular direction for vertices without usable UVs
+		t = DirectX::XMVectorSubtract(t, DirectX::XMVectorScale(n, DirectX::XMVectorGetX(DirectX::XMVector3Dot(n, t))));
+		if (DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(t)) < 1e-12f)
+		{
+			DirectX::XMVECTOR axis = fabsf(vertex.normal.x) < 0.9f ? DirectX::XMVectorSet(1, 0, 0, 0) : DirectX::XMVectorSet(0, 1, 0, 0);
+			t = DirectX::XMVector3Cross(axis, n);
+		}
+		t = DirectX::XMVector3Normalize(t);
+		// Mirrored UVs turn the texture up direction against cross(tang, normal)
+		float sign = DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVector3Cross(t, n), DirectX::XMLoadFloat3(&ups[i]))) < 0.0f
+			? -1.0f : 1.0f;
+		DirectX::XMStoreFloat4(&vertex.tang, DirectX::XMVectorSetW(t, sign));
+	}
+}
+
+bool ConvertIndices(const vector<UINT32>& indices, vector<USHORT>& outIndices)
+{
+	outIndices.resize(indices.size());
+	for (size_t i = 0; i < indices.size(); i++)
+	{
+		if (indices[i] > 0xFFFF)
+			return false;
+		outIndices[i] = USHORT(indices[i]);
+	}
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "GeometryData.h"
+
+struct MeshImportStats
+{
+	size_t fileBytes = 0;
+	size_t vertexCount = 0;
+	size_t triangleCount = 0;
+	double seconds = 0.0;
+
+	double GetMegabytesPerSecond() const { return seconds > 0.0 ? fileBytes / (1024.0 * 1024.0) / seconds : 0.0; }
+	double GetTrianglesPerSecond() const { return seconds > 0.0 ? triangleCount / seconds : 0.0; }
+};
+
+// Wavefront OBJ, text is split into line-aligned chunks parsed on separate threads (threadCount 0 - one per core)
+bool ImportOBJ(const wchar_t* fileName, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	MeshImportStats* pStats = nullptr, UINT threadCount = 0);
+bool ParseOBJ(const char* pText, size_t size, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	UINT threadCount = 0);
+
+// Binary glTF 2.0, all triangle primitives of all meshes are merged, node transforms are ignored
+bool ImportGLB(const wchar_t* fileName, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	MeshImportStats* pStats = nullptr);
+bool ParseGLB(const uint8_t* pData, size_t size, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices);
+
+// Chooses the importer by file extension
+bool ImportMesh(const wchar_t* fileName, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices,
+	MeshImportStats* pStats = nullptr);
+
+void ComputeNormals(vector<TextureNormalVertex>& vertices, const vector<UINT32>& indices);
+void ComputeTangents(vector<TextureNormalVertex>& vertices, const vector<UINT32>& indices);
+// Only the vertices [firstVertex, firstVertex + vertexCount) referenced by the triangles [firstIndex, firstIndex + indexCount)
+void ComputeTangents(vector<TextureNormalVertex>& vertices, const vector<UINT32>& indices,
+	size_t firstVertex, size_t vertexCount, size_t firstIndex, size_t indexCount);
+// Fails if the mesh does not fit into 16-bit indices of the geometry pools
+bool ConvertIndices(const vector<UINT32>& indices, vector<USHORT>& outIndices);
@@ -0,0 +1,414 @@
+#include "MeshSimplifier.h"
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace
+{
+	struct Quadric
+	{
+		float a00, a11, a22, a01, a02, a12;
+		float b0, b1, b2;
+		float c;
+		float weight;
+	};
+
+	void AddPlane(Quadric& q, const float n[3], float d, float weight)
+	{
+		q.a00 += weight * n[0] * n[0];
+		q.a11 += weight * n[1] * n[1];
+		q.a22 += weight * n[2] * n[2];
+		q.a01 += weight * n[0] * n[1];
+		q.a02 += weight * n[0] * n[2];
+		q.a12 += weight * n[1] * n[2];
+		q.b0 += weight * n[0] * d;
+		q.b1 += weight * n[1] * d;
+		q.b2 += weight * n[2] * d;
+		q.c += weight * d * d;
+		q.weight += weight;
+	}
+
+	void AddQuadric(Quadric& q, const Quadric& other)
+	{
+		q.a00 += other.a00;
+		q.a11 += other.a11;
+		q.a22 += other.a22;
+		q.a01 += other.a01;
+		q.a02 += other.a02;
+		q.a12 += other.a12;
+		q.b0 += other.b0;
+		q.b1 += other.b1;
+		q.b2 += other.b2;
+		q.c += other.c;
+		q.weight += other.weight;
+	}
+
+	// Area weighted mean of squared distances to the accumulated planes
+	float Evaluate(const Quadric& q, const float p[3])
+	{
+		float r = q.a00 * p[0] * p[0] + q.a11 * p[1] * p[1] + q.a22 * p[2] * p[2]
+			+ 2.0f * (q.a01 * p[0] * p[1] + q.a02 * p[0] * p[2] + q.a12 * p[1] * p[2])
+			+ 2.0f * (q.b0 * p[0] + q.b1 * p[1] + q.b2 * p[2]) + q.c;
+		return q.weight > 0.0f ? fabsf(r) / q.weight : 0.0f;
+	}
+
+	void Cross(const float a[3], const float b[3], const float c[3], float n[3])
+	{
+		float e0[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+		float e1[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+		n[0] = e0[1] * e1[2] - e0[2] * e1[1];
+		n[1] = e0[2] * e1[0] - e0[0] * e1[2];
+		n[2] = e0[0] * e1[1] - e0[1] * e1[0];
+	}
+
+	struct PositionKey
+	{
+		uint32_t x, y, z;
+		bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return size_t(key.x) * 73856093u ^ size_t(key.y) * 19349663u ^ size_t(key.z) * 83492791u;
+		}
+	};
+
+	class Simplifier
+	{
+	public:
+		Simplifier(const void* pVertices, UINT vertexStride, UINT vertexCount)
+			: m_pVertices(reinterpret_cast<const uint8_t*>(pVertices)), m_vertexStride(vertexStride), m_vertexCount(vertexCount)
+		{
+		}
+
+		const float* Position(UINT32 vertex) const
+		{
+			return reinterpret_cast<const float*>(m_pVertices + size_t(vertex) * m_vertexStride);
+		}
+
+		void Init(const vector<UINT32>& indices)
+		{
+			// Vertices sharing a position are wedges of one position, a position with several wedges is a seam
+			m_positionIds.resize(m_vertexCount);
+			vector<UINT32> wedgeCounts;
+			std::unordered_map<PositionKey, UINT32, PositionKeyHash> positions;
+			positions.reserve(m_vertexCount);
+			for (UINT32 i = 0; i < m_vertexCount; i++)
+			{
+				PositionKey key;
+				memcpy(&key, Position(i), sizeof(key));
+				auto it = positions.emplace(key, (UINT32)wedgeCounts.size()).first;
+				if (it->second == wedgeCounts.size())
+					wedgeCounts.push_back(0);
+				m_positionIds[i] = it->second;
+				wedgeCounts[it->second]++;
+			}
+
+			m_locked.assign(wedgeCounts.size(), 0);
+			for (size_t i = 0; i < wedgeCounts.size(); i++)
+				m_locked[i] = wedgeCounts[i] > 1 ? 1 : 0;
+
+			// Open borders and non-manifold edges are locked as well
+			std::unordered_map<uint64_t, UINT32> edgeCounts;
+			edgeCounts.reserve(indices.size());
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					UINT32 a = m_positionIds[indices[t + e]];
+					UINT32 b = m_positionIds[indices[t + (e + 1) % 3]];
+					if (a == b)
+						continue;
+					edgeCounts[uint64_t(min(a, b)) << 32 | max(a, b)]++;
+				}
+			}
+			for (const auto& edge : edgeCounts)
+			{
+				if (edge.second != 2)
+				{
+					m_locked[UINT32(edge.first >> 32)] = 1;
+					m_locked[UINT32(edge.first)] = 1;
+				}
+			}
+
+			m_quadrics.assign(wedgeCounts.size(), Quadric());
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				const float* p0 = Position(indices[t]);
+				float n[3];
+				Cross(p0, Position(indices[t + 1]), Position(indices[t + 2]), n);
+				float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+				if (length == 0.0f)
+					continue;
+				n[0] /= length;
+				n[1] /= length;
+				n[2] /= length;
+				float d = -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]);
+				for (int c = 0; c < 3; c++)
+					AddPlane(m_quadrics[m_positionIds[indices[t + c]]], n, d, length * 0.5f);
+			}
+		}
+
+		// One pass of independent collapses in cost order, returns the number of collapses
+		UINT Pass(vector<UINT32>& indices, size_t targetTriangleCount, float maxError, float& appliedError)
+		{
+			BuildAdjacency(indices);
+
+			vector<float> costs(m_vertexCount, FLT_MAX);
+			vector<UINT32> targets(m_vertexCount, UINT32(~0u));
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				for (int e = 0; e < 3; e++)
+				{
+					UINT32 a = indices[t + e];
+					UINT32 b = indices[t + (e + 1) % 3];
+					for (int dir = 0; dir < 2; dir++, std::swap(a, b))
+					{
+						if (m_locked[m_positionIds[a]])
+							continue;
+						const float* pb = Position(b);
+						float cost = Evaluate(m_quadrics[m_positionIds[a]], pb) + Evaluate(m_quadrics[m_positionIds[b]], pb);
+						if (cost < costs[a])
+						{
+							costs[a] = cost;
+							targets[a] = b;
+						}
+					}
+				}
+			}
+
+			vector<UINT32> order;
+			for (UINT32 v = 0; v < m_vertexCount; v++)
+			{
+				if (targets[v] != ~0u && costs[v] <= maxError)
+					order.push_back(v);
+			}
+			std::sort(order.begin(), order.end(), [&](UINT32 a, UINT32 b) { return costs[a] < costs[b]; });
+
+			size_t triangleCount = indices.size() / 3;
+			vector<char> touched(m_vertexCount, 0);
+			UINT collapses = 0;
+			for (UINT32 a : order)
+			{
+				if (triangleCount <= targetTriangleCount)
+					break;
+				UINT32 b = targets[a];
+				if (touched[a] || touched[b] || !CanCollapse(indices, a, b))
+					continue;
+
+				for (UINT32 i = m_adjacencyOffsets[a]; i < m_adjacencyOffsets[a + 1]; i++)
+				{
+					UINT32* pTri = &indices[m_adjacency[i] * 3];
+					bool hasB = pTri[0] == b || pTri[1] == b || pTri[2] == b;
+					for (int c = 0; c < 3; c++)
+					{
+						touched[pTri[c]] = 1;
+						if (pTri[c] == a)
+							pTri[c] = b;
+					}
+					if (hasB)
+						triangleCount--;
+				}
+				AddQuadric(m_quadrics[m_positionIds[b]], m_quadrics[m_positionIds[a]]);
+				appliedError = max(appliedError, costs[a]);
+				collapses++;
+			}
+
+			size_t write = 0;
+			for (size_t t = 0; t + 2 < indices.size(); t += 3)
+			{
+				UINT32 i0 = indices[t], i1 = indices[t + 1], i2 = indices[t + 2];
+				if (i0 == i1 || i1 == i2 || i0 == i2)
+					continue;
+				indices[write++] = i0;
+				indices[write++] = i1;
+				indices[write++] = i2;
+			}
+			indices.resize(write);
+			return collapses;
+		}
+
+	private:
+		void BuildAdjacency(const vector<UINT32>& indices)
+		{
+			m_adjacencyOffsets.assign(size_t(m_vertexCount) + 1, 0);
+			for (UINT32 index : indices)
+				m_adjacencyOffsets[index + 1]++;
+			for (UINT32 v = 0; v < m_vertexCount; v++)
+				m_adjacencyOffsets[v + 1] += m_adjacencyOffsets[v];
+
+			m_adjacency.resize(indices.size());
+			vector<UINT32> fill(m_adjacencyOffsets.begin(), m_adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); i++)
+				m_adjacency[fill[indices[i]]++] = UINT32(i / 3);
+		}
+
+		void GatherRing(const vector<UINT32>& indices, UINT32 vertex, vector<UINT32>& ring) const
+		{
+			ring.clear();
+			for (UINT32 i = m_adjacencyOffsets[vertex]; i < m_adjacencyOffsets[vertex + 1]; i++)
+			{
+				const UINT32* pTri = &indices[m_adjacency[i] * 3];
+				for (int c = 0; c < 3; c++)
+					ring.push_back(m_positionIds[pTri[c]]);
+			}
+			std::sort(ring.begin(), ring.end());
+			ring.erase(std::unique(ring.begin(), ring.end()), ring.end());
+		}
+
+		bool CanCollapse(const vector<UINT32>& indices, UINT32 a, UINT32 b)
+		{
+			// Link condition: an interior edge shares exactly two neighbours, more would pinch the surface
+			GatherRing(indices, a, m_ringA);
+			GatherRing(indices, b, m_ringB);
+			UINT32 pa = m_positionIds[a], pb = m_positionIds[b];
+			int shared = 0;
+			for (UINT32 p : m_ringA)
+			{
+				if (p != pa && p != pb && std::binary_search(m_ringB.begin(), m_ringB.end(), p))
+					shared++;
+			}
+			if (shared > 2)
+				return false;
+
+			// Reject collapses flipping any of the remaining triangles
+			for (UINT32 i = m_adjacencyOffsets[a]; i < m_adjacencyOffsets[a + 1]; i++)
+			{
+				const UINT32* pTri = &indices[m_adjacency[i] * 3];
+				if (pTri[0] == b || pTri[1] == b || pTri[2] == b)
+					continue;
+				const float* p[3];
+				const float* q[3];
+				for (int c = 0; c < 3; c++)
+				{
+					p[c] = Position(pTri[c]);
+					q[c] = Position(pTri[c] == a ? b : pTri[c]);
+				}
+				float n0[3], n1[3];
+				Cross(p[0], p[1], p[2], n0);
+				Cross(q[0], q[1], q[2], n1);
+				if (n0[0] * n1[0] + n0[1] * n1[1] + n0[2] * n1[2] <= 0.0f)
+					return false;
+			}
+			return true;
+		}
+
+		const uint8_t* m_pVertices;
+		UINT m_vertexStride;
+		UINT m_vertexCount;
+		vector<UINT32> m_positionIds;
+		vector<char> m_locked;
+		vector<Quadric> m_quadrics;
+		vector<UINT32> m_adjacencyOffsets;
+		vector<UINT32> m_adjacency;
+		vector<UINT32> m_ringA;
+		vector<UINT32> m_ringB;
+	};
+
+	float ComputeExtent(const void* pVertices, UINT vertexStride, UINT vertexCount)
+	{
+		float minVec[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+		float maxVec[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		const uint8_t* pVertex = reinterpret_cast<const uint8_t*>(pVertices);
+		for (UINT i = 0; i < vertexCount; i++, pVertex += vertexStride)
+		{
+			const float* pPos = reinterpret_cast<const float*>(pVertex);
+			for (int c = 0; c < 3; c++)
+			{
+				minVec[c] = min(minVec[c], pPos[c]);
+				maxVec[c] = max(maxVec[c], pPos[c]);
+			}
+		}
+		return vertexCount > 0 ? max(maxVec[0] - minVec[0], max(maxVec[1] - minVec[1], maxVec[2] - minVec[2])) : 0.0f;
+	}
+}
+
+bool SimplifyMesh(const void* pVertices, UINT vertexStride, UINT vertexCount, const vector<UINT32>& indices,
+	const MeshSimplifyOptions& options, vector<UINT32>& outIndices, MeshSimplifyStats* pStats)
+{
+	if (pVertices == nullptr || vertexStride < sizeof(float) * 3 || indices.size() % 3 != 0)
+		return false;
+	for (UINT32 index : indices)
+	{
+		if (index >= vertexCount)
+			return false;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	float extent = ComputeExtent(pVertices, vertexStride, vertexCount);
+	float maxError = FLT_MAX;
+	if (options.targetError > 0.0f)
+		maxError = options.targetError * extent * options.targetError * extent;
+
+	outIndices = indices;
+	size_t targetTriangleCount = options.targetIndexCount / 3;
+	float appliedError = 0.0f;
+	if (outIndices.size() / 3 > targetTriangleCount)
+	{
+		Simplifier simplifier(pVertices, vertexStride, vertexCount);
+		simplifier.Init(outIndices);
+		while (outIndices.size() / 3 > targetTriangleCount)
+		{
+			if (simplifier.Pass(outIndices, targetTriangleCount, maxError, appliedError) == 0)
+				break;
+		}
+	}
+
+	if (pStats != nullptr)
+	{
+		pStats->sourceTriangleCount = indices.size() / 3;
+		pStats->resultTriangleCount = outIndices.size() / 3;
+		pStats->error = sqrtf(appliedError);
+		pStats->relativeError = extent > 0.0f ? pStats->error / extent : 0.0f;
+		pStats->seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+	return true;
+}
+
+bool BuildMeshLods(const void* pVertices, UINT vertexStride, UINT vertexCount, const vector<UINT32>& indices,
+	UINT lodCount, float triangleRatio, float targetError, vector<UINT32>& outIndices, vector<CookedMeshLod>& outLods,
+	MeshSimplifyStats* pStats)
+{
+	outIndices = indices;
+	outLods.assign(1, { 0, (uint32_t)indices.size(), 0.0f, 0 });
+
+	MeshSimplifyStats total;
+	total.sourceTriangleCount = indices.size() / 3;
+	total.resultTriangleCount = indices.size() / 3;
+
+	// Every LOD is simplified from the previous one, so the errors add up
+	vector<UINT32> lodIndices = indices;
+	float error = 0.0f;
+	for (UINT lod = 1; lod < lodCount; lod++)
+	{
+		MeshSimplifyOptions options;
+		options.targetIndexCount = UINT(lodIndices.size() / 3 * triangleRatio) * 3;
+		options.targetError = targetError;
+
+		vector<UINT32> simplified;
+		MeshSimplifyStats stats;
+		if (!SimplifyMesh(pVertices, vertexStride, vertexCount, lodIndices, options, simplified, &stats))
+			return false;
+		if (simplified.size() == lodIndices.size() || simplified.empty())
+			break;
+
+		error += stats.error;
+		total.error = error;
+		total.relativeError += stats.relativeError;
+		total.resultTriangleCount = stats.resultTriangleCount;
+		total.seconds += stats.seconds;
+
+		outLods.push_back({ (uint32_t)outIndices.size(), (uint32_t)simplified.size(), error, 0 });
+		outIndices.insert(outIndices.end(), simplified.begin(), simplified.end());
+		lodIndices.swap(simplified);
+	}
+
+	if (pStats != nullptr)
+		*pStats = total;
+	return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include "CookedMesh.h"
+
+struct MeshSimplifyOptions
+{
+	UINT targetIndexCount = 0;
+	// Maximum geometric error relative to the largest mesh extent, 0 - no limit
+	float targetError = 0.0f;
+};
+
+struct MeshSimplifyStats
+{
+	size_t sourceTriangleCount = 0;
+	size_t resultTriangleCount = 0;
+	float error = 0.0f; // in mesh units
+	float relativeError = 0.0f;
+	double seconds = 0.0;
+
+	double GetTrianglesPerSecond() const { return seconds > 0.0 ? sourceTriangleCount / seconds : 0.0; }
+};
+
+// Quadric error metric simplifier with half-edge collapses, so surviving vertices keep their UVs and normals.
+// Vertices with equal positions but different attributes (seams) and open borders are never collapsed.
+// The result indexes the source vertex buffer, positions are read from the first three floats of each vertex.
+bool SimplifyMesh(const void* pVertices, UINT vertexStride, UINT vertexCount, const vector<UINT32>& indices,
+	const MeshSimplifyOptions& options, vector<UINT32>& outIndices, MeshSimplifyStats* pStats = nullptr);
+
+// Appends lodCount LODs to one index buffer, every LOD keeps triangleRatio of the previous one.
+// The ranges go to CookedMeshDesc::lods or straight to GeometryData::firstIndex/indexCount.
+bool BuildMeshLods(const void* pVertices, UINT vertexStride, UINT vertexCount, const vector<UINT32>& indices,
+	UINT lodCount, float triangleRatio, float targetError, vector<UINT32>& outIndices, vector<CookedMeshLod>& outLods,
+	MeshSimplifyStats* pStats = nullptr);
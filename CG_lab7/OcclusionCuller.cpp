@@ -0,0 +1,455 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <immintrin.h>
+
+namespace
+{
+	// Depth of a working layer that covers nothing yet
+	const float EmptyDepth = FLT_MAX;
+	const uint32_t FullMask = 0xFFFFFFFFu;
+	const float MinClipW = 1e-5f;
+	// Below this many triangles the workers are not woken
+	const size_t MinParallelTriangles = 256;
+
+	void MultiplyMatrices(const float* pA, const float* pB, float* pOut)
+	{
+		for (int r = 0; r < 4; r++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				pOut[r * 4 + c] = pA[r * 4] * pB[c] + pA[r * 4 + 1] * pB[4 + c] + pA[r * 4 + 2] * pB[8 + c] +
+					pA[r * 4 + 3] * pB[12 + c];
+			}
+		}
+	}
+
+	float HorizontalMin(__m128 v)
+	{
+		v = _mm_min_ps(v, _mm_movehl_ps(v, v));
+		return _mm_cvtss_f32(_mm_min_ss(v, _mm_shuffle_ps(v, v, 1)));
+	}
+
+	float HorizontalMax(__m128 v)
+	{
+		v = _mm_max_ps(v, _mm_movehl_ps(v, v));
+		return _mm_cvtss_f32(_mm_max_ss(v, _mm_shuffle_ps(v, v, 1)));
+	}
+
+	// Screen rectangle (min x, min y, max x, max y in pixels) and nearest depth of the 8 box corners,
+	// false when a corner is behind the camera or in front of the near plane
+	bool ProjectBox(const float* pMatrix, const float minVec[3], const float maxVec[3], float width, float height,
+		float rect[4], float& nearestDepth)
+	{
+#if defined(__AVX2__)
+		const __m256 x = _mm256_setr_ps(minVec[0], maxVec[0], minVec[0], maxVec[0], minVec[0], maxVec[0], minVec[0], maxVec[0]);
+		const __m256 y = _mm256_setr_ps(minVec[1], minVec[1], maxVec[1], maxVec[1], minVec[1], minVec[1], maxVec[1], maxVec[1]);
+		const __m256 z = _mm256_setr_ps(minVec[2], minVec[2], minVec[2], minVec[2], maxVec[2], maxVec[2], maxVec[2], maxVec[2]);
+		__m256 clip[4];
+		for (int c = 0; c < 4; c++)
+		{
+			clip[c] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(pMatrix[c])), _mm256_mul_ps(y, _mm256_set1_ps(pMatrix[4 + c]))),
+				_mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(pMatrix[8 + c])), _mm256_set1_ps(pMatrix[12 + c])));
+		}
+		const __m256 nearMask = _mm256_or_ps(_mm256_cmp_ps(clip[3], _mm256_set1_ps(MinClipW), _CMP_LE_OQ),
+			_mm256_cmp_ps(clip[2], clip[3], _CMP_GT_OQ));
+		if (_mm256_movemask_ps(nearMask) != 0)
+			return false;
+		const __m256 invW = _mm256_div_ps(_mm256_set1_ps(1.0f), clip[3]);
+		const __m256 ndcX = _mm256_mul_ps(clip[0], invW);
+		const __m256 ndcY = _mm256_mul_ps(clip[1], invW);
+		const __m256 depth = _mm256_mul_ps(clip[2], invW);
+		const __m128 minX = _mm_min_ps(_mm256_castps256_ps128(ndcX), _mm256_extractf128_ps(ndcX, 1));
+		const __m128 maxX = _mm_max_ps(_mm256_castps256_ps128(ndcX), _mm256_extractf128_ps(ndcX, 1));
+		const __m128 minY = _mm_min_ps(_mm256_castps256_ps128(ndcY), _mm256_extractf128_ps(ndcY, 1));
+		const __m128 maxY = _mm_max_ps(_mm256_castps256_ps128(ndcY), _mm256_extractf128_ps(ndcY, 1));
+		const __m128 maxDepth = _mm_max_ps(_mm256_castps256_ps128(depth), _mm256_extractf128_ps(depth, 1));
+#else
+		const __m128 x = _mm_setr_ps(minVec[0], maxVec[0], minVec[0], maxVec[0]);
+		const __m128 y = _mm_setr_ps(minVec[1], minVec[1], maxVec[1], maxVec[1]);
+		__m128 ndc[2][2];
+		__m128 depth[2];
+		for (int half = 0; half < 2; half++)
+		{
+			const __m128 z = _mm_set1_ps(half == 0 ? minVec[2] : maxVec[2]);
+			__m128 clip[4];
+			for (int c = 0; c < 4; c++)
+			{
+				clip[c] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(pMatrix[c])), _mm_mul_ps(y, _mm_set1_ps(pMatrix[4 + c]))),
+					_mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(pMatrix[8 + c])), _mm_set1_ps(pMatrix[12 + c])));
+			}
+			const __m128 nearMask = _mm_or_ps(_mm_cmple_ps(clip[3], _mm_set1_ps(MinClipW)), _mm_cmpgt_ps(clip[2], clip[3]));
+			if (_mm_movemask_ps(nearMask) != 0)
+				return false;
+			const __m128 invW = _mm_div_ps(_mm_set1_ps(1.0f), clip[3]);
+			ndc[half][0] = _mm_mul_ps(clip[0], invW);
+			ndc[half][1] = _mm_mul_ps(clip[1], invW);
+			depth[half] = _mm_mul_ps(clip[2], invW);
+		}
+		const __m128 minX = _mm_min_ps(ndc[0][0], ndc[1][0]);
+		const __m128 maxX = _mm_max_ps(ndc[0][0], ndc[1][0]);
+		const __m128 minY = _mm_min_ps(ndc[0][1], ndc[1][1]);
+		const __m128 maxY = _mm_max_ps(ndc[0][1], ndc[1][1]);
+		const __m128 maxDepth = _mm_max_ps(depth[0], depth[1]);
+#endif
+		// Screen y grows downwards
+		const __m128 ndcRect = _mm_setr_ps(HorizontalMin(minX), -HorizontalMax(maxY), HorizontalMax(maxX), -HorizontalMin(minY));
+		const __m128 halfSize = _mm_setr_ps(width * 0.5f, height * 0.5f, width * 0.5f, height * 0.5f);
+		_mm_storeu_ps(rect, _mm_add_ps(_mm_mul_ps(ndcRect, halfSize), halfSize));
+		nearestDepth = HorizontalMax(maxDepth);
+		return true;
+	}
+
+	// Coverage of the 8x4 pixel tile, bit row * 8 + column is set for the pixel centers inside the triangle
+	uint32_t TileCoverage(const float edges[3][3], float tileX, float tileY)
+	{
+		uint32_t mask = 0;
+#if defined(__AVX2__)
+		const __m256 laneX = _mm256_add_ps(_mm256_set1_ps(tileX + 0.5f), _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f));
+		__m256 rowValues[3];
+		__m256 rowSteps[3];
+		for (int e = 0; e < 3; e++)
+		{
+			rowValues[e] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edges[e][0]), laneX),
+				_mm256_set1_ps(edges[e][1] * (tileY + 0.5f) + edges[e][2]));
+			rowSteps[e] = _mm256_set1_ps(edges[e][1]);
+		}
+		const __m256 zero = _mm256_setzero_ps();
+		for (uint32_t row = 0; row < OcclusionCuller::TileHeight; row++)
+		{
+			const __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(rowValues[0], zero, _CMP_GT_OQ),
+				_mm256_cmp_ps(rowValues[1], zero, _CMP_GT_OQ)), _mm256_cmp_ps(rowValues[2], zero, _CMP_GT_OQ));
+			mask |= uint32_t(_mm256_movemask_ps(inside)) << (row * 8);
+			for (int e = 0; e < 3; e++)
+				rowValues[e] = _mm256_add_ps(rowValues[e], rowSteps[e]);
+		}
+#else
+		const __m128 laneX = _mm_add_ps(_mm_set1_ps(tileX + 0.5f), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+		__m128 rowValues[3];
+		__m128 columnSteps[3];
+		__m128 rowSteps[3];
+		for (int e = 0; e < 3; e++)
+		{
+			rowValues[e] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(edges[e][0]), laneX), _mm_set1_ps(edges[e][1] * (tileY + 0.5f) + edges[e][2]));
+			columnSteps[e] = _mm_set1_ps(edges[e][0] * 4.0f);
+			rowSteps[e] = _mm_set1_ps(edges[e][1]);
+		}
+		const __m128 zero = _mm_setzero_ps();
+		for (uint32_t row = 0; row < OcclusionCuller::TileHeight; row++)
+		{
+			for (uint32_t half = 0; half < 2; half++)
+			{
+				const __m128 value0 = half == 0 ? rowValues[0] : _mm_add_ps(rowValues[0], columnSteps[0]);
+				const __m128 value1 = half == 0 ? rowValues[1] : _mm_add_ps(rowValues[1], columnSteps[1]);
+				const __m128 value2 = half == 0 ? rowValues[2] : _mm_add_ps(rowValues[2], columnSteps[2]);
+				const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(value0, zero), _mm_cmpgt_ps(value1, zero)),
+					_mm_cmpgt_ps(value2, zero));
+				mask |= uint32_t(_mm_movemask_ps(inside)) << (row * 8 + half * 4);
+			}
+			for (int e = 0; e < 3; e++)
+				rowValues[e] = _mm_add_ps(rowValues[e], rowSteps[e]);
+		}
+#endif
+		return mask;
+	}
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	Term();
+}
+
+void OcclusionCuller::Init(uint32_t width, uint32_t height, uint32_t threadCount)
+{
+	Term();
+	m_tilesX = std::max(1u, (width + TileWidth - 1) / TileWidth);
+	m_tilesY = std::max(1u, (height + TileHeight - 1) / TileHeight);
+	m_coarseX = (m_tilesX + CoarseSize - 1) / CoarseSize;
+	m_coarseY = (m_tilesY + CoarseSize - 1) / CoarseSize;
+	m_tileDepth.assign(size_t(m_tilesX) * m_tilesY, 0.0f);
+	m_workingDepth.assign(m_tileDepth.size(), EmptyDepth);
+	m_workingMask.assign(m_tileDepth.size(), 0);
+	m_coarseDepth.assign(size_t(m_coarseX) * m_coarseY, 0.0f);
+
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	m_stop = false;
+	m_generation = 0;
+	for (uint32_t i = 1; i < threadCount; i++)
+		m_workers.emplace_back(&OcclusionCuller::WorkerLoop, this);
+}
+
+void OcclusionCuller::Term()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+void OcclusionCuller::WorkerLoop()
+{
+	uint64_t seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&]() { return m_stop || m_generation != seenGeneration; });
+			if (m_stop)
+				return;
+			seenGeneration = m_generation;
+		}
+		RunJobs();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (++m_finishedWorkers == m_workers.size())
+				m_doneCondition.notify_one();
+		}
+	}
+}
+
+void OcclusionCuller::RunJobs()
+{
+	for (uint32_t band = m_nextBand++; band < m_coarseY; band = m_nextBand++)
+		RasterizeBand(band);
+}
+
+void OcclusionCuller::BeginFrame(const float* pViewProjection)
+{
+	std::copy(pViewProjection, pViewProjection + 16, m_viewProjection);
+	std::fill(m_tileDepth.begin(), m_tileDepth.end(), 0.0f);
+	std::fill(m_workingDepth.begin(), m_workingDepth.end(), EmptyDepth);
+	std::fill(m_workingMask.begin(), m_workingMask.end(), 0u);
+	m_triangles.clear();
+	m_stats = {};
+}
+
+void OcclusionCuller::AddOccluder(const OccluderMesh& mesh, const float* pModel)
+{
+	float matrix[16];
+	MultiplyMatrices(pModel, m_viewProjection, matrix);
+
+	const size_t vertexCount = mesh.positions.size() / 3;
+	m_clipVertices.resize(vertexCount * 4);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		const float* pPos = &mesh.positions[i * 3];
+		for (int c = 0; c < 4; c++)
+			m_clipVertices[i * 4 + c] = pPos[0] * matrix[c] + pPos[1] * matrix[4 + c] + pPos[2] * matrix[8 + c] + matrix[12 + c];
+	}
+
+	const float width = float(GetWidth());
+	const float height = float(GetHeight());
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		float x[3], y[3], z[3];
+		bool clipped = false;
+		for (int v = 0; v < 3; v++)
+		{
+			const float* pClip = &m_clipVertices[size_t(mesh.indices[i + v]) * 4];
+			if (pClip[3] <= MinClipW || pClip[2] > pClip[3] || pClip[2] < 0.0f)
+			{
+				clipped = true;
+				break;
+			}
+			const float invW = 1.0f / pClip[3];
+			x[v] = (pClip[0] * invW * 0.5f + 0.5f) * width;
+			y[v] = (0.5f - pClip[1] * invW * 0.5f) * height;
+			z[v] = pClip[2] * invW;
+		}
+		if (clipped)
+			continue;
+
+		float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+		if (fabsf(area) < 1e-6f)
+			continue;
+		if (area < 0.0f)
+		{
+			std::swap(x[1], x[2]);
+			std::swap(y[1], y[2]);
+			std::swap(z[1], z[2]);
+			area = -area;
+		}
+
+		const float minX = std::min(x[0], std::min(x[1], x[2]));
+		const float maxX = std::max(x[0], std::max(x[1], x[2]));
+		const float minY = std::min(y[0], std::min(y[1], y[2]));
+		const float maxY = std::max(y[0], std::max(y[1], y[2]));
+		if (maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+			continue;
+
+		Triangle triangle;
+		for (int e = 0; e < 3; e++)
+		{
+			const int a = e;
+			const int b = (e + 1) % 3;
+			triangle.edges[e][0] = y[a] - y[b];
+			triangle.edges[e][1] = x[b] - x[a];
+			triangle.edges[e][2] = x[a] * y[b] - y[a] * x[b];
+		}
+		triangle.depthPlane[0] = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+		triangle.depthPlane[1] = ((x[1] - x[0]) * (z[2] - z[0]) - (x[2] - x[0]) * (z[1] - z[0])) / area;
+		triangle.depthPlane[2] = z[0] - triangle.depthPlane[0] * x[0] - triangle.depthPlane[1] * y[0];
+		triangle.farthestDepth = std::min(z[0], std::min(z[1], z[2]));
+		triangle.tileMinX = uint32_t(std::max(minX, 0.0f)) / TileWidth;
+		triangle.tileMinY = uint32_t(std::max(minY, 0.0f)) / TileHeight;
+		triangle.tileMaxX = uint32_t(std::min(maxX, width - 1.0f)) / TileWidth;
+		triangle.tileMaxY = uint32_t(std::min(maxY, height - 1.0f)) / TileHeight;
+		m_triangles.push_back(triangle);
+	}
+	m_stats.occluderTriangles = uint32_t(m_triangles.size());
+}
+
+void OcclusionCuller::UpdateTile(size_t tile, uint32_t mask, float depth)
+{
+	// Reverse-Z form of the paper's merge: the working layer is dropped when the new triangle is farther
+	// from it than it is from the reference layer
+	float& workingDepth = m_workingDepth[tile];
+	uint32_t& workingMask = m_workingMask[tile];
+	if (depth - workingDepth > workingDepth - m_tileDepth[tile])
+	{
+		workingDepth = EmptyDepth;
+		workingMask = 0;
+	}
+	workingDepth = std::min(workingDepth, depth);
+	workingMask |= mask;
+	if (workingMask == FullMask)
+	{
+		m_tileDepth[tile] = std::max(m_tileDepth[tile], workingDepth);
+		workingDepth = EmptyDepth;
+		workingMask = 0;
+	}
+}
+
+void OcclusionCuller::RasterizeBand(uint32_t band)
+{
+	const uint32_t firstRow = band * CoarseSize;
+	const uint32_t endRow = std::min(firstRow + CoarseSize, m_tilesY);
+	for (const Triangle& triangle : m_triangles)
+	{
+		if (triangle.tileMaxY < firstRow || triangle.tileMinY >= endRow)
+			continue;
+		const uint32_t rowBegin = std::max(triangle.tileMinY, firstRow);
+		const uint32_t rowEnd = std::min(triangle.tileMaxY + 1, endRow);
+		for (uint32_t tileY = rowBegin; tileY < rowEnd; tileY++)
+		{
+			const float top = float(tileY * TileHeight);
+			// The plane is linear, its farthest point over the tile is one of the corners
+			const float rowDepth = triangle.depthPlane[1] * (triangle.depthPlane[1] < 0.0f ? top + TileHeight : top) + triangle.depthPlane[2];
+			for (uint32_t tileX = triangle.tileMinX; tileX <= triangle.tileMaxX; tileX++)
+			{
+				const float left = float(tileX * TileWidth);
+				const uint32_t mask = TileCoverage(triangle.edges, left, top);
+				if (mask == 0)
+					continue;
+				const float cornerDepth = triangle.depthPlane[0] * (triangle.depthPlane[0] < 0.0f ? left + TileWidth : left) + rowDepth;
+				UpdateTile(size_t(tileY) * m_tilesX + tileX, mask, std::max(cornerDepth, triangle.farthestDepth));
+			}
+		}
+	}
+
+	for (uint32_t coarseX = 0; coarseX < m_coarseX; coarseX++)
+	{
+		const uint32_t endColumn = std::min((coarseX + 1) * CoarseSize, m_tilesX);
+		float farthest = FLT_MAX;
+		for (uint32_t tileY = firstRow; tileY < endRow; tileY++)
+		{
+			for (uint32_t tileX = coarseX * CoarseSize; tileX < endColumn; tileX++)
+				farthest = std::min(farthest, m_tileDepth[size_t(tileY) * m_tilesX + tileX]);
+		}
+		m_coarseDepth[size_t(band) * m_coarseX + coarseX] = farthest;
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	m_nextBand = 0;
+	if (m_workers.empty() || m_triangles.size() < MinParallelTriangles)
+	{
+		RunJobs();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_finishedWorkers = 0;
+		m_generation++;
+	}
+	m_wakeCondition.notify_all();
+	RunJobs();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [&]() { return m_finishedWorkers == m_workers.size(); });
+}
+
+bool OcclusionCuller::IsOccluded(const float minVec[3], const float maxVec[3]) const
+{
+	float rect[4];
+	float nearestDepth;
+	const float width = float(GetWidth());
+	const float height = float(GetHeight());
+	if (!ProjectBox(m_viewProjection, minVec, maxVec, width, height, rect, nearestDepth))
+		return false;
+	if (rect[2] < 0.0f || rect[3] < 0.0f || rect[0] >= width || rect[1] >= height)
+		return false;
+
+	const uint32_t tileMinX = uint32_t(std::max(rect[0], 0.0f)) / TileWidth;
+	const uint32_t tileMinY = uint32_t(std::max(rect[1], 0.0f)) / TileHeight;
+	const uint32_t tileMaxX = uint32_t(std::min(rect[2], width - 1.0f)) / TileWidth;
+	const uint32_t tileMaxY = uint32_t(std::min(rect[3], height - 1.0f)) / TileHeight;
+
+	// Strictly farther than every reference depth, equal depth passes GREATER_EQUAL on the GPU
+	bool coarseOccluded = true;
+	for (uint32_t coarseY = tileMinY / CoarseSize; coarseY <= tileMaxY / CoarseSize && coarseOccluded; coarseY++)
+	{
+		for (uint32_t coarseX = tileMinX / CoarseSize; coarseX <= tileMaxX / CoarseSize; coarseX++)
+		{
+			if (!(nearestDepth < m_coarseDepth[size_t(coarseY) * m_coarseX + coarseX]))
+			{
+				coarseOccluded = false;
+				break;
+			}
+		}
+	}
+	if (coarseOccluded)
+		return true;
+
+	const __m128 nearest = _mm_set1_ps(nearestDepth);
+	for (uint32_t tileY = tileMinY; tileY <= tileMaxY; tileY++)
+	{
+		const float* pRow = &m_tileDepth[size_t(tileY) * m_tilesX];
+		uint32_t tileX = tileMinX;
+		for (; tileX + 4 <= tileMaxX + 1; tileX += 4)
+		{
+			if (_mm_movemask_ps(_mm_cmpge_ps(nearest, _mm_loadu_ps(pRow + tileX))) != 0)
+				return false;
+		}
+		for (; tileX <= tileMaxX; tileX++)
+		{
+			if (!(nearestDepth < pRow[tileX]))
+				return false;
+		}
+	}
+	return true;
+}
+
+uint32_t OcclusionCuller::CullOccluded(const BVHInput& bounds, uint32_t* pIds, uint32_t count)
+{
+	uint32_t visibleCount = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const uint32_t id = pIds[i];
+		assert(id < bounds.count);
+		const float minVec[3] = { bounds.pMin[0][id], bounds.pMin[1][id], bounds.pMin[2][id] };
+		const float maxVec[3] = { bounds.pMax[0][id], bounds.pMax[1][id], bounds.pMax[2][id] };
+		pIds[visibleCount] = id;
+		visibleCount += IsOccluded(minVec, maxVec) ? 0 : 1;
+	}
+	m_stats.testedBoxes += count;
+	m_stats.occludedBoxes += count - visibleCount;
+	return visibleCount;
+}
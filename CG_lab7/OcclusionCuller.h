@@ -0,0 +1,101 @@
+#pragma once
+#include "InstanceBVH.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Occluder geometry kept on the CPU, xyz positions and a triangle list
+struct OccluderMesh
+{
+	std::vector<float> positions;
+	std::vector<uint16_t> indices;
+};
+
+struct OcclusionStats
+{
+	uint32_t occluderTriangles = 0; // set up for rasterization, after near/far plane and screen rejection
+	uint32_t testedBoxes = 0;
+	uint32_t occludedBoxes = 0;
+};
+
+// CPU occlusion culling against a low resolution masked depth buffer (Andersson et al., Masked Software Occlusion
+// Culling). Kept free of Windows and D3D headers. Depth is reverse-Z like the main pass, which draws with
+// D3D11_COMPARISON_GREATER_EQUAL: larger is nearer, 0 is the far plane.
+// Every 8x4 pixel tile keeps a reference depth that all of its pixels are nearer than, and a working layer with
+// a coverage mask that replaces the reference once it covers the whole tile. Coarse cells of 4x4 tiles keep the
+// farthest reference depth of their tiles, most occluded boxes are accepted there without visiting the tiles.
+class OcclusionCuller
+{
+public:
+	static const uint32_t TileWidth = 8;
+	static const uint32_t TileHeight = 4;
+	static const uint32_t CoarseSize = 4; // tiles per coarse cell side
+
+	~OcclusionCuller();
+
+	// The size is rounded up to whole tiles. threadCount includes the calling thread, 0 - one per core
+	void Init(uint32_t width, uint32_t height, uint32_t threadCount = 0);
+	void Term();
+
+	// Matrices are 16 floats with row vectors, the DirectXMath layout
+	void BeginFrame(const float* pViewProjection);
+	// Triangles are two sided. The ones reaching in front of the near plane or behind the far plane are skipped,
+	// the GPU clips them so they cannot be trusted to hide anything.
+	void AddOccluder(const OccluderMesh& mesh, const float* pModel);
+	// Rasterizes the added occluders in bands of tile rows on the worker threads. Every tile belongs to one band
+	// and sees the triangles in submission order, so the result does not depend on the thread count.
+	void Rasterize();
+
+	// Boxes reaching in front of the near plane or off the screen are never occluded
+	bool IsOccluded(const float minVec[3], const float maxVec[3]) const;
+	// Removes the occluded boxes from the id list keeping the order, returns the new count
+	uint32_t CullOccluded(const BVHInput& bounds, uint32_t* pIds, uint32_t count);
+
+	uint32_t GetWidth() const { return m_tilesX * TileWidth; }
+	uint32_t GetHeight() const { return m_tilesY * TileHeight; }
+	uint32_t GetTilesX() const { return m_tilesX; }
+	uint32_t GetTilesY() const { return m_tilesY; }
+	// Reference depth of the tile, 0 where it is not fully covered
+	float GetTileDepth(uint32_t tileX, uint32_t tileY) const { return m_tileDepth[tileY * m_tilesX + tileX]; }
+	uint32_t GetThreadCount() const { return uint32_t(m_workers.size()) + 1; }
+	const OcclusionStats& GetStats() const { return m_stats; }
+
+private:
+	struct Triangle
+	{
+		float edges[3][3]; // a, b, c of a * x + b * y + c, positive inside
+		float depthPlane[3]; // depth = a * x + b * y + c
+		float farthestDepth; // smallest vertex depth
+		uint32_t tileMinX, tileMinY, tileMaxX, tileMaxY; // inclusive
+	};
+
+	void WorkerLoop();
+	void RunJobs();
+	void RasterizeBand(uint32_t band);
+	void UpdateTile(size_t tile, uint32_t mask, float depth);
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	uint64_t m_generation = 0;
+	size_t m_finishedWorkers = 0;
+	bool m_stop = false;
+	std::atomic<uint32_t> m_nextBand{ 0 };
+
+	uint32_t m_tilesX = 0;
+	uint32_t m_tilesY = 0;
+	uint32_t m_coarseX = 0;
+	uint32_t m_coarseY = 0;
+	float m_viewProjection[16] = {};
+	std::vector<float> m_tileDepth; // reference layer
+	std::vector<float> m_workingDepth;
+	std::vector<uint32_t> m_workingMask;
+	std::vector<float> m_coarseDepth;
+	std::vector<float> m_clipVertices;
+	std::vector<Triangle> m_triangles;
+	OcclusionStats m_stats;
+};
@@ -0,0 +1,329 @@
+#include "ParallelCuller.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace
+{
+	// Linear buffers using the plain kernel run the coherent one this often to refresh the hit rate
+	const UINT ProbeInterval = 16;
+}
+
+ParallelCuller::~ParallelCuller()
+{
+	Term();
+}
+
+void ParallelCuller::Init(UINT threadCount)
+{
+	Term();
+	if (threadCount == 0)
+		threadCount = max(1u, std::thread::hardware_concurrency());
+	m_stop = false;
+	m_generation = 0;
+	m_hasLastFrustum = false;
+	for (UINT i = 1; i < threadCount; i++)
+		m_workers.emplace_back(&ParallelCuller::WorkerLoop, this);
+}
+
+void ParallelCuller::Term()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wakeCondition.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+}
+
+void ParallelCuller::WorkerLoop()
+{
+	UINT64 seenGeneration = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [&]() { return m_stop || m_generation != seenGeneration; });
+			if (m_stop)
+				return;
+			seenGeneration = m_generation;
+		}
+		RunJobs();
+		{
+			// Every worker reports back each generation, so the job list is not touched after Cull returns
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (++m_finishedWorkers == m_workers.size())
+				m_doneCondition.notify_one();
+		}
+	}
+}
+
+void ParallelCuller::RunJobs()
+{
+	for (size_t i = m_nextJob++; i < m_dirtyJobs.size(); i = m_nextJob++)
+		RunJob(m_dirtyJobs[i]);
+}
+
+void ParallelCuller::RunJob(size_t jobIndex)
+{
+	const Job& job = m_jobs[jobIndex];
+	const ObjectBuffer& buffer = (*m_pBuffers)[job.buffer];
+	BufferState& state = m_bufferStates[job.buffer];
+	std::vector<UINT32>& visible = m_jobVisible[jobIndex];
+	BVHCullCounters& counters = m_jobCounters[jobIndex];
+	counters = {};
+	visible.clear();
+	if (job.useIds)
+	{
+		const UINT32* pCandidates = m_candidates[job.buffer]->data();
+		visible.assign(pCandidates + job.first, pCandidates + job.end);
+		visible.resize(CullAABBIds(*m_pFrustum, buffer.bounds, visible.data(), job.end - job.first));
+		counters.testedItems = job.end - job.first;
+	}
+	else if (job.useBVH)
+	{
+		buffer.bvh.CullSubtree(buffer.GetBVHInput(), &m_pFrustum->planes[0].x, job.first, visible,
+			state.failedPlanes.data(), &counters);
+	}
+	else
+	{
+		visible.resize(job.end - job.first);
+		UINT visibleCount = 0;
+		if (state.coherent)
+		{
+			UINT planeHits = 0;
+			visibleCount = CullAABBRangeCoherent(*m_pFrustum, buffer.bounds, job.first, job.end, state.failedPlanes.data(),
+				visible.data(), &planeHits);
+			counters.planeHits = planeHits;
+		}
+		else
+		{
+			visibleCount = CullAABBRange(*m_pFrustum, buffer.bounds, job.first, job.end, visible.data());
+		}
+		visible.resize(visibleCount);
+		counters.testedItems = job.end - job.first;
+	}
+
+	const UINT aabbVisibleCount = UINT(visible.size());
+	if (buffer.volumes.GetCount() == buffer.bounds.GetCount())
+		visible.resize(CullBoundingVolumes(*m_pFrustum, buffer.volumes, visible.data(), aabbVisibleCount));
+	m_jobVolumeCulled[jobIndex] = aabbVisibleCount - UINT(visible.size());
+
+	const UINT frustumVisibleCount = UINT(visible.size());
+	visible.resize(CullSmallAABBs(m_contribution, buffer.bounds, visible.data(), frustumVisibleCount));
+	m_jobContributionCulled[jobIndex] = frustumVisibleCount - UINT(visible.size());
+}
+
+void ParallelCuller::CreateJobs(const std::vector<ObjectBuffer>& buffers)
+{
+	m_prevJobs.swap(m_jobs);
+	m_jobs.clear();
+	m_bufferStates.resize(buffers.size());
+	for (UINT i = 0; i < buffers.size(); i++)
+	{
+		const ObjectBuffer& buffer = buffers[i];
+		BufferState& state = m_bufferStates[i];
+		const UINT count = UINT(buffer.bounds.GetCount());
+		state.failedPlanes.resize(count);
+		state.firstJob = m_jobs.size();
+		const std::vector<UINT32>* pCandidates = i < m_candidates.size() ? m_candidates[i] : nullptr;
+		state.candidatesChanged = pCandidates && *pCandidates != state.lastCandidates;
+		if (pCandidates)
+		{
+			if (state.candidatesChanged)
+				state.lastCandidates = *pCandidates;
+			const UINT candidateCount = UINT(pCandidates->size());
+			for (UINT first = 0; first < candidateCount; first += batchSize)
+			{
+				UINT end = min(candidateCount, first + batchSize);
+				m_jobs.push_back({ i, first, end, end - first, 0, false, true });
+			}
+		}
+		else if (buffer.bvh.GetItemCount() == count)
+		{
+			m_subtrees.clear();
+			buffer.bvh.GetSubtrees(batchSize, m_subtrees);
+			for (uint32_t node : m_subtrees)
+				m_jobs.push_back({ i, node, node + 1, buffer.bvh.GetNodeItemCount(node), buffer.bvh.GetBuildCount(), true, false });
+		}
+		else
+		{
+			for (UINT first = 0; first < count; first += batchSize)
+			{
+				UINT end = min(count, first + batchSize);
+				m_jobs.push_back({ i, first, end, end - first, 0, false, false });
+			}
+		}
+		state.jobCount = m_jobs.size() - state.firstJob;
+
+		// Scalar BVH leaf tests always gain from the cached plane
+		state.coherent = buffer.bvh.GetItemCount() == count || state.planeHitRate >= coherentHitRate ||
+			++state.framesSinceProbe >= ProbeInterval;
+		if (state.coherent)
+			state.framesSinceProbe = 0;
+	}
+	if (m_jobVisible.size() < m_jobs.size())
+	{
+		m_jobVisible.resize(m_jobs.size());
+		m_jobCounters.resize(m_jobs.size());
+		m_jobVolumeCulled.resize(m_jobs.size());
+		m_jobContributionCulled.resize(m_jobs.size());
+	}
+}
+
+void ParallelCuller::MarkDirtyJobs(const Frustum& frustum, const ContributionParams& contribution,
+	const std::vector<ObjectBuffer>& buffers)
+{
+	bool reuse = m_hasLastFrustum && memcmp(frustum.planes, m_lastFrustum.planes, sizeof(frustum.planes)) == 0 &&
+		memcmp(&contribution, &m_contribution, sizeof(contribution)) == 0 && m_jobs == m_prevJobs;
+	m_lastFrustum = frustum;
+	m_contribution = contribution;
+	m_hasLastFrustum = true;
+
+	m_jobDirty.assign(m_jobs.size(), reuse ? 0 : 1);
+	for (size_t i = 0; i < buffers.size() && reuse; i++)
+	{
+		const ObjectBuffer& buffer = buffers[i];
+		const BufferState& state = m_bufferStates[i];
+		if (state.jobCount == 0 || (!buffer.allChanged && buffer.changedInstances.empty() && !state.candidatesChanged))
+			continue;
+		if (buffer.allChanged || state.candidatesChanged)
+		{
+			std::fill_n(m_jobDirty.begin() + state.firstJob, state.jobCount, UINT8(1));
+			continue;
+		}
+		if (m_jobs[state.firstJob].useIds)
+		{
+			const std::vector<UINT32>& candidates = *m_candidates[i];
+			for (uint32_t instance : buffer.changedInstances)
+			{
+				auto it = std::lower_bound(candidates.begin(), candidates.end(), instance);
+				if (it != candidates.end() && *it == instance)
+					m_jobDirty[state.firstJob + (it - candidates.begin()) / batchSize] = 1;
+			}
+			continue;
+		}
+		if (!m_jobs[state.firstJob].useBVH)
+		{
+			for (uint32_t instance : buffer.changedInstances)
+				m_jobDirty[state.firstJob + instance / batchSize] = 1;
+			continue;
+		}
+
+		// The changed item is in the subtree of the first job root found on the way to the BVH root
+		m_subtreeJobs.clear();
+		for (size_t job = state.firstJob; job < state.firstJob + state.jobCount; job++)
+			m_subtreeJobs.push_back({ m_jobs[job].first, job });
+		std::sort(m_subtreeJobs.begin(), m_subtreeJobs.end());
+		for (uint32_t instance : buffer.changedInstances)
+		{
+			uint32_t node = buffer.bvh.GetItemLeaf(instance);
+			for (;;)
+			{
+				auto it = std::lower_bound(m_subtreeJobs.begin(), m_subtreeJobs.end(), std::make_pair(node, size_t(0)));
+				if (it != m_subtreeJobs.end() && it->first == node)
+				{
+					m_jobDirty[it->second] = 1;
+					break;
+				}
+				assert(node != 0);
+				node = buffer.bvh.GetParent(node);
+			}
+		}
+	}
+
+	m_dirtyJobs.clear();
+	for (size_t i = 0; i < m_jobs.size(); i++)
+	{
+		if (m_jobDirty[i])
+			m_dirtyJobs.push_back(i);
+	}
+}
+
+void ParallelCuller::SetCandidates(size_t bufferIndex, const std::vector<UINT32>* pIds)
+{
+	if (m_candidates.size() <= bufferIndex)
+		m_candidates.resize(bufferIndex + 1, nullptr);
+	m_candidates[bufferIndex] = pIds;
+}
+
+void ParallelCuller::Cull(const Frustum& frustum, const ContributionParams& contribution, const std::vector<ObjectBuffer>& buffers)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	m_pFrustum = &frustum;
+	m_pBuffers = &buffers;
+	CreateJobs(buffers);
+	MarkDirtyJobs(frustum, contribution, buffers);
+
+	size_t dirtyItemCount = 0;
+	for (size_t job : m_dirtyJobs)
+		dirtyItemCount += m_jobs[job].itemCount;
+
+	m_nextJob = 0;
+	if (m_workers.empty() || dirtyItemCount <= batchSize)
+	{
+		// Not worth waking the workers
+		RunJobs();
+	}
+	else
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_finishedWorkers = 0;
+			m_generation++;
+		}
+		m_wakeCondition.notify_all();
+		RunJobs();
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_doneCondition.wait(lock, [&]() { return m_finishedWorkers == m_workers.size(); });
+	}
+
+	// Jobs were created in buffer order, so concatenating them keeps the single threaded order
+	CullStats stats;
+	m_visible.resize(buffers.size());
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		BufferState& state = m_bufferStates[i];
+		size_t visibleCount = 0;
+		size_t tested = 0;
+		size_t planeHits = 0;
+		for (size_t job = state.firstJob; job < state.firstJob + state.jobCount; job++)
+		{
+			visibleCount += m_jobVisible[job].size();
+			stats.volumeCulled += m_jobVolumeCulled[job];
+			stats.contributionCulled += m_jobContributionCulled[job];
+			if (m_jobDirty[job])
+			{
+				tested += m_jobCounters[job].testedItems;
+				planeHits += m_jobCounters[job].planeHits;
+			}
+			else
+			{
+				stats.reusedCount += m_jobs[job].itemCount;
+			}
+		}
+		if (state.coherent && tested > 0)
+			state.planeHitRate = float(planeHits) / tested;
+
+		std::vector<UINT32>& visible = m_visible[i];
+		visible.resize(visibleCount);
+		UINT32* pDst = visible.data();
+		for (size_t job = state.firstJob; job < state.firstJob + state.jobCount; job++)
+		{
+			std::copy(m_jobVisible[job].begin(), m_jobVisible[job].end(), pDst);
+			pDst += m_jobVisible[job].size();
+		}
+
+		stats.instanceCount += buffers[i].bounds.GetCount();
+		if (i < m_candidates.size() && m_candidates[i])
+			stats.candidateCulled += buffers[i].bounds.GetCount() - m_candidates[i]->size();
+		stats.testedCount += tested;
+		stats.planeHits += planeHits;
+	}
+
+	stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	m_lastStats = stats;
+}
@@ -0,0 +1,119 @@
+#pragma once
+#include "framework.h"
+#include "GeometryData.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+struct CullStats
+{
+	size_t instanceCount = 0;
+	size_t reusedCount = 0; // results kept from the previous frame without testing
+	size_t testedCount = 0;
+	size_t planeHits = 0; // boxes rejected by the plane cached for them
+	size_t candidateCulled = 0; // left out of the candidate lists
+	size_t volumeCulled = 0; // AABB inside the frustum but bounding sphere or oriented box outside
+	size_t contributionCulled = 0; // inside the frustum but below the pixel threshold
+	double seconds = 0.0;
+
+	float GetReuseRate() const { return instanceCount > 0 ? float(reusedCount) / instanceCount : 0.0f; }
+	float GetPlaneHitRate() const { return testedCount > 0 ? float(planeHits) / testedCount : 0.0f; }
+};
+
+// Frustum culls all object buffers on a persistent worker pool. Every job culls one batch of instances
+// (an index range or a BVH subtree) into its own list, the lists are concatenated in job order afterwards,
+// so the result is the same as ObjectBuffer::Cull on a single thread.
+// A job whose frustum, batch layout and instance bounds did not change since the previous frame keeps its list.
+// Every instance remembers the plane that rejected it last, which is tested first where that pays off.
+class ParallelCuller
+{
+public:
+	~ParallelCuller();
+
+	// threadCount includes the calling thread, 0 - one per core
+	void Init(UINT threadCount = 0);
+	void Term();
+
+	// Blocks until every buffer is culled. The buffers must be refreshed before and ObjectBuffer::ClearChanges
+	// called after, the changed instance lists decide which batches are culled again.
+	// The AABB survivors go through CullBoundingVolumes, then CullSmallAABBs when contribution is enabled.
+	void Cull(const Frustum& frustum, const ContributionParams& contribution, const std::vector<ObjectBuffer>& buffers);
+	const std::vector<UINT32>& GetVisible(size_t bufferIndex) const { return m_visible[bufferIndex]; }
+	// Culls only the listed instances of the buffer, e.g. the potentially visible set of the camera cell. The ids
+	// must be ascending and the list kept alive until Cull returns, the visible ids then come in that order.
+	// nullptr culls the whole buffer again.
+	void SetCandidates(size_t bufferIndex, const std::vector<UINT32>* pIds);
+
+	UINT GetThreadCount() const { return UINT(m_workers.size()) + 1; }
+	size_t GetJobCount() const { return m_jobs.size(); }
+	const CullStats& GetLastStats() const { return m_lastStats; }
+
+	UINT batchSize = 4096;
+	// Linear buffers test the cached plane first above this hit rate, below it the plain SIMD kernel is faster
+	float coherentHitRate = 0.9f;
+
+private:
+	struct Job
+	{
+		UINT buffer;
+		UINT first; // instance range, candidate list range or BVH node
+		UINT end;
+		UINT itemCount;
+		UINT bvhBuild; // BVH node indices are only valid for one build
+		bool useBVH;
+		bool useIds;
+
+		bool operator==(const Job& other) const
+		{
+			return buffer == other.buffer && first == other.first && end == other.end && bvhBuild == other.bvhBuild &&
+				useBVH == other.useBVH && useIds == other.useIds;
+		}
+	};
+
+	struct BufferState
+	{
+		std::vector<UINT8> failedPlanes;
+		float planeHitRate = 1.0f;
+		UINT framesSinceProbe = 0;
+		bool coherent = true;
+		bool candidatesChanged = false;
+		std::vector<UINT32> lastCandidates;
+		size_t firstJob = 0;
+		size_t jobCount = 0;
+	};
+
+	void CreateJobs(const std::vector<ObjectBuffer>& buffers);
+	void MarkDirtyJobs(const Frustum& frustum, const ContributionParams& contribution, const std::vector<ObjectBuffer>& buffers);
+	void WorkerLoop();
+	void RunJobs();
+	void RunJob(size_t jobIndex);
+
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+	UINT64 m_generation = 0;
+	size_t m_finishedWorkers = 0;
+	bool m_stop = false;
+	std::atomic<size_t> m_nextJob{ 0 };
+
+	const Frustum* m_pFrustum = nullptr;
+	ContributionParams m_contribution;
+	const std::vector<ObjectBuffer>* m_pBuffers = nullptr;
+	std::vector<const std::vector<UINT32>*> m_candidates;
+	std::vector<Job> m_jobs;
+	std::vector<Job> m_prevJobs;
+	std::vector<size_t> m_dirtyJobs;
+	std::vector<UINT8> m_jobDirty;
+	std::vector<BVHCullCounters> m_jobCounters;
+	std::vector<UINT> m_jobVolumeCulled;
+	std::vector<UINT> m_jobContributionCulled;
+	std::vector<std::vector<UINT32>> m_jobVisible;
+	std::vector<std::vector<UINT32>> m_visible;
+	std::vector<BufferState> m_bufferStates;
+	std::vector<uint32_t> m_subtrees;
+	std::vector<std::pair<uint32_t, size_t>> m_subtreeJobs;
+	Frustum m_lastFrustum = {};
+	bool m_hasLastFrustum = false;
+	CullStats m_lastStats;
+};
@@ -0,0 +1,381 @@
+#include "PotentiallyVisibleSet.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <emmintrin.h>
+#include <map>
+#include <random>
+#include <thread>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+	const uint32_t MaxRunWords = 0xFFFF;
+
+	uint32_t PopCount(uint32_t word)
+	{
+#if defined(_MSC_VER)
+		return uint32_t(__popcnt(word));
+#else
+		return uint32_t(__builtin_popcount(word));
+#endif
+	}
+
+	// Set bit positions of every byte value, padded to 8 so a byte is expanded with two stores
+	struct ByteBitTable
+	{
+		uint32_t positions[256][8];
+		uint8_t counts[256];
+
+		ByteBitTable()
+		{
+			for (uint32_t value = 0; value < 256; value++)
+			{
+				counts[value] = 0;
+				for (uint32_t bit = 0; bit < 8; bit++)
+				{
+					positions[value][bit] = 0;
+					if (value >> bit & 1)
+						positions[value][counts[value]++] = bit;
+				}
+			}
+		}
+	};
+
+	const ByteBitTable& GetByteBitTable()
+	{
+		static const ByteBitTable table;
+		return table;
+	}
+
+	// Writes the ids of the set bits and returns their number, up to 8 slots past it are overwritten
+	uint32_t ExpandWord(const ByteBitTable& table, uint32_t wordIndex, uint32_t word, uint32_t* pOut)
+	{
+		uint32_t count = 0;
+		for (uint32_t byte = 0; byte < 4 && word != 0; byte++, word >>= 8)
+		{
+			const uint32_t value = word & 0xFF;
+			const __m128i base = _mm_set1_epi32(int(wordIndex * 32 + byte * 8));
+			const __m128i* pPositions = reinterpret_cast<const __m128i*>(table.positions[value]);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + count), _mm_add_epi32(_mm_loadu_si128(pPositions), base));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + count + 4), _mm_add_epi32(_mm_loadu_si128(pPositions + 1), base));
+			count += table.counts[value];
+		}
+		return count;
+	}
+
+	// Slab test of the segment against the box, done in the box frame where it is the [-1, 1] cube
+	bool SegmentHitsOccluder(const PVSOccluder& occluder, const float origin[3], const float end[3])
+	{
+		float tNear = 0.0f;
+		float tFar = 1.0f;
+		for (int b = 0; b < 3; b++)
+		{
+			const float* pAxis = occluder.axes[b];
+			float lengthSq = pAxis[0] * pAxis[0] + pAxis[1] * pAxis[1] + pAxis[2] * pAxis[2];
+			if (lengthSq <= 0.0f)
+				return false; // flat boxes hide nothing reliably
+			float localOrigin = 0.0f;
+			float localEnd = 0.0f;
+			for (int a = 0; a < 3; a++)
+			{
+				localOrigin += (origin[a] - occluder.center[a]) * pAxis[a];
+				localEnd += (end[a] - occluder.center[a]) * pAxis[a];
+			}
+			localOrigin /= lengthSq;
+			float direction = localEnd / lengthSq - localOrigin;
+			if (direction == 0.0f)
+			{
+				if (localOrigin < -1.0f || localOrigin > 1.0f)
+					return false;
+				continue;
+			}
+			float t0 = (-1.0f - localOrigin) / direction;
+			float t1 = (1.0f - localOrigin) / direction;
+			tNear = std::max(tNear, std::min(t0, t1));
+			tFar = std::min(tFar, std::max(t0, t1));
+			if (tNear > tFar)
+				return false;
+		}
+		return true;
+	}
+}
+
+void PotentiallyVisibleSet::Clear()
+{
+	m_itemCount = 0;
+	m_wordCount = 0;
+	m_maxVisibleCount = 0;
+	m_bakeWords.clear();
+	m_cellSets.clear();
+	m_setData.clear();
+	m_bakeStats = {};
+}
+
+void PotentiallyVisibleSet::Bake(const PVSBakeDesc& desc, const BVHInput& targets, const std::vector<PVSOccluder>& allOccluders)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	Clear();
+	uint32_t cellCount = 1;
+	for (int a = 0; a < 3; a++)
+	{
+		assert(desc.cellCounts[a] > 0 && desc.maxVec[a] > desc.minVec[a]);
+		m_minVec[a] = desc.minVec[a];
+		m_cellCounts[a] = desc.cellCounts[a];
+		m_cellSize[a] = (desc.maxVec[a] - desc.minVec[a]) / desc.cellCounts[a];
+		m_invCellSize[a] = 1.0f / m_cellSize[a];
+		cellCount *= desc.cellCounts[a];
+	}
+	m_itemCount = targets.count;
+	m_wordCount = (targets.count + 31) / 32;
+	m_bakeWords.assign(size_t(cellCount) * m_wordCount, 0);
+
+	// Dynamic items are somewhere else at runtime, they hide nothing. Rays only look at the occluders whose bounds they pass through.
+	std::vector<PVSOccluder> occluders;
+	for (const PVSOccluder& occluder : allOccluders)
+	{
+		if (std::find(desc.pDynamicItems, desc.pDynamicItems + desc.dynamicCount, occluder.item) == desc.pDynamicItems + desc.dynamicCount)
+			occluders.push_back(occluder);
+	}
+	std::vector<float> occluderMin[3], occluderMax[3];
+	for (int a = 0; a < 3; a++)
+	{
+		occluderMin[a].resize(occluders.size());
+		occluderMax[a].resize(occluders.size());
+	}
+	for (size_t i = 0; i < occluders.size(); i++)
+	{
+		const PVSOccluder& occluder = occluders[i];
+		for (int a = 0; a < 3; a++)
+		{
+			float extent = std::fabs(occluder.axes[0][a]) + std::fabs(occluder.axes[1][a]) + std::fabs(occluder.axes[2][a]);
+			occluderMin[a][i] = occluder.center[a] - extent;
+			occluderMax[a][i] = occluder.center[a] + extent;
+		}
+	}
+	BVHInput occluderBounds = {
+		{ occluderMin[0].data(), occluderMin[1].data(), occluderMin[2].data() },
+		{ occluderMax[0].data(), occluderMax[1].data(), occluderMax[2].data() },
+		uint32_t(occluders.size()) };
+	InstanceBVH occluderBVH;
+	occluderBVH.Build(occluderBounds);
+
+	BakeCells(desc, targets, occluders, occluderBVH, occluderBounds);
+	if (desc.dilate)
+	{
+		const std::vector<uint32_t> sampledWords = m_bakeWords;
+		const uint32_t neighbourSteps[3] = { 1, m_cellCounts[0], m_cellCounts[0] * m_cellCounts[1] };
+		for (uint32_t cell = 0; cell < cellCount; cell++)
+		{
+			const uint32_t cellIndex[3] = { cell % m_cellCounts[0], cell / m_cellCounts[0] % m_cellCounts[1],
+				cell / (m_cellCounts[0] * m_cellCounts[1]) };
+			uint32_t* pWords = m_bakeWords.data() + size_t(cell) * m_wordCount;
+			for (int a = 0; a < 3; a++)
+			{
+				for (int side = 0; side < 2; side++)
+				{
+					if (side == 0 ? cellIndex[a] == 0 : cellIndex[a] + 1 == m_cellCounts[a])
+						continue;
+					const uint32_t neighbour = side == 0 ? cell - neighbourSteps[a] : cell + neighbourSteps[a];
+					const uint32_t* pNeighbourWords = sampledWords.data() + size_t(neighbour) * m_wordCount;
+					for (uint32_t word = 0; word < m_wordCount; word++)
+						pWords[word] |= pNeighbourWords[word];
+				}
+			}
+		}
+	}
+	for (size_t i = 0; i < desc.dynamicCount; i++)
+	{
+		const uint32_t item = desc.pDynamicItems[i];
+		assert(item < m_itemCount);
+		for (uint32_t cell = 0; cell < cellCount; cell++)
+			m_bakeWords[size_t(cell) * m_wordCount + item / 32] |= 1u << (item % 32);
+	}
+	CompressSets();
+	m_bakeWords = std::vector<uint32_t>();
+	m_bakeStats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+}
+
+void PotentiallyVisibleSet::BakeCells(const PVSBakeDesc& desc, const BVHInput& targets,
+	const std::vector<PVSOccluder>& occluders, const InstanceBVH& occluderBVH, const BVHInput& occluderBounds)
+{
+	const uint32_t cellCount = m_cellCounts[0] * m_cellCounts[1] * m_cellCounts[2];
+	std::atomic<uint32_t> nextCell{ 0 };
+	std::atomic<uint64_t> castRays{ 0 };
+	auto bakeLoop = [&]()
+	{
+		uint64_t threadRays = 0;
+		for (uint32_t cell = nextCell++; cell < cellCount; cell = nextCell++)
+		{
+			const uint32_t cellIndex[3] = { cell % m_cellCounts[0], cell / m_cellCounts[0] % m_cellCounts[1],
+				cell / (m_cellCounts[0] * m_cellCounts[1]) };
+			float cellMin[3], cellMax[3];
+			for (int a = 0; a < 3; a++)
+			{
+				cellMin[a] = m_minVec[a] + cellIndex[a] * m_cellSize[a];
+				cellMax[a] = cellMin[a] + m_cellSize[a];
+			}
+			uint32_t* pWords = m_bakeWords.data() + size_t(cell) * m_wordCount;
+			std::mt19937 random(desc.seed * 0x9E3779B9u + cell);
+			std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+			for (uint32_t item = 0; item < targets.count; item++)
+			{
+				float itemMin[3], itemMax[3];
+				bool touching = true;
+				for (int a = 0; a < 3; a++)
+				{
+					itemMin[a] = targets.pMin[a][item];
+					itemMax[a] = targets.pMax[a][item];
+					touching = touching && itemMin[a] <= cellMax[a] && itemMax[a] >= cellMin[a];
+				}
+				bool visible = touching;
+				for (uint32_t ray = 0; ray < desc.raysPerItem && !visible; ray++)
+				{
+					float origin[3], end[3];
+					for (int a = 0; a < 3; a++)
+					{
+						origin[a] = cellMin[a] + unit(random) * m_cellSize[a];
+						end[a] = itemMin[a] + unit(random) * (itemMax[a] - itemMin[a]);
+					}
+					threadRays++;
+					visible = !occluderBVH.QuerySegment(occluderBounds, origin, end, [&](uint32_t occluder)
+					{
+						return occluders[occluder].item != item && SegmentHitsOccluder(occluders[occluder], origin, end);
+					});
+				}
+				if (visible)
+					pWords[item / 32] |= 1u << (item % 32);
+			}
+		}
+		castRays += threadRays;
+	};
+
+	uint32_t threadCount = desc.threadCount;
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, cellCount);
+	std::vector<std::thread> workers;
+	for (uint32_t i = 1; i < threadCount; i++)
+		workers.emplace_back(bakeLoop);
+	bakeLoop();
+	for (auto& worker : workers)
+		worker.join();
+	m_bakeStats.castRays = castRays;
+}
+
+void PotentiallyVisibleSet::CompressSets()
+{
+	const uint32_t cellCount = m_cellCounts[0] * m_cellCounts[1] * m_cellCounts[2];
+	std::map<std::vector<uint32_t>, uint32_t> setOffsets;
+	std::vector<uint32_t> encoded;
+	m_cellSets.resize(cellCount);
+	for (uint32_t cell = 0; cell < cellCount; cell++)
+	{
+		const uint32_t* pWords = m_bakeWords.data() + size_t(cell) * m_wordCount;
+		uint32_t visibleCount = 0;
+		for (uint32_t word = 0; word < m_wordCount; word++)
+			visibleCount += PopCount(pWords[word]);
+		m_maxVisibleCount = std::max(m_maxVisibleCount, visibleCount);
+
+		encoded.clear();
+		EncodeRuns(pWords, encoded);
+		auto inserted = setOffsets.insert(std::make_pair(encoded, uint32_t(m_setData.size())));
+		if (inserted.second)
+			m_setData.insert(m_setData.end(), encoded.begin(), encoded.end());
+		m_cellSets[cell] = inserted.first->second;
+	}
+
+	m_bakeStats.uniqueSets = uint32_t(setOffsets.size());
+	m_bakeStats.compressedBytes = (m_setData.size() + m_cellSets.size()) * sizeof(uint32_t);
+	m_bakeStats.uncompressedBytes = size_t(cellCount) * m_wordCount * sizeof(uint32_t);
+}
+
+void PotentiallyVisibleSet::EncodeRuns(const uint32_t* pWords, std::vector<uint32_t>& outData) const
+{
+	const size_t runCountIndex = outData.size();
+	outData.push_back(0);
+	uint32_t word = 0;
+	while (word < m_wordCount)
+	{
+		uint32_t zeroWords = 0;
+		while (word < m_wordCount && pWords[word] == 0 && zeroWords < MaxRunWords)
+		{
+			zeroWords++;
+			word++;
+		}
+		const uint32_t firstLiteral = word;
+		while (word < m_wordCount && pWords[word] != 0 && word - firstLiteral < MaxRunWords)
+			word++;
+		const uint32_t literalWords = word - firstLiteral;
+		if (literalWords == 0 && word == m_wordCount)
+			break; // trailing zeros are implied
+		outData.push_back(zeroWords << 16 | literalWords);
+		outData.insert(outData.end(), pWords + firstLiteral, pWords + word);
+		outData[runCountIndex]++;
+	}
+}
+
+int32_t PotentiallyVisibleSet::FindCell(const float position[3]) const
+{
+	if (m_cellSets.empty())
+		return -1;
+	uint32_t cellIndex[3];
+	for (int a = 0; a < 3; a++)
+	{
+		float cell = (position[a] - m_minVec[a]) * m_invCellSize[a];
+		if (!(cell >= 0.0f && cell < float(m_cellCounts[a])))
+			return -1;
+		cellIndex[a] = std::min(uint32_t(cell), m_cellCounts[a] - 1);
+	}
+	return int32_t((cellIndex[2] * m_cellCounts[1] + cellIndex[1]) * m_cellCounts[0] + cellIndex[0]);
+}
+
+void PotentiallyVisibleSet::GetVisible(int32_t cell, std::vector<uint32_t>& outIds) const
+{
+	outIds.clear();
+	if (cell < 0)
+		return;
+	const ByteBitTable& table = GetByteBitTable();
+	outIds.resize(m_maxVisibleCount + 8);
+	uint32_t* pOut = outIds.data();
+	uint32_t count = 0;
+	const uint32_t* pData = &m_setData[m_cellSets[cell]];
+	const uint32_t runCount = *pData++;
+	uint32_t wordIndex = 0;
+	for (uint32_t run = 0; run < runCount; run++)
+	{
+		const uint32_t header = *pData++;
+		wordIndex += header >> 16;
+		for (uint32_t i = 0; i < (header & 0xFFFF); i++)
+			count += ExpandWord(table, wordIndex++, *pData++, pOut + count);
+	}
+	outIds.resize(count);
+}
+
+bool PotentiallyVisibleSet::IsVisible(int32_t cell, uint32_t item) const
+{
+	if (cell < 0)
+		return false;
+	const uint32_t* pData = &m_setData[m_cellSets[cell]];
+	const uint32_t runCount = *pData++;
+	const uint32_t itemWord = item / 32;
+	uint32_t word = 0;
+	for (uint32_t run = 0; run < runCount; run++)
+	{
+		const uint32_t header = *pData++;
+		word += header >> 16;
+		const uint32_t literalWords = header & 0xFFFF;
+		if (itemWord < word)
+			return false;
+		if (itemWord < word + literalWords)
+			return (pData[itemWord - word] >> (item % 32) & 1) != 0;
+		word += literalWords;
+		pData += literalWords;
+	}
+	return false;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include "InstanceBVH.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Solid box blocking the sight rays: center and the three axes scaled by the half extents. Only geometry that
+// is really solid may be given, a box larger than its object hides what is seen past the object's edges.
+struct PVSOccluder
+{
+	float center[3];
+	float axes[3][3];
+	uint32_t item; // target item the box belongs to, it does not hide that item; UINT32_MAX for none
+};
+
+struct PVSBakeDesc
+{
+	float minVec[3] = {}; // baked region, cameras outside of it get no set
+	float maxVec[3] = {};
+	uint32_t cellCounts[3] = { 8, 2, 8 };
+	uint32_t raysPerItem = 64; // sight rays per cell and target item
+	bool dilate = true; // adds the sampled sets of the face neighbours, which covers most of the sampling misses
+	uint32_t threadCount = 0; // includes the calling thread, 0 - one per core
+	uint32_t seed = 1;
+	const uint32_t* pDynamicItems = nullptr; // moving items, visible from every cell and never occluding
+	size_t dynamicCount = 0;
+};
+
+struct PVSBakeStats
+{
+	uint64_t castRays = 0;
+	uint32_t uniqueSets = 0;
+	size_t compressedBytes = 0; // set data and the cell table
+	size_t uncompressedBytes = 0; // one plain bitset per cell
+	double seconds = 0.0;
+};
+
+// Potentially visible sets of a static scene. The baked region is split into a grid of cells, every cell keeps
+// the target items a sight ray from somewhere in the cell reaches. The rays run from random points in the cell
+// to random points in the item bounds and stop at the occluder boxes. An item is missing when no sample found
+// the gap it is seen through, dilating the sets over the neighbour cells makes up for most of these.
+// Items touching the cell are always in its set.
+// Sets are bitsets over the item ids with the runs of zero words removed, identical sets are stored once.
+// Kept free of Windows and D3D headers.
+class PotentiallyVisibleSet
+{
+public:
+	// Blocks until every cell is baked. Every cell draws its own samples, the result does not depend on the thread count.
+	void Bake(const PVSBakeDesc& desc, const BVHInput& targets, const std::vector<PVSOccluder>& occluders);
+	void Clear();
+
+	bool IsBaked() const { return !m_cellSets.empty(); }
+	// Cell containing the point, -1 outside the baked region
+	int32_t FindCell(const float position[3]) const;
+	// Replaces the list with the visible ids of the cell in ascending order
+	void GetVisible(int32_t cell, std::vector<uint32_t>& outIds) const;
+	bool IsVisible(int32_t cell, uint32_t item) const;
+
+	uint32_t GetItemCount() const { return m_itemCount; }
+	uint32_t GetCellCount() const { return uint32_t(m_cellSets.size()); }
+	const PVSBakeStats& GetBakeStats() const { return m_bakeStats; }
+
+private:
+	void BakeCells(const PVSBakeDesc& desc, const BVHInput& targets, const std::vector<PVSOccluder>& occluders,
+		const InstanceBVH& occluderBVH, const BVHInput& occluderBounds);
+	void CompressSets();
+	void EncodeRuns(const uint32_t* pWords, std::vector<uint32_t>& outData) const;
+
+	float m_minVec[3] = {};
+	float m_cellSize[3] = {};
+	float m_invCellSize[3] = {};
+	uint32_t m_cellCounts[3] = {};
+	uint32_t m_itemCount = 0;
+	uint32_t m_wordCount = 0;
+	uint32_t m_maxVisibleCount = 0;
+	std::vector<uint32_t> m_bakeWords; // plain bitsets while baking
+	std::vector<uint32_t> m_cellSets; // offset of every cell's set in m_setData
+	// Per set: the run count, then every run as (zero words << 16 | literal words) followed by the literal words
+	std::vector<uint32_t> m_setData;
+	PVSBakeStats m_bakeStats;
+};
@@ -0,0 +1,475 @@
+#include "PrimitiveLibrary.h"
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <tuple>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	// sin and cos of i * step for i in [0, count], four angles per XMVectorSinCos
+	void BuildSinCosTable(UINT count, float step, vector<float>& outSin, vector<float>& outCos)
+	{
+		size_t size = (size_t(count) + 1 + 3) & ~size_t(3);
+		outSin.resize(size);
+		outCos.resize(size);
+		for (size_t i = 0; i < size; i += 4)
+		{
+			XMVECTOR angles = XMVectorScale(XMVectorSet(float(i), float(i + 1), float(i + 2), float(i + 3)), step);
+			XMVECTOR s, c;
+			XMVectorSinCos(&s, &c, angles);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&outSin[i]), s);
+			XMStoreFloat4(reinterpret_cast<XMFLOAT4*>(&outCos[i]), c);
+		}
+		outSin.resize(size_t(count) + 1);
+		outCos.resize(size_t(count) + 1);
+	}
+
+	TextureNormalVertex MakeVertex(FXMVECTOR pos, FXMVECTOR tang, FXMVECTOR normal, float u, float v)
+	{
+		TextureNormalVertex vertex;
+		XMStoreFloat3(&vertex.pos, pos);
+		XMStoreFloat4(&vertex.tang, XMVectorSetW(tang, 1.0f));
+		XMStoreFloat3(&vertex.normal, normal);
+		vertex.textureUV = XMFLOAT2(u, v);
+		return vertex;
+	}
+
+	void AddTriangle(vector<UINT32>& indices, UINT32 a, UINT32 b, UINT32 c)
+	{
+		indices.push_back(a);
+		indices.push_back(b);
+		indices.push_back(c);
+	}
+
+	// Rows of (segments + 1) vertices, row r + 1 below row r, triangles touching a collapsed row are skipped
+	void AddRowIndices(vector<UINT32>& indices, UINT32 base, UINT segments, UINT rows, bool collapsedFirst, bool collapsedLast)
+	{
+		for (UINT r = 0; r < rows; r++)
+		{
+			for (UINT s = 0; s < segments; s++)
+			{
+				UINT32 i = base + r * (segments + 1) + s;
+				UINT32 iNext = i + segments + 1;
+				if (r != 0 || !collapsedFirst)
+					AddTriangle(indices, i, i + 1, iNext + 1);
+				if (r + 1 != rows || !collapsedLast)
+					AddTriangle(indices, iNext + 1, iNext, i);
+			}
+		}
+	}
+
+	void GenerateUVSphere(const PrimitiveDesc& desc, vector<TextureNormalVertex>& vertices, vector<UINT32>& indices)
+	{
+		UINT segments = max(desc.segments, 3u);
+		UINT rings = max(desc.rings, 2u);
+		vector<float> sinA, cosA, sinB, cosB;
+		BuildSinCosTable(segments, XM_2PI / segments, sinA, cosA);
+		BuildSinCosTable(rings, XM_PI / rings, sinB, cosB);
+
+		XMVECTOR radius = XMVectorReplicate(desc.size.x);
+		for (UINT r = 0; r <= rings; r++)
+		{
+			for (UINT s = 0; s <= segments; s++)
+			{
+				XMVECTOR normal = XMVectorSet(sinB[r] * cosA[s], cosB[r], sinB[r] * sinA[s], 0.0f);
+				XMVECTOR tang = XMVectorSet(-sinA[s], 0.0f, cosA[s], 0.0f);
+				vertices.push_back(MakeVertex(XMVectorMultiply(normal, radius), tang, normal, float(s) / segments, float(r) / rings));
+			}
+		}
+		AddRowIndices(indices, 0, segments, rings, true, true);
+	}
+
+	void GenerateIcosphere(const PrimitiveDesc& desc, vector<TextureNormalVertex>& vertices, vector<UINT32>& indices)
+	{
+		const float t = (1.0f + sqrtf(5.0f)) * 0.5f;
+		vector<XMFLOAT3> points = {
+			{ -1, t, 0 }, { 1, t, 0 }, { -1, -t, 0 }, { 1, -t, 0 },
+			{ 0, -1, t }, { 0, 1, t }, { 0, -1, -t }, { 0, 1, -t },
+			{ t, 0, -1 }, { t, 0, 1 }, { -t, 0, -1 }, { -t, 0, 1 },
+		};
+		for (XMFLOAT3& point : points)
+			XMStoreFloat3(&point, XMVector3Normalize(XMLoadFloat3(&point)));
+
+		vector<UINT32> faces = {
+			0, 11, 5, 0, 5, 1, 0, 1, 7, 0, 7, 10, 0, 10, 11,
+			1, 5, 9, 5, 11, 4, 11, 10, 2, 10, 7, 6, 7, 1, 8,
+			3, 9, 4, 3, 4, 2, 3, 2, 6, 3, 6, 8, 3, 8, 9,
+			4, 9, 5, 2, 4, 11, 6, 2, 10, 8, 6, 7, 9, 8, 1,
+		};
+		// Front faces are clockwise seen from outside
+		for (size_t i = 0; i < faces.size(); i += 3)
+		{
+			XMVECTOR a = XMLoadFloat3(&points[faces[i]]);
+			XMVECTOR b = XMLoadFloat3(&points[faces[i + 1]]);
+			XMVECTOR c = XMLoadFloat3(&points[faces[i + 2]]);
+			XMVECTOR n = XMVector3Cross(XMVectorSubtract(b, a), XMVectorSubtract(c, a));
+			if (XMVectorGetX(XMVector3Dot(n, XMVectorAdd(XMVectorAdd(a, b), c))) < 0.0f)
+				std::swap(faces[i + 1], faces[i + 2]);
+		}
+
+		for (UINT level = 0; level < desc.rings; level++)
+		{
+			std::unordered_map<uint64_t, UINT32> midpoints;
+			auto midpoint = [&](UINT32 a, UINT32 b)
+			{
+				uint64_t key = uint64_t(min(a, b)) << 32 | max(a, b);
+				auto it = midpoints.find(key);
+				if (it != midpoints.end())
+					return it->second;
+				XMFLOAT3 point;
+				XMStoreFloat3(&point, XMVector3Normalize(XMVectorAdd(XMLoadFloat3(&points[a]), XMLoadFloat3(&points[b]))));
+				points.push_back(point);
+				midpoints[key] = UINT32(points.size() - 1);
+				return UINT32(points.size() - 1);
+			};
+
+			vector<UINT32> subdivided;
+			subdivided.reserve(faces.size() * 4);
+			for (size_t i = 0; i < faces.size(); i += 3)
+			{
+				UINT32 a = faces[i], b = faces[i + 1], c = faces[i + 2];
+				UINT32 ab = midpoint(a, b), bc = midpoint(b, c), ca = midpoint(c, a);
+				AddTriangle(subdivided, a, ab, ca);
+				AddTriangle(subdivided, b, bc, ab);
+				AddTriangle(subdivided, c, ca, bc);
+				AddTriangle(subdivided, ab, bc, ca);
+			}
+			faces.swap(subdivided);
+		}
+
+		XMVECTOR radius = XMVectorReplicate(desc.size.x);
+		auto makeVertex = [&](const XMFLOAT3& point, float u)
+		{
+			XMVECTOR normal = XMLoadFloat3(&point);
+			float sinA, cosA;
+			XMScalarSinCos(&sinA, &cosA, u * XM_2PI);
+			float v = acosf(max(-1.0f, min(1.0f, point.y))) / XM_PI;
+			return MakeVertex(XMVectorMultiply(normal, radius), XMVectorSet(-sinA, 0.0f, cosA, 0.0f), normal, u, v);
+		};
+		for (const XMFLOAT3& point : points)
+		{
+			float u = atan2f(point.z, point.x) / XM_2PI;
+			vertices.push_back(makeVertex(point, u < 0.0f ? u + 1.0f : u));
+		}
+
+		// Triangles crossing u = 1 get copies with u + 1 (the sampler wraps), pole vertices get a copy per triangle
+		std::unordered_map<UINT32, UINT32> seamCopies;
+		for (size_t i = 0; i < faces.size(); i += 3)
+		{
+			UINT32* pTri = &faces[i];
+			bool pole[3];
+			float minU = 1.0f, maxU = 0.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				pole[c] = fabsf(points[pTri[c]].y) > 0.9999f;
+				if (!pole[c])
+				{
+					minU = min(minU, vertices[pTri[c]].textureUV.x);
+					maxU = max(maxU, vertices[pTri[c]].textureUV.x);
+				}
+			}
+			if (maxU - minU > 0.5f)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					if (pole[c] || vertices[pTri[c]].textureUV.x >= 0.5f)
+						continue;
+					auto it = seamCopies.find(pTri[c]);
+					if (it == seamCopies.end())
+					{
+						vertices.push_back(makeVertex(points[pTri[c]], vertices[pTri[c]].textureUV.x + 1.0f));
+						it = seamCopies.emplace(pTri[c], UINT32(vertices.size() - 1)).first;
+					}
+					pTri[c] = it->second;
+				}
+			}
+			for (int c = 0; c < 3; c++)
+			{
+				if (!pole[c])
+					continue;
+				float u = (vertices[pTri[(c + 1) % 3]].textureUV.x + vertices[pTri[(c + 2) % 3]].textureUV.x) * 0.5f;
+				vertices.push_back(makeVertex(points[pTri[c]], u));
+				pTri[c] = UINT32(vertices.size() - 1);
+			}
+		}
+		indices.insert(indices.end(), faces.begin(), faces.end());
+	}
+
+	struct CubeFace
+	{
+		XMFLOAT3 normal;
+		XMFLOAT3 tang;
+		XMFLOAT3 up;
+	};
+
+	// cross(tang, up) = -normal keeps the quads clockwise seen from outside
+	const CubeFace CubeFaces[] = {
+		{ { 0, 0, -1 }, { 1, 0, 0 }, { 0, 1, 0 } },
+		{ { 0, 0, 1 }, { -1, 0, 0 }, { 0, 1, 0 } },
+		{ { -1, 0, 0 }, { 0, 0, -1 }, { 0, 1, 0 } },
+		{ { 1, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 } },
+		{ { 0, 1, 0 }, { 1, 0, 0 }, { 0, 0, 1 } },
+		{ { 0, -1, 0 }, { 1, 0, 0 }, { 0, 0, -1 } },
+	};
+
+	void GenerateFaceGrid(const CubeFace& face, UINT cells, bool spherify, FXMVECTOR scale,
+		vector<TextureNormalVertex>& vertices, vector<UINT32>& indices)
+	{
+		XMVECTOR n = XMLoadFloat3(&face.normal);
+		XMVECTOR t = XMLoadFloat3(&face.tang);
+		XMVECTOR up = XMLoadFloat3(&face.up);
+		UINT32 base = UINT32(vertices.size());
+		for (UINT j = 0; j <= cells; j++)
+		{
+			for (UINT i = 0; i <= cells; i++)
+			{
+				float u = float(i) / cells;
+				float v = float(j) / cells;
+				XMVECTOR p = XMVectorMultiplyAdd(t, XMVectorReplicate(2.0f * u - 1.0f), XMVectorMultiplyAdd(up, XMVectorReplicate(1.0f - 2.0f * v), n));
+				if (!spherify)
+				{
+					vertices.push_back(MakeVertex(XMVectorMultiply(p, scale), t, n, u, v));
+					continue;
+				}
+
+				// Cube to sphere mapping with more even cells than plain normalization
+				XMVECTOR sq = XMVectorMultiply(p, p);
+				XMFLOAT3 s;
+				XMStoreFloat3(&s, sq);
+				XMVECTOR k = XMVectorSet(
+					sqrtf(1.0f - s.y * 0.5f - s.z * 0.5f + s.y * s.z / 3.0f),
+					sqrtf(1.0f - s.z * 0.5f - s.x * 0.5f + s.z * s.x / 3.0f),
+					sqrtf(1.0f - s.x * 0.5f - s.y * 0.5f + s.x * s.y / 3.0f), 0.0f);
+				XMVECTOR normal = XMVector3Normalize(XMVectorMultiply(p, k));
+				XMVECTOR tang = XMVector3Normalize(XMVectorSubtract(t, XMVectorMultiply(normal, XMVector3Dot(t, normal))));
+				vertices.push_back(MakeVertex(XMVectorMultiply(normal, scale), tang, normal, u, v));
+			}
+		}
+		for (UINT j = 0; j < cells; j++)
+		{
+			for (UINT i = 0; i < cells; i++)
+			{
+				UINT32 tl = base + j * (cells + 1) + i;
+				UINT32 bl = tl + cells + 1;
+				AddTriangle(indices, bl, tl, tl + 1);
+				AddTriangle(indices, tl + 1, bl + 1, bl);
+			}
+		}
+	}
+
+	void GenerateCap(UINT segments, float radius, float y, bool top, const vector<float>& sinA, const vector<float>& cosA,
+		vector<TextureNormalVertex>& vertices, vector<UINT32>& indices)
+	{
+		XMVECTOR normal = XMVectorSet(0.0f, top ? 1.0f : -1.0f, 0.0f, 0.0f);
+		XMVECTOR tang = XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f);
+		UINT32 center = UINT32(vertices.size());
+		vertices.push_back(MakeVertex(XMVectorSet(0.0f, y, 0.0f, 0.0f), tang, normal, 0.5f, 0.5f));
+		for (UINT s = 0; s <= segments; s++)
+		{
+			XMVECTOR pos = XMVectorSet(radius * cosA[s], y, radius * sinA[s], 0.0f);
+			vertices.push_back(MakeVertex(pos, tang, normal, 0.5f + 0.5f * cosA[s], 0.5f + 0.5f * sinA[s]));
+		}
+		for (UINT s = 0; s < segments; s++)
+		{
+			if (top)
+				AddTriangle(indices, center, center + s + 2, center + s + 1);
+			else
+				AddTriangle(indices, center, center + s + 1, center + s + 2);
+		}
+	}
+
+	// Cylinder for topRadius == bottomRadius, cone for topRadius == 0
+	void GenerateTube(const PrimitiveDesc& desc, float topRadius, vector<TextureNormalVertex>& vertices, vector<UINT32>& indices)
+	{
+		UINT segments = max(desc.segments, 3u);
+		UINT rows = max(desc.rings, 1u);
+		float bottomRadius = desc.size.x;
+		float halfHeight = desc.size.y;
+		vector<float> sinA, cosA;
+		BuildSinCosTable(segments, XM_2PI / segments, sinA, cosA);
+
+		UINT32 base = UINT32(vertices.size());
+		for (UINT r = 0; r <= rows; r++)
+		{
+			float k = float(r) / rows;
+			float radius = topRadius + (bottomRadius - topRadius) * k;
+			float y = halfHeight - 2.0f * halfHeight * k;
+			for (UINT s = 0; s <= segments; s++)
+			{
+				XMVECTOR normal = XMVector3Normalize(XMVectorSet(cosA[s] * 2.0f * halfHeight, bottomRadius - topRadius, sinA[s] * 2.0f * halfHeight, 0.0f));
+				XMVECTOR tang = XMVectorSet(-sinA[s], 0.0f, cosA[s], 0.0f);
+				vertices.push_back(MakeVertex(XMVectorSet(radius * cosA[s], y, radius * sinA[s], 0.0f), tang, normal, float(s) / segments, k));
+			}
+		}
+		AddRowIndices(indices, base, segments, rows, topRadius == 0.0f, false);
+
+		if (topRadius > 0.0f)
+			GenerateCap(segments, topRadius, halfHeight, true, sinA, cosA, vertices, indices);
+		GenerateCap(segments, bottomRadius, -halfHeight, false, sinA, cosA, vertices, indices);
+	}
+
+	struct PositionKey
+	{
+		uint32_t x, y, z;
+		bool operator==(const PositionKey& other) const { return x == other.x && y == other.y && z == other.z; }
+	};
+
+	struct PositionKeyHash
+	{
+		size_t operator()(const PositionKey& key) const
+		{
+			return size_t(key.x) * 73856093u ^ size_t(key.y) * 19349663u ^ size_t(key.z) * 83492791u;
+		}
+	};
+}
+
+bool PrimitiveDesc::operator<(const PrimitiveDesc& other) const
+{
+	return std::tie(type, format, segments, rings, size.x, size.y, size.z, insideOut)
+		< std::tie(other.type, other.format, other.segments, other.rings, other.size.x, other.size.y, other.size.z, other.insideOut);
+}
+
+bool PrimitiveLibrary::Generate(const PrimitiveDesc& desc, PrimitiveMesh& outMesh)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	vector<TextureNormalVertex> vertices;
+	vector<UINT32> indices;
+	switch (desc.type)
+	{
+	case PrimitiveType::UVSphere:
+		GenerateUVSphere(desc, vertices, indices);
+		break;
+	case PrimitiveType::Icosphere:
+		GenerateIcosphere(desc, vertices, indices);
+		break;
+	case PrimitiveType::CubeSphere:
+	case PrimitiveType::Box:
+	{
+		bool spherify = desc.type == PrimitiveType::CubeSphere;
+		XMVECTOR scale = spherify ? XMVectorReplicate(desc.size.x) : XMLoadFloat3(&desc.size);
+		for (const CubeFace& face : CubeFaces)
+			GenerateFaceGrid(face, max(desc.rings, 1u), spherify, scale, vertices, indices);
+		break;
+	}
+	case PrimitiveType::Plane:
+		GenerateFaceGrid(CubeFaces[0], max(desc.rings, 1u), false, XMVectorSet(desc.size.x, desc.size.y, 0.0f, 0.0f), vertices, indices);
+		break;
+	case PrimitiveType::Cylinder:
+		GenerateTube(desc, desc.size.x, vertices, indices);
+		break;
+	case PrimitiveType::Cone:
+		GenerateTube(desc, 0.0f, vertices, indices);
+		break;
+	}
+
+	if (desc.insideOut)
+	{
+		for (size_t i = 0; i < indices.size(); i += 3)
+			std::swap(indices[i + 1], indices[i + 2]);
+		for (TextureNormalVertex& vertex : vertices)
+		{
+			XMStoreFloat3(&vertex.normal, XMVectorNegate(XMLoadFloat3(&vertex.normal)));
+			vertex.tang.w = -vertex.tang.w;
+		}
+	}
+
+	outMesh = PrimitiveMesh();
+	if (desc.format == PrimitiveFormat::Position)
+	{
+		std::unordered_map<PositionKey, UINT32, PositionKeyHash> welded;
+		vector<UINT32> remap(vertices.size());
+		for (size_t i = 0; i < vertices.size(); i++)
+		{
+			PositionKey key;
+			memcpy(&key, &vertices[i].pos, sizeof(key));
+			auto it = welded.emplace(key, UINT32(outMesh.positions.size())).first;
+			if (it->second == outMesh.positions.size())
+				outMesh.positions.push_back({ vertices[i].pos.x, vertices[i].pos.y, vertices[i].pos.z });
+			remap[i] = it->second;
+		}
+		for (UINT32& index : indices)
+			index = remap[index];
+	}
+	else
+		outMesh.vertices.swap(vertices);
+
+	if (outMesh.GetVertexCount() > 0x10000)
+		return false;
+	outMesh.indices.assign(indices.begin(), indices.end());
+
+	XMVECTOR minVec = XMVectorReplicate(FLT_MAX);
+	XMVECTOR maxVec = XMVectorReplicate(-FLT_MAX);
+	const uint8_t* pVertex = reinterpret_cast<const uint8_t*>(outMesh.GetVertexData());
+	size_t stride = outMesh.vertices.empty() ? sizeof(Vertex) : sizeof(TextureNormalVertex);
+	for (UINT i = 0; i < outMesh.GetVertexCount(); i++, pVertex += stride)
+	{
+		XMVECTOR pos = XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(pVertex));
+		minVec = XMVectorMin(minVec, pos);
+		maxVec = XMVectorMax(maxVec, pos);
+	}
+	XMFLOAT3 minPos, maxPos;
+	XMStoreFloat3(&minPos, minVec);
+	XMStoreFloat3(&maxPos, maxVec);
+	for (int i = 0; i < 8; i++)
+	{
+		outMesh.vectorsAABB.push_back({
+			(i & 1) ? minPos.x : maxPos.x,
+			(i & 2) ? minPos.y : maxPos.y,
+			(i & 4) ? minPos.z : maxPos.z });
+	}
+
+	outMesh.generationSeconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+	return true;
+}
+
+const PrimitiveMesh* PrimitiveLibrary::Get(const PrimitiveDesc& desc)
+{
+	auto it = m_cache.find(desc);
+	if (it != m_cache.end())
+	{
+		m_cacheHits++;
+		return &it->second;
+	}
+
+	m_cacheMisses++;
+	PrimitiveMesh mesh;
+	if (!Generate(desc, mesh))
+		return nullptr;
+	return &m_cache.emplace(desc, std::move(mesh)).first->second;
+}
+
+void PrimitiveLibrary::LogStats() const
+{
+	char line[256];
+	for (const auto& entry : m_cache)
+	{
+		const PrimitiveDesc& desc = entry.first;
+		const PrimitiveMesh& mesh = entry.second;
+		snprintf(line, sizeof(line), "%s (segments %u, rings %u): %u vertices, %u triangles, %.3f ms\n",
+			GetTypeName(desc.type), desc.segments, desc.rings, mesh.GetVertexCount(), mesh.GetTriangleCount(),
+			mesh.generationSeconds * 1000.0);
+		OutputDebugStringA(line);
+	}
+	snprintf(line, sizeof(line), "Primitive cache: %u hits, %u misses\n", m_cacheHits, m_cacheMisses);
+	OutputDebugStringA(line);
+}
+
+const char* PrimitiveLibrary::GetTypeName(PrimitiveType type)
+{
+	switch (type)
+	{
+	case PrimitiveType::UVSphere: return "UVSphere";
+	case PrimitiveType::Icosphere: return "Icosphere";
+	case PrimitiveType::CubeSphere: return "CubeSphere";
+	case PrimitiveType::Box: return "Box";
+	case PrimitiveType::Plane: return "Plane";
+	case PrimitiveType::Cylinder: return "Cylinder";
+	case PrimitiveType::Cone: return "Cone";
+	}
+	return "Unknown";
+}
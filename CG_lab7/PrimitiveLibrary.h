@@ -0,0 +1,72 @@
+#pragma once
+#include "GeometryData.h"
+#include <map>
+#include <string>
+
+enum class PrimitiveType
+{
+	UVSphere,
+	Icosphere,
+	CubeSphere,
+	Box,
+	Plane,
+	Cylinder,
+	Cone,
+};
+
+enum class PrimitiveFormat
+{
+	TextureNormal, // TextureNormalVertex, split at UV seams
+	Position, // Vertex, welded
+};
+
+struct PrimitiveDesc
+{
+	PrimitiveType type = PrimitiveType::Icosphere;
+	PrimitiveFormat format = PrimitiveFormat::TextureNormal;
+	UINT segments = 16; // around the axis: UV sphere, cylinder, cone
+	UINT rings = 2; // UV sphere - rings from pole to pole, icosphere - subdivisions, other - grid cells per face edge
+	DirectX::XMFLOAT3 size = { 1.0f, 1.0f, 1.0f }; // spheres - radius in x, box - half extents, plane - half extents in x and y,
+	                                               // cylinder and cone - radius in x and half height in y
+	bool insideOut = false; // faces visible from the inside, as the skybox needs
+
+	bool operator<(const PrimitiveDesc& other) const;
+};
+
+struct PrimitiveMesh
+{
+	vector<TextureNormalVertex> vertices;
+	vector<Vertex> positions;
+	vector<USHORT> indices;
+	vector<DirectX::XMFLOAT3> vectorsAABB;
+	double generationSeconds = 0.0;
+
+	UINT GetVertexCount() const { return UINT(vertices.empty() ? positions.size() : vertices.size()); }
+	UINT GetIndexCount() const { return UINT(indices.size()); }
+	UINT GetTriangleCount() const { return UINT(indices.size() / 3); }
+	const void* GetVertexData() const { return vertices.empty() ? (const void*)positions.data() : (const void*)vertices.data(); }
+};
+
+// Generated primitives cached by their parameters
+class PrimitiveLibrary
+{
+public:
+	// Fails when the primitive does not fit into 16-bit indices
+	static bool Generate(const PrimitiveDesc& desc, PrimitiveMesh& outMesh);
+
+	const PrimitiveMesh* Get(const PrimitiveDesc& desc);
+	void Clear() { m_cache.clear(); }
+
+	size_t GetCachedCount() const { return m_cache.size(); }
+	UINT GetCacheHits() const { return m_cacheHits; }
+	UINT GetCacheMisses() const { return m_cacheMisses; }
+	// Vertex and triangle counts and generation time of every cached primitive, written to the debug output
+	void LogStats() const;
+
+	static const char* GetTypeName(PrimitiveType type);
+
+private:
+	std::map<PrimitiveDesc, PrimitiveMesh> m_cache;
+	UINT m_cacheHits = 0;
+	UINT m_cacheMisses = 0;
+};
@@ -0,0 +1,96 @@
+#include "RangeAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+RangeAllocator::RangeAllocator(uint32_t capacity)
+{
+	Reset(capacity);
+}
+
+void RangeAllocator::Reset(uint32_t capacity)
+{
+	m_capacity = capacity;
+	m_freeSize = capacity;
+	m_freeBlocks.clear();
+	if (capacity > 0)
+		m_freeBlocks.push_back({ 0, capacity });
+}
+
+uint32_t RangeAllocator::Allocate(uint32_t size)
+{
+	if (size == 0)
+		return InvalidOffset;
+
+	for (size_t i = 0; i < m_freeBlocks.size(); i++)
+	{
+		Block& block = m_freeBlocks[i];
+		if (block.size < size)
+			continue;
+
+		uint32_t offset = block.offset;
+		block.offset += size;
+		block.size -= size;
+		if (block.size == 0)
+			m_freeBlocks.erase(m_freeBlocks.begin() + i);
+		m_freeSize -= size;
+		return offset;
+	}
+	return InvalidOffset;
+}
+
+void RangeAllocator::Free(uint32_t offset, uint32_t size)
+{
+	if (size == 0 || offset == InvalidOffset)
+		return;
+	assert(offset + size <= m_capacity);
+
+	auto next = std::lower_bound(m_freeBlocks.begin(), m_freeBlocks.end(), offset,
+		[](const Block& block, uint32_t value) { return block.offset < value; });
+	assert(next == m_freeBlocks.end() || offset + size <= next->offset);
+
+	bool mergePrev = false;
+	if (next != m_freeBlocks.begin())
+	{
+		auto prev = next - 1;
+		assert(prev->offset + prev->size <= offset);
+		mergePrev = prev->offset + prev->size == offset;
+	}
+	bool mergeNext = next != m_freeBlocks.end() && offset + size == next->offset;
+
+	if (mergePrev && mergeNext)
+	{
+		auto prev = next - 1;
+		prev->size += size + next->size;
+		m_freeBlocks.erase(next);
+	}
+	else if (mergePrev)
+	{
+		(next - 1)->size += size;
+	}
+	else if (mergeNext)
+	{
+		next->offset = offset;
+		next->size += size;
+	}
+	else
+	{
+		m_freeBlocks.insert(next, { offset, size });
+	}
+	m_freeSize += size;
+}
+
+uint32_t RangeAllocator::GetLargestFreeBlock() const
+{
+	uint32_t largest = 0;
+	for (auto& block : m_freeBlocks)
+		largest = std::max(largest, block.size);
+	return largest;
+}
+
+float RangeAllocator::GetFragmentation() const
+{
+	if (m_freeSize == 0)
+		return 0.0f;
+	return 1.0f - float(GetLargestFreeBlock()) / float(m_freeSize);
+}
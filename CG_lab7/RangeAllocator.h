@@ -0,0 +1,36 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// First-fit free-list allocator over an abstract [0, capacity) range.
+// Knows nothing about D3D, so it is used for vertex/index pools and can be run on any platform.
+class RangeAllocator
+{
+public:
+	static const uint32_t InvalidOffset = 0xFFFFFFFFu;
+
+	explicit RangeAllocator(uint32_t capacity = 0);
+
+	void Reset(uint32_t capacity);
+	uint32_t Allocate(uint32_t size);
+	void Free(uint32_t offset, uint32_t size);
+
+	uint32_t GetCapacity() const { return m_capacity; }
+	uint32_t GetFreeSize() const { return m_freeSize; }
+	uint32_t GetUsedSize() const { return m_capacity - m_freeSize; }
+	uint32_t GetFreeBlockCount() const { return uint32_t(m_freeBlocks.size()); }
+	uint32_t GetLargestFreeBlock() const;
+	// 0 - all free space is one block, close to 1 - free space is scattered in small holes
+	float GetFragmentation() const;
+
+private:
+	struct Block
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	std::vector<Block> m_freeBlocks; // sorted by offset, never adjacent
+	uint32_t m_capacity = 0;
+	uint32_t m_freeSize = 0;
+};
@@ -0,0 +1,108 @@
+﻿#include "RenderQueue.h"
+#include <algorithm>
+
+namespace
+{
+	const uint32_t DigitBits = 11;
+	const uint32_t DigitCount = (64 + DigitBits - 1) / DigitBits;
+	const uint32_t Radix = 1u << DigitBits;
+	// Below this many items the histograms cost more than a comparison sort
+	const size_t MinRadixCount = 1024;
+
+	uint64_t Field(uint32_t value, uint32_t bits, uint32_t shift)
+	{
+		return uint64_t(value & ((1u << bits) - 1)) << shift;
+	}
+}
+
+namespace DrawKey
+{
+	const uint32_t DepthShift = 0;
+	const uint32_t GeometryShift = DepthShift + DepthBits;
+	const uint32_t MaterialShift = GeometryShift + GeometryBits;
+	const uint32_t PermutationShift = MaterialShift + MaterialBits;
+	const uint32_t PassShift = PermutationShift + PermutationBits;
+
+	uint64_t Make(uint32_t pass, uint32_t permutation, uint32_t material, uint32_t geometry, uint32_t depth)
+	{
+		return Field(pass, PassBits, PassShift) | Field(permutation, PermutationBits, PermutationShift) |
+			Field(material, MaterialBits, MaterialShift) | Field(geometry, GeometryBits, GeometryShift) | Field(depth, DepthBits, DepthShift);
+	}
+
+	uint64_t MakeBackToFront(uint32_t pass, uint32_t permutation, uint32_t material, uint32_t geometry, uint32_t depth)
+	{
+		// pass | inverted depth | permutation | material | geometry
+		return Field(pass, PassBits, PassShift) | Field(MaxDepth - (depth & MaxDepth), DepthBits, PassShift - DepthBits) |
+			Field(permutation, PermutationBits, MaterialBits + GeometryBits) | Field(material, MaterialBits, GeometryBits) |
+			Field(geometry, GeometryBits, 0);
+	}
+
+	uint32_t GetPass(uint64_t key)
+	{
+		return uint32_t(key >> PassShift) & ((1u << PassBits) - 1);
+	}
+
+	uint32_t GetPermutation(uint64_t key, bool backToFront)
+	{
+		const uint32_t shift = backToFront ? MaterialBits + GeometryBits : PermutationShift;
+		return uint32_t(key >> shift) & ((1u << PermutationBits) - 1);
+	}
+
+	uint32_t QuantizeDepth(float viewDepth, float nearZ, float farZ)
+	{
+		float t = (viewDepth - nearZ) / (farZ - nearZ);
+		t = std::min(std::max(t, 0.0f), 1.0f);
+		return uint32_t(t * float(MaxDepth));
+	}
+}
+
+bool CanMergeDraws(uint64_t firstKey, const void* pFirstGeometry, uint32_t firstIdCount, uint64_t nextKey, const void* pNextGeometry,
+	uint32_t nextIdCount, bool backToFront)
+{
+	// Equal passes share the key layout
+	return firstIdCount > 0 && nextIdCount > 0 && pFirstGeometry == pNextGeometry &&
+		DrawKey::GetPass(firstKey) == DrawKey::GetPass(nextKey) &&
+		DrawKey::GetPermutation(firstKey, backToFront) == DrawKey::GetPermutation(nextKey, backToFront);
+}
+
+void RenderQueue::Sort()
+{
+	const size_t count = m_items.size();
+	if (count < MinRadixCount)
+	{
+		std::stable_sort(m_items.begin(), m_items.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+		return;
+	}
+
+	// Histograms of all digits in one pass over the keys
+	m_histograms.assign(DigitCount * Radix, 0);
+	for (const DrawItem& item : m_items)
+	{
+		for (uint32_t d = 0; d < DigitCount; d++)
+			m_histograms[d * Radix + ((item.key >> (d * DigitBits)) & (Radix - 1))]++;
+	}
+
+	m_scratch.resize(count);
+	DrawItem* pSource = m_items.data();
+	DrawItem* pTarget = m_scratch.data();
+	for (uint32_t d = 0; d < DigitCount; d++)
+	{
+		uint32_t* pCounts = &m_histograms[d * Radix];
+		const uint32_t shift = d * DigitBits;
+		// Every key has the same digit, the order stays as it is
+		if (pCounts[(pSource[0].key >> shift) & (Radix - 1)] == count)
+			continue;
+		uint32_t offset = 0;
+		for (uint32_t b = 0; b < Radix; b++)
+		{
+			const uint32_t bucket = pCounts[b];
+			pCounts[b] = offset;
+			offset += bucket;
+		}
+		for (size_t i = 0; i < count; i++)
+			pTarget[pCounts[(pSource[i].key >> shift) & (Radix - 1)]++] = pSource[i];
+		std::swap(pSource, pTarget);
+	}
+	if (pSource != m_items.data())
+		m_items.swap(m_scratch);
+}
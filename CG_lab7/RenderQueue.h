@@ -0,0 +1,57 @@
+﻿#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Fields of a 64 bit draw key, most significant first: pass, shader permutation, material, geometry, depth.
+// Sorting by key groups the draws of a pass by pipeline state and then front to back. Passes blending back to
+// front use the depth key, which moves the inverted depth right after the pass.
+namespace DrawKey
+{
+	const uint32_t PassBits = 4;
+	const uint32_t PermutationBits = 8;
+	const uint32_t MaterialBits = 16;
+	const uint32_t GeometryBits = 12;
+	const uint32_t DepthBits = 24;
+	const uint32_t MaxDepth = (1u << DepthBits) - 1;
+
+	// Fields are masked to their widths
+	uint64_t Make(uint32_t pass, uint32_t permutation, uint32_t material, uint32_t geometry, uint32_t depth);
+	uint64_t MakeBackToFront(uint32_t pass, uint32_t permutation, uint32_t material, uint32_t geometry, uint32_t depth);
+	// Same bits in both layouts
+	uint32_t GetPass(uint64_t key);
+	uint32_t GetPermutation(uint64_t key, bool backToFront);
+	// Linear view depth between the planes mapped to [0, MaxDepth]
+	uint32_t QuantizeDepth(float viewDepth, float nearZ, float farZ);
+}
+
+struct DrawItem
+{
+	uint64_t key;
+	uint32_t command; // index of the caller's draw description
+};
+
+// Whether the item sorted right after an instanced draw is folded into its DrawIndexedInstanced: both draw instance
+// ids (idCount > 0) of the same geometry in the same pass and shader permutation. Materials may differ, the shaders
+// read them per instance. backToFront gives the key layout of the first item's pass.
+bool CanMergeDraws(uint64_t firstKey, const void* pFirstGeometry, uint32_t firstIdCount, uint64_t nextKey, const void* pNextGeometry,
+	uint32_t nextIdCount, bool backToFront);
+
+// Draw items of a frame, LSD radix sorted by key in 11 bit digits. Digits shared by every key are skipped, so
+// the few passes and permutations of a frame cost no sorting passes. Kept free of Windows and D3D headers.
+class RenderQueue
+{
+public:
+	void Clear() { m_items.clear(); }
+	void Push(uint64_t key, uint32_t command) { m_items.push_back({ key, command }); }
+	// Stable, items with equal keys keep the order they were pushed in
+	void Sort();
+
+	const DrawItem* GetItems() const { return m_items.data(); }
+	size_t GetCount() const { return m_items.size(); }
+
+private:
+	std::vector<DrawItem> m_items;
+	std::vector<DrawItem> m_scratch;
+	std::vector<uint32_t> m_histograms; // counts and then offsets of every digit
+};
@@ -36,22 +36,28 @@ class D3DInclude : public ID3DInclude
 	}
 };
 
-struct Light
+struct DrawBuffer
 {
-	DirectX::XMVECTOR pos = { 0, 0, 0, 0 };
-	DirectX::XMVECTOR color = { 1, 1, 1, 0 };
+	DirectX::XMUINT4 drawOffsets = { 0, 0, 0, 0 };
 };
 
-
 struct ViewBuffer
 {
 	DirectX::XMMATRIX vp;
 	DirectX::XMVECTOR cameraPosition;
 	DirectX::XMINT4 lightCount = { 0, 0, 0, 0 };
-	Light lights[10];
 	DirectX::XMFLOAT4 ambientColor;
+	DirectX::XMUINT4 clusterCounts;
+	DirectX::XMFLOAT4 clusterDepth;
 };
 
+static const UINT PositionPoolVertexCapacity = 16 * 1024;
+static const UINT PositionPoolIndexCapacity = 64 * 1024;
+static const UINT MeshPoolVertexCapacity = 64 * 1024;
+static const UINT MeshPoolIndexCapacity = 256 * 1024;
+static const UINT InstanceUploadCapacity = 16 * 1024;
+static const UINT IdUploadCapacity = 64 * 1024;
+
 UINT32 Up(UINT32 a, UINT32 b)
 {
 	return (a + b - 1) / b;
@@ -135,14 +141,9 @@ bool Renderer::Init(HWND hWnd)
 		return false;
 
 
-	result = SetupColorBuffer();
 	result = SetupBackBuffer();
 	
 	
-	if (!SUCCEEDED(result))
-		return false;
-
-	result = SetupDepthBuffer();
 	if (!SUCCEEDED(result))
 		return false;
 
@@ -578,13 +579,14 @@ HRESULT Renderer::InitTextures() {
 
 HRESULT Renderer::InitShaders() {
 	SetupDepthBlend();
-	std::vector<Vertex> sphereVertices;
-	std::vector<USHORT> sphereIndices;
-	int hRes = 18;
-	int wRes = 8;
-	float rad = 1.1f;
-
-	GeometryData::getSphereGeometry(sphereVertices, sphereIndices, hRes, wRes, rad);
+	// light sphere and skybox, the skybox is seen from the inside
+	PrimitiveDesc sphereDesc;
+	sphereDesc.type = PrimitiveType::Icosphere;
+	sphereDesc.format = PrimitiveFormat::Position;
+	sphereDesc.rings = 2;
+	sphereDesc.size = { 1.1f, 1.1f, 1.1f };
+	sphereDesc.insideOut = true;
+	const PrimitiveMesh* pSphere = m_primitiveLibrary.Get(sphereDesc);
 
 	std::vector<TextureNormalVertex> cubeVertices;
 	std::vector<USHORT> cubeIndices;
@@ -596,164 +598,59 @@ HRESULT Renderer::InitShaders() {
 
 	HRESULT result = S_OK;
 
+	// geometry pools
 	if (SUCCEEDED(result))
 	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = sizeof(SceneBuffer[100]);
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pCubesModelBuffer);
-		assert(SUCCEEDED(result));
-		if (SUCCEEDED(result))
-		{
-			result = SetResourceName(m_pCubesModelBuffer, "CubesModelBuffer");
-		}
+		result = m_positionGeometryPool.Init(m_pDevice, sizeof(Vertex), PositionPoolVertexCapacity,
+			DXGI_FORMAT_R16_UINT, PositionPoolIndexCapacity, "PositionPool");
 	}
 	if (SUCCEEDED(result))
 	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = sizeof(SceneBuffer[100]);
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		//desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pSpheresModelBuffer);
-		assert(SUCCEEDED(result));
-		if (SUCCEEDED(result))
-		{
-			result = SetResourceName(m_pSpheresModelBuffer, "SpheresModelBuffer");
-		}
-	}
-
-	// plane
-	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = UINT(sizeof(TextureNormalVertex) * planeVertices.size());
-		desc.Usage = D3D11_USAGE_IMMUTABLE;
-		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-
-		D3D11_SUBRESOURCE_DATA data;
-		data.pSysMem = planeVertices.data();
-		data.SysMemPitch = UINT(sizeof(TextureNormalVertex) * planeVertices.size());
-		data.SysMemSlicePitch = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, &data, &m_pPlaneVertexBuffer);
-		if (SUCCEEDED(result))
-		{
-			result = SetResourceName(m_pPlaneVertexBuffer, "PlaneVertexBuffer");
-		}
-	}
-	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = UINT(sizeof(USHORT) * planeIndices.size());
-		desc.Usage = D3D11_USAGE_IMMUTABLE;
-		desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-
-		D3D11_SUBRESOURCE_DATA data;
-		data.pSysMem = planeIndices.data();
-		data.SysMemPitch = UINT(sizeof(USHORT) * planeIndices.size());
-		data.SysMemSlicePitch = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, &data, &m_pPlaneIndexBuffer);
-		if (SUCCEEDED(result))
-		{
-			result = SetResourceName(m_pPlaneIndexBuffer, "PlaneIndexBuffer");
-		}
+		result = m_meshGeometryPool.Init(m_pDevice, sizeof(TextureNormalVertex), MeshPoolVertexCapacity,
+			DXGI_FORMAT_R16_UINT, MeshPoolIndexCapacity, "MeshPool");
 	}
 	//sphere
+	if (SUCCEEDED(result))
 	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = sizeof(Vertex) * UINT32(sphereVertices.size());
-		desc.Usage = D3D11_USAGE_IMMUTABLE;
-		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-		D3D11_SUBRESOURCE_DATA data;
-		data.pSysMem = sphereVertices.data();
-		data.SysMemPitch = sizeof(Vertex) * UINT32(sphereVertices.size());
-		data.SysMemSlicePitch = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, &data, &m_pSphereVertexBuffer);
-		if (SUCCEEDED(result)) {
-			result = SetResourceName(m_pSphereVertexBuffer, "SphereVertexBuffer");
-		}
+		result = pSphere != nullptr ? S_OK : E_FAIL;
 	}
+	if (SUCCEEDED(result))
 	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = sizeof(UINT32) * UINT32(sphereIndices.size());
-		desc.Usage = D3D11_USAGE_IMMUTABLE;
-		desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-		D3D11_SUBRESOURCE_DATA data;
-		data.pSysMem = sphereIndices.data();
-		data.SysMemPitch = sizeof(UINT32) * UINT32(sphereIndices.size());
-		data.SysMemSlicePitch = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, &data, &m_pSphereIndexBuffer);
-		if (SUCCEEDED(result)) {
-			result = SetResourceName(m_pSphereIndexBuffer, "SphereIndexBuffer");
-		}
+		result = m_positionGeometryPool.Add(m_pDeviceContext, pSphere->GetVertexData(), pSphere->GetVertexCount(),
+			pSphere->indices.data(), pSphere->GetIndexCount(), SphereGeometry);
+		SphereGeometry.ComputeBounds(pSphere->GetVertexData(), sizeof(Vertex), pSphere->GetVertexCount());
 	}
 	//cube
+	if (SUCCEEDED(result))
 	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = UINT(cubeVertices.size() * sizeof(TextureNormalVertex));
-		desc.Usage = D3D11_USAGE_IMMUTABLE;
-		desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-		D3D11_SUBRESOURCE_DATA data;
-		data.pSysMem = cubeVertices.data();
-		data.SysMemPitch = UINT(cubeVertices.size() * sizeof(TextureNormalVertex));
-		data.SysMemSlicePitch = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, &data, &m_pCubeVertexBuffer);
-		if (SUCCEEDED(result)) {
-			result = SetResourceName(m_pCubeVertexBuffer, "CubeVertexBuffer");
-		}
+		result = m_meshGeometryPool.Add(m_pDeviceContext, cubeVertices.data(), UINT(cubeVertices.size()),
+			cubeIndices.data(), UINT(cubeIndices.size()), CubeGeometry);
+		CubeGeometry.ComputeBounds(cubeVertices.data(), sizeof(TextureNormalVertex), cubeVertices.size());
+		m_cubeOccluder.positions.clear();
+		for (const auto& vertex : cubeVertices)
+			m_cubeOccluder.positions.insert(m_cubeOccluder.positions.end(), { vertex.pos.x, vertex.pos.y, vertex.pos.z });
+		m_cubeOccluder.indices.assign(cubeIndices.begin(), cubeIndices.end());
 	}
+	// plane
+	if (SUCCEEDED(result))
 	{
-		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = UINT(sizeof(USHORT) * cubeIndices.size());
-		desc.Usage = D3D11_USAGE_IMMUTABLE;
-		desc.BindFlags = D3D11_BIND_INDEX_BUFFER;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.StructureByteStride = 0;
-		D3D11_SUBRESOURCE_DATA data;
-		data.pSysMem = cubeIndices.data();
-		data.SysMemPitch = UINT(sizeof(USHORT) * cubeIndices.size());
-		data.SysMemSlicePitch = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, &data, &m_pCubeIndexBuffer);
-		if (SUCCEEDED(result)) {
-			result = SetResourceName(m_pCubeIndexBuffer, "CubeIndexBuffer");
-		}
+		result = m_meshGeometryPool.Add(m_pDeviceContext, planeVertices.data(), UINT(planeVertices.size()),
+			planeIndices.data(), UINT(planeIndices.size()), PlaneGeometry);
+		PlaneGeometry.ComputeBounds(planeVertices.data(), sizeof(TextureNormalVertex), planeVertices.size());
 	}
+	assert(SUCCEEDED(result));
+#ifdef _DEBUG
+	m_primitiveLibrary.LogStats();
+#endif
 	// texture
 	result = InitTextures();
 	assert(SUCCEEDED(result));
 	{
 		D3D11_BUFFER_DESC desc = {};
 		desc.ByteWidth = sizeof(SceneBuffer);
-		desc.Usage = D3D11_USAGE_DEFAULT;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
 		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
-		desc.CPUAccessFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		desc.MiscFlags = 0;
 		desc.StructureByteStride = 0;
 
@@ -764,37 +661,55 @@ HRESULT Renderer::InitShaders() {
 			result = SetResourceName(m_pSceneBuffer, "SceneBuffer");
 		}
 	}
+	if (SUCCEEDED(result))
 	{
 		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = sizeof(ViewBuffer);
+		desc.ByteWidth = sizeof(DrawBuffer);
 		desc.Usage = D3D11_USAGE_DYNAMIC;
 		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		desc.MiscFlags = 0;
 		desc.StructureByteStride = 0;
-		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pViewBuffer);
+
+		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pDrawBuffer);
 		assert(SUCCEEDED(result));
 		if (SUCCEEDED(result))
 		{
-			result = SetResourceName(m_pViewBuffer, "ViewBuffer");
+			result = SetResourceName(m_pDrawBuffer, "DrawBuffer");
 		}
 	}
-
 	if (SUCCEEDED(result))
+	{
+		D3D11_FEATURE_DATA_D3D11_OPTIONS options = {};
+		m_noOverwriteUploads = SUCCEEDED(m_pDevice->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS, &options, sizeof(options))) &&
+			options.MapNoOverwriteOnDynamicBufferSRV;
+		result = CreateUploadRing(m_instanceUpload, InstanceUploadCapacity, sizeof(InstanceData), "InstanceUpload");
+	}
+	if (SUCCEEDED(result))
+	{
+		result = CreateUploadRing(m_idUpload, IdUploadCapacity, sizeof(UINT32), "VisibleIdUpload");
+	}
+	for (UINT i = 0; i < FrameQueryCount && SUCCEEDED(result); i++)
+	{
+		D3D11_QUERY_DESC desc = {};
+		desc.Query = D3D11_QUERY_EVENT;
+		desc.MiscFlags = 0;
+		result = m_pDevice->CreateQuery(&desc, &m_pFrameQueries[i]);
+		assert(SUCCEEDED(result));
+	}
 	{
 		D3D11_BUFFER_DESC desc = {};
-		desc.ByteWidth = sizeof(DirectX::XMUINT4[100]);
+		desc.ByteWidth = sizeof(ViewBuffer);
 		desc.Usage = D3D11_USAGE_DYNAMIC;
 		desc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
 		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
 		desc.MiscFlags = 0;
 		desc.StructureByteStride = 0;
-
-		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pVisibleBuffer);
+		result = m_pDevice->CreateBuffer(&desc, nullptr, &m_pViewBuffer);
 		assert(SUCCEEDED(result));
 		if (SUCCEEDED(result))
 		{
-			result = SetResourceName(m_pVisibleBuffer, "VisibleBuffer");
+			result = SetResourceName(m_pViewBuffer, "ViewBuffer");
 		}
 	}
 
@@ -804,9 +719,9 @@ HRESULT Renderer::InitShaders() {
 
 	static const D3D11_INPUT_ELEMENT_DESC InputDesc[] = {
 	{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-	{"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
-	{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0},
-	{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0}
+	{"TANGENT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+	{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 28, D3D11_INPUT_PER_VERTEX_DATA, 0},
+	{"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 40, D3D11_INPUT_PER_VERTEX_DATA, 0}
 	};
 
 	if (SUCCEEDED(result))
@@ -888,32 +803,11 @@ HRESULT Renderer::InitShaders() {
 
 	SafeRelease(pVertexShaderCode);
 
-	SphereGeometry = { m_pSphereIndexBuffer, m_pSphereVertexBuffer, sizeof(Vertex), 0, 756 };
-	SphereGeometry.vectorsAABB.push_back({ 1.0f,  1.0f,  1.0f });
-	SphereGeometry.vectorsAABB.push_back({ -1.0f,  1.0f,  1.0f });
-	SphereGeometry.vectorsAABB.push_back({ 1.0f, -1.0f,  1.0f });
-	SphereGeometry.vectorsAABB.push_back({ -1.0f, -1.0f,  1.0f });
-	SphereGeometry.vectorsAABB.push_back({ 1.0f,  1.0f, -1.0f });
-	SphereGeometry.vectorsAABB.push_back({ -1.0f,  1.0f, -1.0f });
-	SphereGeometry.vectorsAABB.push_back({ 1.0f, -1.0f, -1.0f });
-	SphereGeometry.vectorsAABB.push_back({ -1.0f, -1.0f, -1.0f });
-
-	CubeGeometry = { m_pCubeIndexBuffer, m_pCubeVertexBuffer, sizeof(TextureNormalVertex), 0, UINT(cubeIndices.size()) };
-	CubeGeometry.vectorsAABB.push_back({ 0.5f,  0.5f,  0.5f });
-	CubeGeometry.vectorsAABB.push_back({ -0.5f,  0.5f,  0.5f });
-	CubeGeometry.vectorsAABB.push_back({ 0.5f, -0.5f,  0.5f });
-	CubeGeometry.vectorsAABB.push_back({ -0.5f, -0.5f,  0.5f });
-	CubeGeometry.vectorsAABB.push_back({ 0.5f,  0.5f, -0.5f });
-	CubeGeometry.vectorsAABB.push_back({ -0.5f,  0.5f, -0.5f });
-	CubeGeometry.vectorsAABB.push_back({ 0.5f, -0.5f, -0.5f });
-	CubeGeometry.vectorsAABB.push_back({ -0.5f, -0.5f, -0.5f });
-
-	PlaneGeometry = { m_pPlaneIndexBuffer, m_pPlaneVertexBuffer, sizeof(TextureNormalVertex), 0, UINT(planeIndices.size()) };
-	PlaneGeometry.vectorsAABB.push_back({ 0.5f,  0.5f,  0.0f });
-	PlaneGeometry.vectorsAABB.push_back({ -0.5f,  0.5f,  0.0f });
-	PlaneGeometry.vectorsAABB.push_back({ 0.5f, -0.5f,  0.0f });
-	PlaneGeometry.vectorsAABB.push_back({ -0.5f, -0.5f,  0.0f });
 	InitSceneResources();
+	BakeVisibility();
+	m_parallelCuller.Init();
+	m_occlusionCuller.Init(OcclusionWidth, OcclusionHeight);
+	m_lightClusters.Init(ClusterGridDesc());
 	return result;
 }
 
@@ -972,8 +866,6 @@ HRESULT Renderer::CompileShader(const std::wstring& path, ID3D11DeviceChild** pp
 }
 
 void Renderer::Clean() {
-	SafeRelease(m_pSpheresModelBuffer);
-	SafeRelease(m_pCubesModelBuffer);
 	SafeRelease(m_pGrayPostprocPixelShader);
 	SafeRelease(m_pColorTextureArrayView);
 	SafeRelease(m_pColorTextureArray);
@@ -987,10 +879,7 @@ void Renderer::Clean() {
 	SafeRelease(m_pBaseVertexShader);
 	SafeRelease(m_pBaseInputLayout);
 	SafeRelease(m_pBasePixelShader);
-	SafeRelease(m_pVisibleBuffer);
-	SafeRelease(m_pColorBuffer);
-	SafeRelease(m_pColorBufferRTV);
-	SafeRelease(m_pColorBufferSRV);
+	ReleaseTransientTargets();
 	
 	SafeRelease(m_pColorTexturePS);
 	SafeRelease(m_pColorTextureVS);
@@ -1004,19 +893,29 @@ void Renderer::Clean() {
 	SafeRelease(m_pSkyboxPS);
 	SafeRelease(m_pSkyboxVS);
 
-	SafeRelease(m_pDepthBuffer);
-	SafeRelease(m_pDepthBufferDSV);
 	SafeRelease(m_pViewBuffer);
 	SafeRelease(m_pSceneBuffer);
 
-	SafeRelease(m_pPlaneVertexBuffer);
-	SafeRelease(m_pPlaneIndexBuffer);
 	SafeRelease(m_pTransBlendState);
 
-	SafeRelease(m_pSphereIndexBuffer);
-	SafeRelease(m_pSphereVertexBuffer);
-	SafeRelease(m_pCubeIndexBuffer);
-	SafeRelease(m_pCubeVertexBuffer);
+	ReleaseUploadRing(m_instanceUpload);
+	ReleaseUploadRing(m_idUpload);
+	SafeRelease(m_pDrawBuffer);
+	for (UINT i = 0; i < FrameQueryCount; i++)
+	{
+		SafeRelease(m_pFrameQueries[i]);
+	}
+	ReleaseStructuredBuffer(m_lightBuffer);
+	ReleaseStructuredBuffer(m_clusterRangeBuffer);
+	ReleaseStructuredBuffer(m_clusterLightBuffer);
+	ReleaseStructuredBuffer(m_materialBuffer);
+
+	m_parallelCuller.Term();
+	m_occlusionCuller.Term();
+	m_lightClusters.Term();
+	m_positionGeometryPool.Clean();
+	m_meshGeometryPool.Clean();
+	m_stateCache.Reset(nullptr);
 
 	SafeRelease(m_pDepthStateRead);
 	SafeRelease(m_pDepthStateReadWrite);
@@ -1032,80 +931,553 @@ void Renderer::Clean() {
 	m_isRunning = false;
 }
 
-DirectX::XMVECTOR buildPlane(const DirectX::XMVECTOR& p0, const DirectX::XMVECTOR& p1, const DirectX::XMVECTOR& p2, const DirectX::XMVECTOR& p3)
+void Renderer::BindGeometry(const GeometryData& geometry)
 {
-	DirectX::XMVECTOR norm = DirectX::XMVector3Cross(DirectX::XMVectorSubtract(p1, p0), DirectX::XMVectorSubtract(p3, p0));
-	norm = DirectX::XMVector3Normalize(norm);
-	DirectX::XMVECTOR pos = DirectX::XMVectorScale(DirectX::XMVectorAdd(DirectX::XMVectorAdd(p0, p1), DirectX::XMVectorAdd(p2, p3)), 0.25f);
-	return DirectX::XMVECTOR{ norm.m128_f32[0], norm.m128_f32[1], norm.m128_f32[2], -DirectX::XMVector3Dot(pos, norm).m128_f32[0] };
+	m_stateCache.SetIndexBuffer(geometry.pIndexBuffer, geometry.indexFormat);
+	m_stateCache.SetVertexBuffer(geometry.vertexBuffer[0], geometry.strides[0], geometry.offsets[0]);
 }
 
-std::vector<DirectX::XMVECTOR> GetFrustum(float nearPlane, float farPlane, float fov, float aspectRatio, const DirectX::XMMATRIX viewTransform)
+void Renderer::RasterizeOccluders(const DirectX::XMMATRIX& viewProjection)
 {
-	DirectX::XMVECTOR nearPoints[4] =
+	DirectX::XMFLOAT4X4 matrix;
+	DirectX::XMStoreFloat4x4(&matrix, viewProjection);
+	m_occlusionCuller.BeginFrame(&matrix.m[0][0]);
+
+	// The frustum visible cubes covering the most of the screen hide the rest
+	DirectX::XMVECTOR camera = pSceneManager.m_cameraTransform.r[3];
+	m_occluderCandidates.clear();
+	for (size_t objIdx = 0; objIdx < objBuffers.size(); objIdx++)
 	{
-		{ nearPlane * tanf(fov / 2),nearPlane * tanf(fov / 2) * aspectRatio,nearPlane,1 },
-		{ -nearPlane * tanf(fov / 2),nearPlane * tanf(fov / 2) * aspectRatio,nearPlane,1 },
-		{ -nearPlane * tanf(fov / 2),-nearPlane * tanf(fov / 2) * aspectRatio,nearPlane,1 },
-		{ nearPlane * tanf(fov / 2),-nearPlane * tanf(fov / 2) * aspectRatio,nearPlane,1 },
-	};
-	DirectX::XMVECTOR farPoints[4] =
+		const AABBSoA& bounds = objBuffers[objIdx].bounds;
+		for (UINT32 id : m_parallelCuller.GetVisible(objIdx))
+		{
+			DirectX::XMVECTOR minVec = DirectX::XMVectorSet(bounds.GetMinX()[id], bounds.GetMinY()[id], bounds.GetMinZ()[id], 0.0f);
+			DirectX::XMVECTOR maxVec = DirectX::XMVectorSet(bounds.GetMaxX()[id], bounds.GetMaxY()[id], bounds.GetMaxZ()[id], 0.0f);
+			DirectX::XMVECTOR center = DirectX::XMVectorScale(DirectX::XMVectorAdd(minVec, maxVec), 0.5f);
+			float sizeSq = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(maxVec, minVec)));
+			float distSq = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(center, camera)));
+			m_occluderCandidates.push_back({ sizeSq / max(distSq, 1e-6f), UINT(objIdx), id });
+		}
+	}
+	size_t occluderCount = min(m_occluderCandidates.size(), size_t(m_maxOccluders));
+	std::partial_sort(m_occluderCandidates.begin(), m_occluderCandidates.begin() + occluderCount, m_occluderCandidates.end(),
+		[](const OccluderCandidate& a, const OccluderCandidate& b) { return a.score > b.score; });
+	for (size_t i = 0; i < occluderCount; i++)
+	{
+		const OccluderCandidate& candidate = m_occluderCandidates[i];
+		DirectX::XMStoreFloat4x4(&matrix, objBuffers[candidate.buffer].instances[candidate.instance].model);
+		m_occlusionCuller.AddOccluder(m_cubeOccluder, &matrix.m[0][0]);
+	}
+	m_occlusionCuller.Rasterize();
+}
+
+void Renderer::BakeVisibility()
+{
+	ObjectBuffer& cubes = objBuffers[0];
+	cubes.Refresh();
+	const BVHInput targets = cubes.GetBVHInput();
+	if (targets.count == 0)
+		return;
+
+	// The oriented boxes of the cubes are the cubes themselves, so they are exact occluders
+	std::vector<PVSOccluder> occluders(targets.count);
+	for (UINT32 i = 0; i < targets.count; i++)
+	{
+		PVSOccluder& occluder = occluders[i];
+		for (int a = 0; a < 3; a++)
+		{
+			occluder.center[a] = cubes.volumes.GetBoxCenter(a)[i];
+			for (int b = 0; b < 3; b++)
+				occluder.axes[b][a] = cubes.volumes.GetBoxAxis(b, a)[i];
+		}
+		occluder.item = i;
+	}
+
+	// The region covers the cubes and the space around them the camera usually moves in
+	const float margin = 10.0f;
+	PVSBakeDesc desc;
+	for (int a = 0; a < 3; a++)
+	{
+		desc.minVec[a] = *std::min_element(targets.pMin[a], targets.pMin[a] + targets.count) - margin;
+		desc.maxVec[a] = *std::max_element(targets.pMax[a], targets.pMax[a] + targets.count) + margin;
+	}
+	// Render moves the second cube every frame
+	const uint32_t dynamicItems[] = { 1 };
+	desc.pDynamicItems = dynamicItems;
+	desc.dynamicCount = targets.count > 1 ? 1 : 0;
+	m_cubeVisibility.Bake(desc, targets, occluders);
+	m_visibilityCell = -1;
+}
+
+void* Renderer::MapStructuredBuffer(DynamicStructuredBuffer& buffer, UINT count, UINT stride, const char* name)
+{
+	HRESULT result = S_OK;
+	if (buffer.pBuffer == NULL || count > buffer.capacity)
+	{
+		ReleaseStructuredBuffer(buffer);
+		UINT capacity = max(count + count / 2, 1u);
+
+		D3D11_BUFFER_DESC desc = {};
+		desc.ByteWidth = capacity * stride;
+		desc.Usage = D3D11_USAGE_DYNAMIC;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		desc.StructureByteStride = stride;
+		result = m_pDevice->CreateBuffer(&desc, nullptr, &buffer.pBuffer);
+		assert(SUCCEEDED(result));
+		if (SUCCEEDED(result))
+		{
+			result = SetResourceName(buffer.pBuffer, name);
+		}
+		if (SUCCEEDED(result))
+		{
+			D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+			viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+			viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+			viewDesc.Buffer.FirstElement = 0;
+			viewDesc.Buffer.NumElements = capacity;
+			result = m_pDevice->CreateShaderResourceView(buffer.pBuffer, &viewDesc, &buffer.pView);
+			assert(SUCCEEDED(result));
+		}
+		if (SUCCEEDED(result))
+		{
+			buffer.capacity = capacity;
+		}
+	}
+	if (FAILED(result))
+	{
+		return NULL;
+	}
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	result = m_pDeviceContext->Map(buffer.pBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+	assert(SUCCEEDED(result));
+	return SUCCEEDED(result) ? subresource.pData : NULL;
+}
+
+HRESULT Renderer::UpdateStructuredBuffer(DynamicStructuredBuffer& buffer, const void* pData, UINT count, UINT stride, const char* name)
+{
+	void* pMapped = MapStructuredBuffer(buffer, count, stride, name);
+	if (pMapped == NULL)
+	{
+		return E_FAIL;
+	}
+	if (count > 0)
+	{
+		memcpy(pMapped, pData, size_t(count) * stride);
+	}
+	m_pDeviceContext->Unmap(buffer.pBuffer, 0);
+	return S_OK;
+}
+
+HRESULT Renderer::CreateUploadRing(UploadRingBuffer& upload, UINT elementCount, UINT stride, const char* name)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.ByteWidth = elementCount * stride;
+	desc.Usage = D3D11_USAGE_DYNAMIC;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+	desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+	desc.StructureByteStride = stride;
+	HRESULT result = m_pDevice->CreateBuffer(&desc, nullptr, &upload.pBuffer);
+	assert(SUCCEEDED(result));
+	if (SUCCEEDED(result))
+	{
+		result = SetResourceName(upload.pBuffer, name);
+	}
+	if (SUCCEEDED(result))
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc = {};
+		viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		viewDesc.Buffer.FirstElement = 0;
+		viewDesc.Buffer.NumElements = elementCount;
+		result = m_pDevice->CreateShaderResourceView(upload.pBuffer, &viewDesc, &upload.pView);
+		assert(SUCCEEDED(result));
+	}
+	upload.ring.Init(SUCCEEDED(result) ? size_t(elementCount) * stride : 0);
+	upload.stride = stride;
+	upload.name = name;
+	upload.discarded = false;
+	return result;
+}
+
+void Renderer::ReleaseUploadRing(UploadRingBuffer& upload)
+{
+	SafeRelease(upload.pView);
+	SafeRelease(upload.pBuffer);
+	upload.ring.Init(0);
+}
+
+void* Renderer::AllocateUpload(UploadRingBuffer& upload, UINT count, UINT& outFirstElement)
+{
+	size_t size = size_t(max(count, 1u)) * upload.stride;
+	size_t offset = 0;
+	D3D11_MAP mapType = D3D11_MAP_WRITE_NO_OVERWRITE;
+	if (!m_noOverwriteUploads || !upload.discarded || !upload.ring.Allocate(size, upload.stride, offset))
+	{
+		if (size > upload.ring.GetCapacity())
+		{
+			// Draws recorded earlier keep the old buffer alive
+			UINT elementCount = UINT(max(upload.ring.GetCapacity() * 2, size) / upload.stride);
+			ReleaseUploadRing(upload);
+			if (FAILED(CreateUploadRing(upload, elementCount, upload.stride, upload.name)))
+			{
+				return NULL;
+			}
+		}
+		// The discarded memory is not read by any frame in flight
+		upload.ring.Reset();
+		upload.ring.Allocate(size, upload.stride, offset);
+		mapType = D3D11_MAP_WRITE_DISCARD;
+		upload.discarded = true;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	HRESULT result = m_pDeviceContext->Map(upload.pBuffer, 0, mapType, 0, &subresource);
+	assert(SUCCEEDED(result));
+	if (FAILED(result))
+	{
+		return NULL;
+	}
+	outFirstElement = UINT(offset / upload.stride);
+	return static_cast<BYTE*>(subresource.pData) + offset;
+}
+
+void Renderer::RetireUploads()
+{
+	while (m_completedFrame + 1 < m_frameIndex)
+	{
+		// The query of the oldest frame is waited for once its slot is needed for the current one
+		bool wait = m_frameIndex - (m_completedFrame + 1) >= FrameQueryCount;
+		HRESULT result = m_pDeviceContext->GetData(m_pFrameQueries[(m_completedFrame + 1) % FrameQueryCount], NULL, 0,
+			wait ? 0 : D3D11_ASYNC_GETDATA_DONOTFLUSH);
+		if (result == S_FALSE)
+		{
+			if (wait)
+				continue;
+			break;
+		}
+		m_completedFrame++;
+	}
+	m_instanceUpload.ring.Retire(m_completedFrame);
+	m_idUpload.ring.Retire(m_completedFrame);
+}
+
+void Renderer::EndUploadFrame()
+{
+	m_pDeviceContext->End(m_pFrameQueries[m_frameIndex % FrameQueryCount]);
+	m_instanceUpload.ring.EndFrame(m_frameIndex);
+	m_idUpload.ring.EndFrame(m_frameIndex);
+	m_frameIndex++;
+}
+
+void Renderer::UpdateSceneBuffer(const SceneBuffer& sceneBuffer)
+{
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	HRESULT result = m_pDeviceContext->Map(m_pSceneBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+	assert(SUCCEEDED(result));
+	if (SUCCEEDED(result))
+	{
+		memcpy(subresource.pData, &sceneBuffer, sizeof(SceneBuffer));
+		m_pDeviceContext->Unmap(m_pSceneBuffer, 0);
+	}
+}
+
+HRESULT Renderer::UploadDrawInstances(UINT& outFirstElement)
+{
+	outFirstElement = 0;
+	if (m_frameInstanceCount == 0)
+	{
+		return S_OK;
+	}
+	InstanceData* pInstances = static_cast<InstanceData*>(AllocateUpload(m_instanceUpload, m_frameInstanceCount, outFirstElement));
+	if (pInstances == NULL)
+	{
+		return E_FAIL;
+	}
+	for (const InstanceSource& source : m_instanceSources)
 	{
-		{ farPlane * tanf(fov / 2),farPlane * tanf(fov / 2) * aspectRatio,farPlane,1 },
-		{ -farPlane * tanf(fov / 2),farPlane * tanf(fov / 2) * aspectRatio,farPlane,1 },
-		{ -farPlane * tanf(fov / 2),-farPlane * tanf(fov / 2) * aspectRatio,farPlane,1 },
-		{ farPlane * tanf(fov / 2),-farPlane * tanf(fov / 2) * aspectRatio,farPlane,1 },
+		if (source.pObjects != nullptr)
+			source.pObjects->WriteInstanceData(pInstances + source.base);
+		else
+			pInstances[source.base] = m_frameInstances[source.instance];
+	}
+	m_pDeviceContext->Unmap(m_instanceUpload.pBuffer, 0);
+	return S_OK;
+}
+
+void Renderer::BindDrawOffsets(const DirectX::XMUINT4& drawOffsets)
+{
+	D3D11_MAPPED_SUBRESOURCE subresource;
+	HRESULT result = m_pDeviceContext->Map(m_pDrawBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
+	assert(SUCCEEDED(result));
+	if (SUCCEEDED(result))
+	{
+		reinterpret_cast<DrawBuffer*>(subresource.pData)->drawOffsets = drawOffsets;
+		m_pDeviceContext->Unmap(m_pDrawBuffer, 0);
+
+		m_stateCache.SetVSConstantBuffer(2, m_pDrawBuffer);
+		m_stateCache.SetVSShaderResource(5, m_instanceUpload.pView);
+		m_stateCache.SetVSShaderResource(6, m_idUpload.pView);
+	}
+}
+
+void Renderer::PushDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const DrawCommand& command)
+{
+	// Geometries are numbered in the order they are first drawn
+	UINT geometry = UINT(std::find(m_drawGeometries.begin(), m_drawGeometries.end(), command.pGeometry) - m_drawGeometries.begin());
+	if (geometry == m_drawGeometries.size())
+	{
+		m_drawGeometries.push_back(command.pGeometry);
+	}
+	UINT64 key = pass == TransparentPass ? DrawKey::MakeBackToFront(pass, permutation, material, geometry, depth) :
+		DrawKey::Make(pass, permutation, material, geometry, depth);
+	m_renderQueue.Push(key, UINT32(m_drawCommands.size()));
+	m_drawCommands.push_back(command);
+}
+
+void Renderer::PushObjectDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const GeometryData& geometry, const ObjectBuffer& obj,
+	const UINT32* pIds, UINT idCount)
+{
+	// Every drawn object buffer is uploaded once per frame
+	auto source = std::find_if(m_instanceSources.begin(), m_instanceSources.end(),
+		[&](const InstanceSource& source) { return source.pObjects == &obj; });
+	if (source == m_instanceSources.end())
+	{
+		m_instanceSources.push_back({ &obj, 0, m_frameInstanceCount });
+		m_frameInstanceCount += UINT(obj.instances.size());
+		source = m_instanceSources.end() - 1;
+	}
+	const DrawCommand command = { &geometry, source->base, UINT(m_drawIds.size()), idCount };
+	m_drawIds.insert(m_drawIds.end(), pIds, pIds + idCount);
+	PushDraw(pass, permutation, material, depth, command);
+}
+
+void Renderer::PushInstanceDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const GeometryData& geometry, const InstanceData& instance)
+{
+	m_instanceSources.push_back({ nullptr, UINT(m_frameInstances.size()), m_frameInstanceCount });
+	m_frameInstances.push_back(instance);
+	const DrawCommand command = { &geometry, m_frameInstanceCount++, UINT(m_drawIds.size()), 1 };
+	m_drawIds.push_back(0);
+	PushDraw(pass, permutation, material, depth, command);
+}
+
+void Renderer::PushSceneDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const GeometryData& geometry, const SceneBuffer& sceneBuffer)
+{
+	const DrawCommand command = { &geometry, 0, UINT(m_drawSceneBuffers.size()), 0 };
+	m_drawSceneBuffers.push_back(sceneBuffer);
+	PushDraw(pass, permutation, material, depth, command);
+}
+
+UINT Renderer::GetDrawPermutation(UINT64 key) const
+{
+	return DrawKey::GetPermutation(key, DrawKey::GetPass(key) == TransparentPass);
+}
+
+PipelineState Renderer::GetPipelineState(UINT pass, UINT permutation) const
+{
+	PipelineState state;
+	switch (pass)
+	{
+	case OpaquePass:
+		state.pDepthStencilState = m_pDepthStateReadWrite;
+		break;
+	case SkyPass:
+		state.pDepthStencilState = m_pDepthStateRead;
+		break;
+	case TransparentPass:
+		state.pDepthStencilState = m_pDepthStateRead;
+		state.pBlendState = m_pTransBlendState;
+		break;
+	}
+	switch (permutation)
+	{
+	case ColorTexturePermutation:
+		state.pInputLayout = m_pColorTextureInputLayout;
+		state.pVertexShader = m_pColorTextureVS;
+		state.pPixelShader = m_pColorTexturePS;
+		break;
+	case SkyboxPermutation:
+		state.pInputLayout = m_pSkyboxInputLayout;
+		state.pVertexShader = m_pSkyboxVS;
+		state.pPixelShader = m_pSkyboxPS;
+		break;
+	case BasePermutation:
+	case TransparentPermutation:
+		state.pInputLayout = m_pBaseInputLayout;
+		state.pVertexShader = m_pBaseVertexShader;
+		state.pPixelShader = permutation == TransparentPermutation ? m_pTransPixelShader : m_pBasePixelShader;
+		break;
+	}
+	return state;
+}
+
+void Renderer::ApplyDrawState(UINT pass, UINT permutation)
+{
+	m_stateCache.SetPipelineState(GetPipelineState(pass, permutation));
+	m_stateCache.SetVSConstantBuffer(0, m_pViewBuffer);
+	m_stateCache.SetPSConstantBuffer(0, m_pViewBuffer);
+	m_stateCache.SetPSSampler(0, m_pTextureSampler);
+	switch (permutation)
+	{
+	case SkyboxPermutation:
+		m_stateCache.SetVSConstantBuffer(1, m_pSceneBuffer);
+		m_stateCache.SetPSShaderResource(0, m_pCubemapTextureView);
+		break;
+	case BasePermutation:
+	case TransparentPermutation:
+		m_stateCache.SetPSShaderResource(0, m_pColorTextureArrayView);
+		m_stateCache.SetPSShaderResource(1, m_pNormalMapArrayView);
+		break;
+	}
+}
+
+void Renderer::SubmitDraws()
+{
+	m_renderQueue.Sort();
+	const DrawItem* pItems = m_renderQueue.GetItems();
+	const UINT itemCount = UINT(m_renderQueue.GetCount());
+	auto mergeable = [&](const DrawItem& first, const DrawItem& next)
+	{
+		const DrawCommand& a = m_drawCommands[first.command];
+		const DrawCommand& b = m_drawCommands[next.command];
+		return CanMergeDraws(first.key, a.pGeometry, a.idCount, next.key, b.pGeometry, b.idCount,
+			DrawKey::GetPass(first.key) == TransparentPass);
 	};
-	for (auto& point : nearPoints)
+	m_drawRuns.clear();
+	UINT idCount = 0;
+	for (UINT i = 0; i < itemCount;)
 	{
-		point = (DirectX::XMMatrixTranslationFromVector(point) * viewTransform).r[3];
+		DrawRun run = { i, 1, idCount, m_drawCommands[pItems[i].command].idCount };
+		while (i + run.itemCount < itemCount && mergeable(pItems[i], pItems[i + run.itemCount]))
+		{
+			run.idCount += m_drawCommands[pItems[i + run.itemCount].command].idCount;
+			run.itemCount++;
+		}
+		m_drawRuns.push_back(run);
+		idCount += run.idCount;
+		i += run.itemCount;
 	}
-	for (auto& point : farPoints)
+
+	// The ids of all runs are generated in item order into one upload, as indices into the instance upload
+	UINT firstInstance = 0;
+	UINT firstId = 0;
+	bool instancesUploaded = SUCCEEDED(UploadDrawInstances(firstInstance));
+	if (instancesUploaded && idCount > 0)
 	{
-		point = (DirectX::XMMatrixTranslationFromVector(point) * viewTransform).r[3];
+		UINT32* pIds = static_cast<UINT32*>(AllocateUpload(m_idUpload, idCount, firstId));
+		instancesUploaded = pIds != NULL;
+		for (UINT i = 0; i < itemCount && instancesUploaded; i++)
+		{
+			const DrawCommand& command = m_drawCommands[pItems[i].command];
+			const UINT32 offset = firstInstance + command.instanceBase;
+			for (UINT k = 0; k < command.idCount; k++)
+				*pIds++ = m_drawIds[command.firstId + k] + offset;
+		}
+		if (instancesUploaded)
+			m_pDeviceContext->Unmap(m_idUpload.pBuffer, 0);
+	}
+
+	m_drawCounters.items = itemCount;
+	m_drawCounters.drawCalls = 0;
+	for (const DrawRun& run : m_drawRuns)
+	{
+		const DrawItem& item = pItems[run.firstItem];
+		const DrawCommand& command = m_drawCommands[item.command];
+		if (command.idCount > 0 && !instancesUploaded)
+			continue;
+		// Every run states all it needs, the cache drops what the previous run already bound
+		ApplyDrawState(DrawKey::GetPass(item.key), GetDrawPermutation(item.key));
+		const GeometryData& geometry = *command.pGeometry;
+		BindGeometry(geometry);
+		if (command.idCount > 0)
+		{
+			BindDrawOffsets({ 0, firstId + run.firstId, 0, 0 });
+			m_pDeviceContext->DrawIndexedInstanced(geometry.indexCount, run.idCount, geometry.firstIndex, geometry.baseVertex, 0);
+		}
+		else
+		{
+			UpdateSceneBuffer(m_drawSceneBuffers[command.firstId]);
+			m_pDeviceContext->DrawIndexed(geometry.indexCount, geometry.firstIndex, geometry.baseVertex);
+		}
+		m_drawCounters.drawCalls++;
 	}
+}
 
-	std::vector<DirectX::XMVECTOR> frustum;
-	frustum.push_back(buildPlane(farPoints[3], farPoints[2], farPoints[1], farPoints[0]));
-	frustum.push_back(buildPlane(nearPoints[0], nearPoints[1], nearPoints[2], nearPoints[3]));
-	frustum.push_back(buildPlane(farPoints[0], farPoints[1], nearPoints[1], nearPoints[0]));
-	frustum.push_back(buildPlane(farPoints[1], farPoints[2], nearPoints[2], nearPoints[1]));
-	frustum.push_back(buildPlane(farPoints[2], farPoints[3], nearPoints[3], nearPoints[2]));
-	frustum.push_back(buildPlane(farPoints[3], farPoints[0], nearPoints[0], nearPoints[3]));
+void Renderer::UpdateLights(const DirectX::XMMATRIX& view, const ClusterProjection& projection)
+{
+	m_lights.clear();
+	ClusterLight light = {};
+	DirectX::XMStoreFloat3(reinterpret_cast<DirectX::XMFLOAT3*>(light.position), pSceneManager.m_lightPos);
+	light.radius = 40.0f;
+	light.color[0] = light.color[1] = light.color[2] = 20.0f;
+	light.color[3] = 1.0f;
+	m_lights.push_back(light);
+
+	DirectX::XMFLOAT4X4 matrix;
+	DirectX::XMStoreFloat4x4(&matrix, view);
+	m_lightClusters.Build(&matrix.m[0][0], projection, m_lights.data(), UINT(m_lights.size()));
+
+	const std::vector<uint32_t>& ranges = m_lightClusters.GetClusterRanges();
+	const std::vector<uint32_t>& indices = m_lightClusters.GetLightIndices();
+	HRESULT result = UpdateStructuredBuffer(m_lightBuffer, m_lights.data(), UINT(m_lights.size()), sizeof(ClusterLight), "LightBuffer");
+	if (SUCCEEDED(result))
+	{
+		result = UpdateStructuredBuffer(m_clusterRangeBuffer, ranges.data(), UINT(ranges.size() / 2), sizeof(UINT32) * 2, "ClusterRangeBuffer");
+	}
+	if (SUCCEEDED(result))
+	{
+		result = UpdateStructuredBuffer(m_clusterLightBuffer, indices.data(), UINT(indices.size()), sizeof(UINT32), "ClusterLightBuffer");
+	}
+	// The light lists stay bound for every pass of the frame
+	m_stateCache.SetPSShaderResource(2, m_lightBuffer.pView);
+	m_stateCache.SetPSShaderResource(3, m_clusterRangeBuffer.pView);
+	m_stateCache.SetPSShaderResource(4, m_clusterLightBuffer.pView);
+}
 
-	return frustum;
+void Renderer::UpdateMaterials()
+{
+	if (m_materialBufferVersion != m_materials.GetVersion())
+	{
+		const std::vector<Material>& materials = m_materials.GetMaterials();
+		HRESULT result = UpdateStructuredBuffer(m_materialBuffer, materials.data(), UINT(materials.size()), sizeof(Material), "MaterialBuffer");
+		if (SUCCEEDED(result))
+			m_materialBufferVersion = m_materials.GetVersion();
+	}
+	m_stateCache.SetPSShaderResource(7, m_materialBuffer.pView);
 }
 
 void Renderer::InitSceneResources() {
-	SceneBuffer sceneBuffer;
 	DirectX::XMMATRIX model = pSceneManager.m_modelTransform;
-	DirectX::XMFLOAT4 lightParams = { 1.0f, 1.0f, 3.0f, 32.0f };
-	DirectX::XMFLOAT4 baseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
-	Instance inst1(model, lightParams, baseColor, 1);
+	Material material;
+	material.modelInfo.x = 1;
+	UINT16 texturedMaterial = m_materials.Add(material);
+	material.modelInfo.x = 0;
+	UINT16 plainMaterial = m_materials.Add(material);
+	Material markerMaterial;
+	markerMaterial.modelInfo = { -1, -1, 0, 0 };
+	m_lightMarkerMaterial = m_materials.Add(markerMaterial);
 	ObjectBuffer objTmp;
 	objTmp.instances.resize(3);
 
-	objTmp.set(0, model, CubeGeometry.vectorsAABB, 1);
+	objTmp.set(0, model, CubeGeometry, texturedMaterial);
 
 	auto tmpp = DirectX::XMMatrixTranslation(1.8f, 0.3f, -1.8f);
-	Instance inst2(tmpp, lightParams, baseColor);
-	objTmp.set(1, tmpp, CubeGeometry.vectorsAABB);
+	objTmp.set(1, tmpp, CubeGeometry, plainMaterial);
 	tmpp = DirectX::XMMatrixTranslation(-8.8f, 0.3f, -8.8f);
-	Instance inst3(tmpp, lightParams, baseColor);
-	objTmp.set(2, tmpp, CubeGeometry.vectorsAABB);
+	objTmp.set(2, tmpp, CubeGeometry, plainMaterial);
 
 	objBuffers.push_back(objTmp);
 
-	std::vector<SceneBuffer> sceneBuffers;
-	baseColor = { 1.0f, 0.0f, 0.0f, 0.4f };
+	material.baseColor = { 1.0f, 0.0f, 0.0f, 0.4f };
+	material.modelInfo.x = 0;
 	model = DirectX::XMMatrixTranslation(-2.125f, 1.0f, -1.25f);
-	Instance redPlane(model, lightParams, baseColor, 0);
-	planeBuffers.instances.push_back(redPlane);
-	lightParams = { 1.0f, 1.0f, 3.0f, 32.0f };
-	baseColor = { 0.0f, 1.0f, 0.0f, 0.4f };
+	planeBuffers.instances.push_back(Instance(model, m_materials.Add(material)));
+	material.baseColor = { 0.0f, 1.0f, 0.0f, 0.4f };
+	material.modelInfo.x = 1;
 	model = DirectX::XMMatrixScaling(2, 2, 2) * DirectX::XMMatrixTranslation(-1.125f, 1.0f, 3.25f);
-	Instance greenPlane(model, lightParams, baseColor, 1);
-	planeBuffers.instances.push_back(greenPlane);
+	planeBuffers.instances.push_back(Instance(model, m_materials.Add(material)));
 }
 
 bool Renderer::Render()
@@ -1115,6 +1487,8 @@ bool Renderer::Render()
 		return false;
 	}
 	m_pDeviceContext->ClearState();
+	m_stateCache.Reset(m_pDeviceContext);
+	RetireUploads();
 	DirectX::XMMATRIX v = DirectX::XMMatrixInverse(nullptr, pSceneManager.m_cameraTransform);
 	float f = 100.0f;
 	float n = 0.1f;
@@ -1129,7 +1503,17 @@ bool Renderer::Render()
 
 	DirectX::XMMATRIX p = DirectX::XMMatrixPerspectiveLH(tanf(fov / 2) * 2 * f, tanf(fov / 2) * 2 * f * aspectRatio, f, n);
 
-	std::vector<DirectX::XMVECTOR> frustum = GetFrustum(n, f, fov, aspectRatio, pSceneManager.m_cameraTransform);
+	DirectX::XMMATRIX vp = DirectX::XMMatrixMultiply(v, p);
+	Frustum frustum;
+	frustum.ExtractFromMatrix(vp);
+
+	ClusterProjection clusterProjection;
+	clusterProjection.tanHalfFovX = tanf(fov / 2);
+	clusterProjection.tanHalfFovY = tanf(fov / 2) * aspectRatio;
+	clusterProjection.nearZ = n;
+	clusterProjection.farZ = f;
+	UpdateLights(v, clusterProjection);
+	UpdateMaterials();
 
 	D3D11_MAPPED_SUBRESOURCE subresource;
 	HRESULT result = m_pDeviceContext->Map(m_pViewBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
@@ -1137,241 +1521,170 @@ bool Renderer::Render()
 	if (SUCCEEDED(result)) {
 		ViewBuffer& viewBuffer = *reinterpret_cast<ViewBuffer*>(subresource.pData);
 
-		viewBuffer.vp = DirectX::XMMatrixMultiply(v, p);
+		viewBuffer.vp = vp;
 		viewBuffer.cameraPosition = pSceneManager.m_cameraTransform.r[3];
 		viewBuffer.ambientColor = { 0.1f, 0.1f, 0.1f, 1 };
-		std::vector<Light> lights;
-		lights.push_back({ pSceneManager.m_lightPos, { 20, 20, 20, 1 } });;
-		int lightCount = int(min(lights.size(), 10));
-		viewBuffer.lightCount = { lightCount, 0, 0, 0 };
-		for (int i = 0; i < lightCount; i++)
-		{
-			viewBuffer.lights[i] = lights[i];
-		}
+		viewBuffer.lightCount = { int(m_lights.size()), 0, 0, 0 };
+		const ClusterGridDesc& grid = m_lightClusters.GetGridDesc();
+		viewBuffer.clusterCounts = { grid.tilesX, grid.tilesY, grid.slices, 0 };
+		viewBuffer.clusterDepth = { 0.0f, 0.0f, 0.0f, 0.0f };
+		m_lightClusters.GetSliceParams(viewBuffer.clusterDepth.x, viewBuffer.clusterDepth.y);
 		m_pDeviceContext->Unmap(m_pViewBuffer, 0);
 	}
-	{
-		ID3D11RenderTargetView* views[] = { m_pColorBufferRTV };
-		m_pDeviceContext->OMSetRenderTargets(1, views, m_pDepthBufferDSV);
-
-		static const FLOAT BackColor[4] = { 0.3f, 0.2f, 0.8f, 1.0f };
-		m_pDeviceContext->ClearRenderTargetView(m_pColorBufferRTV, BackColor);
-		m_pDeviceContext->ClearDepthStencilView(m_pDepthBufferDSV, D3D11_CLEAR_DEPTH, 0.0f, 0);
-	}
-	D3D11_VIEWPORT viewport;
-	viewport.TopLeftX = 0;
-	viewport.TopLeftY = 0;
-	viewport.Width = (FLOAT)m_width;
-	viewport.Height = (FLOAT)m_height;
-	viewport.MinDepth = 0.0f;
-	viewport.MaxDepth = 1.0f;
-	m_pDeviceContext->RSSetViewports(1, &viewport);
-
-	D3D11_RECT rect;
-	rect.left = 0;
-	rect.top = 0;
-	rect.right = m_width;
-	rect.bottom = m_height;
-	m_pDeviceContext->RSSetScissorRects(1, &rect);
 
+	// Draws are collected per system and submitted in the order of their keys
+	m_renderQueue.Clear();
+	m_drawCommands.clear();
+	m_drawIds.clear();
+	m_drawSceneBuffers.clear();
+	m_instanceSources.clear();
+	m_frameInstances.clear();
+	m_frameInstanceCount = 0;
+	DirectX::XMFLOAT4X4 view;
+	DirectX::XMStoreFloat4x4(&view, v);
+	auto viewDepth = [&](float x, float y, float z) { return x * view.m[0][2] + y * view.m[1][2] + z * view.m[2][2] + view.m[3][2]; };
 
 	//light
+	for (const ClusterLight& light : m_lights)
 	{
-		DirectX::XMFLOAT4 lightParams = { 1.0f, 1.0f, 3.0f, 32.0f };
-		DirectX::XMFLOAT4 baseColor = { 1.0f, 1.0f, 1.0f, 1.0f };
-		DirectX::XMMATRIX model = DirectX::XMMatrixScaling(0.2f, 0.2f, 0.2f) * DirectX::XMMatrixTranslationFromVector(pSceneManager.m_lightPos);
-		SceneBuffer sceneBuffer;
-		sceneBuffer.setModel(model);
-		sceneBuffer.lightParams = lightParams;
-		sceneBuffer.baseColor = baseColor;
-
-		m_pDeviceContext->OMSetDepthStencilState(m_pDepthStateReadWrite, 0);
-		m_pDeviceContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
-		m_pDeviceContext->IASetInputLayout(m_pColorTextureInputLayout);
-		m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_pDeviceContext->VSSetShader(m_pColorTextureVS, nullptr, 0);
-		m_pDeviceContext->PSSetShader(m_pColorTexturePS, nullptr, 0);
-		m_pDeviceContext->VSSetConstantBuffers(2, 1, &m_pVisibleBuffer);
-		m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pViewBuffer);
-		m_pDeviceContext->VSSetConstantBuffers(1, 1, &m_pSceneBuffer);
-		m_pDeviceContext->PSSetConstantBuffers(0, 1, &m_pViewBuffer);
-		m_pDeviceContext->PSSetConstantBuffers(1, 1, &m_pSceneBuffer);
-
-		m_pDeviceContext->IASetIndexBuffer(SphereGeometry.pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-		m_pDeviceContext->IASetVertexBuffers(0, 1, SphereGeometry.vertexBuffer, SphereGeometry.strides, SphereGeometry.offsets);
-		m_pDeviceContext->UpdateSubresource(m_pSceneBuffer, 0, nullptr, &sceneBuffer, 0, 0);
-		m_pDeviceContext->DrawIndexed(SphereGeometry.indexCount, 0, 0);
+		// A marker sphere per light, the markers are drawn together by the queue
+		InstanceData marker = {};
+		marker.world[0] = { 0.2f, 0.0f, 0.0f, light.position[0] };
+		marker.world[1] = { 0.0f, 0.2f, 0.0f, light.position[1] };
+		marker.world[2] = { 0.0f, 0.0f, 0.2f, light.position[2] };
+		marker.materialId = m_lightMarkerMaterial;
+		PushInstanceDraw(OpaquePass, ColorTexturePermutation, m_lightMarkerMaterial,
+			DrawKey::QuantizeDepth(viewDepth(light.position[0], light.position[1], light.position[2]), n, f), SphereGeometry, marker);
 	}
 	//Texture
 	{
 		auto curModel = pSceneManager.m_modelTransform;
-		objBuffers[0].instances[1].sceneBuffer.setModel(curModel * DirectX::XMMatrixTranslation(2, 1, 2));
-		m_pDeviceContext->OMSetDepthStencilState(m_pDepthStateReadWrite, 0);
-		m_pDeviceContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
-		m_pDeviceContext->IASetInputLayout(m_pBaseInputLayout);
-		m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_pDeviceContext->VSSetShader(m_pBaseVertexShader, nullptr, 0);
-		m_pDeviceContext->PSSetShader(m_pBasePixelShader, nullptr, 0);
-
-		m_pDeviceContext->VSSetConstantBuffers(2, 1, &m_pVisibleBuffer);
-		m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pViewBuffer);
-		m_pDeviceContext->PSSetConstantBuffers(0, 1, &m_pViewBuffer);
-
-		ID3D11SamplerState* samplers[] = { m_pTextureSampler };
-		m_pDeviceContext->PSSetSamplers(0, 1, samplers);
-		for (auto obj : objBuffers) {
-			D3D11_MAPPED_SUBRESOURCE subresource;
-			result = m_pDeviceContext->Map(m_pVisibleBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-			DirectX::XMUINT4* pVisibleInstIdBuffer = reinterpret_cast<DirectX::XMUINT4*>(subresource.pData);
-			int instCount = obj.instances.size(), visibleInstCount = 0;
-			for (int i = 0; i < instCount; i++)
+		objBuffers[0].setModel(1, curModel * DirectX::XMMatrixTranslation(2, 1, 2));
+		for (auto& obj : objBuffers)
+			obj.Refresh();
+		ContributionParams contribution;
+		contribution.Set(pSceneManager.m_cameraTransform.r[3], fov, aspectRatio, float(m_height), m_minInstancePixelArea);
+		// Only the cubes in the potentially visible set of the camera cell are frustum culled
+		DirectX::XMFLOAT3 cameraPosition;
+		DirectX::XMStoreFloat3(&cameraPosition, pSceneManager.m_cameraTransform.r[3]);
+		int32_t visibilityCell = m_cubeVisibility.GetItemCount() == objBuffers[0].instances.size() ?
+			m_cubeVisibility.FindCell(&cameraPosition.x) : -1;
+		if (visibilityCell != m_visibilityCell)
+		{
+			m_cubeVisibility.GetVisible(visibilityCell, m_visibilityCandidates);
+			m_visibilityCell = visibilityCell;
+		}
+		m_parallelCuller.SetCandidates(0, visibilityCell >= 0 ? &m_visibilityCandidates : nullptr);
+		m_parallelCuller.Cull(frustum, contribution, objBuffers);
+		for (auto& obj : objBuffers)
+			obj.ClearChanges();
+		if (m_maxOccluders > 0)
+			RasterizeOccluders(vp);
+		for (size_t objIdx = 0; objIdx < objBuffers.size(); objIdx++) {
+			const ObjectBuffer& obj = objBuffers[objIdx];
+			const std::vector<UINT32>& frustumVisibleIds = m_parallelCuller.GetVisible(objIdx);
+			m_visibleInstanceIds.assign(frustumVisibleIds.begin(), frustumVisibleIds.end());
+			if (m_maxOccluders > 0)
 			{
-				if (!obj.instances[i].IsVisible(frustum))
-					continue;
-				pVisibleInstIdBuffer[visibleInstCount++].x = UINT32(i);
+				m_visibleInstanceIds.resize(m_occlusionCuller.CullOccluded(obj.GetBVHInput(), m_visibleInstanceIds.data(),
+					UINT32(m_visibleInstanceIds.size())));
 			}
-			m_pDeviceContext->Unmap(m_pVisibleBuffer, 0);
+			UINT visibleInstCount = UINT(m_visibleInstanceIds.size());
 			if (visibleInstCount == 0)
 				continue;
+			obj.SortByMaterial(m_visibleInstanceIds, m_materials.GetCount(), m_materialSortScratch);
 
-			std::vector<SceneBuffer> sceneBuffer;
-			sceneBuffer.reserve(100);
-
-			for (int i = 0; i < instCount; i++)
+			// One draw per material run, keyed on its material so the queue orders the runs of all buffers by
+			// material. SubmitDraws merges consecutive runs of the same geometry back into one instanced draw.
+			for (UINT first = 0; first < visibleInstCount;)
 			{
-				sceneBuffer.push_back(obj.instances[i].sceneBuffer);
+				const UINT16 material = obj.instances[m_visibleInstanceIds[first]].materialId;
+				UINT end = first + 1;
+				while (end < visibleInstCount && obj.instances[m_visibleInstanceIds[end]].materialId == material)
+					end++;
+				// Sorted front to back by the closest box center
+				float nearestDepth = f;
+				for (UINT i = first; i < end; i++)
+				{
+					UINT32 id = m_visibleInstanceIds[i];
+					float depth = viewDepth((obj.bounds.GetMinX()[id] + obj.bounds.GetMaxX()[id]) * 0.5f, (obj.bounds.GetMinY()[id] + obj.bounds.GetMaxY()[id]) * 0.5f,
+						(obj.bounds.GetMinZ()[id] + obj.bounds.GetMaxZ()[id]) * 0.5f);
+					nearestDepth = min(nearestDepth, depth);
+				}
+				PushObjectDraw(OpaquePass, BasePermutation, material, DrawKey::QuantizeDepth(nearestDepth, n, f),
+					CubeGeometry, obj, m_visibleInstanceIds.data() + first, end - first);
+				first = end;
 			}
-
-			m_pDeviceContext->UpdateSubresource(m_pCubesModelBuffer, 0, nullptr, sceneBuffer.data(), 0, 0);
-
-			m_pDeviceContext->PSSetShaderResources(0, 1, &m_pColorTextureArrayView);
-			m_pDeviceContext->PSSetShaderResources(1, 1, &m_pNormalMapArrayView);
-			m_pDeviceContext->IASetIndexBuffer(CubeGeometry.pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-			m_pDeviceContext->IASetVertexBuffers(0, 1, CubeGeometry.vertexBuffer, CubeGeometry.strides, CubeGeometry.offsets);
-			m_pDeviceContext->VSSetConstantBuffers(1, 1, &m_pCubesModelBuffer);
-			m_pDeviceContext->PSSetConstantBuffers(1, 1, &m_pCubesModelBuffer);
-
-			m_pDeviceContext->DrawIndexedInstanced(CubeGeometry.indexCount, visibleInstCount, 0, 0, 0);
 		}
 	}
 	//skybox
 	{
-		
-		m_pDeviceContext->OMSetDepthStencilState(m_pDepthStateRead, 0);
-		m_pDeviceContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
-		m_pDeviceContext->IASetInputLayout(m_pSkyboxInputLayout);
-		m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_pDeviceContext->VSSetShader(m_pSkyboxVS, nullptr, 0);
-		m_pDeviceContext->PSSetShader(m_pSkyboxPS, nullptr, 0);
-		m_pDeviceContext->VSSetConstantBuffers(0, 1, &m_pViewBuffer);
-
-		ID3D11SamplerState* samplers[] = { m_pTextureSampler };
-		m_pDeviceContext->PSSetSamplers(0, 1, samplers);
-		SceneBuffer sceneTransformsBuffer;
-		sceneTransformsBuffer.model = skyboxScale;
-
-		ID3D11ShaderResourceView* resources[] = { m_pCubemapTextureView };
-		m_pDeviceContext->PSSetShaderResources(0, 1, resources);
-
-		m_pDeviceContext->IASetIndexBuffer(m_pSphereIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-		ID3D11Buffer* vertexBuffers[] = { m_pSphereVertexBuffer };
-		UINT strides[] = { sizeof(Vertex) };
-		UINT offsets[] = { 0 };
-		m_pDeviceContext->IASetVertexBuffers(0, 1, vertexBuffers, strides, offsets);
-
-		m_pDeviceContext->UpdateSubresource(m_pSceneBuffer, 0, nullptr, &sceneTransformsBuffer, 0, 0);
-		m_pDeviceContext->DrawIndexed(756, 0, 0);
+		SceneBuffer sceneBuffer;
+		sceneBuffer.model = skyboxScale;
+		PushSceneDraw(SkyPass, SkyboxPermutation, 0, DrawKey::MaxDepth, SphereGeometry, sceneBuffer);
 	}
 	// planes
 	{
-		m_pDeviceContext->OMSetDepthStencilState(m_pDepthStateRead, 0);
-		m_pDeviceContext->OMSetBlendState(m_pTransBlendState, nullptr, 0xFFFFFFFF);
-		m_pDeviceContext->IASetInputLayout(m_pBaseInputLayout);
-		m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_pDeviceContext->VSSetShader(m_pBaseVertexShader, nullptr, 0);
-		m_pDeviceContext->PSSetShader(m_pTransPixelShader, nullptr, 0);
-
-		m_pDeviceContext->VSSetConstantBuffers(2, 1, &m_pVisibleBuffer);
-		m_pDeviceContext->VSSetConstantBuffers(1, 1, &m_pViewBuffer);
-		m_pDeviceContext->PSSetConstantBuffers(1, 1, &m_pViewBuffer);
-
-		ID3D11SamplerState* samplers[] = { m_pTextureSampler };
-		m_pDeviceContext->PSSetSamplers(0, 1, samplers);
-
-		std::vector<std::pair<int, float>> cameraDist;
-		for (int i = 0; i < planeBuffers.instances.size(); i++)
+		// Back to front by the nearest corner of every plane
+		UINT visibleInstCount = UINT(planeBuffers.instances.size());
+		if (visibleInstCount > 0)
 		{
-			float minDist = 0.1;
-			for (size_t j = 0; j < 4; j++)
-			{
-				float x = -1.0f + 2.0f * (j % 2);
-				float y = -1.0f + 2.0f * (j / 2 % 2);
-				float dist = DirectX::XMVectorGetZ((DirectX::XMMatrixTranslation(x, y, 0.0f) * planeBuffers.instances[i].sceneBuffer.model * v).r[3]);
-				if (dist < minDist)
-					minDist = dist;
-			}
-			cameraDist.push_back({ i, minDist });
-		}
-
-		std::stable_sort(cameraDist.begin(), cameraDist.end(), [](const std::pair<int, float>& a, const std::pair<int, float>& b)
-			{
-				return a.second > b.second;
-			});
-
-		{
-			int instCount = planeBuffers.instances.size();
-			int visibleInstCount = 0;
-			D3D11_MAPPED_SUBRESOURCE subresource;
-			ID3D11Buffer* pModelBuffer = m_pCubesModelBuffer;
-			result = m_pDeviceContext->Map(m_pVisibleBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &subresource);
-			DirectX::XMUINT4* pVisibleInstIdBuffer = reinterpret_cast<DirectX::XMUINT4*>(subresource.pData);
-			for (int i = 0; i < instCount; i++)
-			{
-				pVisibleInstIdBuffer[visibleInstCount++].x = UINT32(i);
-			}
-			m_pDeviceContext->Unmap(m_pVisibleBuffer, 0);
-			std::vector<SceneBuffer> sceneBuffers;
-			sceneBuffers.reserve(100);
-			for (int i = 0; i < instCount; i++)
-			{
-				sceneBuffers.push_back(planeBuffers.instances[i].sceneBuffer);
-			}
-			m_pDeviceContext->UpdateSubresource(pModelBuffer, 0, nullptr, sceneBuffers.data(), 0, 0);
-
-			m_pDeviceContext->PSSetShaderResources(0, 1, &m_pColorTextureArrayView);
-			m_pDeviceContext->PSSetShaderResources(1, 1, &m_pNormalMapArrayView);
-
-			m_pDeviceContext->IASetIndexBuffer(PlaneGeometry.pIndexBuffer, DXGI_FORMAT_R16_UINT, 0);
-			m_pDeviceContext->IASetVertexBuffers(0, 1, PlaneGeometry.vertexBuffer, PlaneGeometry.strides, PlaneGeometry.offsets);
-			m_pDeviceContext->VSSetConstantBuffers(1, 1, &pModelBuffer);
-			m_pDeviceContext->PSSetConstantBuffers(1, 1, &pModelBuffer);
-			m_pDeviceContext->DrawIndexedInstanced(PlaneGeometry.indexCount, visibleInstCount, 0, 0, 0);
-
+			m_transparencySorter.Sort(&planeBuffers.instances[0].model, sizeof(Instance), visibleInstCount, v, 1.0f, 1.0f, 0.1f);
+			const std::vector<UINT32>& order = m_transparencySorter.GetOrder();
+			PushObjectDraw(TransparentPass, TransparentPermutation, 0, DrawKey::QuantizeDepth(m_transparencySorter.GetDepths()[order[0]], n, f),
+				PlaneGeometry, planeBuffers, order.data(), visibleInstCount);
 		}
 	}
 
+	m_frameGraph.Reset();
+	const UINT32 backBuffer = m_frameGraph.Import("BackBuffer");
+	const UINT32 colorBuffer = m_frameGraph.CreateTransient("ColorBuffer",
+		{ m_width, m_height, DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE });
+	const UINT32 depthBuffer = m_frameGraph.CreateTransient("DepthBuffer", { m_width, m_height, DXGI_FORMAT_D32_FLOAT, D3D11_BIND_DEPTH_STENCIL });
+	const UINT32 scenePass = m_frameGraph.AddPass("Scene", [&]()
+	{
+		ID3D11RenderTargetView* pColorRTV = GetRenderTargetView(colorBuffer);
+		ID3D11DepthStencilView* pDepthDSV = m_transientTargets[m_frameGraph.GetSlot(depthBuffer)].pDSV;
+		m_pDeviceContext->OMSetRenderTargets(1, &pColorRTV, pDepthDSV);
+
+		static const FLOAT BackColor[4] = { 0.3f, 0.2f, 0.8f, 1.0f };
+		m_pDeviceContext->ClearRenderTargetView(pColorRTV, BackColor);
+		m_pDeviceContext->ClearDepthStencilView(pDepthDSV, D3D11_CLEAR_DEPTH, 0.0f, 0);
+		SetFullscreenViewport();
+		SubmitDraws();
+	});
+	m_frameGraph.Write(scenePass, colorBuffer);
+	m_frameGraph.Write(scenePass, depthBuffer);
+
+	auto postprocPass = [&](ID3D11PixelShader* pPostprocPixelShader)
 	{
-		ID3D11PixelShader* pPostprocPixelShader;
-		if (pSceneManager.enablePostproc)
-			pPostprocPixelShader = m_pGrayPostprocPixelShader;
-		else
-			pPostprocPixelShader = m_pPostprocPixelShader;
 		ID3D11RenderTargetView* views[] = { m_pBackBufferRTV };
 		m_pDeviceContext->OMSetRenderTargets(1, views, nullptr);
-		ID3D11SamplerState* samplers[] = { m_pTextureSampler };
-		m_pDeviceContext->PSSetSamplers(0, 1, samplers);
-
-		ID3D11ShaderResourceView* resources[] = { m_pColorBufferSRV };
-		m_pDeviceContext->PSSetShaderResources(0, 1, resources);
-		m_pDeviceContext->OMSetDepthStencilState(nullptr, 0);
-		m_pDeviceContext->RSSetState(nullptr);
-		m_pDeviceContext->OMSetBlendState(nullptr, nullptr, 0xFFFFFFFF);
-		m_pDeviceContext->IASetInputLayout(nullptr);
-		m_pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-		m_pDeviceContext->VSSetShader(m_pPostprocVertexShader, nullptr, 0);
-		m_pDeviceContext->PSSetShader(pPostprocPixelShader, nullptr, 0);
+		SetFullscreenViewport();
+		m_stateCache.SetPSSampler(0, m_pTextureSampler);
+		m_stateCache.SetPSShaderResource(0, m_transientTargets[m_frameGraph.GetSlot(colorBuffer)].pSRV);
+		PipelineState state;
+		state.pVertexShader = m_pPostprocVertexShader;
+		state.pPixelShader = pPostprocPixelShader;
+		m_stateCache.SetPipelineState(state);
 		m_pDeviceContext->Draw(3, 0);
+	};
+	if (pSceneManager.enablePostproc)
+	{
+		const UINT32 pass = m_frameGraph.AddPass("Postproc", [&]() { postprocPass(m_pGrayPostprocPixelShader); });
+		m_frameGraph.Read(pass, colorBuffer);
+		m_frameGraph.Write(pass, backBuffer);
+	}
+	else
+	{
+		// Same format and size, the scene goes straight into the back buffer
+		m_frameGraph.AddCopyPass("Copy", colorBuffer, backBuffer, [&]() { postprocPass(m_pPostprocPixelShader); });
 	}
+	m_frameGraph.Compile();
+	result = SetupTransientTargets();
+	if (SUCCEEDED(result))
+		m_frameGraph.Execute();
+	EndUploadFrame();
 	result = m_pSwapChain->Present(0, 0);
 
 	return SUCCEEDED(result);
@@ -1382,12 +1695,8 @@ bool Renderer::Resize(UINT width, UINT height)
 {
 	if (width != m_width || height != m_height)
 	{
-		SafeRelease(m_pColorBufferSRV);
-		SafeRelease(m_pColorBufferRTV);
-		SafeRelease(m_pColorBuffer);
+		ReleaseTransientTargets();
 		SafeRelease(m_pBackBufferRTV);
-		SafeRelease(m_pDepthBufferDSV);
-		SafeRelease(m_pDepthBuffer);
 
 		HRESULT result = m_pSwapChain->ResizeBuffers(2, width, height, DXGI_FORMAT_R8G8B8A8_UNORM, 0);
 		if (!SUCCEEDED(result))
@@ -1397,105 +1706,104 @@ bool Renderer::Resize(UINT width, UINT height)
 
 		
 		result = SetupBackBuffer();
-		assert(SUCCEEDED(result));
-		result = SetupDepthBuffer();
-		assert(SUCCEEDED(result));
-		result = SetupColorBuffer();
 		return SUCCEEDED(result);
 	}
 
 	return true;
 }
 
-HRESULT Renderer::SetupColorBuffer()
+HRESULT Renderer::SetupTransientTargets()
 {
-	SafeRelease(m_pColorBufferSRV);
-	SafeRelease(m_pColorBufferRTV);
-	SafeRelease(m_pColorBuffer);
+	const std::vector<TransientDesc>& slots = m_frameGraph.GetSlots();
 	HRESULT result = S_OK;
-	if (SUCCEEDED(result))
+	for (size_t i = slots.size(); i < m_transientTargets.size(); i++)
+		ReleaseTransientTarget(m_transientTargets[i]);
+	m_transientTargets.resize(slots.size());
+	for (size_t i = 0; i < slots.size() && SUCCEEDED(result); i++)
 	{
+		TransientTarget& target = m_transientTargets[i];
+		if (target.pTexture != NULL && target.desc == slots[i])
+			continue;
+		ReleaseTransientTarget(target);
+		target.desc = slots[i];
+
 		D3D11_TEXTURE2D_DESC desc;
-		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+		desc.Format = DXGI_FORMAT(target.desc.format);
 		desc.ArraySize = 1;
 		desc.MipLevels = 1;
 		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+		desc.BindFlags = target.desc.bindFlags;
 		desc.CPUAccessFlags = 0;
 		desc.MiscFlags = 0;
 		desc.SampleDesc.Count = 1;
 		desc.SampleDesc.Quality = 0;
-		desc.Height = m_height;
-		desc.Width = m_width;
-		result = m_pDevice->CreateTexture2D(&desc, nullptr, &m_pColorBuffer);
+		desc.Height = target.desc.height;
+		desc.Width = target.desc.width;
+		result = m_pDevice->CreateTexture2D(&desc, nullptr, &target.pTexture);
 		assert(SUCCEEDED(result));
 		if (SUCCEEDED(result))
 		{
-			result = SetResourceName(m_pColorBuffer, "ColorBuffer");
+			result = SetResourceName(target.pTexture, "TransientTarget");
 		}
-	}
-	if (SUCCEEDED(result))
-	{
-		result = m_pDevice->CreateRenderTargetView(m_pColorBuffer, nullptr, &m_pColorBufferRTV);
-		assert(SUCCEEDED(result));
-		if (SUCCEEDED(result))
+		if (SUCCEEDED(result) && (desc.BindFlags & D3D11_BIND_RENDER_TARGET))
 		{
-			result = SetResourceName(m_pColorBufferRTV, "ColorBufferRTV");
+			result = m_pDevice->CreateRenderTargetView(target.pTexture, nullptr, &target.pRTV);
+			assert(SUCCEEDED(result));
 		}
-	}
-	if (SUCCEEDED(result))
-	{
-		D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
-		desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-		desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		desc.Texture2D.MipLevels = 1;
-		desc.Texture2D.MostDetailedMip = 0;
-		result = m_pDevice->CreateShaderResourceView(m_pColorBuffer, &desc, &m_pColorBufferSRV);
-		assert(SUCCEEDED(result));
-		if (SUCCEEDED(result))
+		if (SUCCEEDED(result) && (desc.BindFlags & D3D11_BIND_SHADER_RESOURCE))
 		{
-			result = SetResourceName(m_pColorBufferSRV, "ColorBufferSRV");
+			result = m_pDevice->CreateShaderResourceView(target.pTexture, nullptr, &target.pSRV);
+			assert(SUCCEEDED(result));
+		}
+		if (SUCCEEDED(result) && (desc.BindFlags & D3D11_BIND_DEPTH_STENCIL))
+		{
+			result = m_pDevice->CreateDepthStencilView(target.pTexture, nullptr, &target.pDSV);
+			assert(SUCCEEDED(result));
 		}
 	}
 	return result;
 }
 
-HRESULT Renderer::SetupDepthBuffer()
+void Renderer::ReleaseTransientTarget(TransientTarget& target)
 {
-	SafeRelease(m_pDepthBufferDSV);
-	SafeRelease(m_pDepthBuffer);
-	HRESULT result = S_OK;
-	if (SUCCEEDED(result))
-	{
-		D3D11_TEXTURE2D_DESC desc;
-		desc.Format = DXGI_FORMAT_D32_FLOAT;
-		desc.ArraySize = 1;
-		desc.BindFlags = D3D11_BIND_DEPTH_STENCIL;
-		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = 0;
-		desc.SampleDesc.Count = 1;
-		desc.SampleDesc.Quality = 0;
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.Height = m_height;
-		desc.Width = m_width;
-		desc.MipLevels = 1;
-		result = m_pDevice->CreateTexture2D(&desc, nullptr, &m_pDepthBuffer);
-		assert(SUCCEEDED(result));
-		if (SUCCEEDED(result))
-		{
-			result = SetResourceName(m_pDepthBuffer, "DepthBuffer");
-		}
-	}
-	if (SUCCEEDED(result))
-	{
-		result = m_pDevice->CreateDepthStencilView(m_pDepthBuffer, nullptr, &m_pDepthBufferDSV);
-		assert(SUCCEEDED(result));
-		if (SUCCEEDED(result))
-		{
-			result = SetResourceName(m_pDepthBufferDSV, "pDepthBufferDSV");
-		}
-	}
-	return result;
+	SafeRelease(target.pRTV);
+	SafeRelease(target.pSRV);
+	SafeRelease(target.pDSV);
+	SafeRelease(target.pTexture);
+}
+
+void Renderer::ReleaseTransientTargets()
+{
+	for (TransientTarget& target : m_transientTargets)
+		ReleaseTransientTarget(target);
+	m_transientTargets.clear();
+}
+
+ID3D11RenderTargetView* Renderer::GetRenderTargetView(UINT32 resource) const
+{
+	// The back buffer is the only imported resource
+	if (m_frameGraph.IsImported(resource))
+		return m_pBackBufferRTV;
+	return m_transientTargets[m_frameGraph.GetSlot(resource)].pRTV;
+}
+
+void Renderer::SetFullscreenViewport()
+{
+	D3D11_VIEWPORT viewport;
+	viewport.TopLeftX = 0;
+	viewport.TopLeftY = 0;
+	viewport.Width = (FLOAT)m_width;
+	viewport.Height = (FLOAT)m_height;
+	viewport.MinDepth = 0.0f;
+	viewport.MaxDepth = 1.0f;
+	m_pDeviceContext->RSSetViewports(1, &viewport);
+
+	D3D11_RECT rect;
+	rect.left = 0;
+	rect.top = 0;
+	rect.right = m_width;
+	rect.bottom = m_height;
+	m_pDeviceContext->RSSetScissorRects(1, &rect);
 }
 
 HRESULT Renderer::SetupBackBuffer()
@@ -10,6 +10,17 @@
 #include "SceneManager.h"
 #include "LoadDDS.h"
 #include "GeometryData.h"
+#include "GeometryPool.h"
+#include "PrimitiveLibrary.h"
+#include "ParallelCuller.h"
+#include "OcclusionCuller.h"
+#include "PotentiallyVisibleSet.h"
+#include "LightClusters.h"
+#include "UploadRing.h"
+#include "RenderQueue.h"
+#include "TransparencySorter.h"
+#include "StateCache.h"
+#include "FrameGraph.h"
 
 class Renderer {
 public:
@@ -27,6 +38,16 @@ public:
     bool Render();
     bool Resize(UINT width, UINT height);
     bool IsRunning() { return m_isRunning; }
+    struct DrawCounters
+    {
+        UINT items = 0; // queued draw items
+        UINT drawCalls = 0; // issued after merging
+    };
+    // Of the last rendered frame
+    const DrawCounters& GetDrawCounters() const { return m_drawCounters; }
+    const StateCache::Counters& GetStateCounters() const { return m_stateCache.GetCounters(); }
+    // Reuse and plane hit rates, volume and contribution culled instances and culling time
+    const CullStats& GetCullStats() const { return m_parallelCuller.GetLastStats(); }
     ~Renderer();
 private:
     Renderer() {};
@@ -36,7 +57,90 @@ private:
         ID3DBlob** ppCode = nullptr,  D3D_SHADER_MACRO* macros = nullptr);
     HRESULT SetupBackBuffer();
     HRESULT SetupDepthBlend();
-    HRESULT SetupColorBuffer();
+    // Textures of the transient slots of the compiled frame graph, kept while the slot descriptions do not change
+    HRESULT SetupTransientTargets();
+    void ReleaseTransientTargets();
+    // Of a color resource of the compiled frame graph
+    ID3D11RenderTargetView* GetRenderTargetView(UINT32 resource) const;
+    void SetFullscreenViewport();
+    void BindGeometry(const GeometryData& geometry);
+    void RasterizeOccluders(const DirectX::XMMATRIX& viewProjection);
+    void BakeVisibility();
+    struct DynamicStructuredBuffer
+    {
+        ID3D11Buffer* pBuffer = NULL;
+        ID3D11ShaderResourceView* pView = NULL;
+        UINT capacity = 0; // elements
+    };
+    // Recreates the buffer when it is too small, at least one element is always allocated. Returns the
+    // discarded contents for writing, NULL on failure; the caller unmaps the buffer.
+    void* MapStructuredBuffer(DynamicStructuredBuffer& buffer, UINT count, UINT stride, const char* name);
+    HRESULT UpdateStructuredBuffer(DynamicStructuredBuffer& buffer, const void* pData, UINT count, UINT stride, const char* name);
+    // Frame scoped upload memory: an UploadRing suballocates the buffer, which is mapped with NO_OVERWRITE.
+    // A frame's allocations are reused once the event query issued at its end has passed on the GPU.
+    struct UploadRingBuffer
+    {
+        UploadRing ring;
+        ID3D11Buffer* pBuffer = NULL;
+        ID3D11ShaderResourceView* pView = NULL;
+        UINT stride = 0;
+        const char* name = "";
+        bool discarded = false; // the first map of a new buffer discards
+    };
+    HRESULT CreateUploadRing(UploadRingBuffer& upload, UINT elementCount, UINT stride, const char* name);
+    void ReleaseUploadRing(UploadRingBuffer& upload);
+    // Maps count elements for writing, NULL on failure; the caller unmaps the buffer. A full ring discards its
+    // buffer and starts over, a too small one is recreated.
+    void* AllocateUpload(UploadRingBuffer& upload, UINT count, UINT& outFirstElement);
+    void RetireUploads();
+    void EndUploadFrame();
+    void UpdateSceneBuffer(const SceneBuffer& sceneBuffer);
+    // Writes the instances of the frame's draws into the instance upload ring in one allocation
+    HRESULT UploadDrawInstances(UINT& outFirstElement);
+    void BindDrawOffsets(const DirectX::XMUINT4& drawOffsets);
+    // Passes and permutations in the order they are submitted, their values are fields of the draw keys
+    enum RenderPass
+    {
+        OpaquePass,
+        SkyPass, // behind every opaque pixel
+        TransparentPass
+    };
+    enum ShaderPermutation
+    {
+        ColorTexturePermutation,
+        BasePermutation,
+        SkyboxPermutation,
+        TransparentPermutation
+    };
+    // The pass and permutation of a command are in its key
+    struct DrawCommand
+    {
+        const GeometryData* pGeometry;
+        // Drawn instances: idCount ids from firstId in m_drawIds, relative to instanceBase in the frame's instances.
+        // Draws without instancing have no ids, their firstId indexes m_drawSceneBuffers.
+        UINT instanceBase;
+        UINT firstId;
+        UINT idCount;
+    };
+    // Queues the command, transparent draws are ordered back to front and the rest by state and front to back
+    void PushDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const DrawCommand& command);
+    // Queues an instanced draw of the ids of the object buffer
+    void PushObjectDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const GeometryData& geometry, const ObjectBuffer& obj,
+        const UINT32* pIds, UINT idCount);
+    // Queues a draw of a single instance, it is merged with the neighbouring draws of the same state
+    void PushInstanceDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const GeometryData& geometry, const InstanceData& instance);
+    // Queues a draw without instancing of the scene buffer
+    void PushSceneDraw(UINT pass, UINT permutation, UINT material, UINT32 depth, const GeometryData& geometry, const SceneBuffer& sceneBuffer);
+    UINT GetDrawPermutation(UINT64 key) const;
+    PipelineState GetPipelineState(UINT pass, UINT permutation) const;
+    // Binds the pipeline state and the resources shared by the draws of the permutation
+    void ApplyDrawState(UINT pass, UINT permutation);
+    // Sorts the queue and draws it. Consecutive instanced items of the same pass, permutation and geometry become one draw over their concatenated ids.
+    void SubmitDraws();
+    void ReleaseStructuredBuffer(DynamicStructuredBuffer& buffer);
+    void UpdateLights(const DirectX::XMMATRIX& view, const ClusterProjection& projection);
+    // Uploads the material table when materials were added and binds it for the base pixel shaders
+    void UpdateMaterials();
     bool Update();
 
     unsigned int m_width = 1280;
@@ -46,10 +150,10 @@ private:
     ID3D11DeviceContext* m_pDeviceContext = NULL;
     ID3D11RenderTargetView* m_pBackBufferRTV = NULL;
 
-    ID3D11Buffer * m_pSphereVertexBuffer = NULL;
-    ID3D11Buffer * m_pSphereIndexBuffer = NULL;
-    ID3D11Buffer * m_pCubeVertexBuffer = NULL;
-    ID3D11Buffer * m_pCubeIndexBuffer = NULL;
+    GeometryPool m_positionGeometryPool;
+    GeometryPool m_meshGeometryPool;
+    PrimitiveLibrary m_primitiveLibrary;
+    StateCache m_stateCache; // every binding of Render goes through it
 
     ID3D11Buffer* m_pSceneBuffer = NULL;
     ID3D11Buffer* m_pViewBuffer = NULL;
@@ -63,14 +167,10 @@ private:
     ID3D11Texture2D* m_pCubemapTexture = NULL;
     ID3D11ShaderResourceView* m_pCubemapTextureView = NULL;
     //
-    ID3D11Texture2D* m_pDepthBuffer = NULL;
-    ID3D11DepthStencilView* m_pDepthBufferDSV = NULL;
     ID3D11DepthStencilState* m_pDepthStateReadWrite = NULL;
     ID3D11DepthStencilState* m_pDepthStateRead = NULL;
 
     ID3D11BlendState* m_pTransBlendState = NULL;
-    ID3D11Buffer* m_pPlaneVertexBuffer = NULL;
-    ID3D11Buffer* m_pPlaneIndexBuffer = NULL;
     ID3D11PixelShader* m_pColorTexturePS = NULL;
     ID3D11VertexShader* m_pColorTextureVS = NULL;
     ID3D11InputLayout* m_pColorTextureInputLayout = NULL;
@@ -86,7 +186,76 @@ private:
     ID3D11PixelShader* m_pTransPixelShader = NULL;
 
     ID3D11Buffer* m_pDefaultModelBuffer = NULL;
-    ID3D11Buffer* m_pVisibleBuffer = NULL;
+    ID3D11Buffer* m_pDrawBuffer = NULL;
+    UploadRingBuffer m_instanceUpload;
+    UploadRingBuffer m_idUpload;
+    static const UINT FrameQueryCount = 4;
+    ID3D11Query* m_pFrameQueries[FrameQueryCount] = {};
+    UINT64 m_frameIndex = 1; // fence of the frame being recorded
+    UINT64 m_completedFrame = 0;
+    bool m_noOverwriteUploads = false; // NO_OVERWRITE maps of shader resource buffers need driver support
+    ParallelCuller m_parallelCuller;
+    // Instances covering less than this many pixels are not drawn, 0 keeps everything
+    float m_minInstancePixelArea = 4.0f;
+
+    struct OccluderCandidate
+    {
+        float score; // squared box diagonal over squared distance
+        UINT buffer;
+        UINT32 instance;
+    };
+    static const UINT OcclusionWidth = 320;
+    static const UINT OcclusionHeight = 180;
+    OcclusionCuller m_occlusionCuller;
+    OccluderMesh m_cubeOccluder;
+    // Largest frustum visible cubes rasterized as occluders each frame, 0 disables occlusion culling
+    UINT m_maxOccluders = 16;
+    RenderQueue m_renderQueue;
+    std::vector<DrawCommand> m_drawCommands; // indexed by the queued items
+    std::vector<const GeometryData*> m_drawGeometries; // position is the geometry field of the keys
+    std::vector<UINT32> m_drawIds;
+    std::vector<SceneBuffer> m_drawSceneBuffers;
+    // The frame's instances in upload order: whole object buffers and single instances of m_frameInstances
+    struct InstanceSource
+    {
+        const ObjectBuffer* pObjects;
+        UINT instance; // in m_frameInstances without an object buffer
+        UINT base;
+    };
+    std::vector<InstanceSource> m_instanceSources;
+    std::vector<InstanceData> m_frameInstances;
+    UINT m_frameInstanceCount = 0;
+    struct DrawRun
+    {
+        UINT firstItem;
+        UINT itemCount;
+        UINT firstId; // in the frame's id upload
+        UINT idCount;
+    };
+    std::vector<DrawRun> m_drawRuns;
+    TransparencySorter m_transparencySorter;
+    DrawCounters m_drawCounters;
+    std::vector<OccluderCandidate> m_occluderCandidates;
+    std::vector<UINT32> m_visibleInstanceIds;
+    // From-cell visibility of the cube buffer, baked once the scene is built. Outside of its region the whole
+    // buffer is frustum culled.
+    PotentiallyVisibleSet m_cubeVisibility;
+    int32_t m_visibilityCell = -1; // the candidates are only decoded when the camera changes cells
+    std::vector<UINT32> m_visibilityCandidates;
+
+    // Point lights of the frame, assigned to view clusters. A light only costs the pixels inside its radius.
+    std::vector<ClusterLight> m_lights;
+    UINT16 m_lightMarkerMaterial = 0;
+    LightClusterBuilder m_lightClusters;
+    DynamicStructuredBuffer m_lightBuffer;
+    DynamicStructuredBuffer m_clusterRangeBuffer;
+    DynamicStructuredBuffer m_clusterLightBuffer;
+
+    // Shading parameters referenced by the instances, visible ids are drawn in material order
+    MaterialTable m_materials;
+    DynamicStructuredBuffer m_materialBuffer;
+    UINT m_materialBufferVersion = 0;
+    std::vector<UINT32> m_materialSortScratch;
 
     ID3D11Texture2D* m_pColorTextureArray = NULL;
     ID3D11ShaderResourceView* m_pColorTextureArrayView = NULL;
@@ -96,12 +265,18 @@ private:
 
     ID3D11PixelShader* m_pGrayPostprocPixelShader = NULL;
 
-    ID3D11Buffer* m_pCubesModelBuffer = NULL;
-    ID3D11Buffer* m_pSpheresModelBuffer = NULL;
+    struct TransientTarget
+    {
+        TransientDesc desc = {};
+        ID3D11Texture2D* pTexture = NULL;
+        ID3D11RenderTargetView* pRTV = NULL;
+        ID3D11ShaderResourceView* pSRV = NULL;
+        ID3D11DepthStencilView* pDSV = NULL;
+    };
+    static void ReleaseTransientTarget(TransientTarget& target);
 
-    ID3D11Texture2D* m_pColorBuffer = NULL;
-    ID3D11RenderTargetView* m_pColorBufferRTV = NULL;
-    ID3D11ShaderResourceView* m_pColorBufferSRV = NULL;
+    FrameGraph m_frameGraph; // scene and postprocess passes, rebuilt every frame
+    std::vector<TransientTarget> m_transientTargets; // by slot
 
     GeometryData SphereGeometry;
     GeometryData CubeGeometry;
@@ -109,7 +284,5 @@ private:
     vector<ObjectBuffer> objBuffers;
     ObjectBuffer planeBuffers;
 
-    HRESULT SetupDepthBuffer();
-
     bool m_isRunning = false;
 };
@@ -0,0 +1,108 @@
+#include "StateCache.h"
+
+void StateCache::Reset(ID3D11DeviceContext* pContext)
+{
+	*this = StateCache();
+	m_pContext = pContext;
+	// ClearState leaves no topology
+	m_pipeline.topology = D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED;
+}
+
+bool StateCache::Update(bool changed)
+{
+	if (changed)
+		m_counters.issued++;
+	else
+		m_counters.skipped++;
+	return changed;
+}
+
+void StateCache::SetPipelineState(const PipelineState& state)
+{
+	if (Update(state.pInputLayout != m_pipeline.pInputLayout))
+		m_pContext->IASetInputLayout(state.pInputLayout);
+	if (Update(state.topology != m_pipeline.topology))
+		m_pContext->IASetPrimitiveTopology(state.topology);
+	if (Update(state.pVertexShader != m_pipeline.pVertexShader))
+		m_pContext->VSSetShader(state.pVertexShader, nullptr, 0);
+	if (Update(state.pPixelShader != m_pipeline.pPixelShader))
+		m_pContext->PSSetShader(state.pPixelShader, nullptr, 0);
+	if (Update(state.pBlendState != m_pipeline.pBlendState))
+		m_pContext->OMSetBlendState(state.pBlendState, nullptr, 0xFFFFFFFF);
+	if (Update(state.pDepthStencilState != m_pipeline.pDepthStencilState))
+		m_pContext->OMSetDepthStencilState(state.pDepthStencilState, 0);
+	if (Update(state.pRasterizerState != m_pipeline.pRasterizerState))
+		m_pContext->RSSetState(state.pRasterizerState);
+	m_pipeline = state;
+}
+
+void StateCache::SetVertexBuffer(ID3D11Buffer* pBuffer, UINT stride, UINT offset)
+{
+	if (Update(pBuffer != m_pVertexBuffer || stride != m_vertexStride || offset != m_vertexOffset))
+	{
+		m_pContext->IASetVertexBuffers(0, 1, &pBuffer, &stride, &offset);
+		m_pVertexBuffer = pBuffer;
+		m_vertexStride = stride;
+		m_vertexOffset = offset;
+	}
+}
+
+void StateCache::SetIndexBuffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format)
+{
+	if (Update(pBuffer != m_pIndexBuffer || format != m_indexFormat))
+	{
+		m_pContext->IASetIndexBuffer(pBuffer, format, 0);
+		m_pIndexBuffer = pBuffer;
+		m_indexFormat = format;
+	}
+}
+
+void StateCache::SetVSConstantBuffer(UINT slot, ID3D11Buffer* pBuffer)
+{
+	assert(slot < ConstantBufferSlots);
+	if (Update(pBuffer != m_vertexStage.constantBuffers[slot]))
+	{
+		m_pContext->VSSetConstantBuffers(slot, 1, &pBuffer);
+		m_vertexStage.constantBuffers[slot] = pBuffer;
+	}
+}
+
+void StateCache::SetPSConstantBuffer(UINT slot, ID3D11Buffer* pBuffer)
+{
+	assert(slot < ConstantBufferSlots);
+	if (Update(pBuffer != m_pixelStage.constantBuffers[slot]))
+	{
+		m_pContext->PSSetConstantBuffers(slot, 1, &pBuffer);
+		m_pixelStage.constantBuffers[slot] = pBuffer;
+	}
+}
+
+void StateCache::SetVSShaderResource(UINT slot, ID3D11ShaderResourceView* pView)
+{
+	assert(slot < ShaderResourceSlots);
+	if (Update(pView != m_vertexStage.shaderResources[slot]))
+	{
+		m_pContext->VSSetShaderResources(slot, 1, &pView);
+		m_vertexStage.shaderResources[slot] = pView;
+	}
+}
+
+void StateCache::SetPSShaderResource(UINT slot, ID3D11ShaderResourceView* pView)
+{
+	assert(slot < ShaderResourceSlots);
+	if (Update(pView != m_pixelStage.shaderResources[slot]))
+	{
+		m_pContext->PSSetShaderResources(slot, 1, &pView);
+		m_pixelStage.shaderResources[slot] = pView;
+	}
+}
+
+void StateCache::SetPSSampler(UINT slot, ID3D11SamplerState* pSampler)
+{
+	assert(slot < SamplerSlots);
+	if (Update(pSampler != m_pixelSamplers[slot]))
+	{
+		m_pContext->PSSetSamplers(slot, 1, &pSampler);
+		m_pixelSamplers[slot] = pSampler;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include "framework.h"
+
+// Shaders, input layout and fixed function state of a draw, bound together by StateCache::SetPipelineState
+struct PipelineState
+{
+	ID3D11InputLayout* pInputLayout = nullptr;
+	D3D11_PRIMITIVE_TOPOLOGY topology = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+	ID3D11VertexShader* pVertexShader = nullptr;
+	ID3D11PixelShader* pPixelShader = nullptr;
+	ID3D11BlendState* pBlendState = nullptr; // default blend factor and sample mask
+	ID3D11DepthStencilState* pDepthStencilState = nullptr; // stencil reference 0
+	ID3D11RasterizerState* pRasterizerState = nullptr;
+};
+
+// Shadow of the device context bindings that drops calls which would not change them. The shadow starts from
+// the cleared context, so Reset follows every ClearState. Bindings the runtime removes on its own, like the
+// shader resource view of a texture later bound as render target, are not seen by the shadow.
+class StateCache
+{
+public:
+	static const UINT ConstantBufferSlots = 4;
+	static const UINT ShaderResourceSlots = 8;
+	static const UINT SamplerSlots = 2;
+
+	struct Counters
+	{
+		UINT issued = 0; // calls passed to the context
+		UINT skipped = 0; // calls dropped as redundant
+	};
+
+	// Clears the shadow and the counters
+	void Reset(ID3D11DeviceContext* pContext);
+
+	void SetPipelineState(const PipelineState& state);
+	void SetVertexBuffer(ID3D11Buffer* pBuffer, UINT stride, UINT offset);
+	void SetIndexBuffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format);
+	void SetVSConstantBuffer(UINT slot, ID3D11Buffer* pBuffer);
+	void SetPSConstantBuffer(UINT slot, ID3D11Buffer* pBuffer);
+	void SetVSShaderResource(UINT slot, ID3D11ShaderResourceView* pView);
+	void SetPSShaderResource(UINT slot, ID3D11ShaderResourceView* pView);
+	void SetPSSampler(UINT slot, ID3D11SamplerState* pSampler);
+
+	const Counters& GetCounters() const { return m_counters; }
+
+private:
+	// Counts the call and tells whether it is issued
+	bool Update(bool changed);
+
+	struct Stage
+	{
+		ID3D11Buffer* constantBuffers[ConstantBufferSlots];
+		ID3D11ShaderResourceView* shaderResources[ShaderResourceSlots];
+	};
+
+	ID3D11DeviceContext* m_pContext = nullptr;
+	PipelineState m_pipeline;
+	ID3D11Buffer* m_pVertexBuffer = nullptr;
+	UINT m_vertexStride = 0;
+	UINT m_vertexOffset = 0;
+	ID3D11Buffer* m_pIndexBuffer = nullptr;
+	DXGI_FORMAT m_indexFormat = DXGI_FORMAT_UNKNOWN;
+	Stage m_vertexStage = {};
+	Stage m_pixelStage = {};
+	ID3D11SamplerState* m_pixelSamplers[SamplerSlots] = {};
+	Counters m_counters;
+};
@@ -0,0 +1,110 @@
+#include "TransparencySorter.h"
+#include <immintrin.h>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+	const UINT32 DigitBits = 11;
+	const UINT32 DigitCount = (32 + DigitBits - 1) / DigitBits;
+	const UINT32 Radix = 1u << DigitBits;
+
+	// Ascending keys for descending floats: the bits of positive floats grow with the value, the sign bit is
+	// flipped to put them above the negative ones, whose bits grow the other way
+	UINT32 FarthestFirstKey(float depth)
+	{
+		UINT32 bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		bits ^= (bits & 0x80000000u) ? 0xFFFFFFFFu : 0x80000000u;
+		return ~bits;
+	}
+}
+
+void TransparencySorter::Sort(const DirectX::XMMATRIX* pModels, size_t modelStride, size_t count, const DirectX::XMMATRIX& view,
+	float halfWidth, float halfHeight, float maxDepth)
+{
+	m_depths.resize(count);
+	m_order.resize(count);
+	m_items.resize(count);
+	if (count == 0)
+		return;
+
+	// Only the z column of the view matters
+	DirectX::XMFLOAT4X4 viewMatrix;
+	DirectX::XMStoreFloat4x4(&viewMatrix, view);
+	const __m128 viewX = _mm_set1_ps(viewMatrix.m[0][2]);
+	const __m128 viewY = _mm_set1_ps(viewMatrix.m[1][2]);
+	const __m128 viewZ = _mm_set1_ps(viewMatrix.m[2][2]);
+	const __m128 viewW = _mm_set1_ps(viewMatrix.m[3][2]);
+	const __m128 cornerX[4] = { _mm_set1_ps(-halfWidth), _mm_set1_ps(halfWidth), _mm_set1_ps(-halfWidth), _mm_set1_ps(halfWidth) };
+	const __m128 cornerY[4] = { _mm_set1_ps(-halfHeight), _mm_set1_ps(-halfHeight), _mm_set1_ps(halfHeight), _mm_set1_ps(halfHeight) };
+	const __m128 clamp = _mm_set1_ps(maxDepth);
+	const BYTE* pModelBytes = reinterpret_cast<const BYTE*>(pModels);
+	for (size_t i = 0; i < count; i += 4)
+	{
+		// Short batches repeat their last instance
+		const size_t batchSize = min(count - i, size_t(4));
+		__m128 rows[3][4]; // rows 0, 1 and 3 of the 4 models
+		for (size_t k = 0; k < 4; k++)
+		{
+			const float* pModel = reinterpret_cast<const float*>(pModelBytes + modelStride * (i + min(k, batchSize - 1)));
+			rows[0][k] = _mm_loadu_ps(pModel);
+			rows[1][k] = _mm_loadu_ps(pModel + 4);
+			rows[2][k] = _mm_loadu_ps(pModel + 12);
+		}
+		for (int r = 0; r < 3; r++)
+			_MM_TRANSPOSE4_PS(rows[r][0], rows[r][1], rows[r][2], rows[r][3]);
+
+		__m128 depth = clamp;
+		for (int c = 0; c < 4; c++)
+		{
+			// Same association as the corner translation multiplied through model and view
+			__m128 point[4];
+			for (int axis = 0; axis < 4; axis++)
+				point[axis] = _mm_add_ps(_mm_mul_ps(cornerX[c], rows[0][axis]), _mm_add_ps(_mm_mul_ps(cornerY[c], rows[1][axis]), rows[2][axis]));
+			const __m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(point[0], viewX), _mm_mul_ps(point[2], viewZ)),
+				_mm_add_ps(_mm_mul_ps(point[1], viewY), _mm_mul_ps(point[3], viewW)));
+			depth = _mm_min_ps(z, depth);
+		}
+		// -0 and 0 compare equal, they get one key
+		depth = _mm_add_ps(depth, _mm_setzero_ps());
+
+		alignas(16) float depths[4];
+		_mm_store_ps(depths, depth);
+		for (size_t k = 0; k < batchSize; k++)
+		{
+			m_depths[i + k] = depths[k];
+			m_items[i + k] = (UINT64(FarthestFirstKey(depths[k])) << 32) | UINT64(i + k);
+		}
+	}
+
+	// LSD radix sort of the high halves, the instances start in order so equal keys stay in it
+	m_histograms.assign(DigitCount * Radix, 0);
+	for (UINT64 item : m_items)
+	{
+		for (UINT32 d = 0; d < DigitCount; d++)
+			m_histograms[d * Radix + ((item >> (32 + d * DigitBits)) & (Radix - 1))]++;
+	}
+	m_scratch.resize(count);
+	UINT64* pSource = m_items.data();
+	UINT64* pTarget = m_scratch.data();
+	for (UINT32 d = 0; d < DigitCount; d++)
+	{
+		UINT32* pCounts = &m_histograms[d * Radix];
+		const UINT32 shift = 32 + d * DigitBits;
+		if (pCounts[(pSource[0] >> shift) & (Radix - 1)] == count)
+			continue;
+		UINT32 offset = 0;
+		for (UINT32 b = 0; b < Radix; b++)
+		{
+			const UINT32 bucket = pCounts[b];
+			pCounts[b] = offset;
+			offset += bucket;
+		}
+		for (size_t i = 0; i < count; i++)
+			pTarget[pCounts[(pSource[i] >> shift) & (Radix - 1)]++] = pSource[i];
+		std::swap(pSource, pTarget);
+	}
+	for (size_t i = 0; i < count; i++)
+		m_order[i] = UINT32(pSource[i]);
+}
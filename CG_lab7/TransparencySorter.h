@@ -0,0 +1,27 @@
+#pragma once
+#include "framework.h"
+#include <vector>
+
+// Back to front order of transparent quads. The depth of an instance is the nearest view depth of the
+// model space corners (+-halfWidth, +-halfHeight, 0) and is clamped to maxDepth. Depths are computed 4
+// instances per iteration and radix sorted as integers, equal depths keep the order of the instances like
+// std::stable_sort would.
+class TransparencySorter
+{
+public:
+	// Consecutive models are modelStride bytes apart
+	void Sort(const DirectX::XMMATRIX* pModels, size_t modelStride, size_t count, const DirectX::XMMATRIX& view,
+		float halfWidth, float halfHeight, float maxDepth);
+
+	// Instance indices, farthest first
+	const std::vector<UINT32>& GetOrder() const { return m_order; }
+	// Depth of every instance
+	const std::vector<float>& GetDepths() const { return m_depths; }
+
+private:
+	std::vector<float> m_depths;
+	std::vector<UINT32> m_order;
+	std::vector<UINT64> m_items; // sort key in the high half, instance in the low one
+	std::vector<UINT64> m_scratch;
+	std::vector<UINT32> m_histograms;
+};
@@ -0,0 +1,52 @@
+#include "UploadRing.h"
+
+void UploadRing::Init(size_t capacity)
+{
+	m_capacity = capacity;
+	Reset();
+}
+
+void UploadRing::Reset()
+{
+	m_head = 0;
+	m_used = 0;
+	m_openBytes = 0;
+	m_frames.clear();
+}
+
+bool UploadRing::Allocate(size_t size, size_t alignment, size_t& outOffset)
+{
+	if (alignment == 0)
+		alignment = 1;
+	size_t offset = (m_head + alignment - 1) / alignment * alignment;
+	if (offset + size > m_capacity)
+		offset = 0; // the tail of the ring is skipped
+	// Bytes taken from the free space, which starts at the head and wraps around to the oldest frame in flight
+	const size_t taken = offset >= m_head ? offset + size - m_head : m_capacity - m_head + size;
+	if (size > m_capacity || m_used + taken > m_capacity)
+		return false;
+
+	m_used += taken;
+	m_openBytes += taken;
+	m_head = offset + size;
+	outOffset = offset;
+	return true;
+}
+
+void UploadRing::EndFrame(uint64_t fence)
+{
+	m_frames.push_back({ fence, m_openBytes });
+	m_openBytes = 0;
+}
+
+void UploadRing::Retire(uint64_t completedFence)
+{
+	while (!m_frames.empty() && m_frames.front().fence <= completedFence)
+	{
+		m_used -= m_frames.front().bytes;
+		m_frames.pop_front();
+	}
+	// Nothing in flight, the next allocation may as well start from the beginning
+	if (m_used == 0)
+		m_head = 0;
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+// Suballocator of a ring of bytes refilled every frame. The allocations of a frame are released together once
+// its fence is reported complete, so the ring never hands out bytes the GPU may still read. Allocation fails
+// instead of overwriting a frame in flight; the owner then waits, discards the memory or grows the ring.
+// Kept free of Windows and D3D headers.
+class UploadRing
+{
+public:
+	void Init(size_t capacity);
+	// Forgets every frame in flight, for backing memory that was replaced
+	void Reset();
+
+	// Offset aligned to a multiple of the alignment, which does not need to be a power of two
+	bool Allocate(size_t size, size_t alignment, size_t& outOffset);
+	// Closes the allocations made since the previous call under the fence value, fences are increasing
+	void EndFrame(uint64_t fence);
+	// Releases the frames whose fence is not above the completed one
+	void Retire(uint64_t completedFence);
+
+	size_t GetCapacity() const { return m_capacity; }
+	// Bytes held by the open frame and the frames in flight, alignment and wrap padding included
+	size_t GetUsed() const { return m_used; }
+	size_t GetFramesInFlight() const { return m_frames.size(); }
+
+private:
+	struct Frame
+	{
+		uint64_t fence;
+		size_t bytes;
+	};
+
+	size_t m_capacity = 0;
+	size_t m_head = 0; // next free byte
+	size_t m_used = 0;
+	size_t m_openBytes = 0; // allocated since the last EndFrame
+	std::deque<Frame> m_frames;
+};
@@ -0,0 +1,19 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+// Best wall time of a few runs in milliseconds, the first run also warms the caches
+template <class Function>
+double MeasureMs(int runs, Function function)
+{
+	double best = 1e30;
+	for (int run = 0; run < runs; run++)
+	{
+		const auto start = std::chrono::high_resolution_clock::now();
+		function();
+		const auto end = std::chrono::high_resolution_clock::now();
+		best = (std::min)(best, std::chrono::duration<double, std::milli>(end - start).count());
+	}
+	return best;
+}
@@ -0,0 +1,142 @@
+#include "Check.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "GeometryData.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Camera at the origin looking along +z with a 90 degree field of view, the side planes are x = +-z and y = +-z
+	Frustum MakeFrustum()
+	{
+		Frustum frustum;
+		frustum.ExtractFromMatrix(XMMatrixPerspectiveLH(2.0f, 2.0f, 1.0f, 100.0f));
+		return frustum;
+	}
+
+	GeometryData MakeCube()
+	{
+		std::vector<TextureNormalVertex> vertices;
+		std::vector<USHORT> indices;
+		GeometryData::getCubeGeometry(vertices, indices);
+		GeometryData geometry;
+		geometry.ComputeBounds(vertices.data(), sizeof(TextureNormalVertex), vertices.size());
+		return geometry;
+	}
+
+	// Ids kept by the AABB test alone and by ObjectBuffer::Cull, which adds the sphere and oriented box tests
+	void Cull(const Frustum& frustum, const ObjectBuffer& buffer, std::vector<UINT32>& outAABBVisible, std::vector<UINT32>& outVisible)
+	{
+		outAABBVisible.resize(buffer.bounds.GetCount());
+		outAABBVisible.resize(CullAABBs(frustum, buffer.bounds, outAABBVisible.data()));
+		buffer.Cull(frustum, outVisible);
+	}
+
+	// A 10 unit rod lying along the left plane x + z = 0. Its AABB reaches 3.5 units into the frustum whatever side
+	// of the plane the rod is on, the oriented box decides.
+	void TestRodAlongPlane()
+	{
+		const GeometryData cube = MakeCube(); // 2 x 2 x 3
+		const std::vector<float> offsets = { -0.5f, -0.2f, 0.0f, 0.5f }; // signed distance of the rod axis from the plane
+		ObjectBuffer buffer;
+		buffer.instances.resize(offsets.size());
+		for (size_t i = 0; i < offsets.size(); i++)
+		{
+			// RotationY(-45 degrees) turns +z into (-1, 0, 1) / sqrt(2), the plane normal is (1, 0, 1) / sqrt(2)
+			const float along = 20.0f;
+			const XMMATRIX model = XMMatrixScaling(0.05f, 0.05f, 10.0f / 3.0f) * XMMatrixRotationY(-XM_PI / 4.0f) *
+				XMMatrixTranslation(-along + offsets[i] * 0.70710678f, 0.0f, along + offsets[i] * 0.70710678f);
+			buffer.set(int(i), model, cube);
+		}
+		buffer.Refresh();
+		buffer.ClearChanges();
+
+		std::vector<UINT32> aabbVisible, visible;
+		Cull(MakeFrustum(), buffer, aabbVisible, visible);
+		CHECK(aabbVisible == std::vector<UINT32>({ 0, 1, 2, 3 }));
+		// The rod is 0.1 thick, so the ones with the axis 0.2 and 0.5 outside are rejected
+		CHECK(visible == std::vector<UINT32>({ 2, 3 }));
+	}
+
+	// Any mesh corner inside the frustum keeps the instance
+	bool IsCornerInside(const Frustum& frustum, const GeometryData& geometry, const XMMATRIX& model)
+	{
+		for (const XMFLOAT3& corner : geometry.vectorsAABB)
+		{
+			XMVECTOR point = XMVector3Transform(XMLoadFloat3(&corner), model);
+			bool inside = true;
+			for (const XMFLOAT4& plane : frustum.planes)
+				inside &= XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&plane), point)) >= 0.0f;
+			if (inside)
+				return true;
+		}
+		return false;
+	}
+
+	// Thin rotated boxes around the frustum: the volume tests only remove AABB survivors, never an instance with a
+	// corner inside, and remove a good part of the AABB false positives
+	void TestRandomThinBoxes()
+	{
+		const GeometryData cube = MakeCube();
+		const Frustum frustum = MakeFrustum();
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const size_t count = 20000; // above InstanceBVH::MinInstanceCount, culled through the BVH
+		ObjectBuffer buffer;
+		buffer.instances.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			float axis[3], scale[3], position[3];
+			for (float& component : axis)
+				component = unit(random) - 0.5f;
+			scale[0] = 0.02f + 0.1f * unit(random);
+			scale[1] = 0.02f + 0.1f * unit(random);
+			scale[2] = 0.5f + 2.0f * unit(random);
+			const float angle = unit(random) * XM_2PI;
+			position[2] = 2.0f + 60.0f * unit(random);
+			position[0] = (unit(random) * 2.0f - 1.0f) * (position[2] + 6.0f);
+			position[1] = (unit(random) * 2.0f - 1.0f) * (position[2] + 6.0f);
+			const XMVECTOR rotationAxis = XMVector3Normalize(XMVectorSet(axis[0], axis[1], axis[2] + 1e-3f, 0.0f));
+			buffer.set(int(i), XMMatrixScaling(scale[0], scale[1], scale[2]) * XMMatrixRotationAxis(rotationAxis, angle) *
+				XMMatrixTranslation(position[0], position[1], position[2]), cube);
+		}
+		buffer.Refresh();
+		buffer.ClearChanges();
+
+		std::vector<UINT32> aabbVisible, visible;
+		Cull(frustum, buffer, aabbVisible, visible);
+		// Ids come in BVH leaf order
+		std::sort(aabbVisible.begin(), aabbVisible.end());
+		std::sort(visible.begin(), visible.end());
+		CHECK(std::includes(aabbVisible.begin(), aabbVisible.end(), visible.begin(), visible.end()));
+		std::vector<UINT8> isVisible(count, 0);
+		for (UINT32 id : visible)
+			isVisible[id] = 1;
+		size_t cornerInside = 0, missed = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (IsCornerInside(frustum, cube, buffer.instances[i].model))
+			{
+				cornerInside++;
+				missed += isVisible[i] == 0;
+			}
+		}
+		CHECK(missed == 0);
+		// Falsely kept by the AABB test: kept without a corner inside, mostly boxes close outside a side plane
+		size_t aabbFalse = aabbVisible.size() - cornerInside;
+		size_t removed = aabbVisible.size() - visible.size();
+		printf("%zu thin boxes, %zu with a corner inside, AABB keeps %zu, volumes remove %zu (%.0f%% of the extra ones)\n", count,
+			cornerInside, aabbVisible.size(), removed, aabbFalse > 0 ? removed * 100.0 / aabbFalse : 0.0);
+		CHECK(removed * 2 > aabbFalse);
+	}
+}
+
+int main()
+{
+	TestRodAlongPlane();
+	TestRandomThinBoxes();
+	return CheckResult();
+}
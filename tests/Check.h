@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdio>
+
+inline int& CheckFailureCount()
+{
+	static int count = 0;
+	return count;
+}
+
+// Prints the failed condition and carries on, so one run reports every failure
+#define CHECK(condition) \
+	((condition) ? (void)0 : (void)(printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition), CheckFailureCount()++))
+
+// Exit code of a test
+inline int CheckResult()
+{
+	if (CheckFailureCount() > 0)
+		printf("%d checks failed\n", CheckFailureCount());
+	return CheckFailureCount() > 0 ? 1 : 0;
+}
@@ -0,0 +1,182 @@
+#include "Check.h"
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "CookedMesh.h"
+#include "MemoryDevice.h"
+
+namespace
+{
+	const int GridSize = 32; // quads per side, more than one meshlet
+
+	void MakeGrid(vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices)
+	{
+		outVertices.clear();
+		outIndices.clear();
+		for (int z = 0; z <= GridSize; z++)
+		{
+			for (int x = 0; x <= GridSize; x++)
+			{
+				TextureNormalVertex vertex = {};
+				vertex.pos = DirectX::XMFLOAT3(x * 0.25f - 3.0f, 0.5f * sinf(x * 0.3f) * cosf(z * 0.2f), z * 0.125f + 1.0f);
+				vertex.tang = DirectX::XMFLOAT4(1.0f, 0.0f, 0.0f, 1.0f);
+				vertex.normal = DirectX::XMFLOAT3(0.0f, 1.0f, 0.0f);
+				vertex.textureUV = DirectX::XMFLOAT2(float(x) / GridSize, float(z) / GridSize);
+				outVertices.push_back(vertex);
+			}
+		}
+		for (int z = 0; z < GridSize; z++)
+		{
+			for (int x = 0; x < GridSize; x++)
+			{
+				UINT32 a = z * (GridSize + 1) + x;
+				UINT32 c = a + GridSize + 1;
+				outIndices.insert(outIndices.end(), { a, c, c + 1, a, c + 1, a + 1 });
+			}
+		}
+	}
+
+	CookedMeshDesc MakeDesc(const vector<TextureNormalVertex>& vertices, const vector<UINT32>& indices)
+	{
+		CookedMeshDesc desc;
+		desc.pVertices = vertices.data();
+		desc.vertexStride = sizeof(TextureNormalVertex);
+		desc.vertexCount = UINT32(vertices.size());
+		desc.pIndices = indices.data();
+		desc.indexCount = UINT32(indices.size());
+		return desc;
+	}
+
+	bool SameBytes(const void* pA, const void* pB, size_t size)
+	{
+		return memcmp(pA, pB, size) == 0;
+	}
+
+	// Cook, validate, write, map and add to a pool; everything read back matches the source mesh and the culling
+	// volumes come from the header
+	void TestRoundTrip(bool allow16BitIndices, bool compressIndices)
+	{
+		vector<TextureNormalVertex> vertices;
+		vector<UINT32> indices;
+		MakeGrid(vertices, indices);
+		CookedMeshDesc desc = MakeDesc(vertices, indices);
+		desc.allow16BitIndices = allow16BitIndices;
+		desc.compressIndices = compressIndices;
+
+		std::vector<uint8_t> data;
+		CHECK(CookMesh(desc, data));
+		std::string error;
+		CHECK(ValidateCookedMesh(data.data(), data.size(), &error));
+		CHECK(error.empty());
+
+		const wchar_t* fileName = L"CookedMeshTest.cgm";
+		CHECK(WriteCookedMesh(fileName, desc));
+		CookedMeshFile file;
+		CHECK(file.Open(fileName));
+		const CookedMeshHeader& header = file.GetHeader();
+		CHECK(header.fileSize == data.size() && SameBytes(&header, data.data(), sizeof(header)));
+		CHECK(header.vertexCount == vertices.size() && header.indexCount == indices.size());
+		CHECK(header.indexStride == (allow16BitIndices ? 2u : 4u));
+		CHECK(header.meshletCount > 1);
+
+		BoundingSphere sphere = ComputeBoundingSphere(vertices.data(), sizeof(TextureNormalVertex), vertices.size());
+		OrientedBox box = ComputeOrientedBox(vertices.data(), sizeof(TextureNormalVertex), vertices.size());
+		CHECK(SameBytes(&header.boundingSphere, &sphere, sizeof(sphere)));
+		CHECK(SameBytes(&header.orientedBox, &box, sizeof(box)));
+		CHECK(SameBytes(file.GetVertices(), vertices.data(), vertices.size() * sizeof(TextureNormalVertex)));
+
+		MemoryDevice device;
+		UploadDeviceContext context;
+		GeometryPool pool;
+		DXGI_FORMAT indexFormat = allow16BitIndices ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+		CHECK(SUCCEEDED(pool.Init(&device, sizeof(TextureNormalVertex), 4096, indexFormat, 16384, "Test")));
+		GeometryData padding;
+		CHECK(SUCCEEDED(pool.Add(&context, vertices.data(), 7, indices.data(), 3, padding))); // nonzero base offsets
+
+		GeometryData geometry;
+		CHECK(SUCCEEDED(file.AddToPool(&context, pool, geometry)));
+		CHECK(geometry.baseVertex == 7 && geometry.vertexCount == vertices.size());
+		CHECK(geometry.firstIndex == 3 && geometry.indexCount == indices.size());
+		CHECK(geometry.vectorsAABB.size() == 8);
+		CHECK(SameBytes(&geometry.boundingSphere, &sphere, sizeof(sphere)));
+		CHECK(SameBytes(&geometry.orientedBox, &box, sizeof(box)));
+
+		const MemoryBuffer* pVertexBuffer = static_cast<const MemoryBuffer*>(geometry.vertexBuffer[0]);
+		const MemoryBuffer* pIndexBuffer = static_cast<const MemoryBuffer*>(geometry.pIndexBuffer);
+		CHECK(SameBytes(pVertexBuffer->data.data() + 7 * sizeof(TextureNormalVertex), vertices.data(),
+			vertices.size() * sizeof(TextureNormalVertex)));
+		bool sameIndices = true;
+		for (size_t i = 0; i < indices.size(); i++)
+		{
+			const uint8_t* pIndex = pIndexBuffer->data.data() + (3 + i) * header.indexStride;
+			UINT32 index = allow16BitIndices ? *reinterpret_cast<const uint16_t*>(pIndex) : *reinterpret_cast<const uint32_t*>(pIndex);
+			sameIndices &= index == indices[i];
+		}
+		CHECK(sameIndices);
+
+		// The pool takes only its own vertex format
+		GeometryPool positionPool;
+		CHECK(SUCCEEDED(positionPool.Init(&device, sizeof(Vertex), 4096, indexFormat, 16384, "Position")));
+		GeometryData rejected;
+		CHECK(file.AddToPool(&context, positionPool, rejected) == E_INVALIDARG);
+
+		file.Close();
+		std::remove("CookedMeshTest.cgm");
+	}
+
+	template <class T>
+	bool IsRejected(std::vector<uint8_t> data, size_t offset, T value, const char* expectedError)
+	{
+		memcpy(data.data() + offset, &value, sizeof(value));
+		std::string error;
+		bool valid = ValidateCookedMesh(data.data(), data.size(), &error);
+		if (!valid && error != expectedError)
+			printf("Unexpected error: %s\n", error.c_str());
+		return !valid && error == expectedError;
+	}
+
+	// Corrupted headers are refused before any count from them is used
+	void TestRejected()
+	{
+		vector<TextureNormalVertex> vertices;
+		vector<UINT32> indices;
+		MakeGrid(vertices, indices);
+		CookedMeshDesc desc = MakeDesc(vertices, indices);
+		std::vector<uint8_t> data;
+		CHECK(CookMesh(desc, data));
+		desc.compressIndices = true;
+		std::vector<uint8_t> compressed;
+		CHECK(CookMesh(desc, compressed));
+
+		CHECK(IsRejected(data, offsetof(CookedMeshHeader, version), uint32_t(1), "Unsupported version"));
+		CHECK(IsRejected(data, offsetof(CookedMeshHeader, indexCount), uint32_t(0xFFFFFFF0),
+			"Index section size does not match the index count"));
+		CHECK(IsRejected(compressed, offsetof(CookedMeshHeader, indexCount), uint32_t(0xFFFFFFF0),
+			"Index count exceeds the compressed index section"));
+		CHECK(IsRejected(data, offsetof(CookedMeshHeader, vertexCount), uint32_t(0x40000000),
+			"Section is out of the file bounds or misaligned"));
+		CHECK(IsRejected(data, offsetof(CookedMeshHeader, meshletCount), uint32_t(0x10000000),
+			"Section is out of the file bounds or misaligned"));
+		CHECK(IsRejected(data, offsetof(CookedMeshHeader, boundingSphere) + offsetof(BoundingSphere, radius), NAN,
+			"Bad bounding volumes"));
+		CHECK(IsRejected(data, size_t(reinterpret_cast<const CookedMeshHeader*>(data.data())->indexOffset), uint16_t(0xFFFF),
+			"Index is out of the vertex range"));
+
+		std::vector<uint8_t> truncated(data.begin(), data.end() - 16);
+		std::string error;
+		CHECK(!ValidateCookedMesh(truncated.data(), truncated.size(), &error) && error == "File size does not match the header");
+	}
+}
+
+int main()
+{
+	TestRoundTrip(true, false);
+	TestRoundTrip(false, false);
+	TestRoundTrip(true, true);
+	TestRoundTrip(false, true);
+	TestRejected();
+	return CheckResult();
+}
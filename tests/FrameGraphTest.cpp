@@ -0,0 +1,209 @@
+#include "Check.h"
+#include "FrameGraph.h"
+#include <string>
+#include <vector>
+
+namespace
+{
+	const TransientDesc Color = { 800, 600, 28, 0x28 };
+	const TransientDesc Depth = { 800, 600, 40, 0x40 };
+	const TransientDesc Half = { 400, 300, 28, 0x28 };
+
+	// The renderer's graph with a postprocess reading the scene color
+	void TestScene()
+	{
+		std::string log;
+		FrameGraph graph;
+		const uint32_t backBuffer = graph.Import("BackBuffer");
+		const uint32_t color = graph.CreateTransient("Color", Color);
+		const uint32_t depth = graph.CreateTransient("Depth", Depth);
+		const uint32_t scene = graph.AddPass("Scene", [&]() { log += "S"; });
+		graph.Write(scene, color);
+		graph.Write(scene, depth);
+		const uint32_t post = graph.AddPass("Post", [&]() { log += "P"; });
+		graph.Read(post, color);
+		graph.Write(post, backBuffer);
+		graph.Compile();
+		graph.Execute();
+
+		CHECK(log == "SP");
+		CHECK((graph.GetOrder() == std::vector<uint32_t>{ scene, post }));
+		CHECK(!graph.IsCulled(scene) && !graph.IsCulled(post));
+		CHECK(graph.GetSlots().size() == 2);
+		CHECK(graph.GetSlot(color) == 0 && graph.GetSlot(depth) == 1);
+		CHECK(graph.GetSlots()[0] == Color && graph.GetSlots()[1] == Depth);
+		CHECK(graph.IsImported(backBuffer) && !graph.IsImported(color));
+	}
+
+	// A postprocess that only copies is dropped, the scene then writes the back buffer and its color needs no slot
+	void TestElidedCopy()
+	{
+		std::string log;
+		FrameGraph graph;
+		const uint32_t backBuffer = graph.Import("BackBuffer");
+		const uint32_t color = graph.CreateTransient("Color", Color);
+		const uint32_t depth = graph.CreateTransient("Depth", Depth);
+		const uint32_t scene = graph.AddPass("Scene", [&]() { log += "S"; });
+		graph.Write(scene, color);
+		graph.Write(scene, depth);
+		const uint32_t copy = graph.AddCopyPass("Copy", color, backBuffer, [&]() { log += "C"; });
+		graph.Compile();
+		graph.Execute();
+
+		CHECK(log == "S");
+		CHECK((graph.GetOrder() == std::vector<uint32_t>{ scene }));
+		CHECK(graph.IsCulled(copy));
+		CHECK(graph.IsImported(color));
+		CHECK(graph.GetSlots().size() == 1 && graph.GetSlot(depth) == 0);
+	}
+
+	// The copy stays when its source has another reader
+	void TestKeptCopy()
+	{
+		std::string log;
+		FrameGraph graph;
+		const uint32_t backBuffer = graph.Import("BackBuffer");
+		const uint32_t color = graph.CreateTransient("Color", Color);
+		const uint32_t blurred = graph.CreateTransient("Blurred", Color);
+		const uint32_t scene = graph.AddPass("Scene", [&]() { log += "S"; });
+		graph.Write(scene, color);
+		const uint32_t copy = graph.AddCopyPass("Copy", color, backBuffer, [&]() { log += "C"; });
+		const uint32_t blur = graph.AddPass("Blur", [&]() { log += "B"; });
+		graph.Read(blur, color);
+		graph.Write(blur, blurred);
+		const uint32_t compose = graph.AddPass("Compose", [&]() { log += "X"; });
+		graph.Read(compose, blurred);
+		graph.Read(compose, backBuffer);
+		graph.Write(compose, backBuffer);
+		graph.Compile();
+		graph.Execute();
+
+		CHECK(log == "SCBX");
+		CHECK((graph.GetOrder() == std::vector<uint32_t>{ scene, copy, blur, compose }));
+		CHECK(!graph.IsCulled(copy));
+		CHECK(!graph.IsImported(color));
+		// The blurred target starts when the color is read for the last time, so they can not share
+		CHECK(graph.GetSlots().size() == 2 && graph.GetSlot(color) != graph.GetSlot(blurred));
+	}
+
+	// Passes feeding only a branch nobody reads are culled, back to the first pass still needed
+	void TestCulledBranch()
+	{
+		std::string log;
+		FrameGraph graph;
+		const uint32_t backBuffer = graph.Import("BackBuffer");
+		const uint32_t color = graph.CreateTransient("Color", Color);
+		const uint32_t small = graph.CreateTransient("Small", Half);
+		const uint32_t debug = graph.CreateTransient("Debug", Color);
+		const uint32_t scene = graph.AddPass("Scene", [&]() { log += "S"; });
+		graph.Write(scene, color);
+		const uint32_t downsample = graph.AddPass("Downsample", [&]() { log += "D"; });
+		graph.Read(downsample, color);
+		graph.Write(downsample, small);
+		const uint32_t overlay = graph.AddPass("Overlay", [&]() { log += "O"; });
+		graph.Read(overlay, small);
+		graph.Write(overlay, debug);
+		const uint32_t post = graph.AddPass("Post", [&]() { log += "P"; });
+		graph.Read(post, color);
+		graph.Write(post, backBuffer);
+		graph.Compile();
+		graph.Execute();
+
+		CHECK(log == "SP");
+		CHECK((graph.GetOrder() == std::vector<uint32_t>{ scene, post }));
+		CHECK(graph.IsCulled(downsample) && graph.IsCulled(overlay));
+		CHECK(!graph.IsCulled(scene) && !graph.IsCulled(post));
+		CHECK(graph.GetSlots().size() == 1 && graph.GetSlot(color) == 0);
+		CHECK(graph.GetSlot(small) == FrameGraph::InvalidId && graph.GetSlot(debug) == FrameGraph::InvalidId);
+	}
+
+	// A chain of full screen passes ping-pongs between two slots
+	void TestChain()
+	{
+		FrameGraph graph;
+		const uint32_t backBuffer = graph.Import("BackBuffer");
+		std::vector<uint32_t> targets = { graph.CreateTransient("Target", Color) };
+		uint32_t pass = graph.AddPass("Scene", nullptr);
+		graph.Write(pass, targets.back());
+		for (int i = 1; i < 8; i++)
+		{
+			targets.push_back(graph.CreateTransient("Target", Color));
+			pass = graph.AddPass("Effect", nullptr);
+			graph.Read(pass, targets[i - 1]);
+			graph.Write(pass, targets[i]);
+		}
+		pass = graph.AddPass("Post", nullptr);
+		graph.Read(pass, targets.back());
+		graph.Write(pass, backBuffer);
+		graph.Compile();
+
+		CHECK(graph.GetOrder().size() == 9);
+		CHECK(graph.GetSlots().size() == 2);
+		bool alternating = true;
+		for (uint32_t i = 0; i < targets.size(); i++)
+			alternating &= graph.GetSlot(targets[i]) == i % 2;
+		CHECK(alternating);
+
+		// Compiling again after Reset starts from no slots
+		graph.Reset();
+		const uint32_t color = graph.CreateTransient("Color", Half);
+		pass = graph.AddPass("Scene", nullptr);
+		graph.Write(pass, color);
+		pass = graph.AddPass("Post", nullptr);
+		graph.Read(pass, color);
+		graph.Write(pass, graph.Import("BackBuffer"));
+		graph.Compile();
+		CHECK(graph.GetOrder().size() == 2);
+		CHECK(graph.GetSlots().size() == 1 && graph.GetSlots()[0] == Half);
+	}
+
+	// Only equal descriptions alias: the half resolution chain reuses its own slot, full resolution targets
+	// living at the same time do not
+	void TestMixedSizes()
+	{
+		FrameGraph graph;
+		const uint32_t backBuffer = graph.Import("BackBuffer");
+		const uint32_t color = graph.CreateTransient("Color", Color);
+		const uint32_t small0 = graph.CreateTransient("Small0", Half);
+		const uint32_t small1 = graph.CreateTransient("Small1", Half);
+		const uint32_t small2 = graph.CreateTransient("Small2", Half);
+		const uint32_t composed = graph.CreateTransient("Composed", Color);
+		uint32_t pass = graph.AddPass("Scene", nullptr);
+		graph.Write(pass, color);
+		pass = graph.AddPass("Downsample", nullptr);
+		graph.Read(pass, color);
+		graph.Write(pass, small0);
+		pass = graph.AddPass("BlurX", nullptr);
+		graph.Read(pass, small0);
+		graph.Write(pass, small1);
+		pass = graph.AddPass("BlurY", nullptr);
+		graph.Read(pass, small1);
+		graph.Write(pass, small2);
+		pass = graph.AddPass("Compose", nullptr);
+		graph.Read(pass, color);
+		graph.Read(pass, small2);
+		graph.Write(pass, composed);
+		pass = graph.AddPass("Post", nullptr);
+		graph.Read(pass, composed);
+		graph.Write(pass, backBuffer);
+		graph.Compile();
+
+		CHECK(graph.GetOrder().size() == 6);
+		CHECK(graph.GetSlots().size() == 4);
+		CHECK(graph.GetSlot(color) == 0 && graph.GetSlot(small0) == 1 && graph.GetSlot(small1) == 2);
+		CHECK(graph.GetSlot(small2) == graph.GetSlot(small0));
+		CHECK(graph.GetSlot(composed) == 3);
+		CHECK(graph.GetSlots()[1] == Half && graph.GetSlots()[3] == Color);
+	}
+}
+
+int main()
+{
+	TestScene();
+	TestElidedCopy();
+	TestKeptCopy();
+	TestCulledBranch();
+	TestChain();
+	TestMixedSizes();
+	return CheckResult();
+}
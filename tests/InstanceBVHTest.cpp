@@ -0,0 +1,158 @@
+#include "Check.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "ParallelCuller.h"
+#include "RandomModel.h"
+
+using namespace DirectX;
+
+namespace
+{
+	struct Scene
+	{
+		GeometryData geometry;
+		std::vector<ObjectBuffer> buffers;
+		std::vector<XMMATRIX> cameras;
+	};
+
+	const XMFLOAT3 SceneMin(-150.0f, -30.0f, -150.0f);
+	const XMFLOAT3 SceneMax(150.0f, 30.0f, 150.0f);
+
+	void MakeScene(unsigned seed, Scene& scene)
+	{
+		std::mt19937 random(seed);
+		std::vector<TextureNormalVertex> vertices;
+		std::vector<USHORT> indices;
+		GeometryData::getCubeGeometry(vertices, indices);
+		scene.geometry.ComputeBounds(vertices.data(), sizeof(TextureNormalVertex), vertices.size());
+
+		// Below and above InstanceBVH::MinInstanceCount, the last one split into several BVH subtree jobs
+		const size_t counts[] = { 40, 3000, 60000 };
+		scene.buffers.resize(3);
+		for (size_t b = 0; b < scene.buffers.size(); b++)
+		{
+			ObjectBuffer& buffer = scene.buffers[b];
+			buffer.instances.resize(counts[b]);
+			for (size_t i = 0; i < counts[b]; i++)
+				buffer.set(int(i), RandomModel(random, SceneMin, SceneMax), scene.geometry);
+			buffer.Refresh();
+			buffer.ClearChanges();
+		}
+
+		std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+		std::uniform_real_distribution<float> offset(-60.0f, 60.0f);
+		const XMMATRIX projection = XMMatrixPerspectiveLH(0.2f, 0.1125f, 0.1f, 120.0f);
+		for (int i = 0; i < 4; i++)
+		{
+			const XMMATRIX camera = XMMatrixRotationAxis(XMVectorSet(1.0f, 0.0f, 0.0f, 0.0f), angle(random) * 0.1f) * XMMatrixRotationY(angle(random)) *
+				XMMatrixTranslation(offset(random), offset(random) * 0.1f, offset(random));
+			scene.cameras.push_back(XMMatrixInverse(nullptr, camera) * projection);
+		}
+	}
+
+	// Ids of the boxes the scalar kernel keeps, narrowed by the bounding volumes like every culling path
+	std::vector<UINT32> CullReference(const Frustum& frustum, const ObjectBuffer& buffer)
+	{
+		std::vector<UINT32> visible(buffer.bounds.GetCount());
+		visible.resize(CullAABBsScalar(frustum, buffer.bounds, visible.data()));
+		visible.resize(CullBoundingVolumes(frustum, buffer.volumes, visible.data(), UINT(visible.size())));
+		return visible;
+	}
+
+	std::vector<UINT32> Sorted(std::vector<UINT32> ids)
+	{
+		std::sort(ids.begin(), ids.end());
+		return ids;
+	}
+
+	// The subtrees culled one by one give the ids of a whole tree cull, in the same order
+	void CheckSubtrees(const Frustum& frustum, const ObjectBuffer& buffer)
+	{
+		if (buffer.bvh.GetItemCount() == 0)
+			return;
+		std::vector<UINT32> whole;
+		buffer.bvh.Cull(buffer.GetBVHInput(), &frustum.planes[0].x, whole);
+
+		std::vector<uint32_t> subtrees;
+		buffer.bvh.GetSubtrees(512, subtrees);
+		CHECK(subtrees.size() > 1);
+		std::vector<uint8_t> failedPlanes(buffer.bvh.GetItemCount());
+		std::vector<UINT32> joined;
+		for (uint32_t node : subtrees)
+			buffer.bvh.CullSubtree(buffer.GetBVHInput(), &frustum.planes[0].x, node, joined, failedPlanes.data());
+		CHECK(joined == whole);
+
+		std::vector<UINT32> reference(buffer.bounds.GetCount());
+		reference.resize(CullAABBsScalar(frustum, buffer.bounds, reference.data()));
+		CHECK(Sorted(whole) == reference);
+	}
+
+	void CheckScene(const Scene& scene, ParallelCuller& culler)
+	{
+		for (const XMMATRIX& viewProjection : scene.cameras)
+		{
+			Frustum frustum;
+			frustum.ExtractFromMatrix(viewProjection);
+			culler.Cull(frustum, ContributionParams(), scene.buffers);
+			for (size_t b = 0; b < scene.buffers.size(); b++)
+			{
+				const std::vector<UINT32> reference = CullReference(frustum, scene.buffers[b]);
+				CHECK(!reference.empty());
+				CHECK(Sorted(culler.GetVisible(b)) == reference);
+				std::vector<UINT32> single;
+				scene.buffers[b].Cull(frustum, single);
+				CHECK(culler.GetVisible(b) == single);
+				CheckSubtrees(frustum, scene.buffers[b]);
+			}
+		}
+	}
+
+	// Moves a share of the instances by up to distance, or to random places when distance is 0. The changed
+	// bounds are refit and the BVH updated in place unless its quality drops too far.
+	void MoveInstances(Scene& scene, std::mt19937& random, float share, float distance)
+	{
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::uniform_real_distribution<float> offset(-distance, distance);
+		for (ObjectBuffer& buffer : scene.buffers)
+		{
+			for (size_t i = 0; i < buffer.instances.size(); i++)
+			{
+				if (unit(random) >= share)
+					continue;
+				if (distance > 0.0f)
+					buffer.setModel(int(i), buffer.instances[i].model * XMMatrixTranslation(offset(random), offset(random), offset(random)));
+				else
+					buffer.setModel(int(i), RandomModel(random, SceneMin, SceneMax));
+			}
+			buffer.Refresh();
+			buffer.ClearChanges();
+		}
+	}
+}
+
+int main()
+{
+	ParallelCuller culler;
+	culler.Init(4);
+	culler.batchSize = 1024;
+	for (unsigned seed = 1; seed <= 3; seed++)
+	{
+		Scene scene;
+		MakeScene(seed, scene);
+		CheckScene(scene, culler);
+
+		std::mt19937 random(seed * 31);
+		const UINT32 buildCount = scene.buffers[2].bvh.GetBuildCount();
+		MoveInstances(scene, random, 0.1f, 2.0f);
+		CHECK(scene.buffers[2].bvh.GetBuildCount() == buildCount);
+		CheckScene(scene, culler);
+
+		// Enough movement to degrade the tree past its rebuild threshold
+		MoveInstances(scene, random, 0.5f, 0.0f);
+		CHECK(scene.buffers[2].bvh.GetRebuildCount() > 0);
+		CheckScene(scene, culler);
+	}
+	culler.Term();
+	return CheckResult();
+}
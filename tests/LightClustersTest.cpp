@@ -0,0 +1,144 @@
+#include "Check.h"
+#include "LightClusters.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Camera turned by yaw and pitch at the position, as a world to view matrix with row vectors
+	void MakeView(float yaw, float pitch, const float position[3], float* pOut)
+	{
+		const float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+		// Rows of the camera rotation are its right, up and forward axes, the view matrix is its transpose
+		const float right[3] = { cy, 0.0f, -sy };
+		const float up[3] = { sy * sp, cp, cy * sp };
+		const float forward[3] = { sy * cp, -sp, cy * cp };
+		const float* axes[3] = { right, up, forward };
+		for (int row = 0; row < 3; row++)
+		{
+			for (int column = 0; column < 3; column++)
+				pOut[row * 4 + column] = axes[column][row];
+			pOut[row * 4 + 3] = 0.0f;
+		}
+		for (int column = 0; column < 3; column++)
+			pOut[12 + column] = -(position[0] * axes[column][0] + position[1] * axes[column][1] + position[2] * axes[column][2]);
+		pOut[15] = 1.0f;
+	}
+
+	std::vector<ClusterLight> MakeLights(std::mt19937& random, uint32_t count)
+	{
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<ClusterLight> lights(count);
+		for (ClusterLight& light : lights)
+		{
+			light.position[0] = unit(random) * 60.0f;
+			light.position[1] = unit(random) * 10.0f;
+			light.position[2] = unit(random) * 60.0f;
+			light.radius = 0.5f + (unit(random) + 1.0f) * 2.0f;
+			for (float& channel : light.color)
+				channel = 1.0f;
+		}
+		if (count > 2)
+		{
+			lights[0].radius = 50.0f; // touching most clusters
+			lights[1].radius = 0.01f;
+		}
+		return lights;
+	}
+
+	bool SameClusters(const LightClusterBuilder& a, const LightClusterBuilder& b)
+	{
+		return a.GetClusterRanges() == b.GetClusterRanges() && a.GetLightIndices() == b.GetLightIndices();
+	}
+
+	// The lights of every cluster are ascending and the ranges cover the index list
+	void CheckRanges(const LightClusterBuilder& builder, uint32_t lightCount)
+	{
+		const std::vector<uint32_t>& ranges = builder.GetClusterRanges();
+		const std::vector<uint32_t>& indices = builder.GetLightIndices();
+		CHECK(ranges.size() == builder.GetClusterCount() * 2);
+		uint32_t total = 0;
+		bool ascending = true;
+		for (uint32_t cluster = 0; cluster < builder.GetClusterCount(); cluster++)
+		{
+			const uint32_t offset = ranges[cluster * 2], count = ranges[cluster * 2 + 1];
+			total += count;
+			for (uint32_t i = offset; i < offset + count; i++)
+				ascending &= indices[i] < lightCount && (i == offset || indices[i - 1] < indices[i]);
+		}
+		CHECK(ascending);
+		CHECK(total == indices.size());
+		CHECK(total == builder.GetStats().assignments);
+	}
+}
+
+int main()
+{
+	ClusterProjection projection;
+	projection.tanHalfFovX = tanf(3.14159f / 6.0f);
+	projection.tanHalfFovY = projection.tanHalfFovX * 720.0f / 1280.0f;
+	projection.nearZ = 0.1f;
+	projection.farZ = 100.0f;
+
+	ClusterGridDesc oddGrid;
+	oddGrid.tilesX = 13;
+	oddGrid.tilesY = 7;
+	oddGrid.slices = 17;
+	const ClusterGridDesc grids[] = { ClusterGridDesc(), oddGrid };
+	const uint32_t lightCounts[] = { 0, 1, 100, 2000 };
+
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	for (const ClusterGridDesc& grid : grids)
+	{
+		LightClusterBuilder single, threaded, reference;
+		single.Init(grid, 1);
+		threaded.Init(grid, 4);
+		reference.Init(grid, 1);
+		for (uint32_t lightCount : lightCounts)
+		{
+			const std::vector<ClusterLight> lights = MakeLights(random, lightCount);
+			for (int view = 0; view < 10; view++)
+			{
+				const float position[3] = { unit(random) * 20.0f, unit(random) * 3.0f, unit(random) * 20.0f };
+				float matrix[16];
+				MakeView(view * 0.7f, unit(random) * 0.5f, position, matrix);
+				single.Build(matrix, projection, lights.data(), lightCount);
+				threaded.Build(matrix, projection, lights.data(), lightCount);
+				reference.BuildReference(matrix, projection, lights.data(), lightCount);
+				CHECK(SameClusters(single, reference));
+				CHECK(SameClusters(threaded, reference));
+				CheckRanges(single, lightCount);
+			}
+		}
+	}
+
+	// A small light in the middle of a cluster lands in that cluster and only in clusters whose box holds it.
+	// Neighbouring boxes overlap, the box of a column is widened to its extent at the far end of the slice.
+	LightClusterBuilder builder;
+	builder.Init(ClusterGridDesc(), 1);
+	const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+	builder.Build(identity, projection, nullptr, 0);
+	const uint32_t cluster = builder.GetClusterCount() / 2 + 5;
+	float minVec[3], maxVec[3];
+	builder.GetClusterBounds(cluster, minVec, maxVec);
+	ClusterLight light = {};
+	for (int axis = 0; axis < 3; axis++)
+		light.position[axis] = (minVec[axis] + maxVec[axis]) * 0.5f;
+	light.radius = 1e-4f;
+	builder.Build(identity, projection, &light, 1);
+	CHECK(builder.GetClusterRanges()[cluster * 2 + 1] == 1);
+	bool inside = true;
+	for (uint32_t other = 0; other < builder.GetClusterCount(); other++)
+	{
+		if (builder.GetClusterRanges()[other * 2 + 1] == 0)
+			continue;
+		builder.GetClusterBounds(other, minVec, maxVec);
+		for (int axis = 0; axis < 3; axis++)
+			inside &= light.position[axis] >= minVec[axis] - light.radius && light.position[axis] <= maxVec[axis] + light.radius;
+	}
+	CHECK(inside);
+	CHECK(builder.GetStats().assignments < 8);
+	return CheckResult();
+}
@@ -0,0 +1,98 @@
+#include "Check.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "MaterialTable.h"
+
+namespace
+{
+	Material MakeMaterial(int index)
+	{
+		Material material;
+		material.baseColor = { float(index % 5) * 0.25f, float(index % 3) * 0.5f, 1.0f, 1.0f };
+		material.modelInfo = { index % 4, index % 2, 1, 0 };
+		return material;
+	}
+
+	// Identical materials share an entry, the ids are the order of the first Add and never change
+	void TestDeduplication()
+	{
+		MaterialTable table;
+		std::vector<UINT16> ids;
+		for (int i = 0; i < 60; i++)
+			ids.push_back(table.Add(MakeMaterial(i)));
+		// 60 = lcm(5, 3, 4, 2), every combination of the fields appears once
+		CHECK(table.GetCount() == 60 && table.GetVersion() == 60);
+		bool stable = true;
+		for (int i = 0; i < 60; i++)
+		{
+			stable &= ids[i] == UINT16(i);
+			stable &= table.Add(MakeMaterial(i)) == ids[i];
+			stable &= table.Add(MakeMaterial(i + 60)) == ids[i];
+		}
+		CHECK(stable);
+		CHECK(table.GetCount() == 60 && table.GetVersion() == 60);
+
+		// Equal is bytewise: -0 and 0 compare equal as floats but are two materials
+		Material positive;
+		positive.lightParams.x = 0.0f;
+		Material negative = positive;
+		negative.lightParams.x = -0.0f;
+		const UINT16 positiveId = table.Add(positive);
+		const UINT16 negativeId = table.Add(negative);
+		CHECK(positiveId != negativeId);
+		CHECK(table.Add(negative) == negativeId && table.Add(positive) == positiveId);
+		CHECK(table.GetCount() == 62 && table.GetVersion() == 62);
+		CHECK(table.Get(negativeId).lightParams.x == 0.0f && std::signbit(table.Get(negativeId).lightParams.x));
+	}
+
+	// Instance-like records, the material index sits inside a larger stride like in Instance
+	struct Record
+	{
+		float model[16];
+		UINT16 materialId;
+	};
+
+	// The counting sort orders by material and keeps the id order within a material, like a stable sort
+	void TestSortIdsByMaterial()
+	{
+		const UINT MaterialCount = 37;
+		std::mt19937 random(2);
+		std::uniform_int_distribution<UINT> material(0, MaterialCount - 1);
+		std::vector<Record> records(5000);
+		for (Record& record : records)
+			record.materialId = UINT16(material(random));
+
+		std::vector<UINT32> ids;
+		for (UINT32 id = 0; id < records.size(); id++)
+		{
+			if (id % 3 != 0)
+				ids.push_back(id);
+		}
+		std::shuffle(ids.begin(), ids.end(), random);
+		std::vector<UINT32> expected = ids;
+		std::stable_sort(expected.begin(), expected.end(),
+			[&](UINT32 a, UINT32 b) { return records[a].materialId < records[b].materialId; });
+
+		std::vector<UINT32> scratch;
+		SortIdsByMaterial(&records[0].materialId, sizeof(Record), MaterialCount, ids.data(), ids.size(), scratch);
+		CHECK(ids == expected);
+
+		// Sorted input, and a single material, are left as they are
+		SortIdsByMaterial(&records[0].materialId, sizeof(Record), MaterialCount, ids.data(), ids.size(), scratch);
+		CHECK(ids == expected);
+		std::vector<UINT32> shuffled = ids;
+		std::shuffle(shuffled.begin(), shuffled.end(), random);
+		std::vector<UINT32> unchanged = shuffled;
+		SortIdsByMaterial(&records[0].materialId, sizeof(Record), 1, shuffled.data(), shuffled.size(), scratch);
+		CHECK(shuffled == unchanged);
+	}
+}
+
+int main()
+{
+	TestDeduplication();
+	TestSortIdsByMaterial();
+	return CheckResult();
+}
@@ -0,0 +1,169 @@
+#include "Check.h"
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MeshImporter.h"
+
+namespace
+{
+	struct GLBPrimitive
+	{
+		std::vector<float> positions;
+		std::vector<float> normals;
+		std::vector<float> tangents; // empty - no TANGENT attribute
+		std::vector<float> uvs;
+		std::vector<uint32_t> indices;
+	};
+
+	void AppendBytes(std::vector<uint8_t>& bytes, const void* pData, size_t size)
+	{
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(pData);
+		bytes.insert(bytes.end(), pBytes, pBytes + size);
+	}
+
+	void AppendUint(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		AppendBytes(bytes, &value, sizeof(value));
+	}
+
+	// One buffer view and accessor per attribute, all primitives in one mesh
+	std::vector<uint8_t> MakeGLB(const std::vector<GLBPrimitive>& primitives)
+	{
+		std::vector<uint8_t> bin;
+		std::string views, accessors, meshPrimitives;
+		int accessorCount = 0;
+		auto addAccessor = [&](const void* pData, size_t count, size_t componentSize, int componentType, const char* type, size_t components)
+		{
+			char text[256];
+			snprintf(text, sizeof(text), "%s{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}", views.empty() ? "" : ",",
+				bin.size(), count * components * componentSize);
+			views += text;
+			snprintf(text, sizeof(text), "%s{\"bufferView\":%d,\"componentType\":%d,\"count\":%zu,\"type\":\"%s\"}",
+				accessors.empty() ? "" : ",", accessorCount, componentType, count, type);
+			accessors += text;
+			AppendBytes(bin, pData, count * components * componentSize);
+			return accessorCount++;
+		};
+		for (const GLBPrimitive& primitive : primitives)
+		{
+			size_t vertexCount = primitive.positions.size() / 3;
+			int position = addAccessor(primitive.positions.data(), vertexCount, 4, 5126, "VEC3", 3);
+			int normal = addAccessor(primitive.normals.data(), vertexCount, 4, 5126, "VEC3", 3);
+			int uv = addAccessor(primitive.uvs.data(), vertexCount, 4, 5126, "VEC2", 2);
+			int index = addAccessor(primitive.indices.data(), primitive.indices.size(), 4, 5125, "SCALAR", 1);
+			char text[256];
+			snprintf(text, sizeof(text), "%s{\"attributes\":{\"POSITION\":%d,\"NORMAL\":%d,\"TEXCOORD_0\":%d", meshPrimitives.empty() ? "" : ",",
+				position, normal, uv);
+			meshPrimitives += text;
+			if (!primitive.tangents.empty())
+			{
+				int tangent = addAccessor(primitive.tangents.data(), vertexCount, 4, 5126, "VEC4", 4);
+				snprintf(text, sizeof(text), ",\"TANGENT\":%d", tangent);
+				meshPrimitives += text;
+			}
+			snprintf(text, sizeof(text), "},\"indices\":%d}", index);
+			meshPrimitives += text;
+		}
+
+		std::string json = "{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":" + std::to_string(bin.size())
+			+ "}],\"bufferViews\":[" + views + "],\"accessors\":[" + accessors + "],\"meshes\":[{\"primitives\":["
+			+ meshPrimitives + "]}]}";
+		while (json.size() % 4 != 0)
+			json += ' ';
+
+		std::vector<uint8_t> glb;
+		AppendUint(glb, 0x46546C67);
+		AppendUint(glb, 2);
+		AppendUint(glb, uint32_t(12 + 8 + json.size() + 8 + bin.size()));
+		AppendUint(glb, uint32_t(json.size()));
+		AppendUint(glb, 0x4E4F534A);
+		glb.insert(glb.end(), json.begin(), json.end());
+		AppendUint(glb, uint32_t(bin.size()));
+		AppendUint(glb, 0x004E4942);
+		glb.insert(glb.end(), bin.begin(), bin.end());
+		return glb;
+	}
+
+	// Unit quad in the xy plane facing +z (-z once mirrored into the left-handed space)
+	GLBPrimitive MakeQuad(bool mirroredU)
+	{
+		GLBPrimitive quad;
+		quad.positions = { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0 };
+		quad.normals = { 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1 };
+		float u0 = mirroredU ? 1.0f : 0.0f;
+		float u1 = 1.0f - u0;
+		quad.uvs = { u0, 1, u1, 1, u1, 0, u0, 0 };
+		quad.indices = { 0, 1, 2, 0, 2, 3 };
+		return quad;
+	}
+
+	bool Near(const DirectX::XMFLOAT4& a, float x, float y, float z, float w)
+	{
+		return fabsf(a.x - x) < 1e-5f && fabsf(a.y - y) < 1e-5f && fabsf(a.z - z) < 1e-5f && a.w == w;
+	}
+
+	// Stored tangents are kept with their sign, generated ones only fill the primitives without TANGENT
+	void TestGLBTangents()
+	{
+		GLBPrimitive stored = MakeQuad(false);
+		stored.tangents = { 0, 1, 0, -1, 0, 1, 0, -1, 0, 1, 0, -1, 0, 1, 0, -1 };
+		std::vector<uint8_t> glb = MakeGLB({ stored, MakeQuad(false), MakeQuad(true) });
+
+		vector<TextureNormalVertex> vertices;
+		vector<UINT32> indices;
+		CHECK(ParseGLB(glb.data(), glb.size(), vertices, indices));
+		CHECK(vertices.size() == 12 && indices.size() == 18);
+		if (vertices.size() != 12)
+			return;
+		for (size_t i = 0; i < 12; i++)
+		{
+			const DirectX::XMFLOAT4& tang = vertices[i].tang;
+			CHECK(vertices[i].normal.z == -1.0f);
+			if (i < 4)
+				CHECK(Near(tang, 0, 1, 0, -1));
+			else if (i < 8)
+				CHECK(Near(tang, 1, 0, 0, 1)); // texture up +y = cross(+x, -z)
+			else
+				CHECK(Near(tang, -1, 0, 0, -1)); // u runs along -x, the texture up stays +y
+		}
+	}
+
+	// The generated tangents match the authored ones of the built-in cube, sign included
+	void TestCubeTangents()
+	{
+		vector<TextureNormalVertex> cube;
+		vector<USHORT> cubeIndices;
+		GeometryData::getCubeGeometry(cube, cubeIndices);
+		vector<TextureNormalVertex> vertices = cube;
+		vector<UINT32> indices(cubeIndices.begin(), cubeIndices.end());
+		for (TextureNormalVertex& vertex : vertices)
+			vertex.tang = DirectX::XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+		ComputeTangents(vertices, indices);
+		for (size_t i = 0; i < cube.size(); i++)
+			CHECK(Near(vertices[i].tang, cube[i].tang.x, cube[i].tang.y, cube[i].tang.z, cube[i].tang.w));
+	}
+
+	void TestParseNumbers()
+	{
+		const char text[] = "v 1.5 -2.25e1 0.1\nv 3 1e-3 -0.000001\nv 1234567.875 0 0\nf 1 2 3\n";
+		vector<TextureNormalVertex> vertices;
+		vector<UINT32> indices;
+		CHECK(ParseOBJ(text, sizeof(text) - 1, vertices, indices, 1));
+		CHECK(vertices.size() == 3);
+		if (vertices.size() != 3)
+			return;
+		// Vertices come in the order of the flipped winding, z is mirrored
+		CHECK(vertices[0].pos.x == 1.5f && vertices[0].pos.y == -22.5f && vertices[0].pos.z == -0.1f);
+		CHECK(vertices[1].pos.x == 1234567.875f);
+		CHECK(vertices[2].pos.x == 3.0f && vertices[2].pos.y == 0.001f && vertices[2].pos.z == 0.000001f);
+	}
+}
+
+int main()
+{
+	TestGLBTangents();
+	TestCubeTangents();
+	TestParseNumbers();
+	return CheckResult();
+}
@@ -0,0 +1,246 @@
+#include "Check.h"
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	const uint32_t Width = 320;
+	const uint32_t Height = 180;
+
+	// Row vector matrices, out = a * b
+	void Multiply(const float* a, const float* b, float* pOut)
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			for (int column = 0; column < 4; column++)
+			{
+				pOut[row * 4 + column] = a[row * 4] * b[column] + a[row * 4 + 1] * b[4 + column] + a[row * 4 + 2] * b[8 + column] +
+					a[row * 4 + 3] * b[12 + column];
+			}
+		}
+	}
+
+	// Reverse-Z like the renderer: depth 1 at the near plane, 0 at the far plane. The camera looks along +z.
+	void Perspective(float fov, float aspectRatio, float nearZ, float farZ, float* pOut)
+	{
+		const float scale = 1.0f / tanf(fov * 0.5f);
+		const float range = nearZ / (nearZ - farZ);
+		const float matrix[16] = { scale, 0, 0, 0, 0, scale / aspectRatio, 0, 0, 0, 0, range, 1, 0, 0, -range * farZ, 0 };
+		std::copy(matrix, matrix + 16, pOut);
+	}
+
+	// Scale, then rotation around y, then translation
+	void Model(float scaleX, float scaleY, float scaleZ, float angle, float x, float y, float z, float* pOut)
+	{
+		const float c = cosf(angle), s = sinf(angle);
+		const float matrix[16] = { scaleX * c, 0, -scaleX * s, 0, 0, scaleY, 0, 0, scaleZ * s, 0, scaleZ * c, 0, x, y, z, 1 };
+		std::copy(matrix, matrix + 16, pOut);
+	}
+
+	OccluderMesh MakeCube()
+	{
+		OccluderMesh mesh;
+		for (int i = 0; i < 8; i++)
+			mesh.positions.insert(mesh.positions.end(), { (i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f, (i & 4) ? 1.0f : -1.0f });
+		const uint16_t faces[6][4] = { { 0, 1, 3, 2 }, { 4, 6, 7, 5 }, { 0, 4, 5, 1 }, { 2, 3, 7, 6 }, { 0, 2, 6, 4 }, { 1, 5, 7, 3 } };
+		for (const auto& face : faces)
+			mesh.indices.insert(mesh.indices.end(), { face[0], face[1], face[2], face[0], face[2], face[3] });
+		return mesh;
+	}
+
+	// Per pixel depth buffer of the same size, the nearest depth at every pixel center
+	struct ReferenceDepth
+	{
+		uint32_t width, height;
+		std::vector<float> depth;
+
+		ReferenceDepth(uint32_t width, uint32_t height) : width(width), height(height), depth(width * height, 0.0f) {}
+
+		bool Project(const float position[3], const float* pMatrix, float& x, float& y, float& z) const
+		{
+			float clip[4];
+			for (int k = 0; k < 4; k++)
+				clip[k] = position[0] * pMatrix[k] + position[1] * pMatrix[4 + k] + position[2] * pMatrix[8 + k] + pMatrix[12 + k];
+			if (clip[3] <= 1e-5f || clip[2] > clip[3] || clip[2] < 0.0f)
+				return false;
+			x = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+			y = (0.5f - clip[1] / clip[3] * 0.5f) * height;
+			z = clip[2] / clip[3];
+			return true;
+		}
+
+		void AddOccluder(const OccluderMesh& mesh, const float* pModelViewProjection)
+		{
+			for (size_t t = 0; t + 2 < mesh.indices.size(); t += 3)
+			{
+				float x[3], y[3], z[3];
+				int projected = 0;
+				while (projected < 3 && Project(&mesh.positions[mesh.indices[t + projected] * 3], pModelViewProjection, x[projected],
+					y[projected], z[projected]))
+					projected++;
+				if (projected < 3)
+					continue;
+				const double area = (x[1] - x[0]) * double(y[2] - y[0]) - (x[2] - x[0]) * double(y[1] - y[0]);
+				if (fabs(area) < 1e-9)
+					continue;
+				for (uint32_t py = 0; py < height; py++)
+				{
+					for (uint32_t px = 0; px < width; px++)
+					{
+						const double cx = px + 0.5, cy = py + 0.5;
+						const double w0 = ((x[1] - x[0]) * (cy - y[0]) - (y[1] - y[0]) * (cx - x[0])) / area;
+						const double w1 = ((x[2] - x[1]) * (cy - y[1]) - (y[2] - y[1]) * (cx - x[1])) / area;
+						const double w2 = ((x[0] - x[2]) * (cy - y[2]) - (y[0] - y[2]) * (cx - x[2])) / area;
+						if (w0 >= 0 && w1 >= 0 && w2 >= 0)
+						{
+							float& pixel = depth[py * width + px];
+							pixel = (std::max)(pixel, float(w1 * z[0] + w2 * z[1] + w0 * z[2]));
+						}
+					}
+				}
+			}
+		}
+
+		bool IsOccluded(const float minVec[3], const float maxVec[3], const float* pViewProjection) const
+		{
+			float minX = 1e9f, minY = 1e9f, maxX = -1e9f, maxY = -1e9f, nearest = 0.0f;
+			for (int i = 0; i < 8; i++)
+			{
+				const float corner[3] = { (i & 1) ? maxVec[0] : minVec[0], (i & 2) ? maxVec[1] : minVec[1], (i & 4) ? maxVec[2] : minVec[2] };
+				float x, y, z;
+				if (!Project(corner, pViewProjection, x, y, z))
+					return false;
+				minX = (std::min)(minX, x);
+				maxX = (std::max)(maxX, x);
+				minY = (std::min)(minY, y);
+				maxY = (std::max)(maxY, y);
+				nearest = (std::max)(nearest, z);
+			}
+			if (maxX < 0 || maxY < 0 || minX >= width || minY >= height)
+				return false;
+			for (int py = (std::max)(0, int(floorf(minY))); py <= (std::min)(int(height) - 1, int(maxY)); py++)
+			{
+				for (int px = (std::max)(0, int(floorf(minX))); px <= (std::min)(int(width) - 1, int(maxX)); px++)
+				{
+					if (!(nearest < depth[py * width + px]))
+						return false;
+				}
+			}
+			return true;
+		}
+	};
+
+	bool IsOccluded(const OcclusionCuller& culler, float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+	{
+		const float minVec[3] = { minX, minY, minZ };
+		const float maxVec[3] = { maxX, maxY, maxZ };
+		return culler.IsOccluded(minVec, maxVec);
+	}
+
+	// A 4x4 wall 10 units in front of the camera with boxes around it
+	void TestWall(const OccluderMesh& cube, const float* pViewProjection)
+	{
+		OcclusionCuller culler;
+		culler.Init(Width, Height, 1);
+		culler.BeginFrame(pViewProjection);
+		float model[16];
+		Model(2.0f, 2.0f, 0.2f, 0.0f, 0.0f, 0.0f, 10.0f, model);
+		culler.AddOccluder(cube, model);
+		culler.Rasterize();
+		CHECK(culler.GetStats().occluderTriangles == 12);
+
+		CHECK(IsOccluded(culler, -1, -1, 20, 1, 1, 22)); // behind
+		CHECK(IsOccluded(culler, -1, -1, 10.1f, 1, 1, 12)); // touching the back face
+		CHECK(IsOccluded(culler, -6, -6, 40, 6, 6, 50)); // larger than the wall but in its shadow
+		CHECK(!IsOccluded(culler, -1, -1, 5, 1, 1, 7)); // in front
+		CHECK(!IsOccluded(culler, 6, -1, 20, 8, 1, 22)); // beside
+		CHECK(!IsOccluded(culler, -1, -1, 9.5f, 1, 1, 12)); // reaching through the wall
+		CHECK(!IsOccluded(culler, -3, -1, 11, 3, 1, 12)); // sticking out on both sides
+		CHECK(!IsOccluded(culler, 1.5f, -1, 11, 3.5f, 1, 12)); // half behind the edge
+		CHECK(!IsOccluded(culler, -1, -1, 0.05f, 1, 1, 30)); // in front of the near plane
+		CHECK(!IsOccluded(culler, -1, -1, -30, 1, 1, -20)); // behind the camera
+
+		// The visible ids keep their order
+		const float minX[] = { -1, 6, -1, -1, 1.5f }, minY[] = { -1, -1, -1, -1, -1 }, minZ[] = { 20, 20, 5, 40, 11 };
+		const float maxX[] = { 1, 8, 1, 1, 3.5f }, maxY[] = { 1, 1, 1, 1, 1 }, maxZ[] = { 22, 22, 7, 50, 12 };
+		const BVHInput bounds = { { minX, minY, minZ }, { maxX, maxY, maxZ }, 5 };
+		uint32_t ids[] = { 4, 3, 2, 1, 0 };
+		CHECK(culler.CullOccluded(bounds, ids, 5) == 3);
+		CHECK(ids[0] == 4 && ids[1] == 2 && ids[2] == 1);
+		CHECK(culler.GetStats().testedBoxes == 5 && culler.GetStats().occludedBoxes == 2);
+	}
+
+	// Random cubes: any thread count gives the same depths, and no box is occluded that a per pixel depth
+	// buffer keeps visible
+	void TestRandomScene(const OccluderMesh& cube, const float* pViewProjection)
+	{
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		std::vector<std::vector<float>> models(64, std::vector<float>(16));
+		for (std::vector<float>& model : models)
+		{
+			float r[7];
+			for (float& value : r)
+				value = unit(random);
+			Model(1 + r[0] * 3, 1 + r[1] * 3, 0.3f + r[2], r[3] * 6.28f, r[4] * 40 - 20, r[5] * 20 - 10, 8 + r[6] * 20, model.data());
+		}
+
+		OcclusionCuller single, threaded;
+		single.Init(Width, Height, 1);
+		threaded.Init(Width, Height, 4);
+		ReferenceDepth reference(single.GetWidth(), single.GetHeight());
+		for (OcclusionCuller* pCuller : { &single, &threaded })
+		{
+			pCuller->BeginFrame(pViewProjection);
+			for (const std::vector<float>& model : models)
+				pCuller->AddOccluder(cube, model.data());
+			pCuller->Rasterize();
+		}
+		for (const std::vector<float>& model : models)
+		{
+			float modelViewProjection[16];
+			Multiply(model.data(), pViewProjection, modelViewProjection);
+			reference.AddOccluder(cube, modelViewProjection);
+		}
+
+		bool sameDepth = true;
+		for (uint32_t y = 0; y < single.GetTilesY(); y++)
+		{
+			for (uint32_t x = 0; x < single.GetTilesX(); x++)
+				sameDepth &= single.GetTileDepth(x, y) == threaded.GetTileDepth(x, y);
+		}
+		CHECK(sameDepth);
+
+		int occluded = 0, referenceOccluded = 0, wrong = 0;
+		for (int i = 0; i < 4000; i++)
+		{
+			const float center[3] = { unit(random) * 80 - 40, unit(random) * 30 - 15, 10 + unit(random) * 80 };
+			const float extent = 0.2f + unit(random) * 1.3f;
+			const float minVec[3] = { center[0] - extent, center[1] - extent, center[2] - extent };
+			const float maxVec[3] = { center[0] + extent, center[1] + extent, center[2] + extent };
+			const bool isOccluded = single.IsOccluded(minVec, maxVec);
+			const bool isReferenceOccluded = reference.IsOccluded(minVec, maxVec, pViewProjection);
+			CHECK(isOccluded == threaded.IsOccluded(minVec, maxVec));
+			occluded += isOccluded;
+			referenceOccluded += isReferenceOccluded;
+			wrong += isOccluded && !isReferenceOccluded;
+		}
+		CHECK(wrong == 0);
+		// Conservative, but most of what the exact buffer hides
+		CHECK(occluded > 0 && occluded * 2 > referenceOccluded);
+		printf("random scene: %d of 4000 boxes occluded, %d by a per pixel depth buffer\n", occluded, referenceOccluded);
+	}
+}
+
+int main()
+{
+	float viewProjection[16];
+	Perspective(3.14f / 3.0f, float(Height) / Width, 0.1f, 100.0f, viewProjection);
+	const OccluderMesh cube = MakeCube();
+	TestWall(cube, viewProjection);
+	TestRandomScene(cube, viewProjection);
+	return CheckResult();
+}
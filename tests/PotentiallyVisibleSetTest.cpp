@@ -0,0 +1,217 @@
+#include "Check.h"
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "PotentiallyVisibleSet.h"
+
+namespace
+{
+	// Item bounds in the SoA layout of BVHInput
+	struct Items
+	{
+		std::vector<float> minVec[3];
+		std::vector<float> maxVec[3];
+
+		void Add(const float minCorner[3], const float maxCorner[3])
+		{
+			for (int a = 0; a < 3; a++)
+			{
+				minVec[a].push_back(minCorner[a]);
+				maxVec[a].push_back(maxCorner[a]);
+			}
+		}
+		BVHInput GetInput() const
+		{
+			return { { minVec[0].data(), minVec[1].data(), minVec[2].data() },
+				{ maxVec[0].data(), maxVec[1].data(), maxVec[2].data() }, uint32_t(minVec[0].size()) };
+		}
+	};
+
+	// Unit cubes on a 40 x 40 floor, every one a solid occluder, and two walls splitting the floor
+	void MakeScene(Items& outItems, std::vector<PVSOccluder>& outOccluders)
+	{
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> position(-19.0f, 19.0f);
+		for (uint32_t i = 0; i < 300; i++)
+		{
+			const float center[3] = { position(random), 0.5f, position(random) };
+			const float minCorner[3] = { center[0] - 0.5f, 0.0f, center[2] - 0.5f };
+			const float maxCorner[3] = { center[0] + 0.5f, 1.0f, center[2] + 0.5f };
+			outItems.Add(minCorner, maxCorner);
+			PVSOccluder occluder = { { center[0], center[1], center[2] }, { { 0.5f, 0.0f, 0.0f }, { 0.0f, 0.5f, 0.0f }, { 0.0f, 0.0f, 0.5f } }, i };
+			outOccluders.push_back(occluder);
+		}
+		PVSOccluder wallX = { { 0.0f, 2.0f, 5.0f }, { { 0.1f, 0.0f, 0.0f }, { 0.0f, 2.0f, 0.0f }, { 0.0f, 0.0f, 15.0f } }, UINT32_MAX };
+		PVSOccluder wallZ = { { -5.0f, 2.0f, 0.0f }, { { 15.0f, 0.0f, 0.0f }, { 0.0f, 2.0f, 0.0f }, { 0.0f, 0.0f, 0.1f } }, UINT32_MAX };
+		outOccluders.push_back(wallX);
+		outOccluders.push_back(wallZ);
+	}
+
+	PVSBakeDesc MakeSceneDesc(uint32_t threadCount)
+	{
+		PVSBakeDesc desc;
+		const float minVec[3] = { -20.0f, 0.0f, -20.0f };
+		const float maxVec[3] = { 20.0f, 4.0f, 20.0f };
+		for (int a = 0; a < 3; a++)
+		{
+			desc.minVec[a] = minVec[a];
+			desc.maxVec[a] = maxVec[a];
+		}
+		desc.cellCounts[0] = 6;
+		desc.cellCounts[1] = 2;
+		desc.cellCounts[2] = 6;
+		desc.raysPerItem = 16;
+		desc.threadCount = threadCount;
+		desc.seed = 3;
+		return desc;
+	}
+
+	bool SameSets(const PotentiallyVisibleSet& a, const PotentiallyVisibleSet& b)
+	{
+		if (a.GetCellCount() != b.GetCellCount())
+			return false;
+		std::vector<uint32_t> idsA, idsB;
+		for (uint32_t cell = 0; cell < a.GetCellCount(); cell++)
+		{
+			a.GetVisible(int32_t(cell), idsA);
+			b.GetVisible(int32_t(cell), idsB);
+			if (idsA != idsB)
+				return false;
+		}
+		return true;
+	}
+
+	// Every cell draws its own samples: baking again, on one thread or on several, gives the same sets
+	void TestDeterministic()
+	{
+		Items items;
+		std::vector<PVSOccluder> occluders;
+		MakeScene(items, occluders);
+		const BVHInput targets = items.GetInput();
+
+		PotentiallyVisibleSet single, again, threaded;
+		single.Bake(MakeSceneDesc(1), targets, occluders);
+		again.Bake(MakeSceneDesc(1), targets, occluders);
+		threaded.Bake(MakeSceneDesc(4), targets, occluders);
+		CHECK(single.IsBaked() && single.GetCellCount() == 72 && single.GetItemCount() == targets.count);
+		CHECK(SameSets(single, again));
+		CHECK(SameSets(single, threaded));
+		CHECK(single.GetBakeStats().castRays == threaded.GetBakeStats().castRays);
+		CHECK(single.GetBakeStats().uniqueSets == threaded.GetBakeStats().uniqueSets);
+		CHECK(single.GetBakeStats().compressedBytes == threaded.GetBakeStats().compressedBytes);
+
+		// The occluders hide something, and every cell keeps the items touching it
+		size_t hidden = 0;
+		bool sorted = true;
+		std::vector<uint32_t> ids;
+		for (uint32_t cell = 0; cell < single.GetCellCount(); cell++)
+		{
+			single.GetVisible(int32_t(cell), ids);
+			hidden += targets.count - ids.size();
+			sorted &= std::is_sorted(ids.begin(), ids.end());
+		}
+		bool keepsTouching = true;
+		for (uint32_t item = 0; item < targets.count; item++)
+		{
+			const float inside[3] = { items.minVec[0][item] + 0.5f, 0.5f, items.minVec[2][item] + 0.5f };
+			keepsTouching &= single.IsVisible(single.FindCell(inside), item);
+		}
+		CHECK(hidden > 0);
+		CHECK(sorted);
+		CHECK(keepsTouching);
+	}
+
+	// Without rays a cell keeps exactly the items touching it and the dynamic ones, which gives known sets to read back
+	// through the run length coding: zero runs longer than one run header holds, a literal run split in two, bits at
+	// the word edges and the last item. Cells 2 and 3 only keep the dynamic items and share their set.
+	void TestKnownSets()
+	{
+		const uint32_t itemCount = 2200000; // 68750 words, more than 0xFFFF
+		const uint32_t literalFirst = 320;
+		const uint32_t literalWords = 68000;
+		std::vector<std::vector<uint32_t>> cellItems = {
+			{ 0, 31, 32, 100, itemCount - 1 },
+			{},
+			{},
+			{},
+		};
+		for (uint32_t word = 0; word < literalWords; word++)
+			cellItems[1].push_back(literalFirst + word * 32);
+		const uint32_t dynamicItems[] = { 5, 1500001 };
+
+		Items items;
+		const float farMin[3] = { 100.0f, 100.0f, 100.0f };
+		const float farMax[3] = { 101.0f, 101.0f, 101.0f };
+		for (uint32_t i = 0; i < itemCount; i++)
+			items.Add(farMin, farMax);
+		for (size_t cell = 0; cell < cellItems.size(); cell++)
+		{
+			for (uint32_t item : cellItems[cell])
+			{
+				items.minVec[0][item] = cell + 0.25f;
+				items.maxVec[0][item] = cell + 0.75f;
+				for (int a = 1; a < 3; a++)
+				{
+					items.minVec[a][item] = 0.25f;
+					items.maxVec[a][item] = 0.75f;
+				}
+			}
+		}
+
+		PVSBakeDesc desc;
+		desc.maxVec[0] = 4.0f;
+		desc.maxVec[1] = 1.0f;
+		desc.maxVec[2] = 1.0f;
+		desc.cellCounts[0] = 4;
+		desc.cellCounts[1] = 1;
+		desc.cellCounts[2] = 1;
+		desc.raysPerItem = 0;
+		desc.dilate = false;
+		desc.pDynamicItems = dynamicItems;
+		desc.dynamicCount = 2;
+		PotentiallyVisibleSet pvs;
+		pvs.Bake(desc, items.GetInput(), std::vector<PVSOccluder>());
+
+		std::vector<uint32_t> ids;
+		for (size_t cell = 0; cell < cellItems.size(); cell++)
+		{
+			std::vector<uint32_t> expected = cellItems[cell];
+			expected.insert(expected.end(), std::begin(dynamicItems), std::end(dynamicItems));
+			std::sort(expected.begin(), expected.end());
+			pvs.GetVisible(int32_t(cell), ids);
+			CHECK(ids == expected);
+
+			// IsVisible walks the runs on its own, it agrees on the set items and their neighbours
+			bool agrees = true;
+			for (uint32_t item : expected)
+			{
+				agrees &= pvs.IsVisible(int32_t(cell), item);
+				for (uint32_t neighbour : { item - 1, item + 1 })
+				{
+					if (neighbour < itemCount)
+						agrees &= pvs.IsVisible(int32_t(cell), neighbour) == std::binary_search(expected.begin(), expected.end(), neighbour);
+				}
+			}
+			CHECK(agrees);
+		}
+
+		const PVSBakeStats& stats = pvs.GetBakeStats();
+		CHECK(stats.castRays == 0);
+		CHECK(stats.uniqueSets == 3);
+		CHECK(stats.uncompressedBytes == size_t(4) * 68750 * sizeof(uint32_t));
+		CHECK(stats.compressedBytes < stats.uncompressedBytes);
+
+		const float outside[3] = { 4.0f, 0.5f, 0.5f };
+		CHECK(pvs.FindCell(outside) == -1);
+		pvs.GetVisible(-1, ids);
+		CHECK(ids.empty());
+	}
+}
+
+int main()
+{
+	TestDeterministic();
+	TestKnownSets();
+	return CheckResult();
+}
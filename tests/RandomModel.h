@@ -0,0 +1,27 @@
+#pragma once
+#include <random>
+#include "framework.h"
+
+// Random affine instance transform of the culling and upload tests and benchmarks: scaled by 0.5 to 1.5 along each
+// axis, rotated about a random axis and translated uniformly inside [minCorner, maxCorner]
+inline DirectX::XMMATRIX RandomModel(std::mt19937& random, const DirectX::XMFLOAT3& minCorner, const DirectX::XMFLOAT3& maxCorner)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	// Every draw is its own statement, argument evaluation order would make the sequence compiler dependent
+	float axis[3];
+	do
+	{
+		for (float& component : axis)
+			component = unit(random) - 0.5f;
+	} while (axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] < 1e-4f);
+	float scale[3], position[3];
+	for (float& component : scale)
+		component = 0.5f + unit(random);
+	const float angle = unit(random) * DirectX::XM_2PI;
+	position[0] = minCorner.x + (maxCorner.x - minCorner.x) * unit(random);
+	position[1] = minCorner.y + (maxCorner.y - minCorner.y) * unit(random);
+	position[2] = minCorner.z + (maxCorner.z - minCorner.z) * unit(random);
+	return DirectX::XMMatrixScaling(scale[0], scale[1], scale[2])
+		* DirectX::XMMatrixRotationAxis(DirectX::XMVector3Normalize(DirectX::XMVectorSet(axis[0], axis[1], axis[2], 0.0f)), angle)
+		* DirectX::XMMatrixTranslation(position[0], position[1], position[2]);
+}
@@ -0,0 +1,101 @@
+#include "Check.h"
+#include <vector>
+#include "RenderQueue.h"
+
+namespace
+{
+	const uint32_t OpaquePass = 1;
+	const uint32_t TransparentPass = 2;
+	const uint32_t BasePermutation = 0;
+	const uint32_t MarkerPermutation = 1;
+
+	const int CubeGeometry = 0;
+	const int SphereGeometry = 1;
+
+	// Merged and kept apart pairs of instanced draws
+	void TestCanMergeDraws()
+	{
+		const void* pCube = &CubeGeometry;
+		const void* pSphere = &SphereGeometry;
+		const uint64_t cubes = DrawKey::Make(OpaquePass, BasePermutation, 3, 0, 100);
+		const uint64_t otherMaterial = DrawKey::Make(OpaquePass, BasePermutation, 4, 0, 50);
+		const uint64_t otherPermutation = DrawKey::Make(OpaquePass, MarkerPermutation, 3, 0, 100);
+		const uint64_t otherPass = DrawKey::Make(TransparentPass, BasePermutation, 3, 0, 100);
+
+		// Same pass, permutation and geometry, the material and depth do not matter
+		CHECK(CanMergeDraws(cubes, pCube, 10, cubes, pCube, 5, false));
+		CHECK(CanMergeDraws(cubes, pCube, 10, otherMaterial, pCube, 5, false));
+
+		CHECK(!CanMergeDraws(cubes, pCube, 10, cubes, pSphere, 5, false));
+		CHECK(!CanMergeDraws(cubes, pCube, 10, otherPermutation, pCube, 5, false));
+		CHECK(!CanMergeDraws(cubes, pCube, 10, otherPass, pCube, 5, false));
+		// Single draws have no ids, they are neither merged into nor merge others
+		CHECK(!CanMergeDraws(cubes, pCube, 10, cubes, pCube, 0, false));
+		CHECK(!CanMergeDraws(cubes, pCube, 0, cubes, pCube, 5, false));
+
+		// Back to front keys: the permutation sits below the depth, draws at different depths still merge
+		const uint64_t nearPlane = DrawKey::MakeBackToFront(TransparentPass, BasePermutation, 3, 0, 10);
+		const uint64_t farPlane = DrawKey::MakeBackToFront(TransparentPass, BasePermutation, 5, 0, 900);
+		const uint64_t farMarker = DrawKey::MakeBackToFront(TransparentPass, MarkerPermutation, 3, 0, 900);
+		CHECK(CanMergeDraws(farPlane, pCube, 1, nearPlane, pCube, 1, true));
+		CHECK(!CanMergeDraws(farPlane, pCube, 1, farMarker, pCube, 1, true));
+	}
+
+	struct Command
+	{
+		const void* pGeometry;
+		uint32_t idCount;
+	};
+
+	// Runs SubmitDraws builds from a sorted queue: consecutive mergeable items form one draw
+	void TestMergedRuns()
+	{
+		const void* pCube = &CubeGeometry;
+		const void* pSphere = &SphereGeometry;
+		const std::vector<Command> commands = {
+			{ pCube, 4 }, // 0
+			{ pSphere, 1 }, // 1, single marker
+			{ pCube, 7 }, // 2
+			{ pSphere, 0 }, // 3, skybox without ids
+			{ pCube, 2 }, // 4
+			{ pSphere, 1 }, // 5, second marker
+		};
+		RenderQueue queue;
+		queue.Push(DrawKey::Make(OpaquePass, BasePermutation, 1, 0, 30), 0);
+		queue.Push(DrawKey::Make(OpaquePass, MarkerPermutation, 2, 1, 10), 1);
+		queue.Push(DrawKey::Make(OpaquePass, BasePermutation, 2, 0, 20), 2);
+		queue.Push(DrawKey::Make(3, BasePermutation, 0, 1, DrawKey::MaxDepth), 3);
+		queue.Push(DrawKey::Make(OpaquePass, BasePermutation, 1, 0, 5), 4);
+		queue.Push(DrawKey::Make(OpaquePass, MarkerPermutation, 2, 1, 40), 5);
+		queue.Sort();
+
+		std::vector<std::vector<uint32_t>> runs;
+		const DrawItem* pItems = queue.GetItems();
+		for (size_t i = 0; i < queue.GetCount(); i++)
+		{
+			const Command& command = commands[pItems[i].command];
+			if (i > 0)
+			{
+				const DrawItem& first = pItems[i - runs.back().size()];
+				const Command& firstCommand = commands[first.command];
+				if (CanMergeDraws(first.key, firstCommand.pGeometry, firstCommand.idCount, pItems[i].key, command.pGeometry, command.idCount,
+					false))
+				{
+					runs.back().push_back(pItems[i].command);
+					continue;
+				}
+			}
+			runs.push_back({ pItems[i].command });
+		}
+		// Cubes by material and depth, then both markers, then the skybox pass
+		const std::vector<std::vector<uint32_t>> expected = { { 4, 0, 2 }, { 1, 5 }, { 3 } };
+		CHECK(runs == expected);
+	}
+}
+
+int main()
+{
+	TestCanMergeDraws();
+	TestMergedRuns();
+	return CheckResult();
+}
@@ -0,0 +1,152 @@
+#include "Check.h"
+#include "CountingDeviceContext.h"
+#include "StateCache.h"
+#include <cstdint>
+
+namespace
+{
+	// Distinct interface pointers, never dereferenced by the cache or the context
+	template<class T>
+	T* Fake(uintptr_t id)
+	{
+		return reinterpret_cast<T*>(id * 16);
+	}
+
+	struct Scene
+	{
+		PipelineState permutations[4];
+		ID3D11ShaderResourceView* permutationViews[4];
+		ID3D11DepthStencilState* depthStates[2];
+		ID3D11BlendState* pBlendState;
+		ID3D11Buffer* geometries[12];
+		ID3D11Buffer* pViewBuffer;
+		ID3D11Buffer* pDrawBuffer;
+		ID3D11SamplerState* pSampler;
+		ID3D11ShaderResourceView* pInstanceView;
+		ID3D11ShaderResourceView* pIdView;
+
+		Scene()
+		{
+			uintptr_t id = 1;
+			for (int i = 0; i < 4; i++)
+			{
+				permutations[i].pInputLayout = Fake<ID3D11InputLayout>(id++);
+				permutations[i].pVertexShader = Fake<ID3D11VertexShader>(id++);
+				permutations[i].pPixelShader = Fake<ID3D11PixelShader>(id++);
+				permutationViews[i] = Fake<ID3D11ShaderResourceView>(id++);
+			}
+			depthStates[0] = Fake<ID3D11DepthStencilState>(id++);
+			depthStates[1] = Fake<ID3D11DepthStencilState>(id++);
+			pBlendState = Fake<ID3D11BlendState>(id++);
+			for (ID3D11Buffer*& pGeometry : geometries)
+				pGeometry = Fake<ID3D11Buffer>(id++);
+			pViewBuffer = Fake<ID3D11Buffer>(id++);
+			pDrawBuffer = Fake<ID3D11Buffer>(id++);
+			pSampler = Fake<ID3D11SamplerState>(id++);
+			pInstanceView = Fake<ID3D11ShaderResourceView>(id++);
+			pIdView = Fake<ID3D11ShaderResourceView>(id++);
+		}
+	};
+
+	// One draw run of the renderer's sorted queue: 16 binding calls, all of them stated every time
+	void BindRun(StateCache& cache, const Scene& scene, int pass, int permutation, int geometry)
+	{
+		PipelineState state = scene.permutations[permutation];
+		state.pDepthStencilState = scene.depthStates[pass == 0 ? 0 : 1];
+		state.pBlendState = pass == 2 ? scene.pBlendState : nullptr;
+		cache.SetPipelineState(state);
+		cache.SetVSConstantBuffer(0, scene.pViewBuffer);
+		cache.SetPSConstantBuffer(0, scene.pViewBuffer);
+		cache.SetPSSampler(0, scene.pSampler);
+		cache.SetPSShaderResource(0, scene.permutationViews[permutation]);
+		cache.SetIndexBuffer(scene.geometries[geometry], DXGI_FORMAT_R16_UINT);
+		cache.SetVertexBuffer(scene.geometries[geometry], 24, 0);
+		cache.SetVSConstantBuffer(2, scene.pDrawBuffer);
+		cache.SetVSShaderResource(5, scene.pInstanceView);
+		cache.SetVSShaderResource(6, scene.pIdView);
+	}
+
+	bool IsBound(const CountingDeviceContext& context, const Scene& scene, int pass, int permutation, int geometry)
+	{
+		const CountingDeviceContext::State& state = context.state;
+		const PipelineState& pipeline = scene.permutations[permutation];
+		return state.pInputLayout == pipeline.pInputLayout && state.topology == D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST &&
+			state.pVertexShader == pipeline.pVertexShader && state.pPixelShader == pipeline.pPixelShader &&
+			state.pBlendState == (pass == 2 ? scene.pBlendState : nullptr) && state.pDepthStencilState == scene.depthStates[pass == 0 ? 0 : 1] &&
+			state.pRasterizerState == nullptr && state.pVertexBuffer == scene.geometries[geometry] && state.vertexStride == 24 &&
+			state.vertexOffset == 0 && state.pIndexBuffer == scene.geometries[geometry] && state.indexFormat == DXGI_FORMAT_R16_UINT &&
+			state.vertexStage.constantBuffers[0] == scene.pViewBuffer && state.vertexStage.constantBuffers[2] == scene.pDrawBuffer &&
+			state.pixelStage.constantBuffers[0] == scene.pViewBuffer && state.pixelStage.samplers[0] == scene.pSampler &&
+			state.pixelStage.shaderResources[0] == scene.permutationViews[permutation] &&
+			state.vertexStage.shaderResources[5] == scene.pInstanceView && state.vertexStage.shaderResources[6] == scene.pIdView;
+	}
+
+	// A frame of 400 opaque runs over two permutations and 12 geometry changes, the sky and the transparent planes
+	void TestFrame()
+	{
+		const Scene scene;
+		CountingDeviceContext context;
+		StateCache cache;
+		context.ClearState();
+		cache.Reset(&context);
+
+		const int runCounts[3] = { 400, 1, 100 };
+		int runs = 0;
+		bool bound = true;
+		for (int pass = 0; pass < 3; pass++)
+		{
+			for (int run = 0; run < runCounts[pass]; run++)
+			{
+				const int permutation = pass == 1 ? 2 : pass == 2 ? 3 : (run < 8 ? 0 : 1);
+				const int geometry = pass == 1 ? 11 : pass == 2 ? 10 : run * 12 / runCounts[0] % 10;
+				BindRun(cache, scene, pass, permutation, geometry);
+				bound &= IsBound(context, scene, pass, permutation, geometry);
+				runs++;
+			}
+		}
+		CHECK(bound);
+		CHECK(IsBound(context, scene, 2, 3, 10));
+
+		// Issued: 4 permutation changes of layout, shaders and view (16), the topology, 2 depth states, the blend
+		// state, the shared view, sampler, draw and instance bindings (6) and 14 geometry changes of both buffers (28)
+		const StateCache::Counters& counters = cache.GetCounters();
+		CHECK(counters.issued + counters.skipped == UINT(runs) * 16);
+		CHECK(counters.issued == 54);
+		CHECK(counters.issued == context.bindCalls);
+	}
+
+	// After ClearState and Reset everything is bound again, nothing is skipped against the stale shadow
+	void TestReset()
+	{
+		const Scene scene;
+		CountingDeviceContext context;
+		StateCache cache;
+		cache.Reset(&context);
+		BindRun(cache, scene, 2, 3, 10);
+		const UINT firstIssued = cache.GetCounters().issued;
+		CHECK(firstIssued == 15); // all but the null rasterizer state
+
+		context.ClearState();
+		cache.Reset(&context);
+		CHECK(cache.GetCounters().issued == 0 && cache.GetCounters().skipped == 0);
+		BindRun(cache, scene, 2, 3, 10);
+		CHECK(cache.GetCounters().issued == firstIssued);
+		CHECK(IsBound(context, scene, 2, 3, 10));
+		CHECK(context.bindCalls == firstIssued * 2);
+
+		// Binding null into a cleared slot is redundant, a changed stride or offset alone is not
+		cache.SetPSShaderResource(3, nullptr);
+		CHECK(cache.GetCounters().skipped == 2);
+		cache.SetVertexBuffer(scene.geometries[10], 32, 0);
+		cache.SetVertexBuffer(scene.geometries[10], 32, 64);
+		CHECK(context.state.vertexStride == 32 && context.state.vertexOffset == 64);
+		CHECK(cache.GetCounters().issued == firstIssued + 2);
+	}
+}
+
+int main()
+{
+	TestFrame();
+	TestReset();
+	return CheckResult();
+}
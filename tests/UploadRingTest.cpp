@@ -0,0 +1,143 @@
+#include "Check.h"
+#include "UploadRing.h"
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Ten 100 byte allocations fill the ring exactly, the next one is refused until the frame retires
+	void TestFull()
+	{
+		UploadRing ring;
+		ring.Init(1000);
+		size_t offset = 0;
+		for (size_t i = 0; i < 10; i++)
+		{
+			CHECK(ring.Allocate(100, 100, offset));
+			CHECK(offset == i * 100);
+		}
+		CHECK(ring.GetUsed() == 1000);
+		CHECK(!ring.Allocate(1, 1, offset));
+		ring.EndFrame(1);
+		CHECK(!ring.Allocate(1, 1, offset));
+		ring.Retire(0);
+		CHECK(!ring.Allocate(1, 1, offset));
+		CHECK(ring.GetFramesInFlight() == 1);
+
+		ring.Retire(1);
+		CHECK(ring.GetUsed() == 0 && ring.GetFramesInFlight() == 0);
+		CHECK(ring.Allocate(1000, 100, offset) && offset == 0);
+		CHECK(!ring.Allocate(1001, 1, offset));
+	}
+
+	// An allocation not fitting before the end starts over at offset 0 when the frames there retired, the
+	// skipped tail counts as used until its frame retires too
+	void TestWrapAround()
+	{
+		UploadRing ring;
+		ring.Init(1000);
+		size_t offset = 0;
+		CHECK(ring.Allocate(600, 1, offset) && offset == 0);
+		ring.EndFrame(1);
+		CHECK(ring.Allocate(300, 1, offset) && offset == 600);
+		ring.EndFrame(2);
+		CHECK(!ring.Allocate(300, 1, offset)); // the first frame still holds the start
+
+		ring.Retire(1);
+		CHECK(ring.GetUsed() == 300);
+		CHECK(ring.Allocate(300, 1, offset) && offset == 0);
+		CHECK(ring.GetUsed() == 700); // with the 100 byte tail
+		CHECK(!ring.Allocate(400, 1, offset)); // would run into the second frame
+		CHECK(ring.Allocate(300, 1, offset) && offset == 300);
+		ring.EndFrame(3);
+		CHECK(!ring.Allocate(1, 1, offset));
+
+		ring.Retire(2);
+		CHECK(ring.GetUsed() == 700);
+		CHECK(ring.Allocate(300, 1, offset) && offset == 600);
+		CHECK(!ring.Allocate(100, 1, offset)); // the tail is still charged to the third frame
+		ring.EndFrame(4);
+		ring.Retire(3);
+		CHECK(ring.GetUsed() == 300 && ring.GetFramesInFlight() == 1);
+		CHECK(ring.Allocate(600, 176, offset) && offset == 0);
+
+		// Alignment that is no power of two, the padding counts as used
+		ring.Reset();
+		CHECK(ring.Allocate(10, 1, offset) && offset == 0);
+		CHECK(ring.Allocate(10, 176, offset) && offset == 176);
+		CHECK(ring.GetUsed() == 186);
+	}
+
+	struct LiveAllocation
+	{
+		size_t offset;
+		size_t size;
+		uint64_t fence;
+	};
+
+	// Frames of random allocations retired a few frames late, like a GPU behind the CPU. No allocation may
+	// overlap one whose frame has not retired.
+	void TestSimulation()
+	{
+		std::mt19937 random(5);
+		size_t allocations = 0, refusals = 0, wraps = 0;
+		bool valid = true;
+		for (int trial = 0; trial < 200; trial++)
+		{
+			const size_t capacity = 1000 + random() % 50000;
+			const uint64_t latency = 1 + random() % 4;
+			UploadRing ring;
+			ring.Init(capacity);
+			std::vector<LiveAllocation> live;
+			size_t lastOffset = 0;
+			for (uint64_t fence = 1; fence <= 300; fence++)
+			{
+				if (fence > latency + 1)
+				{
+					const uint64_t completed = fence - 1 - latency;
+					ring.Retire(completed);
+					std::vector<LiveAllocation> kept;
+					for (const LiveAllocation& allocation : live)
+					{
+						if (allocation.fence > completed)
+							kept.push_back(allocation);
+					}
+					live.swap(kept);
+				}
+				const int count = random() % 20;
+				for (int i = 0; i < count; i++)
+				{
+					const size_t alignment = random() % 3 == 0 ? 176 : (random() % 2 ? 4 : 16);
+					const size_t size = 1 + random() % (capacity / 8);
+					size_t offset = 0;
+					if (!ring.Allocate(size, alignment, offset))
+					{
+						refusals++;
+						continue;
+					}
+					allocations++;
+					wraps += offset < lastOffset;
+					lastOffset = offset;
+					valid &= offset % alignment == 0 && offset + size <= capacity;
+					for (const LiveAllocation& allocation : live)
+						valid &= offset >= allocation.offset + allocation.size || allocation.offset >= offset + size;
+					live.push_back({ offset, size, fence });
+				}
+				valid &= ring.GetUsed() <= capacity;
+				ring.EndFrame(fence);
+			}
+			ring.Retire(300);
+			valid &= ring.GetUsed() == 0 && ring.GetFramesInFlight() == 0;
+		}
+		CHECK(valid);
+		CHECK(allocations > 0 && refusals > 0 && wraps > 0);
+	}
+}
+
+int main()
+{
+	TestFull();
+	TestWrapAround();
+	TestSimulation();
+	return CheckResult();
+}
@@ -0,0 +1,106 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <random>
+#include <vector>
+#include <smmintrin.h>
+#include "GeometryData.h"
+#include "RandomModel.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// out = a * b for row major 4x4 matrices, with the multiply-add order of DirectXMath's SSE XMMatrixMultiply
+	void MultiplySSE(const float* a, const float* b, float* out)
+	{
+		const __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+		for (int row = 0; row < 4; row++)
+		{
+			const __m128 xy = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[row * 4]), b0), _mm_mul_ps(_mm_set1_ps(a[row * 4 + 1]), b1));
+			const __m128 zw = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[row * 4 + 2]), b2), _mm_mul_ps(_mm_set1_ps(a[row * 4 + 3]), b3));
+			_mm_storeu_ps(out + row * 4, _mm_add_ps(xy, zw));
+		}
+	}
+
+	// The removed Instance::UpdateAABB: a translation matrix per support vector times the model
+	void UpdateAABB(const std::vector<XMFLOAT3>& supportVectors, const XMMATRIX& model, XMFLOAT3& outMin, XMFLOAT3& outMax)
+	{
+		float translation[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+		float product[16];
+		for (size_t i = 0; i < supportVectors.size(); i++)
+		{
+			translation[12] = supportVectors[i].x;
+			translation[13] = supportVectors[i].y;
+			translation[14] = supportVectors[i].z;
+			MultiplySSE(translation, (const float*)&model, product);
+			const XMFLOAT3 corner(product[12], product[13], product[14]);
+			if (i == 0)
+				outMin = outMax = corner;
+			outMin = XMFLOAT3((std::min)(outMin.x, corner.x), (std::min)(outMin.y, corner.y), (std::min)(outMin.z, corner.z));
+			outMax = XMFLOAT3((std::max)(outMax.x, corner.x), (std::max)(outMax.y, corner.y), (std::max)(outMax.z, corner.z));
+		}
+	}
+}
+
+int main()
+{
+	std::vector<TextureNormalVertex> vertices;
+	std::vector<USHORT> indices;
+	GeometryData::getCubeGeometry(vertices, indices);
+	GeometryData geometry;
+	geometry.ComputeBounds(vertices.data(), sizeof(TextureNormalVertex), vertices.size());
+
+	const int count = 100000;
+	std::mt19937 random(5);
+	ObjectBuffer buffer;
+	buffer.instances.resize(count);
+	for (int i = 0; i < count; i++)
+		buffer.set(i, RandomModel(random, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(100.0f, 100.0f, 100.0f)), geometry);
+	buffer.Refresh();
+	buffer.ClearChanges();
+
+	double maxError = 0.0;
+	for (int i = 0; i < count; i++)
+	{
+		XMFLOAT3 minVec, maxVec;
+		UpdateAABB(geometry.vectorsAABB, buffer.instances[i].model, minVec, maxVec);
+		const float errors[] = { buffer.bounds.GetMinX()[i] - minVec.x, buffer.bounds.GetMinY()[i] - minVec.y, buffer.bounds.GetMinZ()[i] - minVec.z,
+			buffer.bounds.GetMaxX()[i] - maxVec.x, buffer.bounds.GetMaxY()[i] - maxVec.y, buffer.bounds.GetMaxZ()[i] - maxVec.z };
+		for (float error : errors)
+			maxError = (std::max)(maxError, double(std::fabs(error)));
+	}
+
+	std::vector<UINT32> sparseIds;
+	for (UINT32 i = 0; i < count; i += 7)
+		sparseIds.push_back(i);
+	const XMMATRIX* pModels = &buffer.instances[0].model;
+	XMFLOAT3 minVec, maxVec;
+	const double oldMs = MeasureMs(10, [&]()
+	{
+		for (int i = 0; i < count; i++)
+		{
+			UpdateAABB(geometry.vectorsAABB, buffer.instances[i].model, minVec, maxVec);
+			buffer.bounds.Set(i, minVec, maxVec);
+		}
+	});
+	const double oldSparseMs = MeasureMs(10, [&]()
+	{
+		for (UINT32 i : sparseIds)
+		{
+			UpdateAABB(geometry.vectorsAABB, buffer.instances[i].model, minVec, maxVec);
+			buffer.bounds.Set(i, minVec, maxVec);
+		}
+	});
+	const double rangeMs = MeasureMs(10, [&]() { buffer.bounds.SetTransformed(buffer.localBox, pModels, sizeof(Instance), nullptr, count); });
+	const double sparseMs = MeasureMs(10, [&]()
+	{
+		buffer.bounds.SetTransformed(buffer.localBox, pModels, sizeof(Instance), sparseIds.data(), sparseIds.size());
+	});
+
+	printf("%d instances, max |SetTransformed - UpdateAABB| %g\n", count, maxError);
+	printf("UpdateAABB + Set          %6.1f ns / instance\n", oldMs * 1e6 / count);
+	printf("UpdateAABB + Set, sparse  %6.1f ns / instance\n", oldSparseMs * 1e6 / sparseIds.size());
+	printf("SetTransformed, range     %6.1f ns / instance\n", rangeMs * 1e6 / count);
+	printf("SetTransformed, sparse    %6.1f ns / instance\n", sparseMs * 1e6 / sparseIds.size());
+	return maxError < 1e-4 ? 0 : 1;
+}
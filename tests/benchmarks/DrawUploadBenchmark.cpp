@@ -0,0 +1,134 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "UploadRing.h" // before windows.h and its min and max macros
+#include "GeometryData.h"
+#include "RandomModel.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// System memory stand-in for a mapped upload ring, suballocated like Renderer::AllocateUpload
+	struct UploadMemory
+	{
+		UploadRing ring;
+		std::vector<uint8_t> memory;
+		size_t stride = 0;
+
+		void Init(size_t elementCount, size_t elementStride)
+		{
+			stride = elementStride;
+			ring.Init(elementCount * elementStride);
+			memory.resize(elementCount * elementStride);
+		}
+		void* Allocate(size_t count, UINT& outFirstElement)
+		{
+			size_t offset = 0;
+			if (!ring.Allocate(count * stride, stride, offset))
+			{
+				ring.Reset();
+				ring.Allocate(count * stride, stride, offset);
+			}
+			outFirstElement = UINT(offset / stride);
+			return memory.data() + offset;
+		}
+	};
+
+	// One draw of the visible ids of an object buffer
+	struct Draw
+	{
+		const ObjectBuffer* pObjects;
+		UINT instanceBase;
+		std::vector<UINT32> ids;
+	};
+}
+
+int main()
+{
+	const size_t counts[] = { 100000, 1000000 };
+	const size_t BufferCount = 16;
+	bool matches = true;
+	for (size_t count : counts)
+	{
+		// The instances of a frame split over several object buffers, about half of them visible
+		std::mt19937 random(3);
+		std::bernoulli_distribution visible(0.5);
+		std::vector<ObjectBuffer> buffers(BufferCount);
+		std::vector<Draw> draws;
+		UINT instanceCount = 0;
+		size_t idCount = 0;
+		for (size_t b = 0; b < BufferCount; b++)
+		{
+			ObjectBuffer& buffer = buffers[b];
+			buffer.instances.resize(count / BufferCount);
+			for (size_t i = 0; i < buffer.instances.size(); i++)
+			{
+				buffer.setModel(int(i), RandomModel(random, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(100.0f, 100.0f, 100.0f)));
+				buffer.instances[i].materialId = UINT16(i % 7);
+			}
+			buffer.ClearChanges();
+			Draw draw = { &buffer, instanceCount, {} };
+			for (UINT32 i = 0; i < UINT32(buffer.instances.size()); i++)
+			{
+				if (visible(random))
+					draw.ids.push_back(i);
+			}
+			idCount += draw.ids.size();
+			instanceCount += UINT(buffer.instances.size());
+			draws.push_back(std::move(draw));
+		}
+
+		// Two frames fit, the second frame of every run wraps like a ring in steady use
+		UploadMemory instanceUpload, idUpload;
+		instanceUpload.Init(instanceCount * 2, sizeof(InstanceData));
+		idUpload.Init(idCount * 2, sizeof(UINT32));
+		std::vector<XMUINT4> drawOffsets(draws.size());
+		UINT firstInstance = 0;
+		UINT firstId = 0;
+		InstanceData* pInstances = nullptr;
+		UINT32* pIds = nullptr;
+		const double instanceMs = MeasureMs(10, [&]()
+		{
+			pInstances = static_cast<InstanceData*>(instanceUpload.Allocate(instanceCount, firstInstance));
+			for (const Draw& draw : draws)
+				draw.pObjects->WriteInstanceData(pInstances + draw.instanceBase);
+		});
+		// The ids index the frame's instance upload, every draw reads its ids from drawOffsets.y on
+		const double idMs = MeasureMs(10, [&]()
+		{
+			pIds = static_cast<UINT32*>(idUpload.Allocate(idCount, firstId));
+			UINT32* pOut = pIds;
+			for (size_t d = 0; d < draws.size(); d++)
+			{
+				const Draw& draw = draws[d];
+				drawOffsets[d] = { 0, firstId + UINT(pOut - pIds), 0, 0 };
+				const UINT32 offset = firstInstance + draw.instanceBase;
+				for (UINT32 id : draw.ids)
+					*pOut++ = id + offset;
+			}
+		});
+
+		// Every id of the last build reaches the model of its instance
+		const InstanceData* pFrameInstances = pInstances - firstInstance;
+		const UINT32* pFrameIds = pIds - firstId;
+		for (size_t d = 0; d < draws.size(); d++)
+		{
+			const Draw& draw = draws[d];
+			for (size_t k = 0; k < draw.ids.size(); k += 31)
+			{
+				const InstanceData& data = pFrameInstances[pFrameIds[drawOffsets[d].y + k]];
+				XMFLOAT4 expected;
+				XMStoreFloat4(&expected, XMMatrixTranspose(draw.pObjects->instances[draw.ids[k]].model).r[0]);
+				matches &= memcmp(&data.world[0], &expected, sizeof(expected)) == 0 && data.materialId == draw.ids[k] % 7;
+			}
+		}
+
+		printf("%8zu instances  InstanceData %6.1f MB in %7.2f ms  %8zu ids %5.1f MB in %6.2f ms (%5.1f MB as uint4)  %zu draw offsets\n",
+			count, instanceCount * sizeof(InstanceData) / 1e6, instanceMs, idCount, idCount * sizeof(UINT32) / 1e6, idMs,
+			idCount * sizeof(XMUINT4) / 1e6, drawOffsets.size());
+	}
+	return matches ? 0 : 1;
+}
@@ -0,0 +1,59 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "FrustumCulling.h"
+
+namespace
+{
+	const char* GetKernelName()
+	{
+#if defined(__AVX512F__)
+		return "AVX-512";
+#elif defined(__AVX2__)
+		return "AVX2";
+#else
+		return "SSE";
+#endif
+	}
+
+	// Random unit to 4 unit boxes scattered over a 400 unit cube in front of the camera
+	void MakeBoxes(size_t count, AABBSoA& outBounds)
+	{
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+		std::uniform_real_distribution<float> extent(0.5f, 2.0f);
+		outBounds.Resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			const DirectX::XMFLOAT3 center = { position(random), position(random), position(random) };
+			const DirectX::XMFLOAT3 half = { extent(random), extent(random), extent(random) };
+			outBounds.Set(i, { center.x - half.x, center.y - half.y, center.z - half.z }, { center.x + half.x, center.y + half.y, center.z + half.z });
+		}
+	}
+}
+
+int main()
+{
+	using namespace DirectX;
+	Frustum frustum;
+	frustum.ExtractFromMatrix(XMMatrixTranslation(0.0f, 0.0f, 50.0f) * XMMatrixPerspectiveLH(1.0f, 0.5625f, 0.5f, 300.0f));
+
+	bool matches = true;
+	const size_t counts[] = { 1000, 100000, 1000000 };
+	for (size_t count : counts)
+	{
+		AABBSoA bounds;
+		MakeBoxes(count, bounds);
+		std::vector<UINT32> visible(count), reference(count);
+		UINT visibleCount = 0, referenceCount = 0;
+		const int runs = count > 100000 ? 5 : 50;
+		const double simdMs = MeasureMs(runs, [&]() { visibleCount = CullAABBs(frustum, bounds, visible.data()); });
+		const double scalarMs = MeasureMs(runs, [&]() { referenceCount = CullAABBsScalar(frustum, bounds, reference.data()); });
+		const bool same = visibleCount == referenceCount && std::equal(visible.begin(), visible.begin() + visibleCount, reference.begin());
+		matches &= same;
+		printf("%8zu boxes  %6u visible  %s %9.1f us  scalar %9.1f us  %s\n", count, visibleCount, GetKernelName(), simdMs * 1000.0,
+			scalarMs * 1000.0, same ? "same ids" : "MISMATCH");
+	}
+	return matches ? 0 : 1;
+}
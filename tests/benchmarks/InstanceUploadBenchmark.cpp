@@ -0,0 +1,90 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <random>
+#include <vector>
+#include "GeometryData.h"
+#include "RandomModel.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Per-instance record before the compact layout: SceneBuffer with the normal matrix computed on the CPU
+	struct LegacySceneBuffer
+	{
+		XMMATRIX model;
+		XMMATRIX normTransform;
+		XMFLOAT4 lightParams;
+		XMFLOAT4 baseColor;
+		XMINT4 colorTextureId_normalMapId_useLight;
+
+		void setModel(const XMMATRIX& model)
+		{
+			this->model = model;
+			normTransform = XMMatrixTranspose(XMMatrixInverse(nullptr, model));
+		}
+	};
+}
+
+int main()
+{
+	const size_t count = 100000;
+	std::mt19937 random(3);
+	std::vector<XMMATRIX> models(count);
+	for (XMMATRIX& model : models)
+		model = RandomModel(random, XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(100.0f, 100.0f, 100.0f));
+
+	// Before: every instance kept a SceneBuffer with its normal matrix, uploaded as is
+	std::vector<LegacySceneBuffer> sceneBuffers(count);
+	std::vector<LegacySceneBuffer> sceneUpload(count);
+	const double sceneSetMs = MeasureMs(5, [&]()
+	{
+		for (size_t i = 0; i < count; i++)
+			sceneBuffers[i].setModel(models[i]);
+	});
+	const double sceneWriteMs = MeasureMs(5, [&]()
+	{
+		for (size_t i = 0; i < count; i++)
+			sceneUpload[i] = sceneBuffers[i];
+	});
+
+	ObjectBuffer buffer;
+	buffer.instances.resize(count);
+	buffer.ClearChanges();
+	std::vector<InstanceData> instanceUpload(count);
+	const double instanceSetMs = MeasureMs(5, [&]()
+	{
+		for (size_t i = 0; i < count; i++)
+			buffer.setModel(int(i), models[i]);
+		buffer.ClearChanges();
+	});
+	const double instanceWriteMs = MeasureMs(5, [&]() { buffer.WriteInstanceData(instanceUpload.data()); });
+
+	// Base_VS: world position = dot(world[row], float4(position, 1))
+	std::uniform_real_distribution<float> offset(-2.0f, 2.0f);
+	double maxError = 0.0;
+	for (size_t i = 0; i < count; i += 97)
+	{
+		XMFLOAT4 position(0.0f, 0.0f, 0.0f, 1.0f);
+		position.x = offset(random);
+		position.y = offset(random);
+		position.z = offset(random);
+		XMFLOAT3 expected;
+		XMStoreFloat3(&expected, XMVector3Transform(XMLoadFloat4(&position), models[i]));
+		const float* pExpected = &expected.x;
+		for (int row = 0; row < 3; row++)
+		{
+			const XMFLOAT4& column = instanceUpload[i].world[row];
+			const float value = column.x * position.x + column.y * position.y + column.z * position.z + column.w;
+			maxError = (std::max)(maxError, double(std::fabs(value - pExpected[row])));
+		}
+	}
+
+	printf("%zu instances\n", count);
+	printf("SceneBuffer   %3zu B: setModel %6.2f ms  payload %5.1f MB written in %6.2f ms\n", sizeof(LegacySceneBuffer), sceneSetMs,
+		count * sizeof(LegacySceneBuffer) / 1e6, sceneWriteMs);
+	printf("InstanceData  %3zu B: setModel %6.2f ms  payload %5.1f MB written in %6.2f ms\n", sizeof(InstanceData), instanceSetMs,
+		count * sizeof(InstanceData) / 1e6, instanceWriteMs);
+	printf("max |packed columns - XMVector3Transform| %g\n", maxError);
+	return maxError < 1e-4 ? 0 : 1;
+}
@@ -0,0 +1,178 @@
+#include "Benchmark.h"
+#include "MeshImporter.h"
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace
+{
+	const int GridSize = 512; // quads per side, 512K triangles
+
+	float Height(int x, int z)
+	{
+		return 0.25f * sinf(x * 0.05f) * cosf(z * 0.07f);
+	}
+
+	std::string MakeOBJ()
+	{
+		std::string text;
+		char line[128];
+		for (int z = 0; z <= GridSize; z++)
+		{
+			for (int x = 0; x <= GridSize; x++)
+			{
+				snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0 1 0\n", x * 0.1f, Height(x, z), z * 0.1f,
+					float(x) / GridSize, float(z) / GridSize);
+				text += line;
+			}
+		}
+		for (int z = 0; z < GridSize; z++)
+		{
+			for (int x = 0; x < GridSize; x++)
+			{
+				const int a = z * (GridSize + 1) + x + 1;
+				const int b = a + 1;
+				const int c = a + GridSize + 1;
+				const int d = c + 1;
+				snprintf(line, sizeof(line), "f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, d, d, d, b, b, b);
+				text += line;
+			}
+		}
+		return text;
+	}
+
+	template <class T>
+	void Append(std::vector<uint8_t>& bytes, const std::vector<T>& values)
+	{
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(values.data());
+		bytes.insert(bytes.end(), pBytes, pBytes + values.size() * sizeof(T));
+	}
+
+	void AppendUint(std::vector<uint8_t>& bytes, uint32_t value)
+	{
+		Append(bytes, std::vector<uint32_t>{ value });
+	}
+
+	std::vector<uint8_t> MakeGLB()
+	{
+		const int vertexCount = (GridSize + 1) * (GridSize + 1);
+		std::vector<float> positions, normals, uvs;
+		for (int z = 0; z <= GridSize; z++)
+		{
+			for (int x = 0; x <= GridSize; x++)
+			{
+				positions.insert(positions.end(), { x * 0.1f, Height(x, z), z * 0.1f });
+				normals.insert(normals.end(), { 0.0f, 1.0f, 0.0f });
+				uvs.insert(uvs.end(), { float(x) / GridSize, float(z) / GridSize });
+			}
+		}
+		std::vector<uint32_t> indices;
+		for (int z = 0; z < GridSize; z++)
+		{
+			for (int x = 0; x < GridSize; x++)
+			{
+				const uint32_t a = z * (GridSize + 1) + x;
+				const uint32_t c = a + GridSize + 1;
+				indices.insert(indices.end(), { a, c, c + 1, a, c + 1, a + 1 });
+			}
+		}
+
+		std::vector<uint8_t> bin;
+		Append(bin, positions);
+		Append(bin, normals);
+		Append(bin, uvs);
+		Append(bin, indices);
+		const size_t normalOffset = positions.size() * sizeof(float);
+		const size_t uvOffset = normalOffset + normals.size() * sizeof(float);
+		const size_t indexOffset = uvOffset + uvs.size() * sizeof(float);
+
+		char json[1024];
+		snprintf(json, sizeof(json),
+			"{\"asset\":{\"version\":\"2.0\"},\"buffers\":[{\"byteLength\":%zu}],"
+			"\"bufferViews\":[{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},"
+			"{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu},{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu}],"
+			"\"accessors\":[{\"bufferView\":0,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"},"
+			"{\"bufferView\":1,\"componentType\":5126,\"count\":%d,\"type\":\"VEC3\"},"
+			"{\"bufferView\":2,\"componentType\":5126,\"count\":%d,\"type\":\"VEC2\"},"
+			"{\"bufferView\":3,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}],"
+			"\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"TEXCOORD_0\":2},\"indices\":3}]}]}",
+			bin.size(), normalOffset, normalOffset, uvOffset - normalOffset, uvOffset, indexOffset - uvOffset, indexOffset,
+			bin.size() - indexOffset, vertexCount, vertexCount, vertexCount, indices.size());
+		std::string jsonChunk = json;
+		while (jsonChunk.size() % 4 != 0)
+			jsonChunk += ' ';
+
+		std::vector<uint8_t> glb;
+		AppendUint(glb, 0x46546C67);
+		AppendUint(glb, 2);
+		AppendUint(glb, uint32_t(12 + 8 + jsonChunk.size() + 8 + bin.size()));
+		AppendUint(glb, uint32_t(jsonChunk.size()));
+		AppendUint(glb, 0x4E4F534A);
+		glb.insert(glb.end(), jsonChunk.begin(), jsonChunk.end());
+		AppendUint(glb, uint32_t(bin.size()));
+		AppendUint(glb, 0x004E4942);
+		glb.insert(glb.end(), bin.begin(), bin.end());
+		return glb;
+	}
+
+	bool WriteFile(const char* fileName, const void* pData, size_t size)
+	{
+		FILE* pFile = fopen(fileName, "wb");
+		if (pFile == nullptr)
+			return false;
+		const bool written = fwrite(pData, 1, size, pFile) == size;
+		fclose(pFile);
+		return written;
+	}
+
+	void Report(const char* name, const MeshImportStats& stats)
+	{
+		printf("%-22s %7.1f MB  %8zu vertices  %8zu triangles  %7.2f ms  %7.1f MB/s  %6.2f M triangles/s\n", name,
+			stats.fileBytes / (1024.0 * 1024.0), stats.vertexCount, stats.triangleCount, stats.seconds * 1000.0,
+			stats.GetMegabytesPerSecond(), stats.GetTrianglesPerSecond() / 1e6);
+	}
+}
+
+int main()
+{
+	const std::string obj = MakeOBJ();
+	const std::vector<uint8_t> glb = MakeGLB();
+	if (!WriteFile("MeshImporterBenchmark.obj", obj.data(), obj.size()) || !WriteFile("MeshImporterBenchmark.glb", glb.data(), glb.size()))
+		return 1;
+
+	vector<TextureNormalVertex> vertices;
+	vector<UINT32> indices;
+	bool imported = true;
+	const UINT threadCounts[] = { 1, 0 };
+	for (UINT threadCount : threadCounts)
+	{
+		// Best of three, the first one also reads the file into the page cache
+		MeshImportStats best;
+		best.seconds = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			MeshImportStats stats;
+			imported &= ImportOBJ(L"MeshImporterBenchmark.obj", vertices, indices, &stats, threadCount);
+			if (stats.seconds < best.seconds)
+				best = stats;
+		}
+		char name[32];
+		snprintf(name, sizeof(name), threadCount == 0 ? "OBJ, thread per core" : "OBJ, %u thread", threadCount);
+		Report(name, best);
+	}
+	{
+		MeshImportStats best;
+		best.seconds = 1e30;
+		for (int run = 0; run < 3; run++)
+		{
+			MeshImportStats stats;
+			imported &= ImportGLB(L"MeshImporterBenchmark.glb", vertices, indices, &stats);
+			if (stats.seconds < best.seconds)
+				best = stats;
+		}
+		Report("GLB", best);
+	}
+	std::remove("MeshImporterBenchmark.obj");
+	std::remove("MeshImporterBenchmark.glb");
+	return imported ? 0 : 1;
+}
@@ -0,0 +1,77 @@
+#include "Benchmark.h"
+#include "MeshSimplifier.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// Closed torus, rings x sides quads
+	void MakeTorus(UINT rings, UINT sides, vector<TextureNormalVertex>& outVertices, vector<UINT32>& outIndices)
+	{
+		const float majorRadius = 1.0f;
+		const float minorRadius = 0.35f;
+		outVertices.clear();
+		outIndices.clear();
+		for (UINT ring = 0; ring < rings; ring++)
+		{
+			const float u = 2.0f * float(M_PI) * ring / rings;
+			for (UINT side = 0; side < sides; side++)
+			{
+				const float v = 2.0f * float(M_PI) * side / sides;
+				TextureNormalVertex vertex = {};
+				vertex.normal = { cosf(u) * cosf(v), sinf(v), sinf(u) * cosf(v) };
+				vertex.pos = { cosf(u) * majorRadius + vertex.normal.x * minorRadius, vertex.normal.y * minorRadius,
+					sinf(u) * majorRadius + vertex.normal.z * minorRadius };
+				vertex.textureUV = { float(ring) / rings, float(side) / sides };
+				outVertices.push_back(vertex);
+			}
+		}
+		for (UINT ring = 0; ring < rings; ring++)
+		{
+			for (UINT side = 0; side < sides; side++)
+			{
+				const UINT32 a = ring * sides + side;
+				const UINT32 b = ring * sides + (side + 1) % sides;
+				const UINT32 c = (ring + 1) % rings * sides + side;
+				const UINT32 d = (ring + 1) % rings * sides + (side + 1) % sides;
+				outIndices.insert(outIndices.end(), { a, c, d, a, d, b });
+			}
+		}
+	}
+}
+
+int main()
+{
+	vector<TextureNormalVertex> vertices;
+	vector<UINT32> indices;
+	MakeTorus(400, 200, vertices, indices);
+	const UINT triangleCount = UINT(indices.size() / 3);
+	printf("torus: %u vertices, %u triangles\n", UINT(vertices.size()), triangleCount);
+
+	bool simplified = true;
+	const float ratios[] = { 0.5f, 0.25f, 0.1f, 0.01f };
+	for (float ratio : ratios)
+	{
+		MeshSimplifyOptions options;
+		options.targetIndexCount = UINT(triangleCount * ratio) * 3;
+		vector<UINT32> result;
+		MeshSimplifyStats stats;
+		const double ms = MeasureMs(3, [&]()
+		{
+			simplified &= SimplifyMesh(vertices.data(), sizeof(TextureNormalVertex), UINT(vertices.size()), indices, options, result, &stats);
+		});
+		printf("target %5.1f%%  %7zu triangles  %8.1f ms  %5.2f M source triangles/s  error %.5f (relative %.5f)\n", ratio * 100.0f,
+			stats.resultTriangleCount, ms, triangleCount / ms / 1000.0, stats.error, stats.relativeError);
+	}
+
+	vector<UINT32> lodIndices;
+	vector<CookedMeshLod> lods;
+	MeshSimplifyStats stats;
+	const double ms = MeasureMs(3, [&]()
+	{
+		simplified &= BuildMeshLods(vertices.data(), sizeof(TextureNormalVertex), UINT(vertices.size()), indices, 5, 0.5f, 0.0f,
+			lodIndices, lods, &stats);
+	});
+	printf("5 LODs at 50%% each: %.1f ms, %zu indices in the chain\n", ms, lodIndices.size());
+	return simplified ? 0 : 1;
+}
@@ -0,0 +1,95 @@
+#include "Benchmark.h"
+#include <random>
+#include <vector>
+#include "ParallelCuller.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// Camera turning a little every frame, so the culler can not keep the lists of the previous frame
+	std::vector<Frustum> MakeFrusta(int count)
+	{
+		const XMMATRIX projection = XMMatrixPerspectiveLH(0.2f, 0.1125f, 0.1f, 300.0f);
+		std::vector<Frustum> frusta(count);
+		for (int i = 0; i < count; i++)
+		{
+			const XMMATRIX camera = XMMatrixRotationY(0.7f + 0.01f * i) * XMMatrixTranslation(3.0f, 1.0f, -5.0f);
+			frusta[i].ExtractFromMatrix(XMMatrixInverse(nullptr, camera) * projection);
+		}
+		return frusta;
+	}
+}
+
+int main()
+{
+	std::vector<TextureNormalVertex> vertices;
+	std::vector<USHORT> indices;
+	GeometryData::getCubeGeometry(vertices, indices);
+	GeometryData geometry;
+	geometry.ComputeBounds(vertices.data(), sizeof(TextureNormalVertex), vertices.size());
+
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> position(-150.0f, 150.0f);
+	std::uniform_real_distribution<float> scale(0.1f, 3.0f);
+	const size_t counts[] = { 3, 40, 1000, 200000, 1000000 };
+	std::vector<ObjectBuffer> buffers(5);
+	for (size_t b = 0; b < buffers.size(); b++)
+	{
+		buffers[b].instances.resize(counts[b]);
+		for (size_t i = 0; i < counts[b]; i++)
+		{
+			const float size = scale(random);
+			buffers[b].set(int(i), XMMatrixScaling(size, size, size) * XMMatrixTranslation(position(random), position(random) * 0.1f, position(random)), geometry);
+		}
+		buffers[b].Refresh();
+		buffers[b].ClearChanges();
+	}
+
+	const int frames = 10;
+	const std::vector<Frustum> frusta = MakeFrusta(frames);
+	printf("%u hardware threads\n", std::thread::hardware_concurrency());
+	for (int useBVH = 0; useBVH < 2; useBVH++)
+	{
+		for (ObjectBuffer& buffer : buffers)
+		{
+			if (useBVH)
+				buffer.Refresh();
+			else
+				buffer.bvh.Clear();
+		}
+
+		std::vector<std::vector<UINT32>> reference(frames * buffers.size());
+		const double singleMs = MeasureMs(3, [&]()
+		{
+			for (int frame = 0; frame < frames; frame++)
+			{
+				for (size_t b = 0; b < buffers.size(); b++)
+					buffers[b].Cull(frusta[frame], reference[frame * buffers.size() + b]);
+			}
+		}) / frames;
+
+		const UINT threadCounts[] = { 1, 2, 4, 8 };
+		for (UINT threadCount : threadCounts)
+		{
+			ParallelCuller culler;
+			culler.Init(threadCount);
+			bool same = true;
+			const double parallelMs = MeasureMs(3, [&]()
+			{
+				for (int frame = 0; frame < frames; frame++)
+				{
+					culler.Cull(frusta[frame], ContributionParams(), buffers);
+					for (size_t b = 0; b < buffers.size(); b++)
+						same &= culler.GetVisible(b) == reference[frame * buffers.size() + b];
+				}
+			}) / frames;
+			printf("%-6s %u threads %3zu jobs  single %6.2f ms  pool %6.2f ms  %s\n", useBVH ? "bvh" : "linear", threadCount,
+				culler.GetJobCount(), singleMs, parallelMs, same ? "same ids" : "MISMATCH");
+			culler.Term();
+			if (!same)
+				return 1;
+		}
+	}
+	return 0;
+}
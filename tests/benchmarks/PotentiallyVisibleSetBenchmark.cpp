@@ -0,0 +1,117 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "PotentiallyVisibleSet.h"
+
+namespace
+{
+	// Unit cubes scattered over four square units of floor each and up to four units high, every cube a solid occluder
+	void MakeCubes(uint32_t count, float halfSize, std::vector<float> (&outMin)[3], std::vector<float> (&outMax)[3],
+		std::vector<PVSOccluder>& outOccluders)
+	{
+		std::mt19937 random(9);
+		std::uniform_real_distribution<float> position(-halfSize, halfSize);
+		std::uniform_real_distribution<float> height(0.0f, 4.0f);
+		for (int a = 0; a < 3; a++)
+		{
+			outMin[a].resize(count);
+			outMax[a].resize(count);
+		}
+		outOccluders.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const float x = position(random);
+			const float y = height(random);
+			const float z = position(random);
+			const float center[3] = { x, y, z };
+			PVSOccluder& occluder = outOccluders[i];
+			for (int a = 0; a < 3; a++)
+			{
+				outMin[a][i] = center[a] - 0.5f;
+				outMax[a][i] = center[a] + 0.5f;
+				occluder.center[a] = center[a];
+				for (int b = 0; b < 3; b++)
+					occluder.axes[b][a] = a == b ? 0.5f : 0.0f;
+			}
+			occluder.item = i;
+		}
+	}
+}
+
+int main()
+{
+	const uint32_t counts[] = { 1000, 5000 };
+	bool consistent = true;
+	for (uint32_t count : counts)
+	{
+		const float halfSize = sqrtf(float(count));
+		std::vector<float> minVec[3], maxVec[3];
+		std::vector<PVSOccluder> occluders;
+		MakeCubes(count, halfSize, minVec, maxVec, occluders);
+		const BVHInput targets = { { minVec[0].data(), minVec[1].data(), minVec[2].data() },
+			{ maxVec[0].data(), maxVec[1].data(), maxVec[2].data() }, count };
+
+		PVSBakeDesc desc;
+		desc.minVec[0] = desc.minVec[2] = -halfSize - 10.0f;
+		desc.maxVec[0] = desc.maxVec[2] = halfSize + 10.0f;
+		desc.minVec[1] = -1.0f;
+		desc.maxVec[1] = 6.0f;
+		desc.raysPerItem = 8;
+		PotentiallyVisibleSet pvs;
+		pvs.Bake(desc, targets, occluders);
+		const PVSBakeStats& stats = pvs.GetBakeStats();
+		printf("%6u items  %3u cells  bake %7.1f ms  %9llu rays  %3u unique sets  %7zu of %7zu bytes\n", count, pvs.GetCellCount(),
+			stats.seconds * 1000.0, static_cast<unsigned long long>(stats.castRays), stats.uniqueSets, stats.compressedBytes,
+			stats.uncompressedBytes);
+
+		// Camera positions all over the region, a few outside of it
+		const int Lookups = 1000000;
+		std::mt19937 random(3);
+		std::uniform_real_distribution<float> horizontal(desc.minVec[0] - 1.0f, desc.maxVec[0] + 1.0f);
+		std::uniform_real_distribution<float> vertical(desc.minVec[1], desc.maxVec[1]);
+		std::vector<float> positions(Lookups * 3);
+		for (int i = 0; i < Lookups; i++)
+		{
+			positions[i * 3] = horizontal(random);
+			positions[i * 3 + 1] = vertical(random);
+			positions[i * 3 + 2] = horizontal(random);
+		}
+		int64_t cellSum = 0;
+		const double findMs = MeasureMs(5, [&]()
+		{
+			cellSum = 0;
+			for (int i = 0; i < Lookups; i++)
+				cellSum += pvs.FindCell(&positions[i * 3]);
+		});
+
+		// Every cell expanded into its ids, as the renderer does when the camera enters a cell
+		std::vector<uint32_t> ids;
+		size_t idSum = 0;
+		const double visibleMs = MeasureMs(5, [&]()
+		{
+			idSum = 0;
+			for (uint32_t cell = 0; cell < pvs.GetCellCount(); cell++)
+			{
+				pvs.GetVisible(int32_t(cell), ids);
+				idSum += ids.size();
+			}
+		});
+		size_t visibleSum = 0;
+		const double isVisibleMs = MeasureMs(5, [&]()
+		{
+			visibleSum = 0;
+			for (uint32_t cell = 0; cell < pvs.GetCellCount(); cell++)
+			{
+				for (uint32_t item = 0; item < count; item++)
+					visibleSum += pvs.IsVisible(int32_t(cell), item);
+			}
+		});
+		consistent &= cellSum != 0 && visibleSum == idSum;
+		printf("        FindCell %5.2f ns  GetVisible %7.2f us for %6.0f ids  IsVisible %5.2f ns\n", findMs * 1e6 / Lookups,
+			visibleMs * 1000.0 / pvs.GetCellCount(), double(idSum) / pvs.GetCellCount(),
+			isVisibleMs * 1e6 / (double(pvs.GetCellCount()) * count));
+	}
+	return consistent ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#include "Benchmark.h"
+#include <vector>
+#include "PrimitiveLibrary.h"
+
+namespace
+{
+	struct Detail
+	{
+		UINT segments;
+		UINT rings;
+	};
+
+	// Low, medium and high detail of each primitive, rings are subdivisions for the icosphere and cells per
+	// face edge for the boxes and the plane
+	const Detail Details[][3] = {
+		{ { 16, 8 }, { 64, 32 }, { 256, 128 } }, // UVSphere
+		{ { 0, 1 }, { 0, 3 }, { 0, 5 } }, // Icosphere
+		{ { 0, 4 }, { 0, 16 }, { 0, 64 } }, // CubeSphere
+		{ { 0, 1 }, { 0, 16 }, { 0, 64 } }, // Box
+		{ { 0, 1 }, { 0, 32 }, { 0, 128 } }, // Plane
+		{ { 16, 1 }, { 64, 16 }, { 256, 64 } }, // Cylinder
+		{ { 16, 1 }, { 64, 16 }, { 256, 64 } }, // Cone
+	};
+}
+
+int main()
+{
+	bool generated = true;
+	std::vector<PrimitiveDesc> descs;
+	printf("%-10s %8s %5s %9s %9s %10s %12s\n", "primitive", "segments", "rings", "vertices", "triangles", "generate", "M triangles/s");
+	for (int type = 0; type <= int(PrimitiveType::Cone); type++)
+	{
+		for (const Detail& detail : Details[type])
+		{
+			PrimitiveDesc desc;
+			desc.type = PrimitiveType(type);
+			desc.segments = detail.segments;
+			desc.rings = detail.rings;
+			descs.push_back(desc);
+
+			PrimitiveMesh mesh;
+			bool fits = true;
+			const double ms = MeasureMs(5, [&]() { fits = PrimitiveLibrary::Generate(desc, mesh); });
+			generated &= fits;
+			printf("%-10s %8u %5u %9u %9u %7.3f ms %12.1f%s\n", PrimitiveLibrary::GetTypeName(desc.type), desc.segments, desc.rings,
+				mesh.GetVertexCount(), mesh.GetTriangleCount(), ms, mesh.GetTriangleCount() / ms / 1000.0,
+				fits ? "" : "  exceeds 16-bit indices");
+		}
+	}
+
+	// Welded positions for the depth-only passes, at high detail
+	for (int type = 0; type <= int(PrimitiveType::Cone); type++)
+	{
+		PrimitiveDesc desc;
+		desc.type = PrimitiveType(type);
+		desc.format = PrimitiveFormat::Position;
+		desc.segments = Details[type][2].segments;
+		desc.rings = Details[type][2].rings;
+		PrimitiveMesh mesh;
+		bool fits = true;
+		const double ms = MeasureMs(5, [&]() { fits = PrimitiveLibrary::Generate(desc, mesh); });
+		generated &= fits;
+		printf("%-10s %8u %5u %9u %9u %7.3f ms  welded positions\n", PrimitiveLibrary::GetTypeName(desc.type), desc.segments, desc.rings,
+			mesh.GetVertexCount(), mesh.GetTriangleCount(), ms);
+	}
+
+	// Every primitive is generated once, the other requests are cache hits
+	PrimitiveLibrary library;
+	const int Requests = 100;
+	const double cacheMs = MeasureMs(1, [&]()
+	{
+		for (int i = 0; i < Requests; i++)
+		{
+			for (const PrimitiveDesc& desc : descs)
+				generated &= library.Get(desc) != nullptr;
+		}
+	});
+	const double hitsMs = MeasureMs(5, [&]()
+	{
+		for (const PrimitiveDesc& desc : descs)
+			generated &= library.Get(desc) != nullptr;
+	});
+	printf("Cache: %zu primitives, %u hits, %u misses, %.2f ms for %d requests of each, %.3f us per hit\n", library.GetCachedCount(),
+		library.GetCacheHits(), library.GetCacheMisses(), cacheMs, Requests, hitsMs * 1000.0 / descs.size());
+	return generated && library.GetCacheMisses() == descs.size() ? 0 : 1;
+}
@@ -0,0 +1,62 @@
+#include "Benchmark.h"
+#include "RangeAllocator.h"
+#include <random>
+#include <vector>
+
+namespace
+{
+	struct Range
+	{
+		uint32_t offset;
+		uint32_t size;
+	};
+
+	// Mesh sized allocations freed in random order, the way a geometry pool sees meshes come and go
+	void RunChurn(uint32_t minSize, uint32_t maxSize, int operations)
+	{
+		const uint32_t capacity = (minSize + maxSize) / 2 * 8192;
+		RangeAllocator allocator(capacity);
+		std::vector<Range> live;
+		std::mt19937 random(1);
+		std::uniform_int_distribution<uint32_t> sizes(minSize, maxSize);
+		int failures = 0;
+		float worstFragmentation = 0.0f;
+		const double ms = MeasureMs(1, [&]()
+		{
+			for (int i = 0; i < operations; i++)
+			{
+				// Keeps the pool around three quarters full
+				const bool allocate = live.empty() || allocator.GetUsedSize() < capacity / 4 * 3 ? random() % 4 != 0 : random() % 2 == 0;
+				if (allocate)
+				{
+					const uint32_t size = sizes(random);
+					const uint32_t offset = allocator.Allocate(size);
+					if (offset == RangeAllocator::InvalidOffset)
+						failures++;
+					else
+						live.push_back({ offset, size });
+				}
+				else
+				{
+					const size_t index = random() % live.size();
+					allocator.Free(live[index].offset, live[index].size);
+					live[index] = live.back();
+					live.pop_back();
+				}
+				if (i % 1024 == 0)
+					worstFragmentation = (std::max)(worstFragmentation, allocator.GetFragmentation());
+			}
+		});
+		printf("sizes %6u-%-6u %8d ops %8.2f ms  live %6zu  free blocks %5u  largest free %8u  fragmentation %.3f (worst %.3f)  failed %d\n",
+			minSize, maxSize, operations, ms, live.size(), allocator.GetFreeBlockCount(), allocator.GetLargestFreeBlock(),
+			allocator.GetFragmentation(), worstFragmentation, failures);
+	}
+}
+
+int main()
+{
+	RunChurn(64, 64, 200000);
+	RunChurn(24, 4096, 200000);
+	RunChurn(1024, 262144, 200000);
+	return 0;
+}
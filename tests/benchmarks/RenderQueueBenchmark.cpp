@@ -0,0 +1,60 @@
+#include "Benchmark.h"
+#include "RenderQueue.h"
+#include <random>
+#include <vector>
+
+namespace
+{
+	// Keys of a frame: a few passes and permutations, some materials and geometries, random depths. A tenth of
+	// the draws are transparent and use the back to front layout.
+	std::vector<uint64_t> MakeKeys(size_t count)
+	{
+		std::mt19937 random(9);
+		std::vector<uint64_t> keys(count);
+		for (uint64_t& key : keys)
+		{
+			const uint32_t material = random() % 64;
+			const uint32_t geometry = random() % 32;
+			const uint32_t depth = random() % (DrawKey::MaxDepth + 1);
+			if (random() % 10 == 0)
+				key = DrawKey::MakeBackToFront(2, 3, material, geometry, depth);
+			else
+				key = DrawKey::Make(0, random() % 2, material, geometry, depth);
+		}
+		return keys;
+	}
+}
+
+int main()
+{
+	bool same = true;
+	const size_t counts[] = { 100, 1000, 3000, 10000, 100000 };
+	for (size_t count : counts)
+	{
+		const std::vector<uint64_t> keys = MakeKeys(count);
+		RenderQueue queue;
+		std::vector<DrawItem> reference;
+		const double queueMs = MeasureMs(10, [&]()
+		{
+			queue.Clear();
+			for (size_t i = 0; i < count; i++)
+				queue.Push(keys[i], uint32_t(i));
+			queue.Sort();
+		});
+		const double stableSortMs = MeasureMs(10, [&]()
+		{
+			reference.clear();
+			for (size_t i = 0; i < count; i++)
+				reference.push_back({ keys[i], uint32_t(i) });
+			std::stable_sort(reference.begin(), reference.end(), [](const DrawItem& a, const DrawItem& b) { return a.key < b.key; });
+		});
+
+		bool sameOrder = queue.GetCount() == count;
+		for (size_t i = 0; i < count && sameOrder; i++)
+			sameOrder = queue.GetItems()[i].key == reference[i].key && queue.GetItems()[i].command == reference[i].command;
+		same &= sameOrder;
+		printf("%7zu items  RenderQueue %7.3f ms  std::stable_sort %7.3f ms  %s\n", count, queueMs, stableSortMs,
+			sameOrder ? "same order" : "MISMATCH");
+	}
+	return same ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+#include "Benchmark.h"
+#include <cmath>
+#include <random>
+#include <vector>
+#include <smmintrin.h>
+#include "GeometryData.h"
+#include "TransparencySorter.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// a * b with DirectXMath's SSE XMMatrixMultiply, the stand-in header sums in another order
+	XMMATRIX MultiplySSE(const XMMATRIX& a, const XMMATRIX& b)
+	{
+		XMMATRIX result;
+		for (int row = 0; row < 4; row++)
+		{
+			const __m128 w = _mm_loadu_ps(reinterpret_cast<const float*>(&a.r[row]));
+			__m128 x = _mm_mul_ps(_mm_shuffle_ps(w, w, 0x00), _mm_loadu_ps(reinterpret_cast<const float*>(&b.r[0])));
+			__m128 y = _mm_mul_ps(_mm_shuffle_ps(w, w, 0x55), _mm_loadu_ps(reinterpret_cast<const float*>(&b.r[1])));
+			const __m128 z = _mm_mul_ps(_mm_shuffle_ps(w, w, 0xAA), _mm_loadu_ps(reinterpret_cast<const float*>(&b.r[2])));
+			const __m128 v = _mm_mul_ps(_mm_shuffle_ps(w, w, 0xFF), _mm_loadu_ps(reinterpret_cast<const float*>(&b.r[3])));
+			x = _mm_add_ps(x, z);
+			y = _mm_add_ps(y, v);
+			_mm_storeu_ps(reinterpret_cast<float*>(&result.r[row]), _mm_add_ps(x, y));
+		}
+		return result;
+	}
+
+	// The replaced plane pass: four translated corners through model * view, then a stable sort by depth
+	void SortByMatrixProducts(const std::vector<Instance>& instances, const XMMATRIX& view, std::vector<std::pair<UINT32, float>>& outOrder)
+	{
+		outOrder.clear();
+		for (UINT32 i = 0; i < instances.size(); i++)
+		{
+			float nearest = 0.1f;
+			for (int corner = 0; corner < 4; corner++)
+			{
+				const XMMATRIX translation = XMMatrixTranslation(corner % 2 ? 1.0f : -1.0f, corner / 2 ? 1.0f : -1.0f, 0.0f);
+				nearest = (std::min)(nearest, XMVectorGetZ(MultiplySSE(MultiplySSE(translation, instances[i].model), view).r[3]));
+			}
+			outOrder.push_back({ i, nearest });
+		}
+		std::stable_sort(outOrder.begin(), outOrder.end(),
+			[](const std::pair<UINT32, float>& a, const std::pair<UINT32, float>& b) { return a.second > b.second; });
+	}
+}
+
+int main()
+{
+	const XMMATRIX camera = XMMatrixRotationAxis(XMVector3Normalize(XMVectorSet(0.3f, 1.0f, 0.0f, 0.0f)), 0.7f) * XMMatrixTranslation(3.0f, 2.0f, -5.0f);
+	const XMMATRIX view = XMMatrixInverse(nullptr, camera);
+	bool same = true;
+	const size_t counts[] = { 10000, 100000 };
+	for (size_t count : counts)
+	{
+		std::mt19937 random{ unsigned(count) };
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<Instance> instances(count);
+		for (Instance& instance : instances)
+		{
+			const XMVECTOR axis = XMVector3Normalize(XMVectorSet(unit(random), unit(random), unit(random) + 2.0f, 0.0f));
+			instance.model = XMMatrixScaling(1.0f + unit(random), 1.0f + unit(random), 1.0f) * XMMatrixRotationAxis(axis, unit(random) * 3.0f) *
+				XMMatrixTranslation(unit(random) * 60.0f, unit(random) * 10.0f, unit(random) * 60.0f);
+		}
+
+		std::vector<std::pair<UINT32, float>> reference;
+		TransparencySorter sorter;
+		const double referenceMs = MeasureMs(5, [&]() { SortByMatrixProducts(instances, view, reference); });
+		const double sorterMs = MeasureMs(5, [&]() { sorter.Sort(&instances[0].model, sizeof(Instance), count, view, 1.0f, 1.0f, 0.1f); });
+
+		size_t differences = 0, clamped = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			differences += reference[i].first != sorter.GetOrder()[i] || reference[i].second != sorter.GetDepths()[reference[i].first];
+			clamped += reference[i].second == 0.1f;
+		}
+		same &= differences == 0;
+		printf("%6zu instances (%2zu%% clamped)  matrix products + stable_sort %6.2f ms  sorter %5.2f ms  %s\n", count, clamped * 100 / count,
+			referenceMs, sorterMs, differences == 0 ? "same order and depths" : "MISMATCH");
+	}
+	return same ? 0 : 1;
+}
@@ -0,0 +1,136 @@
+#pragma once
+// Device context of the stand-in d3d11.h that records the bound state and counts the binding calls, for testing
+// code that binds state without a device. Resource, draw and target calls do nothing.
+#include <d3d11.h>
+
+struct CountingDeviceContext : ID3D11DeviceContext
+{
+	struct Stage
+	{
+		ID3D11Buffer* constantBuffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+		ID3D11ShaderResourceView* shaderResources[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+		ID3D11SamplerState* samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+	};
+
+	// What ClearState leaves bound
+	struct State
+	{
+		ID3D11InputLayout* pInputLayout;
+		D3D11_PRIMITIVE_TOPOLOGY topology;
+		ID3D11Buffer* pVertexBuffer;
+		UINT vertexStride;
+		UINT vertexOffset;
+		ID3D11Buffer* pIndexBuffer;
+		DXGI_FORMAT indexFormat;
+		ID3D11VertexShader* pVertexShader;
+		ID3D11PixelShader* pPixelShader;
+		ID3D11BlendState* pBlendState;
+		ID3D11DepthStencilState* pDepthStencilState;
+		ID3D11RasterizerState* pRasterizerState;
+		Stage vertexStage;
+		Stage pixelStage;
+	};
+
+	State state = {};
+	UINT bindCalls = 0;
+
+	ULONG Release() override { return 0; }
+	ULONG AddRef() override { return 0; }
+	HRESULT QueryInterface(const GUID&, void**) override { return E_NOINTERFACE; }
+	HRESULT SetPrivateData(const GUID&, UINT, const void*) override { return S_OK; }
+
+	void ClearState() override { state = {}; }
+	HRESULT Map(ID3D11Resource*, UINT, D3D11_MAP, UINT, D3D11_MAPPED_SUBRESOURCE*) override { return E_FAIL; }
+	void Unmap(ID3D11Resource*, UINT) override {}
+	void End(ID3D11Asynchronous*) override {}
+	HRESULT GetData(ID3D11Asynchronous*, void*, UINT, UINT) override { return S_FALSE; }
+	void UpdateSubresource(ID3D11Resource*, UINT, const D3D11_BOX*, const void*, UINT, UINT) override {}
+	void OMSetRenderTargets(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*) override {}
+	void ClearRenderTargetView(ID3D11RenderTargetView*, const FLOAT[4]) override {}
+	void ClearDepthStencilView(ID3D11DepthStencilView*, UINT, FLOAT, UINT8) override {}
+	void RSSetViewports(UINT, const D3D11_VIEWPORT*) override {}
+	void RSSetScissorRects(UINT, const D3D11_RECT*) override {}
+	void Draw(UINT, UINT) override {}
+	void DrawIndexed(UINT, UINT, INT) override {}
+	void DrawIndexedInstanced(UINT, UINT, UINT, INT, UINT) override {}
+	void CopyResource(ID3D11Resource*, ID3D11Resource*) override {}
+
+	void RSSetState(ID3D11RasterizerState* pState) override
+	{
+		bindCalls++;
+		state.pRasterizerState = pState;
+	}
+	void OMSetDepthStencilState(ID3D11DepthStencilState* pState, UINT) override
+	{
+		bindCalls++;
+		state.pDepthStencilState = pState;
+	}
+	void OMSetBlendState(ID3D11BlendState* pState, const FLOAT[4], UINT) override
+	{
+		bindCalls++;
+		state.pBlendState = pState;
+	}
+	void IASetInputLayout(ID3D11InputLayout* pLayout) override
+	{
+		bindCalls++;
+		state.pInputLayout = pLayout;
+	}
+	void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY topology) override
+	{
+		bindCalls++;
+		state.topology = topology;
+	}
+	void IASetIndexBuffer(ID3D11Buffer* pBuffer, DXGI_FORMAT format, UINT) override
+	{
+		bindCalls++;
+		state.pIndexBuffer = pBuffer;
+		state.indexFormat = format;
+	}
+	// Slot 0 only
+	void IASetVertexBuffers(UINT, UINT, ID3D11Buffer* const* ppBuffers, const UINT* pStrides, const UINT* pOffsets) override
+	{
+		bindCalls++;
+		state.pVertexBuffer = ppBuffers[0];
+		state.vertexStride = pStrides[0];
+		state.vertexOffset = pOffsets[0];
+	}
+	void VSSetShader(ID3D11VertexShader* pShader, ID3D11ClassInstance* const*, UINT) override
+	{
+		bindCalls++;
+		state.pVertexShader = pShader;
+	}
+	void PSSetShader(ID3D11PixelShader* pShader, ID3D11ClassInstance* const*, UINT) override
+	{
+		bindCalls++;
+		state.pPixelShader = pShader;
+	}
+	void VSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* ppBuffers) override
+	{
+		Bind(state.vertexStage.constantBuffers, slot, count, ppBuffers);
+	}
+	void PSSetConstantBuffers(UINT slot, UINT count, ID3D11Buffer* const* ppBuffers) override
+	{
+		Bind(state.pixelStage.constantBuffers, slot, count, ppBuffers);
+	}
+	void VSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* ppViews) override
+	{
+		Bind(state.vertexStage.shaderResources, slot, count, ppViews);
+	}
+	void PSSetShaderResources(UINT slot, UINT count, ID3D11ShaderResourceView* const* ppViews) override
+	{
+		Bind(state.pixelStage.shaderResources, slot, count, ppViews);
+	}
+	void PSSetSamplers(UINT slot, UINT count, ID3D11SamplerState* const* ppSamplers) override
+	{
+		Bind(state.pixelStage.samplers, slot, count, ppSamplers);
+	}
+
+private:
+	template<class T>
+	void Bind(T** pSlots, UINT slot, UINT count, T* const* ppObjects)
+	{
+		bindCalls++;
+		for (UINT i = 0; i < count; i++)
+			pSlots[slot + i] = ppObjects[i];
+	}
+};
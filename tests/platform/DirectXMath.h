@@ -0,0 +1,87 @@
+#pragma once
+// Scalar Linux stand-in for the DirectXMath functions the tested modules use. Results can differ from the SSE
+// implementation in the last bits, tests compare against references computed through the same functions.
+#include <cmath>
+#include <cstdint>
+#define XM_CALLCONV
+namespace DirectX {
+constexpr float XM_PI = 3.141592654f; constexpr float XM_2PI = 6.283185307f; constexpr float XM_PIDIV2 = 1.570796327f;
+union XMVECTOR { float m128_f32[4]; uint32_t m128_u32[4]; };
+typedef const XMVECTOR& FXMVECTOR; typedef const XMVECTOR& GXMVECTOR; typedef const XMVECTOR& HXMVECTOR; typedef const XMVECTOR& CXMVECTOR;
+struct XMMATRIX { XMVECTOR r[4];
+ XMMATRIX() {}
+ XMMATRIX(const XMVECTOR& a,const XMVECTOR& b,const XMVECTOR& c,const XMVECTOR& d){r[0]=a;r[1]=b;r[2]=c;r[3]=d;}
+ XMMATRIX operator*(const XMMATRIX& m) const;
+ XMMATRIX& operator*=(const XMMATRIX& m){ *this = *this * m; return *this; } };
+typedef const XMMATRIX& FXMMATRIX; typedef const XMMATRIX& CXMMATRIX;
+struct XMFLOAT2 { float x, y; XMFLOAT2() = default; constexpr XMFLOAT2(float a,float b):x(a),y(b){} };
+struct XMFLOAT3 { float x, y, z; XMFLOAT3() = default; constexpr XMFLOAT3(float a,float b,float c):x(a),y(b),z(c){} };
+struct XMFLOAT4 { float x, y, z, w; XMFLOAT4() = default; constexpr XMFLOAT4(float a,float b,float c,float d):x(a),y(b),z(c),w(d){} };
+struct XMFLOAT3X4 { float m[3][4]; };
+struct XMFLOAT4X4 { float m[4][4]; };
+struct XMFLOAT3X3 { float m[3][3]; };
+struct XMINT4 { int32_t x, y, z, w; XMINT4() = default; constexpr XMINT4(int32_t a,int32_t b,int32_t c,int32_t d):x(a),y(b),z(c),w(d){} };
+struct XMUINT4 { uint32_t x, y, z, w; };
+struct XMUINT2 { uint32_t x, y; };
+struct XMUINT3 { uint32_t x, y, z; };
+inline XMVECTOR XMVectorSet(float x,float y,float z,float w){ XMVECTOR v; v.m128_f32[0]=x;v.m128_f32[1]=y;v.m128_f32[2]=z;v.m128_f32[3]=w; return v;}
+inline XMVECTOR XMVectorZero(){ return XMVectorSet(0,0,0,0);}
+inline XMVECTOR XMVectorReplicate(float f){ return XMVectorSet(f,f,f,f);}
+inline float XMVectorGetX(FXMVECTOR v){return v.m128_f32[0];} inline float XMVectorGetY(FXMVECTOR v){return v.m128_f32[1];}
+inline float XMVectorGetZ(FXMVECTOR v){return v.m128_f32[2];} inline float XMVectorGetW(FXMVECTOR v){return v.m128_f32[3];}
+#define XM_OP(name, expr) inline XMVECTOR name(FXMVECTOR a, FXMVECTOR b){ XMVECTOR r; for(int i=0;i<4;i++){ float x=a.m128_f32[i], y=b.m128_f32[i]; r.m128_f32[i]=(expr);} return r; }
+XM_OP(XMVectorAdd, x+y) XM_OP(XMVectorSubtract, x-y) XM_OP(XMVectorMultiply, x*y) XM_OP(XMVectorDivide, x/y) XM_OP(XMVectorMin, x<y?x:y) XM_OP(XMVectorMax, x>y?x:y)
+inline XMVECTOR XMVectorMultiplyAdd(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c){ return XMVectorAdd(XMVectorMultiply(a,b),c);}
+inline XMVECTOR XMVectorNegativeMultiplySubtract(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c){ return XMVectorSubtract(c,XMVectorMultiply(a,b));}
+inline XMVECTOR XMVectorScale(FXMVECTOR a, float s){ return XMVectorMultiply(a, XMVectorReplicate(s));}
+inline XMVECTOR XMVectorNegate(FXMVECTOR a){ return XMVectorScale(a,-1);}
+inline XMVECTOR XMVectorAbs(FXMVECTOR a){ XMVECTOR r; for(int i=0;i<4;i++) r.m128_f32[i]=std::fabs(a.m128_f32[i]); return r;}
+inline XMVECTOR XMVectorSqrt(FXMVECTOR a){ XMVECTOR r; for(int i=0;i<4;i++) r.m128_f32[i]=std::sqrt(a.m128_f32[i]); return r;}
+inline XMVECTOR XMVectorReciprocal(FXMVECTOR a){ XMVECTOR r; for(int i=0;i<4;i++) r.m128_f32[i]=1.0f/a.m128_f32[i]; return r;}
+inline XMVECTOR XMVectorSplatX(FXMVECTOR a){ return XMVectorReplicate(a.m128_f32[0]);} inline XMVECTOR XMVectorSplatY(FXMVECTOR a){ return XMVectorReplicate(a.m128_f32[1]);}
+inline XMVECTOR XMVectorSplatZ(FXMVECTOR a){ return XMVectorReplicate(a.m128_f32[2]);} inline XMVECTOR XMVectorSplatW(FXMVECTOR a){ return XMVectorReplicate(a.m128_f32[3]);}
+inline XMVECTOR XMVectorSetW(FXMVECTOR a, float w){ XMVECTOR r=a; r.m128_f32[3]=w; return r;}
+inline XMVECTOR XMVectorSetX(FXMVECTOR a, float w){ XMVECTOR r=a; r.m128_f32[0]=w; return r;}
+inline XMVECTOR XMVectorSelect(FXMVECTOR a, FXMVECTOR b, FXMVECTOR c){ XMVECTOR r; for(int i=0;i<4;i++) r.m128_u32[i]=(a.m128_u32[i]&~c.m128_u32[i])|(b.m128_u32[i]&c.m128_u32[i]); return r;}
+inline XMVECTOR XMVectorLess(FXMVECTOR a, FXMVECTOR b){ XMVECTOR r; for(int i=0;i<4;i++) r.m128_u32[i]=a.m128_f32[i]<b.m128_f32[i]?0xFFFFFFFFu:0; return r;}
+inline XMVECTOR XMVectorGreater(FXMVECTOR a, FXMVECTOR b){ return XMVectorLess(b,a);}
+inline XMVECTOR XMVectorSelectControl(uint32_t a,uint32_t b,uint32_t c,uint32_t d){ XMVECTOR r; r.m128_u32[0]=a?~0u:0;r.m128_u32[1]=b?~0u:0;r.m128_u32[2]=c?~0u:0;r.m128_u32[3]=d?~0u:0; return r;}
+inline void XMVectorSinCos(XMVECTOR* s, XMVECTOR* c, FXMVECTOR a){ for(int i=0;i<4;i++){ s->m128_f32[i]=std::sin(a.m128_f32[i]); c->m128_f32[i]=std::cos(a.m128_f32[i]); } }
+inline void XMScalarSinCos(float* s, float* c, float a){ *s=std::sin(a); *c=std::cos(a); }
+inline XMVECTOR XMVector4Dot(FXMVECTOR a, FXMVECTOR b){ float d=0; for(int i=0;i<4;i++) d+=a.m128_f32[i]*b.m128_f32[i]; return XMVectorReplicate(d);}
+inline XMVECTOR XMVector3Dot(FXMVECTOR a, FXMVECTOR b){ float d=0; for(int i=0;i<3;i++) d+=a.m128_f32[i]*b.m128_f32[i]; return XMVectorReplicate(d);}
+inline XMVECTOR XMVector3Cross(FXMVECTOR a, FXMVECTOR b){ const float* x=a.m128_f32; const float* y=b.m128_f32; return XMVectorSet(x[1]*y[2]-x[2]*y[1], x[2]*y[0]-x[0]*y[2], x[0]*y[1]-x[1]*y[0], 0);}
+inline XMVECTOR XMVector3Length(FXMVECTOR a){ return XMVectorSqrt(XMVector3Dot(a,a));}
+inline XMVECTOR XMVector3LengthSq(FXMVECTOR a){ return XMVector3Dot(a,a);}
+inline XMVECTOR XMVector3Normalize(FXMVECTOR a){ float l=XMVectorGetX(XMVector3Length(a)); return l>0?XMVectorScale(a,1.0f/l):a;}
+inline XMVECTOR XMVector4Length(FXMVECTOR a){ return XMVectorSqrt(XMVector4Dot(a,a));}
+inline XMVECTOR XMPlaneDotCoord(FXMVECTOR p, FXMVECTOR v){ return XMVectorReplicate(p.m128_f32[0]*v.m128_f32[0]+p.m128_f32[1]*v.m128_f32[1]+p.m128_f32[2]*v.m128_f32[2]+p.m128_f32[3]);}
+inline XMVECTOR XMPlaneNormalize(FXMVECTOR p){ float l=XMVectorGetX(XMVector3Length(p)); return XMVectorScale(p,1.0f/l);}
+inline XMVECTOR XMVector4Transform(FXMVECTOR v, FXMMATRIX m){ XMVECTOR r=XMVectorZero(); for(int i=0;i<4;i++) r=XMVectorAdd(r, XMVectorScale(m.r[i], v.m128_f32[i])); return r;}
+inline XMVECTOR XMVector3Transform(FXMVECTOR v, FXMMATRIX m){ return XMVector4Transform(XMVectorSetW(v,1), m);}
+inline XMVECTOR XMVector3TransformCoord(FXMVECTOR v, FXMMATRIX m){ XMVECTOR r=XMVector3Transform(v,m); return XMVectorScale(r, 1.0f/r.m128_f32[3]);}
+inline XMVECTOR XMVector3TransformNormal(FXMVECTOR v, FXMMATRIX m){ return XMVector4Transform(XMVectorSetW(v,0), m);}
+inline XMMATRIX XMMatrixMultiply(FXMMATRIX a, CXMMATRIX b){ XMMATRIX r; for(int i=0;i<4;i++) r.r[i]=XMVector4Transform(a.r[i], b); return r;}
+inline XMMATRIX XMMATRIX::operator*(const XMMATRIX& m) const { return XMMatrixMultiply(*this, m);}
+inline XMMATRIX XMMatrixSet(float a,float b,float c,float d,float e,float f,float g,float h,float i,float j,float k,float l,float m,float n,float o,float p){ return XMMATRIX(XMVectorSet(a,b,c,d),XMVectorSet(e,f,g,h),XMVectorSet(i,j,k,l),XMVectorSet(m,n,o,p));}
+inline XMMATRIX XMMatrixIdentity(){ return XMMatrixSet(1,0,0,0,0,1,0,0,0,0,1,0,0,0,0,1);}
+inline XMMATRIX XMMatrixTranslation(float x,float y,float z){ return XMMatrixSet(1,0,0,0,0,1,0,0,0,0,1,0,x,y,z,1);}
+inline XMMATRIX XMMatrixTranslationFromVector(FXMVECTOR v){ return XMMatrixTranslation(v.m128_f32[0],v.m128_f32[1],v.m128_f32[2]);}
+inline XMMATRIX XMMatrixScaling(float x,float y,float z){ return XMMatrixSet(x,0,0,0,0,y,0,0,0,0,z,0,0,0,0,1);}
+inline XMMATRIX XMMatrixRotationAxis(FXMVECTOR axis, float a){ XMVECTOR n=XMVector3Normalize(axis); float x=n.m128_f32[0],y=n.m128_f32[1],z=n.m128_f32[2]; float c=std::cos(a),s=std::sin(a),t=1-c;
+ return XMMatrixSet(t*x*x+c, t*x*y+s*z, t*x*z-s*y,0, t*x*y-s*z, t*y*y+c, t*y*z+s*x,0, t*x*z+s*y, t*y*z-s*x, t*z*z+c,0, 0,0,0,1);}
+inline XMMATRIX XMMatrixRotationY(float a){ return XMMatrixRotationAxis(XMVectorSet(0,1,0,0),a);}
+inline XMMATRIX XMMatrixTranspose(FXMMATRIX m){ XMMATRIX r; for(int i=0;i<4;i++) for(int j=0;j<4;j++) r.r[i].m128_f32[j]=m.r[j].m128_f32[i]; return r;}
+inline XMMATRIX XMMatrixInverse(XMVECTOR* det, FXMMATRIX m){ float a[4][8]; for(int i=0;i<4;i++) for(int j=0;j<4;j++){ a[i][j]=m.r[i].m128_f32[j]; a[i][j+4]=i==j; }
+ for(int c=0;c<4;c++){ int p=c; for(int r=c+1;r<4;r++) if(std::fabs(a[r][c])>std::fabs(a[p][c])) p=r; for(int j=0;j<8;j++){ float t=a[c][j]; a[c][j]=a[p][j]; a[p][j]=t; }
+ float d=a[c][c]; for(int j=0;j<8;j++) a[c][j]/=d; for(int r=0;r<4;r++) if(r!=c){ float f=a[r][c]; for(int j=0;j<8;j++) a[r][j]-=f*a[c][j]; } }
+ XMMATRIX r; for(int i=0;i<4;i++) for(int j=0;j<4;j++) r.r[i].m128_f32[j]=a[i][j+4]; if(det) *det=XMVectorZero(); return r;}
+inline XMMATRIX XMMatrixPerspectiveLH(float w, float h, float n, float f){ float tn=2*n; float range=f/(f-n); return XMMatrixSet(tn/w,0,0,0, 0,tn/h,0,0, 0,0,range,1, 0,0,-range*n,0);}
+inline XMVECTOR XMLoadFloat3(const XMFLOAT3* p){ return XMVectorSet(p->x,p->y,p->z,0);}
+inline XMVECTOR XMLoadFloat4(const XMFLOAT4* p){ return XMVectorSet(p->x,p->y,p->z,p->w);}
+inline void XMStoreFloat3(XMFLOAT3* p, FXMVECTOR v){ p->x=v.m128_f32[0]; p->y=v.m128_f32[1]; p->z=v.m128_f32[2];}
+inline void XMStoreFloat4(XMFLOAT4* p, FXMVECTOR v){ p->x=v.m128_f32[0]; p->y=v.m128_f32[1]; p->z=v.m128_f32[2]; p->w=v.m128_f32[3];}
+inline void XMStoreFloat3x4(XMFLOAT3X4* p, FXMMATRIX m){ XMMATRIX t=XMMatrixTranspose(m); for(int i=0;i<3;i++) for(int j=0;j<4;j++) p->m[i][j]=t.r[i].m128_f32[j];}
+inline void XMStoreFloat4x4(XMFLOAT4X4* p, FXMMATRIX m){ for(int i=0;i<4;i++) for(int j=0;j<4;j++) p->m[i][j]=m.r[i].m128_f32[j];}
+inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* p){ XMMATRIX r; for(int i=0;i<4;i++) for(int j=0;j<4;j++) r.r[i].m128_f32[j]=p->m[i][j]; return r;}
+}
@@ -0,0 +1,71 @@
+#pragma once
+// Device of the stand-in d3d11.h whose buffers live in system memory, for testing upload paths without a GPU.
+// Only buffers can be created, UploadDeviceContext copies UpdateSubresource data into them.
+#include <d3d11.h>
+#include <vector>
+#include "CountingDeviceContext.h"
+
+struct MemoryBuffer final : ID3D11Buffer
+{
+	D3D11_BUFFER_DESC desc = {};
+	std::vector<uint8_t> data;
+	ULONG refCount = 1;
+
+	ULONG Release() override
+	{
+		ULONG count = --refCount;
+		if (count == 0)
+			delete this;
+		return count;
+	}
+	ULONG AddRef() override { return ++refCount; }
+	HRESULT QueryInterface(const GUID&, void**) override { return E_NOINTERFACE; }
+	HRESULT SetPrivateData(const GUID&, UINT, const void*) override { return S_OK; }
+	void GetDesc(D3D11_BUFFER_DESC* pDesc) override { *pDesc = desc; }
+};
+
+struct MemoryDevice : ID3D11Device
+{
+	UINT bufferCount = 0;
+
+	ULONG Release() override { return 0; }
+	ULONG AddRef() override { return 0; }
+	HRESULT QueryInterface(const GUID&, void**) override { return E_NOINTERFACE; }
+
+	HRESULT CreateBuffer(const D3D11_BUFFER_DESC* pDesc, const D3D11_SUBRESOURCE_DATA* pInitialData, ID3D11Buffer** ppBuffer) override
+	{
+		MemoryBuffer* pBuffer = new MemoryBuffer();
+		pBuffer->desc = *pDesc;
+		pBuffer->data.resize(pDesc->ByteWidth);
+		if (pInitialData != nullptr)
+			memcpy(pBuffer->data.data(), pInitialData->pSysMem, pDesc->ByteWidth);
+		*ppBuffer = pBuffer;
+		bufferCount++;
+		return S_OK;
+	}
+	HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture2D**) override { return E_FAIL; }
+	HRESULT CreateShaderResourceView(ID3D11Resource*, const D3D11_SHADER_RESOURCE_VIEW_DESC*, ID3D11ShaderResourceView**) override { return E_FAIL; }
+	HRESULT CreateRenderTargetView(ID3D11Resource*, const void*, ID3D11RenderTargetView**) override { return E_FAIL; }
+	HRESULT CreateDepthStencilView(ID3D11Resource*, const void*, ID3D11DepthStencilView**) override { return E_FAIL; }
+	HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC*, ID3D11DepthStencilState**) override { return E_FAIL; }
+	HRESULT CreateBlendState(const D3D11_BLEND_DESC*, ID3D11BlendState**) override { return E_FAIL; }
+	HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC*, ID3D11SamplerState**) override { return E_FAIL; }
+	HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC*, UINT, const void*, size_t, ID3D11InputLayout**) override { return E_FAIL; }
+	HRESULT CreateVertexShader(const void*, size_t, ID3D11ClassLinkage*, ID3D11VertexShader**) override { return E_FAIL; }
+	HRESULT CreatePixelShader(const void*, size_t, ID3D11ClassLinkage*, ID3D11PixelShader**) override { return E_FAIL; }
+	HRESULT CheckFeatureSupport(D3D11_FEATURE, void*, UINT) override { return E_FAIL; }
+	HRESULT CreateQuery(const D3D11_QUERY_DESC*, ID3D11Query**) override { return E_FAIL; }
+};
+
+// Buffers only, the box is taken as a byte range
+struct UploadDeviceContext : CountingDeviceContext
+{
+	void UpdateSubresource(ID3D11Resource* pResource, UINT, const D3D11_BOX* pBox, const void* pData, UINT, UINT) override
+	{
+		MemoryBuffer* pBuffer = static_cast<MemoryBuffer*>(pResource);
+		size_t left = pBox != nullptr ? pBox->left : 0;
+		size_t right = pBox != nullptr ? pBox->right : pBuffer->data.size();
+		assert(left <= right && right <= pBuffer->data.size());
+		memcpy(pBuffer->data.data() + left, pData, right - left);
+	}
+};
@@ -0,0 +1,88 @@
+#include "windows.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	// File handles are descriptors, a mapping handle is the descriptor of its file
+	HANDLE ToHandle(int descriptor)
+	{
+		return reinterpret_cast<HANDLE>(intptr_t(descriptor) + 1);
+	}
+
+	int ToDescriptor(HANDLE handle)
+	{
+		return int(reinterpret_cast<intptr_t>(handle) - 1);
+	}
+
+	std::map<LPCVOID, size_t> s_views; // mapped size by address
+	std::mutex s_viewsMutex;
+}
+
+HANDLE CreateFileW(const wchar_t* fileName, DWORD access, DWORD, void*, DWORD disposition, DWORD, HANDLE)
+{
+	std::string path;
+	for (const wchar_t* p = fileName; *p; p++)
+		path += char(*p);
+	const int flags = (access & GENERIC_WRITE) ? O_WRONLY | (disposition == CREATE_ALWAYS ? O_CREAT | O_TRUNC : 0) : O_RDONLY;
+	const int descriptor = open(path.c_str(), flags, 0644);
+	return descriptor < 0 ? INVALID_HANDLE_VALUE : ToHandle(descriptor);
+}
+
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* pSize)
+{
+	struct stat status;
+	if (fstat(ToDescriptor(hFile), &status) != 0)
+		return FALSE;
+	pSize->QuadPart = status.st_size;
+	return TRUE;
+}
+
+BOOL WriteFile(HANDLE hFile, LPCVOID pData, DWORD size, DWORD* pWritten, void*)
+{
+	const ssize_t written = write(ToDescriptor(hFile), pData, size);
+	if (pWritten)
+		*pWritten = written < 0 ? 0 : DWORD(written);
+	return written == ssize_t(size);
+}
+
+HANDLE CreateFileMappingW(HANDLE hFile, void*, DWORD, DWORD, DWORD, const wchar_t*)
+{
+	return ToHandle(dup(ToDescriptor(hFile)));
+}
+
+LPVOID MapViewOfFile(HANDLE hMapping, DWORD, DWORD, DWORD, size_t)
+{
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(hMapping, &size) || size.QuadPart == 0)
+		return nullptr;
+	void* pView = mmap(nullptr, size_t(size.QuadPart), PROT_READ, MAP_PRIVATE, ToDescriptor(hMapping), 0);
+	if (pView == MAP_FAILED)
+		return nullptr;
+	std::lock_guard<std::mutex> lock(s_viewsMutex);
+	s_views[pView] = size_t(size.QuadPart);
+	return pView;
+}
+
+BOOL UnmapViewOfFile(LPCVOID pView)
+{
+	std::lock_guard<std::mutex> lock(s_viewsMutex);
+	auto view = s_views.find(pView);
+	if (view == s_views.end())
+		return FALSE;
+	munmap(const_cast<void*>(pView), view->second);
+	s_views.erase(view);
+	return TRUE;
+}
+
+BOOL CloseHandle(HANDLE handle)
+{
+	return close(ToDescriptor(handle)) == 0;
+}
+
+void OutputDebugStringA(const char* text)
+{
+	fputs(text, stderr);
+}
@@ -0,0 +1,118 @@
+#pragma once
+// Linux stand-in declaring the part of the SDK header the tested modules use, the interfaces are only ever mocked
+#include <dxgi.h>
+enum D3D11_USAGE { D3D11_USAGE_DEFAULT, D3D11_USAGE_IMMUTABLE, D3D11_USAGE_DYNAMIC, D3D11_USAGE_STAGING };
+enum { D3D11_BIND_VERTEX_BUFFER=1, D3D11_BIND_INDEX_BUFFER=2, D3D11_BIND_CONSTANT_BUFFER=4, D3D11_BIND_SHADER_RESOURCE=8, D3D11_BIND_RENDER_TARGET=0x20, D3D11_BIND_DEPTH_STENCIL=0x40, D3D11_BIND_UNORDERED_ACCESS=0x80 };
+enum { D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT=14, D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT=128, D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT=16 };
+enum { D3D11_CPU_ACCESS_WRITE=0x10000, D3D11_CPU_ACCESS_READ=0x20000 };
+enum { D3D11_RESOURCE_MISC_BUFFER_STRUCTURED=0x40, D3D11_RESOURCE_MISC_TEXTURECUBE=4, D3D11_RESOURCE_MISC_BUFFER_ALLOW_RAW_VIEWS=0x20 };
+enum D3D11_MAP { D3D11_MAP_READ=1, D3D11_MAP_WRITE=2, D3D11_MAP_READ_WRITE=3, D3D11_MAP_WRITE_DISCARD=4, D3D11_MAP_WRITE_NO_OVERWRITE=5 };
+enum D3D11_PRIMITIVE_TOPOLOGY { D3D11_PRIMITIVE_TOPOLOGY_UNDEFINED=0, D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST=4 };
+enum D3D11_SRV_DIMENSION { D3D11_SRV_DIMENSION_BUFFER=1, D3D11_SRV_DIMENSION_TEXTURE2D=4, D3D11_SRV_DIMENSION_TEXTURE2DARRAY=5, D3D11_SRV_DIMENSION_TEXTURECUBE=9, D3D11_SRV_DIMENSION_BUFFEREX=11 };
+#define D3D_SRV_DIMENSION_TEXTURECUBE D3D11_SRV_DIMENSION_TEXTURECUBE
+enum D3D11_INPUT_CLASSIFICATION { D3D11_INPUT_PER_VERTEX_DATA, D3D11_INPUT_PER_INSTANCE_DATA };
+enum D3D11_COMPARISON_FUNC { D3D11_COMPARISON_NEVER=1, D3D11_COMPARISON_LESS, D3D11_COMPARISON_EQUAL, D3D11_COMPARISON_LESS_EQUAL, D3D11_COMPARISON_GREATER, D3D11_COMPARISON_NOT_EQUAL, D3D11_COMPARISON_GREATER_EQUAL, D3D11_COMPARISON_ALWAYS };
+enum D3D11_DEPTH_WRITE_MASK { D3D11_DEPTH_WRITE_MASK_ZERO, D3D11_DEPTH_WRITE_MASK_ALL };
+enum D3D11_BLEND { D3D11_BLEND_ZERO=1, D3D11_BLEND_ONE=2, D3D11_BLEND_SRC_ALPHA=5, D3D11_BLEND_INV_SRC_ALPHA=6 };
+enum D3D11_BLEND_OP { D3D11_BLEND_OP_ADD=1 };
+enum { D3D11_COLOR_WRITE_ENABLE_RED=1, D3D11_COLOR_WRITE_ENABLE_GREEN=2, D3D11_COLOR_WRITE_ENABLE_BLUE=4, D3D11_COLOR_WRITE_ENABLE_ALPHA=8, D3D11_COLOR_WRITE_ENABLE_ALL=15 };
+enum D3D11_FILTER { D3D11_FILTER_ANISOTROPIC=0x55, D3D11_FILTER_MIN_MAG_MIP_POINT=0 };
+enum D3D11_TEXTURE_ADDRESS_MODE { D3D11_TEXTURE_ADDRESS_WRAP=1, D3D11_TEXTURE_ADDRESS_CLAMP=3 };
+enum { D3D11_CLEAR_DEPTH=1 };
+enum D3D11_FEATURE { D3D11_FEATURE_D3D11_OPTIONS=7 };
+enum D3D_FEATURE_LEVEL { D3D_FEATURE_LEVEL_11_0=0xb000 };
+struct D3D11_FEATURE_DATA_D3D11_OPTIONS { BOOL OutputMergerLogicOp, UAVOnlyRenderingForcedSampleCount, DiscardAPIsSeenByDriver, FlagsForUpdateAndCopySeenByDriver, ClearView, CopyWithOverlap, ConstantBufferPartialUpdate, ConstantBufferOffsetting, MapNoOverwriteOnDynamicConstantBuffer, MapNoOverwriteOnDynamicBufferSRV, MultisampleRTVWithForcedSampleCountOne, SAD4ShaderInstructions, ExtendedDoublesShaderInstructions, ExtendedResourceSharing; };
+struct D3D11_BUFFER_DESC { UINT ByteWidth; D3D11_USAGE Usage; UINT BindFlags; UINT CPUAccessFlags; UINT MiscFlags; UINT StructureByteStride; };
+struct D3D11_SUBRESOURCE_DATA { const void* pSysMem; UINT SysMemPitch; UINT SysMemSlicePitch; };
+struct D3D11_MAPPED_SUBRESOURCE { void* pData; UINT RowPitch; UINT DepthPitch; };
+struct D3D11_BOX { UINT left, top, front, right, bottom, back; };
+struct DXGI_SAMPLE_DESC { UINT Count, Quality; };
+struct D3D11_TEXTURE2D_DESC { UINT Width, Height, MipLevels, ArraySize; DXGI_FORMAT Format; DXGI_SAMPLE_DESC SampleDesc; D3D11_USAGE Usage; UINT BindFlags, CPUAccessFlags, MiscFlags; };
+struct D3D11_BUFFER_SRV { UINT FirstElement; UINT NumElements; };
+struct D3D11_BUFFEREX_SRV { UINT FirstElement; UINT NumElements; UINT Flags; };
+struct D3D11_TEX2D_SRV { UINT MostDetailedMip, MipLevels; };
+struct D3D11_TEX2D_ARRAY_SRV { UINT MostDetailedMip, MipLevels, FirstArraySlice, ArraySize; };
+struct D3D11_TEXCUBE_SRV { UINT MostDetailedMip, MipLevels; };
+struct D3D11_SHADER_RESOURCE_VIEW_DESC { DXGI_FORMAT Format; D3D11_SRV_DIMENSION ViewDimension; union { D3D11_BUFFER_SRV Buffer; D3D11_BUFFEREX_SRV BufferEx; D3D11_TEX2D_SRV Texture2D; D3D11_TEX2D_ARRAY_SRV Texture2DArray; D3D11_TEXCUBE_SRV TextureCube; }; };
+struct D3D11_INPUT_ELEMENT_DESC { const char* SemanticName; UINT SemanticIndex; DXGI_FORMAT Format; UINT InputSlot; UINT AlignedByteOffset; D3D11_INPUT_CLASSIFICATION InputSlotClass; UINT InstanceDataStepRate; };
+struct D3D11_DEPTH_STENCIL_DESC { BOOL DepthEnable; D3D11_DEPTH_WRITE_MASK DepthWriteMask; D3D11_COMPARISON_FUNC DepthFunc; BOOL StencilEnable; };
+struct D3D11_RENDER_TARGET_BLEND_DESC { BOOL BlendEnable; D3D11_BLEND SrcBlend, DestBlend; D3D11_BLEND_OP BlendOp; D3D11_BLEND SrcBlendAlpha, DestBlendAlpha; D3D11_BLEND_OP BlendOpAlpha; UINT8 RenderTargetWriteMask; };
+struct D3D11_BLEND_DESC { BOOL AlphaToCoverageEnable, IndependentBlendEnable; D3D11_RENDER_TARGET_BLEND_DESC RenderTarget[8]; };
+struct D3D11_SAMPLER_DESC { D3D11_FILTER Filter; D3D11_TEXTURE_ADDRESS_MODE AddressU, AddressV, AddressW; FLOAT MipLODBias; UINT MaxAnisotropy; D3D11_COMPARISON_FUNC ComparisonFunc; FLOAT BorderColor[4]; FLOAT MinLOD, MaxLOD; };
+struct D3D11_VIEWPORT { FLOAT TopLeftX, TopLeftY, Width, Height, MinDepth, MaxDepth; };
+typedef RECT D3D11_RECT;
+const GUID WKPDID_D3DDebugObjectName = {};
+struct ID3D11DeviceChild : IUnknown { virtual HRESULT SetPrivateData(const GUID&, UINT, const void*) = 0; };
+struct ID3D11Resource : ID3D11DeviceChild {};
+struct ID3D11Buffer : ID3D11Resource { virtual void GetDesc(D3D11_BUFFER_DESC*) = 0; };
+struct ID3D11Texture2D : ID3D11Resource { virtual void GetDesc(D3D11_TEXTURE2D_DESC*) = 0; };
+struct ID3D11View : ID3D11DeviceChild { virtual void GetResource(ID3D11Resource**) = 0; };
+struct ID3D11ShaderResourceView : ID3D11View {};
+struct ID3D11RenderTargetView : ID3D11View {};
+struct ID3D11DepthStencilView : ID3D11View {};
+struct ID3D11UnorderedAccessView : ID3D11View {};
+struct ID3D11VertexShader : ID3D11DeviceChild {};
+struct ID3D11PixelShader : ID3D11DeviceChild {};
+struct ID3D11ComputeShader : ID3D11DeviceChild {};
+struct ID3D11InputLayout : ID3D11DeviceChild {};
+struct ID3D11SamplerState : ID3D11DeviceChild {};
+struct ID3D11BlendState : ID3D11DeviceChild {};
+struct ID3D11DepthStencilState : ID3D11DeviceChild {};
+struct ID3D11RasterizerState : ID3D11DeviceChild {};
+struct ID3D11Asynchronous : ID3D11DeviceChild {};
+struct ID3D11Query : ID3D11Asynchronous {};
+enum D3D11_QUERY { D3D11_QUERY_EVENT=0 };
+struct D3D11_QUERY_DESC { D3D11_QUERY Query; UINT MiscFlags; };
+enum { D3D11_ASYNC_GETDATA_DONOTFLUSH=1 };
+struct ID3D11ClassInstance; struct ID3D11ClassLinkage;
+struct ID3D11DeviceContext : ID3D11DeviceChild {
+ virtual void ClearState()=0;
+ virtual HRESULT Map(ID3D11Resource*, UINT, D3D11_MAP, UINT, D3D11_MAPPED_SUBRESOURCE*)=0;
+ virtual void Unmap(ID3D11Resource*, UINT)=0;
+ virtual void End(ID3D11Asynchronous*)=0;
+ virtual HRESULT GetData(ID3D11Asynchronous*, void*, UINT, UINT)=0;
+ virtual void UpdateSubresource(ID3D11Resource*, UINT, const D3D11_BOX*, const void*, UINT, UINT)=0;
+ virtual void OMSetRenderTargets(UINT, ID3D11RenderTargetView* const*, ID3D11DepthStencilView*)=0;
+ virtual void ClearRenderTargetView(ID3D11RenderTargetView*, const FLOAT[4])=0;
+ virtual void ClearDepthStencilView(ID3D11DepthStencilView*, UINT, FLOAT, UINT8)=0;
+ virtual void RSSetViewports(UINT, const D3D11_VIEWPORT*)=0;
+ virtual void RSSetScissorRects(UINT, const D3D11_RECT*)=0;
+ virtual void RSSetState(ID3D11RasterizerState*)=0;
+ virtual void OMSetDepthStencilState(ID3D11DepthStencilState*, UINT)=0;
+ virtual void OMSetBlendState(ID3D11BlendState*, const FLOAT[4], UINT)=0;
+ virtual void IASetInputLayout(ID3D11InputLayout*)=0;
+ virtual void IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY)=0;
+ virtual void IASetIndexBuffer(ID3D11Buffer*, DXGI_FORMAT, UINT)=0;
+ virtual void IASetVertexBuffers(UINT, UINT, ID3D11Buffer* const*, const UINT*, const UINT*)=0;
+ virtual void VSSetShader(ID3D11VertexShader*, ID3D11ClassInstance* const*, UINT)=0;
+ virtual void PSSetShader(ID3D11PixelShader*, ID3D11ClassInstance* const*, UINT)=0;
+ virtual void VSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*)=0;
+ virtual void PSSetConstantBuffers(UINT, UINT, ID3D11Buffer* const*)=0;
+ virtual void VSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*)=0;
+ virtual void PSSetShaderResources(UINT, UINT, ID3D11ShaderResourceView* const*)=0;
+ virtual void PSSetSamplers(UINT, UINT, ID3D11SamplerState* const*)=0;
+ virtual void Draw(UINT, UINT)=0;
+ virtual void DrawIndexed(UINT, UINT, INT)=0;
+ virtual void DrawIndexedInstanced(UINT, UINT, UINT, INT, UINT)=0;
+ virtual void CopyResource(ID3D11Resource*, ID3D11Resource*)=0;
+};
+enum D3D_DRIVER_TYPE { D3D_DRIVER_TYPE_UNKNOWN };
+#define D3D11_SDK_VERSION 7
+enum { D3D11_CREATE_DEVICE_DEBUG = 2 };
+struct ID3D11DeviceContext;
+struct ID3D11Device;
+struct ID3D11Device : IUnknown {
+ virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Buffer**)=0;
+ virtual HRESULT CreateTexture2D(const D3D11_TEXTURE2D_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Texture2D**)=0;
+ virtual HRESULT CreateShaderResourceView(ID3D11Resource*, const D3D11_SHADER_RESOURCE_VIEW_DESC*, ID3D11ShaderResourceView**)=0;
+ virtual HRESULT CreateRenderTargetView(ID3D11Resource*, const void*, ID3D11RenderTargetView**)=0;
+ virtual HRESULT CreateDepthStencilView(ID3D11Resource*, const void*, ID3D11DepthStencilView**)=0;
+ virtual HRESULT CreateDepthStencilState(const D3D11_DEPTH_STENCIL_DESC*, ID3D11DepthStencilState**)=0;
+ virtual HRESULT CreateBlendState(const D3D11_BLEND_DESC*, ID3D11BlendState**)=0;
+ virtual HRESULT CreateSamplerState(const D3D11_SAMPLER_DESC*, ID3D11SamplerState**)=0;
+ virtual HRESULT CreateInputLayout(const D3D11_INPUT_ELEMENT_DESC*, UINT, const void*, size_t, ID3D11InputLayout**)=0;
+ virtual HRESULT CreateVertexShader(const void*, size_t, ID3D11ClassLinkage*, ID3D11VertexShader**)=0;
+ virtual HRESULT CreatePixelShader(const void*, size_t, ID3D11ClassLinkage*, ID3D11PixelShader**)=0;
+ virtual HRESULT CheckFeatureSupport(D3D11_FEATURE, void*, UINT)=0;
+ virtual HRESULT CreateQuery(const D3D11_QUERY_DESC*, ID3D11Query**)=0;
+};
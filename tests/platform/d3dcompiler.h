@@ -0,0 +1,9 @@
+#pragma once
+// Linux stand-in declaring the part of the SDK header the tested modules use, the interfaces are only ever mocked
+#include <d3d11.h>
+struct ID3DBlob : IUnknown { virtual void* GetBufferPointer()=0; virtual size_t GetBufferSize()=0; };
+struct D3D_SHADER_MACRO { const char* Name; const char* Definition; };
+enum D3D_INCLUDE_TYPE { D3D_INCLUDE_LOCAL };
+struct ID3DInclude { virtual HRESULT Open(D3D_INCLUDE_TYPE, LPCSTR, LPCVOID, LPCVOID*, UINT*)=0; virtual HRESULT Close(LPCVOID)=0; };
+#define D3DCOMPILE_DEBUG 1
+#define D3DCOMPILE_SKIP_OPTIMIZATION 4
@@ -0,0 +1,18 @@
+#pragma once
+// Linux stand-in declaring the part of the SDK header the tested modules use, the interfaces are only ever mocked
+#include <windows.h>
+enum DXGI_FORMAT { DXGI_FORMAT_UNKNOWN, DXGI_FORMAT_R16_UINT, DXGI_FORMAT_R32_UINT, DXGI_FORMAT_R32_FLOAT, DXGI_FORMAT_R32G32_FLOAT, DXGI_FORMAT_R32G32B32_FLOAT, DXGI_FORMAT_R32G32B32A32_FLOAT, DXGI_FORMAT_R8G8B8A8_UNORM, DXGI_FORMAT_D32_FLOAT, DXGI_FORMAT_R32G32B32A32_UINT, DXGI_FORMAT_R32_TYPELESS, DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R11G11B10_FLOAT };
+struct IUnknown { virtual ULONG Release() = 0; virtual ULONG AddRef() = 0; virtual HRESULT QueryInterface(const GUID&, void**) = 0; };
+#define __uuidof(x) (*(const GUID*)nullptr)
+enum DXGI_MODE_SCANLINE_ORDER { DXGI_MODE_SCANLINE_ORDER_UNSPECIFIED };
+enum DXGI_MODE_SCALING { DXGI_MODE_SCALING_UNSPECIFIED };
+enum DXGI_SWAP_EFFECT { DXGI_SWAP_EFFECT_FLIP_DISCARD=4 };
+#define DXGI_USAGE_RENDER_TARGET_OUTPUT 0x20
+struct DXGI_RATIONAL { UINT Numerator, Denominator; };
+struct DXGI_MODE_DESC { UINT Width, Height; DXGI_RATIONAL RefreshRate; DXGI_FORMAT Format; DXGI_MODE_SCANLINE_ORDER ScanlineOrdering; DXGI_MODE_SCALING Scaling; };
+struct DXGI_SAMPLE_DESC_ { UINT Count, Quality; };
+struct DXGI_SWAP_CHAIN_DESC { DXGI_MODE_DESC BufferDesc; DXGI_SAMPLE_DESC_ SampleDesc; UINT BufferUsage; UINT BufferCount; HWND OutputWindow; BOOL Windowed; DXGI_SWAP_EFFECT SwapEffect; UINT Flags; };
+struct DXGI_ADAPTER_DESC { WCHAR Description[128]; };
+struct IDXGIAdapter : IUnknown { virtual HRESULT GetDesc(DXGI_ADAPTER_DESC*)=0; };
+struct IDXGISwapChain : IUnknown { virtual HRESULT Present(UINT, UINT)=0; virtual HRESULT GetBuffer(UINT, const GUID&, void**)=0; virtual HRESULT ResizeBuffers(UINT, UINT, UINT, DXGI_FORMAT, UINT)=0; };
+struct IDXGIFactory : IUnknown { virtual HRESULT EnumAdapters(UINT, IDXGIAdapter**)=0; virtual HRESULT CreateSwapChain(IUnknown*, DXGI_SWAP_CHAIN_DESC*, IDXGISwapChain**)=0; };
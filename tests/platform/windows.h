@@ -0,0 +1,105 @@
+#pragma once
+// Linux stand-in for the parts of the Windows SDK the tested CG_lab7 modules use. The standard headers below are
+// the ones MSVC and framework.h make visible to those modules.
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+typedef int BOOL;
+typedef unsigned char BYTE;
+typedef unsigned short USHORT;
+typedef int INT;
+typedef unsigned int UINT;
+typedef long LONG;
+typedef unsigned long ULONG;
+typedef unsigned long DWORD;
+typedef long long LONGLONG;
+typedef float FLOAT;
+typedef uint8_t UINT8;
+typedef uint16_t UINT16;
+typedef uint32_t UINT32;
+typedef int32_t INT32;
+typedef uint64_t UINT64;
+typedef uintptr_t UINT_PTR;
+typedef wchar_t WCHAR;
+typedef long HRESULT;
+typedef void* HANDLE;
+typedef void* HWND;
+typedef void* LPVOID;
+typedef const void* LPCVOID;
+typedef const char* LPCSTR;
+
+typedef union
+{
+	struct
+	{
+		DWORD LowPart;
+		LONG HighPart;
+	};
+	LONGLONG QuadPart;
+} LARGE_INTEGER;
+
+struct RECT
+{
+	long left, top, right, bottom;
+};
+
+struct GUID
+{
+	uint32_t data[4];
+};
+
+#define TRUE 1
+#define FALSE 0
+#define S_OK ((HRESULT)0)
+#define S_FALSE ((HRESULT)1)
+#define E_FAIL ((HRESULT)0x80004005L)
+#define E_NOINTERFACE ((HRESULT)0x80004002L)
+#define E_OUTOFMEMORY ((HRESULT)0x8007000EL)
+#define E_INVALIDARG ((HRESULT)0x80070057L)
+#define SUCCEEDED(hr) (((HRESULT)(hr)) >= 0)
+#define FAILED(hr) (((HRESULT)(hr)) < 0)
+
+#ifndef min
+#define min(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+
+#define INVALID_HANDLE_VALUE ((HANDLE)(intptr_t)-1)
+#define GENERIC_READ 0x80000000ul
+#define GENERIC_WRITE 0x40000000ul
+#define FILE_SHARE_READ 1
+#define CREATE_ALWAYS 2
+#define OPEN_EXISTING 3
+#define FILE_ATTRIBUTE_NORMAL 0x80
+#define PAGE_READONLY 2
+#define FILE_MAP_READ 4
+
+// Implemented over POSIX files in Windows.cpp
+HANDLE CreateFileW(const wchar_t* fileName, DWORD access, DWORD shareMode, void* pSecurity, DWORD disposition, DWORD flags, HANDLE hTemplate);
+BOOL GetFileSizeEx(HANDLE hFile, LARGE_INTEGER* pSize);
+BOOL WriteFile(HANDLE hFile, LPCVOID pData, DWORD size, DWORD* pWritten, void* pOverlapped);
+HANDLE CreateFileMappingW(HANDLE hFile, void* pSecurity, DWORD protect, DWORD sizeHigh, DWORD sizeLow, const wchar_t* name);
+LPVOID MapViewOfFile(HANDLE hMapping, DWORD access, DWORD offsetHigh, DWORD offsetLow, size_t size);
+BOOL UnmapViewOfFile(LPCVOID pView);
+BOOL CloseHandle(HANDLE handle);
+void OutputDebugStringA(const char* text);